@@ -404,7 +404,8 @@ void async_loop() {
 
 	struct uwsgi_async_request *current_request = NULL;
 
-	void *events = event_queue_alloc(64);
+	if (uwsgi.event_batch < 1) uwsgi.event_batch = 1;
+	void *events = event_queue_alloc(uwsgi.event_batch);
 	struct uwsgi_socket *uwsgi_sock;
 
 	uwsgi_async_init();
@@ -448,7 +449,8 @@ void async_loop() {
 			}
 		}
 
-		uwsgi.async_nevents = event_queue_wait_multi(uwsgi.async_queue, timeout, events, 64);
+		uwsgi.async_nevents = event_queue_wait_multi(uwsgi.async_queue, timeout, events, uwsgi.event_batch);
+		uwsgi_events_histogram_add(&uwsgi.workers[uwsgi.mywid].async_events, uwsgi.async_nevents);
 
 		now = (uint64_t) uwsgi_now();
 		// timeout ???
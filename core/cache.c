@@ -1,8 +1,181 @@
 #include <uwsgi.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 extern struct uwsgi_server uwsgi;
 #define cache_item(x) (struct uwsgi_cache_item *) (((char *)uc->items) + ((sizeof(struct uwsgi_cache_item)+uc->keysize) * x))
 
+// open addressing index
+
+/* how the open addressing index works:
+
+	by default colliding items are chained via their prev/next fields, so every hop
+	of a lookup touches a different item header (that could be kilobytes away in the cache area).
+
+	With index=open (--cache2 only) the hashtable is replaced by an array of buckets, each one
+	exactly a cache line (struct uwsgi_cache_bucket) holding 8 hash tags and 8 item slots.
+
+	A lookup maps the hash to a bucket and compares the 8 tags at once (with SSE2 when available),
+	item headers are touched only on a tag match. If the key is not there and the bucket has an
+	empty entry the lookup ends, otherwise the next bucket is probed (linear probing).
+
+	Removed entries become tombstones only if their bucket is full, so a bucket with
+	an empty entry never has items of its probe sequence stored after it.
+	Tombstones are reused by additions, when they are more than 1/UWSGI_CACHE_TOMBSTONES_RATIO
+	of the entries the sweeper thread of the master rebuilds the index from the items (so missing keys
+	do not probe longer and longer). The rebuild never runs in the request deleting the item,
+	open index caches always get a sweeper (even with expiration disabled) for this reason.
+
+	The index is sized for a load factor <= 50%, so probing rarely leaves the first bucket.
+
+*/
+
+#define UWSGI_CACHE_TAG_EMPTY 0
+#define UWSGI_CACHE_TAG_DELETED 1
+#define UWSGI_CACHE_TOMBSTONES_RATIO 8
+
+static uint32_t cache_bucket_tag(uint32_t hash) {
+	// 0 and 1 are reserved
+	if (hash < 2) return hash + 2;
+	return hash;
+}
+
+// returns a bitmask of the bucket entries with the specified tag
+static uint32_t cache_bucket_match(struct uwsgi_cache_bucket *ucb, uint32_t tag) {
+#ifdef __SSE2__
+	__m128i needle = _mm_set1_epi32((int) tag);
+	__m128i low = _mm_cmpeq_epi32(_mm_load_si128((__m128i *) &ucb->tags[0]), needle);
+	__m128i high = _mm_cmpeq_epi32(_mm_load_si128((__m128i *) &ucb->tags[4]), needle);
+	return (uint32_t) _mm_movemask_ps(_mm_castsi128_ps(low)) | ((uint32_t) _mm_movemask_ps(_mm_castsi128_ps(high)) << 4);
+#else
+	uint32_t mask = 0;
+	int i;
+	for(i=0;i<8;i++) {
+		if (ucb->tags[i] == tag) mask |= 1 << i;
+	}
+	return mask;
+#endif
+}
+
+static uint64_t uwsgi_cache_open_get_index(struct uwsgi_cache *uc, uint32_t hash, char *key, uint16_t keylen) {
+	uint32_t tag = cache_bucket_tag(hash);
+	uint64_t pos = hash & (uc->buckets_n - 1);
+	uint64_t probes;
+	for(probes=0;probes<uc->buckets_n;probes++) {
+		struct uwsgi_cache_bucket *ucb = &uc->buckets[pos];
+		uint32_t mask = cache_bucket_match(ucb, tag);
+		while(mask) {
+			int i = __builtin_ctz(mask);
+			uint64_t slot = ucb->slots[i];
+			struct uwsgi_cache_item *uci = cache_item(slot);
+			if (uci->keysize == keylen && !memcmp(uci->key, key, keylen)) return slot;
+			mask &= mask - 1;
+		}
+		if (cache_bucket_match(ucb, UWSGI_CACHE_TAG_EMPTY)) return 0;
+		pos = (pos + 1) & (uc->buckets_n - 1);
+	}
+	return 0;
+}
+
+static void uwsgi_cache_open_add(struct uwsgi_cache *uc, uint32_t hash, uint64_t index) {
+	uint64_t pos = hash & (uc->buckets_n - 1);
+	uint64_t probes;
+	for(probes=0;probes<uc->buckets_n;probes++) {
+		struct uwsgi_cache_bucket *ucb = &uc->buckets[pos];
+		uint32_t mask = cache_bucket_match(ucb, UWSGI_CACHE_TAG_EMPTY) | cache_bucket_match(ucb, UWSGI_CACHE_TAG_DELETED);
+		if (mask) {
+			int i = __builtin_ctz(mask);
+			if (ucb->tags[i] == UWSGI_CACHE_TAG_DELETED) uc->buckets_tombstones--;
+			ucb->slots[i] = index;
+			ucb->tags[i] = cache_bucket_tag(hash);
+			return;
+		}
+		pos = (pos + 1) & (uc->buckets_n - 1);
+	}
+	// this should never happen as the index is always bigger than max_items
+	uwsgi_log("[uwsgi-cache] BUG: no free bucket in the index of cache \"%s\"\n", uc->name);
+}
+
+// drop all of the tombstones re-adding the live items to an empty index
+static void uwsgi_cache_open_rebuild(struct uwsgi_cache *uc) {
+	uint64_t i;
+	memset(uc->buckets, 0, sizeof(struct uwsgi_cache_bucket) * uc->buckets_n);
+	uc->buckets_tombstones = 0;
+	for (i = 0; i < uc->max_items; i++) {
+		struct uwsgi_cache_item *uci = cache_item(i);
+		if (uci->keysize) {
+			uwsgi_cache_open_add(uc, uci->hash, i);
+		}
+	}
+}
+
+static void uwsgi_cache_open_del(struct uwsgi_cache *uc, uint32_t hash, uint64_t index) {
+	uint32_t tag = cache_bucket_tag(hash);
+	uint64_t pos = hash & (uc->buckets_n - 1);
+	uint64_t probes;
+	for(probes=0;probes<uc->buckets_n;probes++) {
+		struct uwsgi_cache_bucket *ucb = &uc->buckets[pos];
+		uint32_t mask = cache_bucket_match(ucb, tag);
+		while(mask) {
+			int i = __builtin_ctz(mask);
+			if (ucb->slots[i] == index) {
+				ucb->slots[i] = 0;
+				if (cache_bucket_match(ucb, UWSGI_CACHE_TAG_EMPTY)) {
+					ucb->tags[i] = UWSGI_CACHE_TAG_EMPTY;
+					return;
+				}
+				ucb->tags[i] = UWSGI_CACHE_TAG_DELETED;
+				uc->buckets_tombstones++;
+				return;
+			}
+			mask &= mask - 1;
+		}
+		if (cache_bucket_match(ucb, UWSGI_CACHE_TAG_EMPTY)) return;
+		pos = (pos + 1) & (uc->buckets_n - 1);
+	}
+}
+
+// lockless reads
+
+/* how lockless reads work:
+
+	with lockless=1 (--cache2 only) uwsgi_cache_magic_get() does not take the cache lock.
+
+	Writers (always holding the write lock) make the cache sequence counter odd while
+	inserting or removing items, and the item version odd while updating its value in place.
+
+	Readers take a snapshot of both counters, copy the value and retry if one of them
+	changed (or was odd). After UWSGI_CACHE_LOCKLESS_RETRIES attempts they fall back to the locked path.
+
+	Readers never trust what they read before validating it, so every offset is bound-checked.
+
+*/
+
+#define UWSGI_CACHE_LOCKLESS_RETRIES 3
+
+static void cache_seq_begin(volatile uint64_t *seq) {
+	if (!seq) return;
+	(*seq)++;
+	__sync_synchronize();
+}
+
+static void cache_seq_end(volatile uint64_t *seq) {
+	if (!seq) return;
+	__sync_synchronize();
+	(*seq)++;
+}
+
+static void uwsgi_cache_reset_index(struct uwsgi_cache *uc) {
+	if (uc->use_open_index) {
+		memset(uc->buckets, 0, sizeof(struct uwsgi_cache_bucket) * uc->buckets_n);
+		uc->buckets_tombstones = 0;
+		return;
+	}
+	memset(uc->hashtable, 0, sizeof(uint64_t) * uc->hashsize);
+}
+
 // block bitmap manager
 
 /* how the cache bitmap works:
@@ -83,7 +256,7 @@ static uint64_t uwsgi_cache_find_free_blocks(struct uwsgi_cache *uc, uint64_t ne
 		j++;
 		need_to_scan--;
 		// check for overlap
-		if (j >= need_to_scan) {
+		if (j >= uc->blocks_bitmap_size) {
 			j = 0;
 			found = 0;
 			base = 0xffffffffffffffffLLU;
@@ -96,63 +269,632 @@ static uint64_t uwsgi_cache_find_free_blocks(struct uwsgi_cache *uc, uint64_t ne
 	return 0xffffffffffffffffLLU;
 }
 
+// set (or clear) the bits of the blocks [index, index+n)
+static void cache_bitmap_fill(struct uwsgi_cache *uc, uint64_t index, uint64_t n, int used) {
+	uint64_t i = index;
+	uint64_t last = index + n;
+	while(i < last) {
+		// whole bytes at once
+		if (i % 8 == 0 && i + 8 <= last) {
+			uc->blocks_bitmap[i/8] = used ? 0xff : 0;
+			i += 8;
+			continue;
+		}
+		uint8_t mask = 1 << (7 - (i % 8));
+		if (used) {
+			uc->blocks_bitmap[i/8] |= mask;
+		}
+		else {
+			uc->blocks_bitmap[i/8] &= ~mask;
+		}
+		i++;
+	}
+}
+
 static uint64_t cache_mark_blocks(struct uwsgi_cache *uc, uint64_t index, uint64_t len) {
 	uint64_t needed_blocks = len/uc->blocksize;
 	if (len % uc->blocksize > 0) needed_blocks++;
+	cache_bitmap_fill(uc, index, needed_blocks, 1);
+	return needed_blocks;
+}
+
+static void cache_unmark_blocks(struct uwsgi_cache *uc, uint64_t index, uint64_t len) {
+	uint64_t needed_blocks = len/uc->blocksize;
+        if (len % uc->blocksize > 0) needed_blocks++;
+	cache_bitmap_fill(uc, index, needed_blocks, 0);
+}
+
+// slab allocator
+
+/* how the slab allocator works:
+
+	with slabs=1 (--cache2 only) the data area is split in pages (slab_page, 1MB by default)
+	and every value is stored in a chunk of the smallest size class able to contain it (like memcached).
+
+	Size classes are multiple of the blocksize, each one slab_factor (1.25 by default) bigger than the previous one,
+	the last one spans a whole page (so it is the max item size).
 
-	uint64_t first_byte = index/8;
-	uint8_t first_byte_bit = index % 8;
-	uint64_t last_byte = (index+needed_blocks)/8;
-	uint8_t last_byte_bit = (index+needed_blocks) % 8;
+	Every class has a free list of chunks (linked through the first 8 bytes of the free chunks)
+	and a page it is carving new chunks from. A page is assigned to a class the first time
+	the class needs it and it is never given back, so both allocations and releases are O(1).
 
-	//uwsgi_log("%llu %u %llu %u\n", first_byte, first_byte_bit, last_byte, last_byte_bit);
+	The price is internal fragmentation (a chunk is generally bigger than the value), reported by the stats server.
 
-	uint8_t mask = 0xff >> first_byte_bit;
-	uc->blocks_bitmap[first_byte] |= mask;
+*/
+
+#define UWSGI_CACHE_SLAB_MAX_CLASSES 64
+#define UWSGI_CACHE_SLAB_FREE_PAGE 0xff
+#define cache_slab_chunk(uc, block) ((uint64_t *) (((char *) uc->data) + ((block) * uc->blocksize)))
 
-	uint64_t needed_bytes = (last_byte - first_byte)+1;
+static void cache_slabs_init(struct uwsgi_cache *uc) {
+	uc->slab_page_blocks = uc->slab_page_size / uc->blocksize;
+	if (uc->slab_page_size % uc->blocksize) uc->slab_page_blocks++;
+	if (uc->slab_page_blocks > uc->blocks) uc->slab_page_blocks = uc->blocks;
+	uc->max_item_size = uc->slab_page_blocks * uc->blocksize;
+	uc->slab_pages = uc->blocks / uc->slab_page_blocks;
 
-	if (needed_bytes > 1) {
-		mask = 0xff << (8 - last_byte_bit);
-		uc->blocks_bitmap[last_byte-1] |= mask;
+	uc->slabs = uwsgi_calloc_shared(sizeof(struct uwsgi_cache_slab_class) * UWSGI_CACHE_SLAB_MAX_CLASSES);
+	uint64_t chunk_blocks = 1;
+	for(;;) {
+		if (uc->slabs_n == UWSGI_CACHE_SLAB_MAX_CLASSES-1) chunk_blocks = uc->slab_page_blocks;
+		uc->slabs[uc->slabs_n].chunk_blocks = chunk_blocks;
+		uc->slabs_n++;
+		if (chunk_blocks >= uc->slab_page_blocks) break;
+		uint64_t next = (uint64_t) ((double) chunk_blocks * uc->slab_factor);
+		if (next <= chunk_blocks) next = chunk_blocks + 1;
+		// do not waste the tail of the page, jump to the last class
+		if (next > uc->slab_page_blocks / 2) next = uc->slab_page_blocks;
+		chunk_blocks = next;
 	}
 
-	if (needed_bytes > 2) {
-		uint8_t *ptr = &uc->blocks_bitmap[first_byte+1];
-		memset(ptr, 0xff, needed_bytes-2);
+	uc->slab_page_class = uwsgi_malloc_shared(uc->slab_pages);
+	memset(uc->slab_page_class, UWSGI_CACHE_SLAB_FREE_PAGE, uc->slab_pages);
+}
+
+static void cache_slabs_reset(struct uwsgi_cache *uc) {
+	uint64_t i;
+	for(i=0;i<uc->slabs_n;i++) {
+		struct uwsgi_cache_slab_class *usc = &uc->slabs[i];
+		uint64_t chunk_blocks = usc->chunk_blocks;
+		memset(usc, 0, sizeof(struct uwsgi_cache_slab_class));
+		usc->chunk_blocks = chunk_blocks;
 	}
-	return needed_blocks;
+	memset(uc->slab_page_class, UWSGI_CACHE_SLAB_FREE_PAGE, uc->slab_pages);
+	uc->slab_pages_used = 0;
+	uc->slab_next_page = 0;
 }
 
-static void cache_unmark_blocks(struct uwsgi_cache *uc, uint64_t index, uint64_t len) {
-	uint64_t needed_blocks = len/uc->blocksize;
-        if (len % uc->blocksize > 0) needed_blocks++;
+static uint8_t cache_slab_class(struct uwsgi_cache *uc, uint64_t vallen) {
+	uint64_t needed_blocks = vallen/uc->blocksize;
+	if (vallen % uc->blocksize > 0) needed_blocks++;
+	// binary search the smallest class
+	uint8_t low = 0, high = uc->slabs_n - 1;
+	while(low < high) {
+		uint8_t mid = (low + high) / 2;
+		if (uc->slabs[mid].chunk_blocks < needed_blocks) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	return low;
+}
 
-        uint64_t first_byte = index/8;
-        uint8_t first_byte_bit = index % 8;
-        uint64_t last_byte = (index+needed_blocks)/8;
-        uint8_t last_byte_bit = (index+needed_blocks) % 8;
+static int cache_slab_has_room(struct uwsgi_cache *uc, uint64_t vallen) {
+	struct uwsgi_cache_slab_class *usc = &uc->slabs[cache_slab_class(uc, vallen)];
+	return usc->free_list || usc->carve < usc->carve_end || uc->slab_pages_used < uc->slab_pages;
+}
 
-	// here we use XOR (0+0 = 0 | 1+0 = 1 | 0+1 = 1| 1+1 = 0|
+static uint64_t cache_slab_alloc(struct uwsgi_cache *uc, uint64_t vallen) {
+	uint8_t class = cache_slab_class(uc, vallen);
+	struct uwsgi_cache_slab_class *usc = &uc->slabs[class];
+	uint64_t block;
+	// blocks are stored +1 in the free list (0 is the end of the list)
+	if (usc->free_list) {
+		block = usc->free_list - 1;
+		usc->free_list = *cache_slab_chunk(uc, block);
+		usc->free--;
+	}
+	else {
+		if (usc->carve >= usc->carve_end) {
+			if (uc->slab_pages_used >= uc->slab_pages) return 0xffffffffffffffffLLU;
+			// pages are never released, so the next free one is generally at the hint
+			uint64_t page = uc->slab_next_page;
+			while(uc->slab_page_class[page] != UWSGI_CACHE_SLAB_FREE_PAGE) {
+				page++;
+				if (page >= uc->slab_pages) page = 0;
+			}
+			uc->slab_page_class[page] = class;
+			uc->slab_pages_used++;
+			uc->slab_next_page = page + 1 < uc->slab_pages ? page + 1 : 0;
+			usc->pages++;
+			usc->carve = page * uc->slab_page_blocks;
+			usc->carve_end = usc->carve + ((uc->slab_page_blocks / usc->chunk_blocks) * usc->chunk_blocks);
+		}
+		block = usc->carve;
+		usc->carve += usc->chunk_blocks;
+	}
+	usc->used++;
+	usc->requested += vallen;
+	return block;
+}
 
-        uint8_t mask = 0xff >> first_byte_bit;
-        uc->blocks_bitmap[first_byte] ^= mask;
+static void cache_slab_free(struct uwsgi_cache *uc, uint64_t block, uint64_t vallen) {
+	struct uwsgi_cache_slab_class *usc = &uc->slabs[uc->slab_page_class[block / uc->slab_page_blocks]];
+	*cache_slab_chunk(uc, block) = usc->free_list;
+	usc->free_list = block + 1;
+	usc->free++;
+	usc->used--;
+	usc->requested -= vallen;
+}
 
-        uint64_t needed_bytes = (last_byte - first_byte)+1;
+// the class of the page holding a block
+static struct uwsgi_cache_slab_class *cache_slab_of(struct uwsgi_cache *uc, uint64_t block) {
+	return &uc->slabs[uc->slab_page_class[block / uc->slab_page_blocks]];
+}
 
-        if (needed_bytes > 1) {
-                mask = 0xff << (8 - last_byte_bit);
-                uc->blocks_bitmap[last_byte-1] ^= mask;
-        }
+// account a restored item (from a cache store), returns -1 if it does not fit the slab layout
+static int cache_slab_claim(struct uwsgi_cache *uc, uint64_t block, uint64_t vallen, uint8_t *claimed) {
+	uint8_t class = cache_slab_class(uc, vallen);
+	struct uwsgi_cache_slab_class *usc = &uc->slabs[class];
+	uint64_t page = block / uc->slab_page_blocks;
+	uint64_t offset = block % uc->slab_page_blocks;
+	if (vallen > uc->max_item_size || page >= uc->slab_pages || offset % usc->chunk_blocks ||
+		offset + usc->chunk_blocks > uc->slab_page_blocks || claimed[block]) return -1;
+	if (uc->slab_page_class[page] == UWSGI_CACHE_SLAB_FREE_PAGE) {
+		uc->slab_page_class[page] = class;
+		uc->slab_pages_used++;
+		usc->pages++;
+	}
+	else if (uc->slab_page_class[page] != class) {
+		return -1;
+	}
+	claimed[block] = 1;
+	usc->used++;
+	usc->requested += vallen;
+	return 0;
+}
 
-        if (needed_bytes > 2) {
-                uint8_t *ptr = &uc->blocks_bitmap[first_byte+1];
-                memset(ptr, 0, needed_bytes-2);
-        }
+// put the unclaimed chunks of the restored pages in the free lists
+static void cache_slabs_rebuild(struct uwsgi_cache *uc, uint8_t *claimed) {
+	uint64_t page;
+	for(page=0;page<uc->slab_pages;page++) {
+		if (uc->slab_page_class[page] == UWSGI_CACHE_SLAB_FREE_PAGE) continue;
+		struct uwsgi_cache_slab_class *usc = &uc->slabs[uc->slab_page_class[page]];
+		uint64_t base = page * uc->slab_page_blocks;
+		uint64_t block = base + ((uc->slab_page_blocks / usc->chunk_blocks) * usc->chunk_blocks);
+		// in reverse order, so lower chunks are used first
+		while(block > base) {
+			block -= usc->chunk_blocks;
+			if (claimed[block]) continue;
+			*cache_slab_chunk(uc, block) = usc->free_list;
+			usc->free_list = block + 1;
+			usc->free++;
+		}
+	}
 }
 
 static void cache_send_udp_command(struct uwsgi_cache *, char *, uint16_t, char *, uint16_t, uint64_t, uint8_t);
 
+// eviction policies
+
+/* how eviction works:
+
+	by default a set on a full cache fails. With eviction=<policy> (--cache2 only) items
+	are evicted (at most UWSGI_CACHE_MAX_EVICTIONS per set) until the new one fits.
+
+	Policies are registered with uwsgi_cache_policy_register(), the embedded ones are:
+
+		lru -> intrusive doubly linked list (in a shared array indexed by item slot), hits only set a bit of the item
+			and the items hit are moved to the head when they reach the tail (batched promotions),
+			so readers never take a lock
+		clock -> second chance, hits only set the reference bit of the item
+		lfu -> sampled lfu (like redis), the item with the lowest access counter over UWSGI_CACHE_LFU_SAMPLES random items is evicted,
+			counters are halved every 10 * max_items hits (so items popular a long time ago can be evicted)
+
+	admission=tinylfu adds a TinyLFU admission filter: a count-min sketch (4 rows of 8bit counters)
+	in shared memory records every access, and a new item is stored only if its estimated frequency
+	is higher than the one of the first victim. Counters are halved every 10 * max_items accesses.
+
+	Victims must make room for the new value: with slabs (when the class of the value is full and no
+	free page is left) only the items of the same class are considered, as pages are never released.
+	Policies check their candidates with uwsgi_cache_victim_fits().
+
+	Hits run concurrently (under the read lock or without any lock in lockless mode), so the state
+	they touch is updated with atomic operations: lfu and sketch counters are incremented with
+	compare and swap (losing an increment under contention is harmless for a frequency estimate)
+	and only the worker whose access is a multiple of the threshold halves them (the access
+	counters only grow, so no aging is lost while another worker is halving). lru and clock
+	only store a bit. Insertions, removals and victims always run under the write lock.
+
+	The stats server reports the counters of the policy (hits, misses, evictions, rejected admissions
+	and agings) in the "policy" object of every cache.
+
+*/
+
+#define UWSGI_CACHE_MAX_EVICTIONS 16
+#define UWSGI_CACHE_LFU_SAMPLES 8
+
+// saturating increment of a shared 8bit counter
+static void cache_counter8_inc(uint8_t *counter) {
+	uint8_t c = *counter;
+	if (c < 255) __sync_bool_compare_and_swap(counter, c, c + 1);
+}
+
+static void cache_counters8_halve(uint8_t *counters, uint64_t n) {
+	uint64_t i;
+	for(i=0;i<n;i++) {
+		uint8_t c;
+		do {
+			c = counters[i];
+		} while (c && !__sync_bool_compare_and_swap(&counters[i], c, c >> 1));
+	}
+}
+
+static void cache_counters32_halve(uint32_t *counters, uint64_t n) {
+	uint64_t i;
+	for(i=0;i<n;i++) {
+		uint32_t c;
+		do {
+			c = counters[i];
+		} while (c && !__sync_bool_compare_and_swap(&counters[i], c, c >> 1));
+	}
+}
+
+void uwsgi_cache_policy_register(struct uwsgi_cache_policy *policy) {
+	struct uwsgi_cache_policy *old_policy = NULL, *ucp = uwsgi.cache_policies;
+	while(ucp) {
+		if (!strcmp(ucp->name, policy->name)) return;
+		old_policy = ucp;
+		ucp = ucp->next;
+	}
+	if (old_policy) {
+		old_policy->next = policy;
+	}
+	else {
+		uwsgi.cache_policies = policy;
+	}
+}
+
+struct uwsgi_cache_policy *uwsgi_cache_policy_get(char *name) {
+	struct uwsgi_cache_policy *ucp = uwsgi.cache_policies;
+	while(ucp) {
+		if (!strcmp(ucp->name, name)) return ucp;
+		ucp = ucp->next;
+	}
+	return NULL;
+}
+
+// lru
+struct cache_lru {
+	uint64_t head;
+	uint64_t tail;
+	// prev and next of each slot, followed by the hit bit of each slot
+	uint64_t links[];
+};
+
+#define lru_prev(x) lru->links[(x)*2]
+#define lru_next(x) lru->links[((x)*2)+1]
+#define lru_hit(x) ((uint8_t *) &lru->links[uc->max_items*2])[x]
+
+static void cache_lru_init(struct uwsgi_cache *uc) {
+	struct cache_lru *lru = (struct cache_lru *) uc->policy_data;
+	size_t len = sizeof(struct cache_lru) + (sizeof(uint64_t) * 2 * uc->max_items) + uc->max_items;
+	if (!lru) {
+		uc->policy_data = uwsgi_calloc_shared(len);
+		return;
+	}
+	memset(lru, 0, len);
+}
+
+static void cache_lru_unlink(struct cache_lru *lru, uint64_t index) {
+	if (lru_prev(index)) {
+		lru_next(lru_prev(index)) = lru_next(index);
+	}
+	else if (lru->head == index) {
+		lru->head = lru_next(index);
+	}
+	if (lru_next(index)) {
+		lru_prev(lru_next(index)) = lru_prev(index);
+	}
+	else if (lru->tail == index) {
+		lru->tail = lru_prev(index);
+	}
+	lru_prev(index) = 0;
+	lru_next(index) = 0;
+}
+
+static void cache_lru_push(struct cache_lru *lru, uint64_t index) {
+	lru_prev(index) = 0;
+	lru_next(index) = lru->head;
+	if (lru->head) {
+		lru_prev(lru->head) = index;
+	}
+	lru->head = index;
+	if (!lru->tail) {
+		lru->tail = index;
+	}
+}
+
+static void cache_lru_insert(struct uwsgi_cache *uc, uint64_t index) {
+	struct cache_lru *lru = (struct cache_lru *) uc->policy_data;
+	lru_hit(index) = 0;
+	cache_lru_push(lru, index);
+}
+
+static void cache_lru_hit(struct uwsgi_cache *uc, uint64_t index) {
+	struct cache_lru *lru = (struct cache_lru *) uc->policy_data;
+	// the move to the head is deferred to the victim selection (avoid dirtying the cache line if not needed)
+	if (!lru_hit(index)) lru_hit(index) = 1;
+}
+
+static void cache_lru_remove(struct uwsgi_cache *uc, uint64_t index) {
+	struct cache_lru *lru = (struct cache_lru *) uc->policy_data;
+	cache_lru_unlink(lru, index);
+	lru_hit(index) = 0;
+}
+
+static uint64_t cache_lru_victim(struct uwsgi_cache *uc, uint64_t vallen) {
+	struct cache_lru *lru = (struct cache_lru *) uc->policy_data;
+	uint64_t index = lru->tail;
+	uint64_t scanned;
+	// every item is visited at most twice (before and after its promotion)
+	for(scanned=0;index && scanned<uc->max_items*2;scanned++) {
+		uint64_t prev = lru_prev(index);
+		if (lru_hit(index)) {
+			// promote the items hit since their last move
+			lru_hit(index) = 0;
+			cache_lru_unlink(lru, index);
+			cache_lru_push(lru, index);
+			if (!prev) prev = lru->tail;
+		}
+		else if (uwsgi_cache_victim_fits(uc, index, vallen)) {
+			return index;
+		}
+		index = prev;
+	}
+	return 0;
+}
+
+// clock
+struct cache_clock {
+	uint64_t hand;
+	uint8_t referenced[];
+};
+
+static void cache_clock_init(struct uwsgi_cache *uc) {
+	struct cache_clock *clock = (struct cache_clock *) uc->policy_data;
+	size_t len = sizeof(struct cache_clock) + uc->max_items;
+	if (!clock) {
+		uc->policy_data = uwsgi_calloc_shared(len);
+		return;
+	}
+	memset(clock, 0, len);
+}
+
+static void cache_clock_hit(struct uwsgi_cache *uc, uint64_t index) {
+	struct cache_clock *clock = (struct cache_clock *) uc->policy_data;
+	// avoid dirtying the cache line if not needed (a plain store, concurrent hits write the same value)
+	if (!clock->referenced[index]) clock->referenced[index] = 1;
+}
+
+static void cache_clock_remove(struct uwsgi_cache *uc, uint64_t index) {
+	struct cache_clock *clock = (struct cache_clock *) uc->policy_data;
+	clock->referenced[index] = 0;
+}
+
+static uint64_t cache_clock_victim(struct uwsgi_cache *uc, uint64_t vallen) {
+	struct cache_clock *clock = (struct cache_clock *) uc->policy_data;
+	uint64_t i;
+	// two rounds are enough to find an unreferenced item
+	for(i=0;i<uc->max_items*2;i++) {
+		clock->hand++;
+		// slot 0 is never used
+		if (clock->hand >= uc->max_items) clock->hand = 1;
+		struct uwsgi_cache_item *uci = cache_item(clock->hand);
+		if (!uci->keysize) continue;
+		if (clock->referenced[clock->hand]) {
+			clock->referenced[clock->hand] = 0;
+			continue;
+		}
+		if (!uwsgi_cache_victim_fits(uc, clock->hand, vallen)) continue;
+		return clock->hand;
+	}
+	return 0;
+}
+
+// lfu
+struct cache_lfu {
+	uint64_t accesses;
+	uint32_t counters[];
+};
+
+static void cache_lfu_init(struct uwsgi_cache *uc) {
+	struct cache_lfu *lfu = (struct cache_lfu *) uc->policy_data;
+	size_t len = sizeof(struct cache_lfu) + (sizeof(uint32_t) * uc->max_items);
+	if (!lfu) {
+		uc->policy_data = uwsgi_calloc_shared(len);
+		return;
+	}
+	memset(lfu, 0, len);
+}
+
+static void cache_lfu_insert(struct uwsgi_cache *uc, uint64_t index) {
+	struct cache_lfu *lfu = (struct cache_lfu *) uc->policy_data;
+	lfu->counters[index] = 1;
+}
+
+static void cache_lfu_hit(struct uwsgi_cache *uc, uint64_t index) {
+	struct cache_lfu *lfu = (struct cache_lfu *) uc->policy_data;
+	uint32_t c = lfu->counters[index];
+	if (c < 0xffffffff) __sync_bool_compare_and_swap(&lfu->counters[index], c, c + 1);
+	// aging (like the tinylfu sketch), items hot a long time ago can be evicted again
+	if (__sync_add_and_fetch(&lfu->accesses, 1) % (uc->max_items * 10) == 0) {
+		cache_counters32_halve(lfu->counters, uc->max_items);
+		__sync_add_and_fetch(&uc->policy_agings, 1);
+	}
+}
+
+static void cache_lfu_remove(struct uwsgi_cache *uc, uint64_t index) {
+	struct cache_lfu *lfu = (struct cache_lfu *) uc->policy_data;
+	lfu->counters[index] = 0;
+}
+
+static uint64_t cache_lfu_victim(struct uwsgi_cache *uc, uint64_t vallen) {
+	struct cache_lfu *lfu = (struct cache_lfu *) uc->policy_data;
+	uint64_t victim = 0;
+	uint32_t victim_count = 0;
+	int samples = 0;
+	int i;
+	if (uc->max_items < 2) return 0;
+	// give up after a bunch of free slots
+	for(i=0;i<UWSGI_CACHE_LFU_SAMPLES*4 && samples < UWSGI_CACHE_LFU_SAMPLES;i++) {
+		uint64_t index = 1 + (rand() % (uc->max_items - 1));
+		struct uwsgi_cache_item *uci = cache_item(index);
+		if (!uci->keysize || !uwsgi_cache_victim_fits(uc, index, vallen)) continue;
+		samples++;
+		if (!victim || lfu->counters[index] < victim_count) {
+			victim = index;
+			victim_count = lfu->counters[index];
+		}
+	}
+	if (victim) return victim;
+	// the sampling missed (sparse cache or only a few items of the needed slab class), scan for the first candidate
+	uint64_t start = 1 + (rand() % (uc->max_items - 1));
+	uint64_t j;
+	for(j=0;j<uc->max_items-1;j++) {
+		uint64_t index = 1 + ((start - 1 + j) % (uc->max_items - 1));
+		struct uwsgi_cache_item *uci = cache_item(index);
+		if (uci->keysize && uwsgi_cache_victim_fits(uc, index, vallen)) return index;
+	}
+	return victim;
+}
+
+static struct uwsgi_cache_policy cache_policy_lru = {
+	.name = "lru",
+	.init = cache_lru_init,
+	.insert = cache_lru_insert,
+	.hit = cache_lru_hit,
+	.remove = cache_lru_remove,
+	.victim = cache_lru_victim,
+};
+
+static struct uwsgi_cache_policy cache_policy_clock = {
+	.name = "clock",
+	.init = cache_clock_init,
+	.insert = cache_clock_remove, // new items start unreferenced
+	.hit = cache_clock_hit,
+	.remove = cache_clock_remove,
+	.victim = cache_clock_victim,
+};
+
+static struct uwsgi_cache_policy cache_policy_lfu = {
+	.name = "lfu",
+	.init = cache_lfu_init,
+	.insert = cache_lfu_insert,
+	.hit = cache_lfu_hit,
+	.remove = cache_lfu_remove,
+	.victim = cache_lfu_victim,
+};
+
+// tinylfu count-min sketch
+static void cache_sketch_init(struct uwsgi_cache *uc) {
+	if (!uc->sketch) {
+		uc->sketch_width = 16;
+		while(uc->sketch_width < uc->max_items) uc->sketch_width <<= 1;
+		uc->sketch = uwsgi_calloc_shared(uc->sketch_width * 4);
+		return;
+	}
+	memset(uc->sketch, 0, uc->sketch_width * 4);
+	uc->sketch_additions = 0;
+}
+
+#define cache_sketch_pos(row) (((row) * uc->sketch_width) + ((hash + ((row) * hash2)) & (uc->sketch_width - 1)))
+
+static void cache_sketch_add(struct uwsgi_cache *uc, uint32_t hash) {
+	uint32_t hash2 = (hash * 2654435761U) | 1;
+	int row;
+	for(row=0;row<4;row++) {
+		cache_counter8_inc(&uc->sketch[cache_sketch_pos(row)]);
+	}
+	// aging
+	if (__sync_add_and_fetch(&uc->sketch_additions, 1) % (uc->max_items * 10) == 0) {
+		cache_counters8_halve(uc->sketch, uc->sketch_width * 4);
+		__sync_add_and_fetch(&uc->policy_agings, 1);
+	}
+}
+
+static uint8_t cache_sketch_estimate(struct uwsgi_cache *uc, uint32_t hash) {
+	uint32_t hash2 = (hash * 2654435761U) | 1;
+	uint8_t estimate = 255;
+	int row;
+	for(row=0;row<4;row++) {
+		uint8_t counter = uc->sketch[cache_sketch_pos(row)];
+		if (counter < estimate) estimate = counter;
+	}
+	return estimate;
+}
+
+static void cache_policy_init(struct uwsgi_cache *uc) {
+	if (uc->policy && uc->policy->init) uc->policy->init(uc);
+	if (uc->use_tinylfu) cache_sketch_init(uc);
+}
+
+static void cache_hit(struct uwsgi_cache *uc, uint64_t index, struct uwsgi_cache_item *uci) {
+	__sync_add_and_fetch(&uci->hits, 1);
+	__sync_add_and_fetch(&uc->hits, 1);
+	if (uc->policy && uc->policy->hit) uc->policy->hit(uc, index);
+	if (uc->use_tinylfu) cache_sketch_add(uc, uci->hash);
+}
+
+static void cache_miss(struct uwsgi_cache *uc, char *key, uint16_t keylen) {
+	__sync_add_and_fetch(&uc->miss, 1);
+	if (uc->use_tinylfu) cache_sketch_add(uc, uc->hash->func(key, keylen));
+}
+
+// can evicting the item make room for a value of vallen bytes ?
+int uwsgi_cache_victim_fits(struct uwsgi_cache *uc, uint64_t index, uint64_t vallen) {
+	if (!uc->slabs || cache_slab_has_room(uc, vallen)) return 1;
+	struct uwsgi_cache_item *uci = cache_item(index);
+	return cache_slab_of(uc, uci->first_block) == &uc->slabs[cache_slab_class(uc, vallen)];
+}
+
+static int cache_has_room(struct uwsgi_cache *uc, uint64_t vallen) {
+	if (uc->first_available_block >= uc->max_items && !uc->unused_blocks_stack_ptr) return 0;
+	if (uc->blocks_bitmap && uwsgi_cache_find_free_blocks(uc, vallen) == 0xffffffffffffffffLLU) return 0;
+	if (uc->slabs && !cache_slab_has_room(uc, vallen)) return 0;
+	return 1;
+}
+
+// returns -1 if the new item has been refused by the admission filter
+static int cache_make_room(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint64_t vallen) {
+	int evictions = 0;
+	uint32_t hash = 0;
+	// a set is an access too
+	if (uc->use_tinylfu) {
+		hash = uc->hash->func(key, keylen);
+		cache_sketch_add(uc, hash);
+	}
+	while(!cache_has_room(uc, vallen)) {
+		// give up, the caller will report the cache as full
+		if (evictions >= UWSGI_CACHE_MAX_EVICTIONS) break;
+		uint64_t victim = uc->policy->victim(uc, vallen);
+		if (!victim) break;
+		if (uc->use_tinylfu && evictions == 0) {
+			struct uwsgi_cache_item *uci = cache_item(victim);
+			if (cache_sketch_estimate(uc, hash) <= cache_sketch_estimate(uc, uci->hash)) {
+				uc->rejected++;
+				return -1;
+			}
+		}
+		uwsgi_cache_del2(uc, NULL, 0, victim, UWSGI_CACHE_FLAG_LOCAL);
+		uc->evictions++;
+		evictions++;
+	}
+	return 0;
+}
+
 static void cache_sync_hook(char *k, uint16_t kl, char *v, uint16_t vl, void *data) {
 	struct uwsgi_cache *uc = (struct uwsgi_cache *) data;
 	if (!uwsgi_strncmp(k, kl, "items", 5)) {
@@ -193,14 +935,15 @@ static void uwsgi_cache_add_items(struct uwsgi_cache *uc) {
 		key_len = value - key;
 		value++;
 		uint64_t len = (usl->value + usl->len) - value;
-                uwsgi_wlock(uc->lock);
-                if (!uwsgi_cache_set2(uc, key, key_len, value, len, 0, 0)) {
+		struct uwsgi_cache *ucs = uwsgi_cache_shard(uc, key, key_len);
+                uwsgi_wlock(ucs->lock);
+                if (!uwsgi_cache_set2(ucs, key, key_len, value, len, 0, 0)) {
                 	uwsgi_log("[cache] stored \"%.*s\" in \"%s\"\n", key_len, key, uc->name);
                 }
                 else {
                 	uwsgi_log("[cache-error] unable to store \"%.*s\" in \"%s\"\n", key_len, key, uc->name);
                 }
-                uwsgi_rwunlock(uc->lock);
+                uwsgi_rwunlock(ucs->lock);
 next:
                 usl = usl->next;
         }
@@ -226,14 +969,15 @@ static void uwsgi_cache_load_files(struct uwsgi_cache *uc) {
 		}
 		value = uwsgi_open_and_read(key, &len, 0, NULL);
 		if (value) {
-			uwsgi_wlock(uc->lock);
-			if (!uwsgi_cache_set2(uc, key, key_len, value, len, 0, 0)) {
+			struct uwsgi_cache *ucs = uwsgi_cache_shard(uc, key, key_len);
+			uwsgi_wlock(ucs->lock);
+			if (!uwsgi_cache_set2(ucs, key, key_len, value, len, 0, 0)) {
 				uwsgi_log("[cache] stored \"%.*s\" in \"%s\"\n", key_len, key, uc->name);
 			}		
 			else {
 				uwsgi_log("[cache-error] unable to store \"%.*s\" in \"%s\"\n", key_len, key, uc->name);
 			}
-			uwsgi_rwunlock(uc->lock);
+			uwsgi_rwunlock(ucs->lock);
 			free(value);
 		}
 		else {
@@ -263,11 +1007,12 @@ next:
                 if (value) {
 			struct uwsgi_buffer *gzipped = uwsgi_gzip(value, len);
 			if (gzipped) {
-                        	uwsgi_wlock(uc->lock);
-                        	if (!uwsgi_cache_set2(uc, key, key_len, gzipped->buf, gzipped->len, 0, 0)) {
+				struct uwsgi_cache *ucs = uwsgi_cache_shard(uc, key, key_len);
+                        	uwsgi_wlock(ucs->lock);
+                        	if (!uwsgi_cache_set2(ucs, key, key_len, gzipped->buf, gzipped->len, 0, 0)) {
                                 	uwsgi_log("[cache-gzip] stored \"%.*s\" in \"%s\"\n", key_len, key, uc->name);
                         	}
-                        	uwsgi_rwunlock(uc->lock);
+                        	uwsgi_rwunlock(ucs->lock);
 				uwsgi_buffer_destroy(gzipped);
 			}
                         free(value);
@@ -280,19 +1025,39 @@ next2:
 
 
 
-void uwsgi_cache_init(struct uwsgi_cache *uc) {
+static void uwsgi_cache_init_storage(struct uwsgi_cache *uc) {
 
-	uc->hashtable = uwsgi_calloc_shared(sizeof(uint64_t) * uc->hashsize);
+	if (uc->use_open_index) {
+		// keep the load factor under 50%
+		uc->buckets_n = 1;
+		while(uc->buckets_n * 8 < uc->max_items * 2) uc->buckets_n <<= 1;
+		uc->buckets = uwsgi_calloc_shared(sizeof(struct uwsgi_cache_bucket) * uc->buckets_n);
+	}
+	else {
+		uc->hashtable = uwsgi_calloc_shared(sizeof(uint64_t) * uc->hashsize);
+	}
 	uc->unused_blocks_stack = uwsgi_calloc_shared(sizeof(uint64_t) * uc->blocks);
 	// the first cache item is always zero
 	uc->first_available_block = 1;
 	uc->unused_blocks_stack_ptr = 0;
 	uc->filesize = ( (sizeof(struct uwsgi_cache_item)+uc->keysize) * uc->max_items) + (uc->blocksize * uc->blocks);
 
+	if (uc->lockless) {
+		uc->lockless_versions = uwsgi_calloc_shared(sizeof(uint64_t) * uc->max_items);
+	}
+
+	cache_policy_init(uc);
+
 	if (uc->use_blocks_bitmap) {
 		uc->blocks_bitmap_size = uc->blocks/8;
 		if (uc->blocks % 8 > 0) uc->blocks_bitmap_size++;
 		uc->blocks_bitmap = uwsgi_calloc_shared(uc->blocks_bitmap_size);
+		// the padding bits of the last byte are not real blocks
+		cache_bitmap_fill(uc, uc->blocks, (uc->blocks_bitmap_size * 8) - uc->blocks, 1);
+	}
+
+	if (uc->use_slabs) {
+		cache_slabs_init(uc);
 	}
 
 	//uwsgi.cache_items = (struct uwsgi_cache_item *) mmap(NULL, sizeof(struct uwsgi_cache_item) * uwsgi.cache_max_items, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
@@ -330,7 +1095,6 @@ void uwsgi_cache_init(struct uwsgi_cache *uc) {
 			exit(1);
 		}
 
-		uwsgi_cache_fix(uc);
 		close(cache_fd);
 	}
 	else {
@@ -348,6 +1112,11 @@ void uwsgi_cache_init(struct uwsgi_cache *uc) {
 
 	uc->data = ((char *)uc->items) + ((sizeof(struct uwsgi_cache_item)+uc->keysize) * uc->max_items);
 
+	// the slab allocator needs the data area to rebuild its free lists
+	if (uc->store) {
+		uwsgi_cache_fix(uc);
+	}
+
 	if (uc->name) {
 		// can't free that until shutdown
 		char *lock_name = uwsgi_concat2("cache_", uc->name);
@@ -364,6 +1133,73 @@ void uwsgi_cache_init(struct uwsgi_cache *uc) {
 			(unsigned long long) ((sizeof(struct uwsgi_cache_item)+uc->keysize) * uc->max_items), (unsigned long long) (uc->blocksize * uc->max_items),
 			(unsigned long long) uc->blocks_bitmap_size);
 
+	if (uc->slabs) {
+		uwsgi_log("*** Cache \"%s\" slabs: %llu pages of %llu bytes, %llu classes (%llu - %llu bytes) ***\n",
+			uc->name,
+			(unsigned long long) uc->slab_pages,
+			(unsigned long long) uc->slab_page_blocks * uc->blocksize,
+			(unsigned long long) uc->slabs_n,
+			(unsigned long long) uc->slabs[0].chunk_blocks * uc->blocksize,
+			(unsigned long long) uc->slabs[uc->slabs_n-1].chunk_blocks * uc->blocksize);
+		// pages are never moved between classes
+		if (uc->slab_pages < uc->slabs_n) {
+			uwsgi_log("*** WARNING: cache \"%s\" has less slab pages than classes, consider a smaller slab_page ***\n", uc->name);
+		}
+	}
+}
+
+/*
+	sharded caches
+
+	with shards=N the cache is split in N independent caches (items, hashtable, blocks bitmap and lock)
+	selected by the key hash. The parent cache only holds the configuration and the shards array.
+
+	Code directly accessing a cache (instead of using the magic functions) has to pick the shard
+	with uwsgi_cache_shard() before locking it. uwsgi_cache_rlock() locks all of the shards.
+
+*/
+
+struct uwsgi_cache *uwsgi_cache_shard(struct uwsgi_cache *uc, char *key, uint16_t keylen) {
+	if (!uc->shards_n) return uc;
+	// fibonacci hashing, the low bits of the hash are used for the hashtable of the shard
+	uint32_t hash = uc->hash->func(key, keylen) * 2654435761U;
+	return &uc->shards[((uint64_t) hash * uc->shards_n) >> 32];
+}
+
+static void uwsgi_cache_init_shards(struct uwsgi_cache *uc) {
+	uint64_t i;
+	uc->shards = uwsgi_calloc_shared(sizeof(struct uwsgi_cache) * uc->shards_n);
+	for(i=0;i<uc->shards_n;i++) {
+		struct uwsgi_cache *ucs = &uc->shards[i];
+		memcpy(ucs, uc, sizeof(struct uwsgi_cache));
+		ucs->shards_n = 0;
+		ucs->shards = NULL;
+		ucs->next = NULL;
+		ucs->name = uwsgi_concat3(uc->name, "#", uwsgi_num2str(i));
+		ucs->name_len = strlen(ucs->name);
+		ucs->max_items = (uc->max_items + uc->shards_n - 1) / uc->shards_n;
+		ucs->blocks = (uc->blocks + uc->shards_n - 1) / uc->shards_n;
+		ucs->hashsize = (uc->hashsize + uc->shards_n - 1) / uc->shards_n;
+		if (ucs->use_blocks_bitmap) {
+			ucs->max_item_size = ucs->blocksize * ucs->blocks;
+		}
+		if (uc->store) {
+			ucs->store = uwsgi_concat3(uc->store, ".", uwsgi_num2str(i));
+		}
+		uwsgi_cache_init_storage(ucs);
+	}
+	uwsgi_log("*** Cache \"%s\" split in %llu shards ***\n", uc->name, (unsigned long long) uc->shards_n);
+}
+
+void uwsgi_cache_init(struct uwsgi_cache *uc) {
+
+	if (uc->shards_n) {
+		uwsgi_cache_init_shards(uc);
+	}
+	else {
+		uwsgi_cache_init_storage(uc);
+	}
+
 	uwsgi_cache_setup_nodes(uc);
 
 	uc->udp_node_socket = socket(AF_INET, SOCK_DGRAM, 0);
@@ -373,6 +1209,11 @@ void uwsgi_cache_init(struct uwsgi_cache *uc) {
 	}
 	uwsgi_socket_nb(uc->udp_node_socket);
 
+	uint64_t i;
+	for(i=0;i<uc->shards_n;i++) {
+		uc->shards[i].udp_node_socket = uc->udp_node_socket;
+	}
+
 	uwsgi_cache_sync_from_nodes(uc);
 
 	uwsgi_cache_load_files(uc);
@@ -381,9 +1222,15 @@ void uwsgi_cache_init(struct uwsgi_cache *uc) {
 
 }
 
-static uint64_t uwsgi_cache_get_index(struct uwsgi_cache *uc, char *key, uint16_t keylen) {
+// in lockless mode the chain could be modified while walking it, so loops are not fatal
+static uint64_t cache_get_index(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint8_t lockless) {
 
 	uint32_t hash = uc->hash->func(key, keylen);
+
+	if (uc->use_open_index) {
+		return uwsgi_cache_open_get_index(uc, hash, key, keylen);
+	}
+
 	uint32_t hash_key = hash % uc->hashsize;
 
 	uint64_t slot = uc->hashtable[hash_key];
@@ -414,6 +1261,7 @@ cycle:
 		uci = cache_item(slot);
 		rounds++;
 		if (rounds > uc->max_items) {
+			if (lockless) return 0;
 			uwsgi_log("ALARM !!! cache-loop (and potential deadlock) detected slot = %lu prev = %lu next = %lu\n", slot, uci->prev, uci->next);
 			// terrible case: the whole uWSGI stack can deadlock, leaving only the master alive
 			// if the master is avalable, trigger a brutal reload
@@ -436,6 +1284,10 @@ cycle:
 	return 0;
 }
 
+static uint64_t uwsgi_cache_get_index(struct uwsgi_cache *uc, char *key, uint16_t keylen) {
+	return cache_get_index(uc, key, keylen, 0);
+}
+
 uint32_t uwsgi_cache_exists2(struct uwsgi_cache *uc, char *key, uint16_t keylen) {
 
 	return uwsgi_cache_get_index(uc, key, keylen);
@@ -450,12 +1302,11 @@ char *uwsgi_cache_get2(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint6
 		if (uci->flags & UWSGI_CACHE_FLAG_UNGETTABLE)
 			return NULL;
 		*valsize = uci->valsize;
-		uci->hits++;
-		uc->hits++;
+		cache_hit(uc, index, uci);
 		return uc->data + (uci->first_block * uc->blocksize);
 	}
 
-	uc->miss++;
+	cache_miss(uc, key, keylen);
 
 	return NULL;
 }
@@ -468,13 +1319,12 @@ int64_t uwsgi_cache_num2(struct uwsgi_cache *uc, char *key, uint16_t keylen) {
                 struct uwsgi_cache_item *uci = cache_item(index);
 		if (uci->flags & UWSGI_CACHE_FLAG_UNGETTABLE)
                         return 0;
-                uci->hits++;
-                uc->hits++;
+                cache_hit(uc, index, uci);
 		int64_t *num = (int64_t *) (uc->data + (uci->first_block * uc->blocksize));
 		return *num;
         }
 
-        uc->miss++;
+        cache_miss(uc, key, keylen);
 	return 0;
 }
 
@@ -489,12 +1339,11 @@ char *uwsgi_cache_get3(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint6
                 *valsize = uci->valsize;
 		if (expires)
 			*expires = uci->expires;
-                uci->hits++;
-                uc->hits++;
+                cache_hit(uc, index, uci);
                 return uc->data + (uci->first_block * uc->blocksize);
         }
 
-        uc->miss++;
+        cache_miss(uc, key, keylen);
 
         return NULL;
 }
@@ -510,17 +1359,73 @@ char *uwsgi_cache_get4(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint6
                 *valsize = uci->valsize;
                 if (hits)
                         *hits = uci->hits;
-                uci->hits++;
-                uc->hits++;
+                cache_hit(uc, index, uci);
                 return uc->data + (uci->first_block * uc->blocksize);
         }
 
-        uc->miss++;
+        cache_miss(uc, key, keylen);
 
         return NULL;
 }
 
-
+
+// returns a copy of the value (or NULL), *contended is set when the locked path has to be used
+char *uwsgi_cache_get_lockless(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint64_t *valsize, uint64_t *expires, int *contended) {
+
+	int retries;
+	for(retries=0;retries<UWSGI_CACHE_LOCKLESS_RETRIES;retries++) {
+		uint64_t seq = uc->lockless_seq;
+		if (seq & 1) continue;
+		__sync_synchronize();
+
+		uint64_t index = cache_get_index(uc, key, keylen, 1);
+		if (!index) {
+			__sync_synchronize();
+			if (uc->lockless_seq != seq) continue;
+			cache_miss(uc, key, keylen);
+			return NULL;
+		}
+
+		uint64_t version = uc->lockless_versions[index];
+		if (version & 1) continue;
+		__sync_synchronize();
+
+		struct uwsgi_cache_item *uci = cache_item(index);
+		uint64_t item_flags = uci->flags;
+		uint64_t item_valsize = uci->valsize;
+		uint64_t item_first_block = uci->first_block;
+		uint64_t item_expires = uci->expires;
+
+		// never go out of the data area
+		if (!item_valsize || item_valsize > uc->max_item_size || item_first_block >= uc->blocks ||
+			(item_first_block * uc->blocksize) + item_valsize > uc->blocks * uc->blocksize) continue;
+
+		char *buf = NULL;
+		if (!(item_flags & UWSGI_CACHE_FLAG_UNGETTABLE)) {
+			buf = uwsgi_malloc(item_valsize);
+			memcpy(buf, uc->data + (item_first_block * uc->blocksize), item_valsize);
+		}
+
+		__sync_synchronize();
+		if (uc->lockless_versions[index] != version || uc->lockless_seq != seq) {
+			if (buf) free(buf);
+			continue;
+		}
+
+		if (!buf) return NULL;
+
+		cache_hit(uc, index, uci);
+		*valsize = item_valsize;
+		if (expires)
+			*expires = item_expires;
+		return buf;
+	}
+
+	uc->lockless_fallbacks++;
+	*contended = 1;
+	return NULL;
+}
+
 int uwsgi_cache_del2(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint64_t index, uint16_t flags) {
 
 	struct uwsgi_cache_item *uci;
@@ -530,35 +1435,45 @@ int uwsgi_cache_del2(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint64_
 		index = uwsgi_cache_get_index(uc, key, keylen);
 
 	if (index) {
+		cache_seq_begin(uc->lockless ? &uc->lockless_seq : NULL);
 		uci = cache_item(index);
-		uci->keysize = 0;
-		uci->valsize = 0;
-		uc->unused_blocks_stack_ptr++;
-		uc->unused_blocks_stack[uc->unused_blocks_stack_ptr] = index;
+		if (uc->policy && uc->policy->remove) uc->policy->remove(uc, index);
 		// unmark blocks
 		if (uc->blocks_bitmap) {
 			cache_unmark_blocks(uc, uci->first_block, uci->valsize);
 		}
+		else if (uc->slabs) {
+			cache_slab_free(uc, uci->first_block, uci->valsize);
+		}
+		uci->keysize = 0;
+		uci->valsize = 0;
+		uc->unused_blocks_stack_ptr++;
+		uc->unused_blocks_stack[uc->unused_blocks_stack_ptr] = index;
 		ret = 0;
-		// relink collisioned entry
-		if (uci->prev) {
-			struct uwsgi_cache_item *ucii = cache_item(uci->prev);
-			ucii->next = uci->next;
+		if (uc->use_open_index) {
+			uwsgi_cache_open_del(uc, uci->hash, index);
 		}
 		else {
-			// set next as the new entry point (could be 0)
-			uc->hashtable[uci->hash % uc->hashsize] = uci->next;
-		}
+			// relink collisioned entry
+			if (uci->prev) {
+				struct uwsgi_cache_item *ucii = cache_item(uci->prev);
+				ucii->next = uci->next;
+			}
+			else {
+				// set next as the new entry point (could be 0)
+				uc->hashtable[uci->hash % uc->hashsize] = uci->next;
+			}
 
-		if (uci->next) {
-			struct uwsgi_cache_item *ucii = cache_item(uci->next);
-			ucii->prev = uci->prev;
-		}
+			if (uci->next) {
+				struct uwsgi_cache_item *ucii = cache_item(uci->next);
+				ucii->prev = uci->prev;
+			}
 
-		if (!uci->prev && !uci->next) {
-			// reset hashtable entry
-			//uwsgi_log("!!! resetted hashtable entry !!!\n");
-			uc->hashtable[uci->hash % uc->hashsize] = 0;
+			if (!uci->prev && !uci->next) {
+				// reset hashtable entry
+				//uwsgi_log("!!! resetted hashtable entry !!!\n");
+				uc->hashtable[uci->hash % uc->hashsize] = 0;
+			}
 		}
 		uci->hash = 0;
 		uci->prev = 0;
@@ -570,6 +1485,7 @@ int uwsgi_cache_del2(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint64_
 		if (uc->use_last_modified) {
 			uc->last_modified_at = uwsgi_now();
 		}
+		cache_seq_end(uc->lockless ? &uc->lockless_seq : NULL);
 	}
 
 	if (uc->nodes && ret == 0 && !(flags & UWSGI_CACHE_FLAG_LOCAL)) {
@@ -584,11 +1500,30 @@ void uwsgi_cache_fix(struct uwsgi_cache *uc) {
 	uint64_t i;
 	unsigned long long restored = 0;
 
+	// restart from a clean eviction state
+	cache_policy_init(uc);
+
+	uint8_t *claimed = NULL;
+	if (uc->slabs) {
+		cache_slabs_reset(uc);
+		claimed = uwsgi_calloc(uc->blocks);
+	}
+
 	for (i = 0; i < uc->max_items; i++) {
 		// valid record ?
 		struct uwsgi_cache_item *uci = cache_item(i);
+		if (uci->keysize && claimed && cache_slab_claim(uc, uci->first_block, uci->valsize, claimed)) {
+			uwsgi_log("[uwsgi-cache] item %llu of cache \"%s\" does not fit the slab layout, dropping it\n", (unsigned long long) i, uc->name);
+			uci->keysize = 0;
+			uci->valsize = 0;
+		}
 		if (uci->keysize) {
-			if (!uci->prev) {
+			if (uc->policy && uc->policy->insert) uc->policy->insert(uc, i);
+			if (uc->use_open_index) {
+				uwsgi_cache_open_add(uc, uci->hash, i);
+				restored++;
+			}
+			else if (!uci->prev) {
 				// put value in hash_table
 				uc->hashtable[uci->hash % uc->hashsize] = i;
 				restored++;
@@ -602,6 +1537,11 @@ void uwsgi_cache_fix(struct uwsgi_cache *uc) {
 		}
 	}
 
+	if (claimed) {
+		cache_slabs_rebuild(uc, claimed);
+		free(claimed);
+	}
+
 	uc->n_items = restored;
 	uwsgi_log("[uwsgi-cache] restored %llu items\n", uc->n_items);
 }
@@ -615,6 +1555,9 @@ int uwsgi_cache_set2(struct uwsgi_cache *uc, char *key, uint16_t keylen, char *v
 	// used to reset key allocation in bitmap mode
 	uint8_t rollback_mode = 0;
 
+	// the lockless sequence counter to bump (if any)
+	volatile uint64_t *seq = NULL;
+
 	int ret = -1;
 	time_t now = 0;
 
@@ -631,6 +1574,12 @@ int uwsgi_cache_set2(struct uwsgi_cache *uc, char *key, uint16_t keylen, char *v
 	//uwsgi_log("putting cache data in key %.*s %d\n", keylen, key, vallen);
 	index = uwsgi_cache_get_index(uc, key, keylen);
 	if (!index) {
+		// evict items if needed (before starting the lockless write)
+		if (uc->policy && cache_make_room(uc, key, keylen, vallen)) goto end;
+		if (uc->lockless) {
+			seq = &uc->lockless_seq;
+			cache_seq_begin(seq);
+		}
 		if (uc->first_available_block >= uc->max_items && !uc->unused_blocks_stack_ptr) {
 			uwsgi_log("*** DANGER cache \"%s\" is FULL !!! ***\n", uc->name);
 			uc->full++;
@@ -651,11 +1600,16 @@ int uwsgi_cache_set2(struct uwsgi_cache *uc, char *key, uint16_t keylen, char *v
 		}
 
 		uci = cache_item(index);
-		if (!uc->blocks_bitmap) {
+		if (!uc->blocks_bitmap && !uc->slabs) {
 			uci->first_block = index;
 		}
 		else {
-			uci->first_block = uwsgi_cache_find_free_blocks(uc, vallen);
+			if (uc->slabs) {
+				uci->first_block = cache_slab_alloc(uc, vallen);
+			}
+			else {
+				uci->first_block = uwsgi_cache_find_free_blocks(uc, vallen);
+			}
 			//uwsgi_log("first block = %llu\n", uci->first_block);
 			if (uci->first_block == 0xffffffffffffffffLLU) {
 				uwsgi_log("*** DANGER cache \"%s\" is FULL !!! ***\n", uc->name);
@@ -668,15 +1622,17 @@ int uwsgi_cache_set2(struct uwsgi_cache *uc, char *key, uint16_t keylen, char *v
 				}
                                 goto end;
 			}
-			// mark used blocks;
-			uint64_t needed_blocks = cache_mark_blocks(uc, uci->first_block, vallen);
-			// optimize the scan
-			if (uc->blocks_bitmap_pos + (needed_blocks+1) > uc->blocks) {
-                        	uc->blocks_bitmap_pos = 0;
-                        }
-                        else {
-                        	uc->blocks_bitmap_pos = uci->first_block + needed_blocks + 1;
-                        }
+			if (uc->blocks_bitmap) {
+				// mark used blocks;
+				uint64_t needed_blocks = cache_mark_blocks(uc, uci->first_block, vallen);
+				// optimize the scan
+				if (uc->blocks_bitmap_pos + (needed_blocks+1) > uc->blocks) {
+                        		uc->blocks_bitmap_pos = 0;
+                        	}
+                        	else {
+                        		uc->blocks_bitmap_pos = uci->first_block + needed_blocks + 1;
+                        	}
+			}
 		}
 		if (expires && !(flags & UWSGI_CACHE_FLAG_ABSEXPIRE)) {
 			now = uwsgi_now();
@@ -720,30 +1676,42 @@ int uwsgi_cache_set2(struct uwsgi_cache *uc, char *key, uint16_t keylen, char *v
 		uci->valsize = vallen;
 		uci->keysize = keylen;
 		ret = 0;
-		// now put the value in the hashtable
-		uint32_t slot = uci->hash % uc->hashsize;
 		// reset values
 		uci->prev = 0;
 		uci->next = 0;
 
-		last_index = uc->hashtable[slot];
-		if (last_index == 0) {
-			uc->hashtable[slot] = index;
+		if (uc->use_open_index) {
+			uwsgi_cache_open_add(uc, uci->hash, index);
 		}
 		else {
-			// append to first available next
-			ucii = cache_item(last_index);
-			while (ucii->next) {
-				last_index = ucii->next;
+			// now put the value in the hashtable
+			uint32_t slot = uci->hash % uc->hashsize;
+
+			last_index = uc->hashtable[slot];
+			if (last_index == 0) {
+				uc->hashtable[slot] = index;
+			}
+			else {
+				// append to first available next
 				ucii = cache_item(last_index);
+				while (ucii->next) {
+					last_index = ucii->next;
+					ucii = cache_item(last_index);
+				}
+				ucii->next = index;
+				uci->prev = last_index;
 			}
-			ucii->next = index;
-			uci->prev = last_index;
 		}
 
+		if (uc->policy && uc->policy->insert) uc->policy->insert(uc, index);
+
 		uc->n_items++ ;
 	}
 	else if (flags & UWSGI_CACHE_FLAG_UPDATE) {
+		if (uc->lockless) {
+			seq = &uc->lockless_versions[index];
+			cache_seq_begin(seq);
+		}
 		uci = cache_item(index);
 		if (expires && !(flags & UWSGI_CACHE_FLAG_ABSEXPIRE) && !(flags & UWSGI_CACHE_FLAG_FIXEXPIRE)) {
 			now = uwsgi_now();
@@ -751,26 +1719,51 @@ int uwsgi_cache_set2(struct uwsgi_cache *uc, char *key, uint16_t keylen, char *v
 			uci->expires = expires;
 		}
 		if (uc->blocks_bitmap) {
+			uint64_t old_needed_blocks = uci->valsize/uc->blocksize;
+			if (uci->valsize % uc->blocksize > 0) old_needed_blocks++;
+			uint64_t new_needed_blocks = vallen/uc->blocksize;
+			if (vallen % uc->blocksize > 0) new_needed_blocks++;
 			// we have a special case here, as we need to find a new series of free blocks
-			uint64_t old_first_block = uci->first_block;
-			uci->first_block = uwsgi_cache_find_free_blocks(uc, vallen);
-                        if (uci->first_block == 0xffffffffffffffffLLU) {
-                                uwsgi_log("*** DANGER cache \"%s\" is FULL !!! ***\n", uc->name);
-                                uc->full++;
-				uci->first_block = old_first_block;
-                                goto end;
-                        }
-                        // mark used blocks;
-                        uint64_t needed_blocks = cache_mark_blocks(uc, uci->first_block, vallen);
-                        // optimize the scan
-                        if (uc->blocks_bitmap_pos + (needed_blocks+1) > uc->blocks) {
-                                uc->blocks_bitmap_pos = 0;
-                        }
-                        else {
-                                uc->blocks_bitmap_pos = uci->first_block + needed_blocks + 1;
-                        }
-			// unmark the old blocks
-			cache_unmark_blocks(uc, uci->first_block, uci->valsize);
+			// (unless the value still needs the same number of blocks)
+			if (new_needed_blocks != old_needed_blocks) {
+				uint64_t old_first_block = uci->first_block;
+				uci->first_block = uwsgi_cache_find_free_blocks(uc, vallen);
+                        	if (uci->first_block == 0xffffffffffffffffLLU) {
+                                	uwsgi_log("*** DANGER cache \"%s\" is FULL !!! ***\n", uc->name);
+                                	uc->full++;
+					uci->first_block = old_first_block;
+                                	goto end;
+                        	}
+                        	// mark used blocks;
+                        	uint64_t needed_blocks = cache_mark_blocks(uc, uci->first_block, vallen);
+                        	// optimize the scan
+                        	if (uc->blocks_bitmap_pos + (needed_blocks+1) > uc->blocks) {
+                                	uc->blocks_bitmap_pos = 0;
+                        	}
+                        	else {
+                                	uc->blocks_bitmap_pos = uci->first_block + needed_blocks + 1;
+                        	}
+				// unmark the old blocks
+				cache_unmark_blocks(uc, old_first_block, uci->valsize);
+			}
+		}
+		else if (uc->slabs) {
+			struct uwsgi_cache_slab_class *usc = cache_slab_of(uc, uci->first_block);
+			// move to a chunk of the right class
+			if (usc != &uc->slabs[cache_slab_class(uc, vallen)]) {
+				uint64_t old_first_block = uci->first_block;
+				uci->first_block = cache_slab_alloc(uc, vallen);
+				if (uci->first_block == 0xffffffffffffffffLLU) {
+					uwsgi_log("*** DANGER cache \"%s\" is FULL !!! ***\n", uc->name);
+					uc->full++;
+					uci->first_block = old_first_block;
+					goto end;
+				}
+				cache_slab_free(uc, old_first_block, uci->valsize);
+			}
+			else {
+				usc->requested += vallen - uci->valsize;
+			}
 		}
 		if ( !(flags & UWSGI_CACHE_FLAG_MATH)) {
 			memcpy(((char *) uc->data) + (uci->first_block * uc->blocksize), val, vallen);
@@ -797,6 +1790,7 @@ int uwsgi_cache_set2(struct uwsgi_cache *uc, char *key, uint16_t keylen, char *v
                         }
 		}
 		uci->valsize = vallen;
+		if (uc->policy && uc->policy->hit) uc->policy->hit(uc, index);
 		ret = 0;
 	}
 
@@ -810,6 +1804,7 @@ int uwsgi_cache_set2(struct uwsgi_cache *uc, char *key, uint16_t keylen, char *v
 
 
 end:
+	cache_seq_end(seq);
 	return ret;
 
 }
@@ -946,25 +1941,62 @@ void *cache_udp_server_loop(void *ucache) {
                                 if (6+keylen+vallen+ss > pktsize) continue;
                                 expires = uwsgi_str_num(buf + 10 + keylen+vallen, ss);
                         }
-                        uwsgi_wlock(uc->lock);
-                        if (uwsgi_cache_set2(uc, key, keylen, val, vallen, expires, UWSGI_CACHE_FLAG_UPDATE|UWSGI_CACHE_FLAG_LOCAL|UWSGI_CACHE_FLAG_ABSEXPIRE)) {
+                        struct uwsgi_cache *ucs = uwsgi_cache_shard(uc, key, keylen);
+                        uwsgi_wlock(ucs->lock);
+                        if (uwsgi_cache_set2(ucs, key, keylen, val, vallen, expires, UWSGI_CACHE_FLAG_UPDATE|UWSGI_CACHE_FLAG_LOCAL|UWSGI_CACHE_FLAG_ABSEXPIRE)) {
                                 uwsgi_log("[cache-udp-server] unable to update cache\n");
                         }
-                        uwsgi_rwunlock(uc->lock);
+                        uwsgi_rwunlock(ucs->lock);
                 }
                 // cache del
                 else if (buf[3] == 11) {
-                        uwsgi_wlock(uc->lock);
-                        if (uwsgi_cache_del2(uc, key, keylen, 0, UWSGI_CACHE_FLAG_LOCAL)) {
+                        struct uwsgi_cache *ucs = uwsgi_cache_shard(uc, key, keylen);
+                        uwsgi_wlock(ucs->lock);
+                        if (uwsgi_cache_del2(ucs, key, keylen, 0, UWSGI_CACHE_FLAG_LOCAL)) {
                                 uwsgi_log("[cache-udp-server] unable to update cache\n");
                         }
-                        uwsgi_rwunlock(uc->lock);
+                        uwsgi_rwunlock(ucs->lock);
                 }
         }
 
         return NULL;
 }
 
+static uint64_t cache_sweep(struct uwsgi_cache *uc) {
+	uint64_t i;
+	uint64_t freed_items = 0;
+	// skip the first slot
+	for (i = 1; i < uc->max_items; i++) {
+		uwsgi_wlock(uc->lock);
+		struct uwsgi_cache_item *uci = cache_item(i);
+		if (uci->expires) {
+			if (uci->expires < (uint64_t) uwsgi.current_time) {
+				uwsgi_cache_del2(uc, NULL, 0, i, UWSGI_CACHE_FLAG_LOCAL);
+				freed_items++;
+			}
+		}
+		uwsgi_rwunlock(uc->lock);
+	}
+	return freed_items;
+}
+
+// called by the sweeper, rebuilds the open addressing index when tombstones pile up
+static void cache_reclaim_tombstones(struct uwsgi_cache *uc) {
+	if (!uc->use_open_index) return;
+	// unlocked check, a stale value only delays the rebuild to the next round
+	if (uc->buckets_tombstones <= (uc->buckets_n * 8) / UWSGI_CACHE_TOMBSTONES_RATIO) return;
+	uwsgi_wlock(uc->lock);
+	volatile uint64_t *seq = uc->lockless ? &uc->lockless_seq : NULL;
+	cache_seq_begin(seq);
+	uwsgi_cache_open_rebuild(uc);
+	cache_seq_end(seq);
+	uwsgi_rwunlock(uc->lock);
+}
+
+static int cache_has_expiration(struct uwsgi_cache *uc) {
+	return !uwsgi.cache_no_expire && !uc->no_expire;
+}
+
 static void *cache_sweeper_loop(void *ucache) {
 
         uint64_t i;
@@ -982,18 +2014,16 @@ static void *cache_sweeper_loop(void *ucache) {
         for (;;) {
 		sleep(uwsgi.cache_expire_freq);
                 uint64_t freed_items = 0;
-                // skip the first slot
-                for (i = 1; i < uc->max_items; i++) {
-                        uwsgi_wlock(uc->lock);
-			struct uwsgi_cache_item *uci = cache_item(i);
-                        if (uci->expires) {
-                                if (uci->expires < (uint64_t) uwsgi.current_time) {
-                                        uwsgi_cache_del2(uc, NULL, 0, i, UWSGI_CACHE_FLAG_LOCAL);
-                                        freed_items++;
-                                }
-                        }
-                        uwsgi_rwunlock(uc->lock);
-                }
+		if (uc->shards_n) {
+			for (i = 0; i < uc->shards_n; i++) {
+				if (cache_has_expiration(uc)) freed_items += cache_sweep(&uc->shards[i]);
+				cache_reclaim_tombstones(&uc->shards[i]);
+			}
+		}
+		else {
+			if (cache_has_expiration(uc)) freed_items = cache_sweep(uc);
+			cache_reclaim_tombstones(uc);
+		}
                 if (uwsgi.cache_report_freed_items && freed_items > 0) {
                         uwsgi_log("freed %llu items for cache \"%s\"\n", (unsigned long long) freed_items, uc->name);
                 }
@@ -1002,14 +2032,26 @@ static void *cache_sweeper_loop(void *ucache) {
         return NULL;
 }
 
+static void cache_sync(struct uwsgi_cache *uc) {
+	if (uc->store && (uwsgi.master_cycles == 0 || (uc->store_sync > 0 && (uwsgi.master_cycles % uc->store_sync) == 0))) {
+		if (msync(uc->items, uc->filesize, MS_ASYNC)) {
+			uwsgi_error("uwsgi_cache_sync_all()/msync()");
+		}
+	}
+}
+
 void uwsgi_cache_sync_all() {
 
 	struct uwsgi_cache *uc = uwsgi.caches;
 	while(uc) {
-		if (uc->store && (uwsgi.master_cycles == 0 || (uc->store_sync > 0 && (uwsgi.master_cycles % uc->store_sync) == 0))) {
-                	if (msync(uc->items, uc->filesize, MS_ASYNC)) {
-                        	uwsgi_error("uwsgi_cache_sync_all()/msync()");
-                        }
+		if (uc->shards_n) {
+			uint64_t i;
+			for(i=0;i<uc->shards_n;i++) {
+				cache_sync(&uc->shards[i]);
+			}
+		}
+		else {
+			cache_sync(uc);
 		}
 		uc = uc->next;
 	}
@@ -1019,7 +2061,7 @@ void uwsgi_cache_start_sweepers() {
 	struct uwsgi_cache *uc = uwsgi.caches;
 	while(uc) {
 		pthread_t cache_sweeper;
-		if (!uwsgi.cache_no_expire && !uc->no_expire) {
+		if (cache_has_expiration(uc) || uc->use_open_index) {
                 	if (pthread_create(&cache_sweeper, NULL, cache_sweeper_loop, (void *) uc)) {
                         	uwsgi_error("pthread_create()");
                         	uwsgi_log("unable to run the sweeper for cache \"%s\" !!!\n", uc->name);
@@ -1103,6 +2145,14 @@ struct uwsgi_cache *uwsgi_cache_create(char *arg) {
 		char *c_bitmap = NULL;
 		char *c_use_last_modified = NULL;
 		char *c_math_initial = NULL;
+		char *c_index = NULL;
+		char *c_shards = NULL;
+		char *c_lockless = NULL;
+		char *c_eviction = NULL;
+		char *c_admission = NULL;
+		char *c_slabs = NULL;
+		char *c_slab_factor = NULL;
+		char *c_slab_page = NULL;
 
 		if (uwsgi_kvlist_parse(arg, strlen(arg), ',', '=',
                         "name", &c_name,
@@ -1130,6 +2180,17 @@ struct uwsgi_cache *uwsgi_cache_create(char *arg) {
                         "bitmap", &c_bitmap,
                         "lastmod", &c_use_last_modified,
                         "math_initial", &c_math_initial,
+                        "index", &c_index,
+                        "shards", &c_shards,
+                        "lockless", &c_lockless,
+                        "eviction", &c_eviction,
+                        "purge", &c_eviction,
+                        "admission", &c_admission,
+                        "slabs", &c_slabs,
+                        "slab_factor", &c_slab_factor,
+                        "slabfactor", &c_slab_factor,
+                        "slab_page", &c_slab_page,
+                        "slabpage", &c_slab_page,
                 	NULL)) {
 			uwsgi_log("unable to parse cache definition\n");
 			exit(1);
@@ -1176,7 +2237,46 @@ struct uwsgi_cache *uwsgi_cache_create(char *arg) {
 			uc->use_blocks_bitmap = 1; 
 			uc->max_item_size = uc->blocksize * uc->blocks;
 		}
+		if (c_slabs) {
+			if (uc->use_blocks_bitmap) { uwsgi_log("bitmap and slabs modes are mutually exclusive for cache \"%s\"\n", uc->name); exit(1); }
+			// free chunks store the free list pointer
+			if (uc->blocksize < sizeof(uint64_t)) { uwsgi_log("slabs mode of cache \"%s\" requires a blocksize of at least %d bytes\n", uc->name, (int) sizeof(uint64_t)); exit(1); }
+			uc->use_slabs = 1;
+			uc->slab_factor = 1.25;
+			if (c_slab_factor) uc->slab_factor = atof(c_slab_factor);
+			if (uc->slab_factor <= 1.0) { uwsgi_log("invalid slab_factor for cache \"%s\" (must be > 1)\n", uc->name); exit(1); }
+			uc->slab_page_size = 1024 * 1024;
+			if (c_slab_page) uc->slab_page_size = uwsgi_n64(c_slab_page);
+			if (!uc->slab_page_size) { uwsgi_log("invalid slab_page for cache \"%s\"\n", uc->name); exit(1); }
+			// the real value is computed (for every shard) by the allocator
+			uc->max_item_size = ((uc->slab_page_size + uc->blocksize - 1) / uc->blocksize) * uc->blocksize;
+			if (uc->max_item_size > uc->blocksize * uc->blocks) uc->max_item_size = uc->blocksize * uc->blocks;
+		}
 		if (c_use_last_modified) uc->use_last_modified = 1;
+		if (c_lockless) uc->lockless = 1;
+
+		if (c_eviction) {
+			uc->policy = uwsgi_cache_policy_get(c_eviction);
+			if (!uc->policy) { uwsgi_log("unknown eviction policy \"%s\" for cache \"%s\"\n", c_eviction, uc->name); exit(1); }
+		}
+
+		if (c_admission) {
+			if (strcmp(c_admission, "tinylfu")) { uwsgi_log("unknown admission filter \"%s\" for cache \"%s\"\n", c_admission, uc->name); exit(1); }
+			uc->use_tinylfu = 1;
+			// the filter needs victims to compare with
+			if (!uc->policy) uc->policy = uwsgi_cache_policy_get("lru");
+		}
+
+		if (c_index) {
+			if (!strcmp(c_index, "open")) {
+				// bucket entries store 32bit slots
+				if (uc->max_items > 0xffffffff) { uwsgi_log("too many items for the open index of cache \"%s\"\n", uc->name); exit(1); }
+				uc->use_open_index = 1;
+			}
+			else if (strcmp(c_index, "chain")) {
+				uwsgi_log("invalid cache index \"%s\" for \"%s\" (allowed: chain, open)\n", c_index, uc->name); exit(1);
+			}
+		}
 
 		if (c_math_initial) uc->math_initial = strtol(c_math_initial, NULL, 10);
 
@@ -1190,6 +2290,14 @@ struct uwsgi_cache *uwsgi_cache_create(char *arg) {
 
 		uc->store = c_store;
 
+		if (c_shards) {
+			uc->shards_n = uwsgi_n64(c_shards);
+			// a single shard is a standard cache
+			if (uc->shards_n == 1) uc->shards_n = 0;
+			if (uc->shards_n > uc->max_items) { uwsgi_log("invalid number of shards for cache \"%s\"\n", uc->name); exit(1); }
+			if (uc->shards_n && c_sync) { uwsgi_log("sharded cache \"%s\" cannot be synced from other nodes\n", uc->name); exit(1); }
+		}
+
 		if (c_nodes) {
 			char *p, *ctx = NULL;
 			uwsgi_foreach_token(c_nodes, ";", p, ctx) {
@@ -1252,6 +2360,11 @@ void uwsgi_cache_create_all() {
 	// register embedded hash algorithms
         uwsgi_hash_algo_register_all();
 
+	// register embedded eviction policies
+	uwsgi_cache_policy_register(&cache_policy_lru);
+	uwsgi_cache_policy_register(&cache_policy_clock);
+	uwsgi_cache_policy_register(&cache_policy_lfu);
+
         // setup default cache
         if (uwsgi.cache_max_items > 0) {
                 uwsgi_cache_create(NULL);
@@ -1466,6 +2579,12 @@ char *uwsgi_cache_magic_get(char *key, uint16_t keylen, uint64_t *vallen, uint64
 
 	// we have a local cache !!!
 	if (uc) {
+		uc = uwsgi_cache_shard(uc, key, keylen);
+		if (uc->lockless) {
+			int contended = 0;
+			char *buf = uwsgi_cache_get_lockless(uc, key, keylen, vallen, expires, &contended);
+			if (!contended) return buf;
+		}
 		uwsgi_rlock(uc->lock);
 		char *value = uwsgi_cache_get3(uc, key, keylen, vallen, expires);
 		if (!value) {
@@ -1536,6 +2655,7 @@ char *uwsgi_cache_magic_get(char *key, uint16_t keylen, uint64_t *vallen, uint64
 		char *value = ub->buf;
 		ub->buf = NULL;
 		uwsgi_buffer_destroy(ub);
+		close(fd);
 		*vallen = ucmc.size;
 		if (expires) {
 			*expires = ucmc.expires;
@@ -1571,6 +2691,7 @@ int uwsgi_cache_magic_exists(char *key, uint16_t keylen, char *cache) {
 
         // we have a local cache !!!
         if (uc) {
+                uc = uwsgi_cache_shard(uc, key, keylen);
                 uwsgi_rlock(uc->lock);
                 if (!uwsgi_cache_exists2(uc, key, keylen)) {
                         uwsgi_rwunlock(uc->lock);
@@ -1609,6 +2730,8 @@ int uwsgi_cache_magic_exists(char *key, uint16_t keylen, char *cache) {
 			return 0;
                 }
 
+                close(fd);
+                uwsgi_buffer_destroy(ub);
 		return 1;
         }
 
@@ -1641,6 +2764,7 @@ int uwsgi_cache_magic_set(char *key, uint16_t keylen, char *value, uint64_t vall
 
 	// we have a local cache !!!
 	if (uc) {
+                uc = uwsgi_cache_shard(uc, key, keylen);
                 uwsgi_wlock(uc->lock);
                 int ret = uwsgi_cache_set2(uc, key, keylen, value, vallen, expires, flags);
                 uwsgi_rwunlock(uc->lock);
@@ -1682,6 +2806,7 @@ int uwsgi_cache_magic_set(char *key, uint16_t keylen, char *value, uint64_t vall
                         return -1;
                 }
 
+		close(fd);
 		uwsgi_buffer_destroy(ub);
 		return 0;
 
@@ -1716,6 +2841,7 @@ int uwsgi_cache_magic_del(char *key, uint16_t keylen, char *cache) {
 
         // we have a local cache !!!
         if (uc) {
+                uc = uwsgi_cache_shard(uc, key, keylen);
                 uwsgi_wlock(uc->lock);
                 if (uwsgi_cache_del2(uc, key, keylen, 0, 0)) {
                         uwsgi_rwunlock(uc->lock);
@@ -1754,6 +2880,8 @@ int uwsgi_cache_magic_del(char *key, uint16_t keylen, char *cache) {
                         return -1;
                 }
 
+                close(fd);
+                uwsgi_buffer_destroy(ub);
                 return 0;
         }
 
@@ -1786,16 +2914,7 @@ int uwsgi_cache_magic_clear(char *cache) {
 
         // we have a local cache !!!
         if (uc) {
-		uint64_t i;
-                uwsgi_wlock(uc->lock);
-		for (i = 1; i < uwsgi.caches->max_items; i++) {
-                	if (uwsgi_cache_del2(uc, NULL, 0, i, 0)) {
-                        	uwsgi_rwunlock(uc->lock);
-                        	return -1;
-                	}
-		}
-                uwsgi_rwunlock(uc->lock);
-                return 0;
+                return uwsgi_cache_clear(uc);
         }
 
         // we have a remote one
@@ -1827,6 +2946,8 @@ int uwsgi_cache_magic_clear(char *cache) {
                         return -1;
                 }
 
+                close(fd);
+                uwsgi_buffer_destroy(ub);
                 return 0;
         }
 
@@ -1835,6 +2956,309 @@ int uwsgi_cache_magic_clear(char *cache) {
 }
 
 
+/*
+	batched operations
+
+	uwsgi_cache_mget() and uwsgi_cache_mset() run a whole batch on a local cache taking the lock
+	(of every involved shard) only once.
+
+	The magic variants accept remote caches too (name@server), sending the whole batch in a single packet:
+
+	multi get: [111, pktsize, 8] + cache name + keys (every item prefixed by its 16bit little endian size)
+		response: [111, found, 8] + 64bit little endian size of the items + for each key its 64bit little endian size
+		(0xffffffffffffffff if not found) + value. The client refuses (failing the whole batch) values bigger than
+		the rest of the response or than the max item size of the local cache with the same name (or of the
+		biggest local cache), so a bogus server cannot make it allocate arbitrary amounts of memory.
+
+	multi set: [111, pktsize, 9] + cache name + 64bit expires + 8bit update flag + (key + 64bit value size) for each item,
+		followed by the stream of the values. response: [111, stored, 9]
+
+*/
+
+#define UWSGI_CACHE_MISSING 0xffffffffffffffffLLU
+
+// the biggest value accepted from a remote cache
+static uint64_t cache_remote_max_item_size(char *name, uint16_t name_len) {
+	struct uwsgi_cache *uc = uwsgi_cache_by_namelen(name, name_len);
+	if (uc) return uc->max_item_size;
+	uint64_t max_item_size = 0;
+	uc = uwsgi.caches;
+	while(uc) {
+		if (uc->max_item_size > max_item_size) max_item_size = uc->max_item_size;
+		uc = uc->next;
+	}
+	// no local caches, use the default of the old-style cache
+	if (!max_item_size) max_item_size = uwsgi.cache_blocksize ? uwsgi.cache_blocksize : UMAX16;
+	return max_item_size;
+}
+
+// values are allocated with malloc() (NULL if not found), returns the number of found items
+uint64_t uwsgi_cache_mget(struct uwsgi_cache *uc, uint64_t n, char **keys, uint16_t *keylens, char **values, uint64_t *vallens) {
+	struct uwsgi_cache **ucs = NULL;
+	uint64_t i, j;
+	uint64_t found = 0;
+
+	for (i = 0; i < n; i++) {
+		values[i] = NULL;
+		vallens[i] = 0;
+	}
+
+	if (uc->shards_n) {
+		ucs = uwsgi_malloc(sizeof(struct uwsgi_cache *) * n);
+		for (i = 0; i < n; i++) {
+			ucs[i] = uwsgi_cache_shard(uc, keys[i], keylens[i]);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		struct uwsgi_cache *ucl = ucs ? ucs[i] : uc;
+		// already managed under a previous lock
+		if (!ucl) continue;
+		uwsgi_rlock(ucl->lock);
+		// serve all of the keys of this shard
+		for (j = i; j < n; j++) {
+			if (ucs) {
+				if (ucs[j] != ucl) continue;
+				ucs[j] = NULL;
+			}
+			uint64_t vallen = 0;
+			char *value = uwsgi_cache_get2(ucl, keys[j], keylens[j], &vallen);
+			if (!value) continue;
+			values[j] = uwsgi_malloc(vallen);
+			memcpy(values[j], value, vallen);
+			vallens[j] = vallen;
+			found++;
+		}
+		uwsgi_rwunlock(ucl->lock);
+		if (!ucs) break;
+	}
+
+	if (ucs) free(ucs);
+	return found;
+}
+
+// returns the number of stored items
+uint64_t uwsgi_cache_mset(struct uwsgi_cache *uc, uint64_t n, char **keys, uint16_t *keylens, char **values, uint64_t *vallens, uint64_t expires, uint64_t flags) {
+	struct uwsgi_cache **ucs = NULL;
+	uint64_t i, j;
+	uint64_t stored = 0;
+
+	if (uc->shards_n) {
+		ucs = uwsgi_malloc(sizeof(struct uwsgi_cache *) * n);
+		for (i = 0; i < n; i++) {
+			ucs[i] = uwsgi_cache_shard(uc, keys[i], keylens[i]);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		struct uwsgi_cache *ucl = ucs ? ucs[i] : uc;
+		if (!ucl) continue;
+		uwsgi_wlock(ucl->lock);
+		for (j = i; j < n; j++) {
+			if (ucs) {
+				if (ucs[j] != ucl) continue;
+				ucs[j] = NULL;
+			}
+			if (!uwsgi_cache_set2(ucl, keys[j], keylens[j], values[j], vallens[j], expires, flags)) stored++;
+		}
+		uwsgi_rwunlock(ucl->lock);
+		if (!ucs) break;
+	}
+
+	if (ucs) free(ucs);
+	return stored;
+}
+
+// returns the number of found items or -1 on error
+int64_t uwsgi_cache_magic_mget(uint64_t n, char **keys, uint16_t *keylens, char **values, uint64_t *vallens, char *cache) {
+	struct uwsgi_cache *uc = NULL;
+	char *cache_server = NULL;
+	char *cache_name = NULL;
+	uint16_t cache_name_len = 0;
+	uint64_t i;
+	if (cache) {
+		char *at = strchr(cache, '@');
+		if (!at) {
+			uc = uwsgi_cache_by_name(cache);
+		}
+		else {
+			cache_server = at + 1;
+			cache_name = cache;
+			cache_name_len = at - cache;
+		}
+	}
+	// use default (local) cache
+	else {
+		uc = uwsgi.caches;
+	}
+
+	// we have a local cache !!!
+	if (uc) {
+		return uwsgi_cache_mget(uc, n, keys, keylens, values, vallens);
+	}
+
+	if (!cache_server) return -1;
+
+	for (i = 0; i < n; i++) {
+		values[i] = NULL;
+		vallens[i] = 0;
+	}
+
+	// we have a remote one
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(uwsgi.page_size);
+	ub->pos = 4;
+	if (uwsgi_buffer_u16le(ub, cache_name_len)) goto error;
+	if (uwsgi_buffer_append(ub, cache_name, cache_name_len)) goto error;
+	for (i = 0; i < n; i++) {
+		if (uwsgi_buffer_u16le(ub, keylens[i])) goto error;
+		if (uwsgi_buffer_append(ub, keys[i], keylens[i])) goto error;
+	}
+	// the whole batch must fit in a single packet
+	if (ub->pos - 4 > 0xffff) goto error;
+	if (uwsgi_buffer_set_uh(ub, 111, 8)) goto error;
+
+	int fd = uwsgi_connect(cache_server, 0, 1);
+	if (fd < 0) goto error;
+
+	if (uwsgi.wait_write_hook(fd, uwsgi.socket_timeout) <= 0) goto error2;
+	if (uwsgi_write_true_nb(fd, ub->buf, ub->pos, uwsgi.socket_timeout)) goto error2;
+
+	struct uwsgi_header uh;
+	if (uwsgi_read_whole_true_nb(fd, (char *) &uh, 4, uwsgi.socket_timeout)) goto error2;
+	if (uh.modifier1 != 111 || uh.modifier2 != 8) goto error2;
+
+	char size[8];
+	if (uwsgi_read_whole_true_nb(fd, size, 8, uwsgi.socket_timeout)) goto error2;
+	uint64_t remains = uwsgi_le64(size);
+	uint64_t max_item_size = cache_remote_max_item_size(cache_name, cache_name_len);
+
+	int64_t found = 0;
+	for (i = 0; i < n; i++) {
+		if (remains < 8) goto error3;
+		if (uwsgi_read_whole_true_nb(fd, size, 8, uwsgi.socket_timeout)) goto error3;
+		remains -= 8;
+		uint64_t vallen = uwsgi_le64(size);
+		if (vallen == UWSGI_CACHE_MISSING) continue;
+		if (vallen > remains || vallen > max_item_size) goto error3;
+		remains -= vallen;
+		values[i] = uwsgi_malloc(vallen);
+		vallens[i] = vallen;
+		if (uwsgi_read_whole_true_nb(fd, values[i], vallen, uwsgi.socket_timeout)) goto error3;
+		found++;
+	}
+
+	close(fd);
+	uwsgi_buffer_destroy(ub);
+	return found;
+
+error3:
+	for (i = 0; i < n; i++) {
+		if (values[i]) {
+			free(values[i]);
+			values[i] = NULL;
+		}
+		vallens[i] = 0;
+	}
+error2:
+	close(fd);
+error:
+	uwsgi_buffer_destroy(ub);
+	return -1;
+}
+
+// returns the number of stored items or -1 on error
+int64_t uwsgi_cache_magic_mset(uint64_t n, char **keys, uint16_t *keylens, char **values, uint64_t *vallens, uint64_t expires, uint64_t flags, char *cache) {
+	struct uwsgi_cache *uc = NULL;
+	char *cache_server = NULL;
+	char *cache_name = NULL;
+	uint16_t cache_name_len = 0;
+	uint64_t i;
+	if (cache) {
+		char *at = strchr(cache, '@');
+		if (!at) {
+			uc = uwsgi_cache_by_name(cache);
+		}
+		else {
+			cache_server = at + 1;
+			cache_name = cache;
+			cache_name_len = at - cache;
+		}
+	}
+	// use default (local) cache
+	else {
+		uc = uwsgi.caches;
+	}
+
+	// we have a local cache !!!
+	if (uc) {
+		return uwsgi_cache_mset(uc, n, keys, keylens, values, vallens, expires, flags);
+	}
+
+	if (!cache_server) return -1;
+
+	// we have a remote one
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(uwsgi.page_size);
+	ub->pos = 4;
+	if (uwsgi_buffer_u16le(ub, cache_name_len)) goto error;
+	if (uwsgi_buffer_append(ub, cache_name, cache_name_len)) goto error;
+	if (uwsgi_buffer_u64le(ub, expires)) goto error;
+	if (uwsgi_buffer_u8(ub, (flags & UWSGI_CACHE_FLAG_UPDATE) ? 1 : 0)) goto error;
+	for (i = 0; i < n; i++) {
+		if (uwsgi_buffer_u16le(ub, keylens[i])) goto error;
+		if (uwsgi_buffer_append(ub, keys[i], keylens[i])) goto error;
+		if (uwsgi_buffer_u64le(ub, vallens[i])) goto error;
+	}
+	if (ub->pos - 4 > 0xffff) goto error;
+	if (uwsgi_buffer_set_uh(ub, 111, 9)) goto error;
+
+	int fd = uwsgi_connect(cache_server, 0, 1);
+	if (fd < 0) goto error;
+
+	if (uwsgi.wait_write_hook(fd, uwsgi.socket_timeout) <= 0) goto error2;
+	if (uwsgi_write_true_nb(fd, ub->buf, ub->pos, uwsgi.socket_timeout)) goto error2;
+	// the values are streamed after the packet
+	for (i = 0; i < n; i++) {
+		if (uwsgi_write_true_nb(fd, values[i], vallens[i], uwsgi.socket_timeout)) goto error2;
+	}
+
+	struct uwsgi_header uh;
+	if (uwsgi_read_whole_true_nb(fd, (char *) &uh, 4, uwsgi.socket_timeout)) goto error2;
+	if (uh.modifier1 != 111 || uh.modifier2 != 9) goto error2;
+
+	close(fd);
+	uwsgi_buffer_destroy(ub);
+	return uwsgi_le16((char *) &uh.pktsize);
+
+error2:
+	close(fd);
+error:
+	uwsgi_buffer_destroy(ub);
+	return -1;
+}
+
+// remove all of the items from a local cache (locking is managed internally)
+int uwsgi_cache_clear(struct uwsgi_cache *uc) {
+	uint64_t i;
+	if (uc->shards_n) {
+		for (i = 0; i < uc->shards_n; i++) {
+			if (uwsgi_cache_clear(&uc->shards[i])) return -1;
+		}
+		return 0;
+	}
+	uwsgi_wlock(uc->lock);
+	for (i = 1; i < uc->max_items; i++) {
+		// skip free slots
+		struct uwsgi_cache_item *uci = cache_item(i);
+		if (!uci->keysize) continue;
+		if (uwsgi_cache_del2(uc, NULL, 0, i, 0)) {
+			uwsgi_rwunlock(uc->lock);
+			return -1;
+		}
+	}
+	uwsgi_rwunlock(uc->lock);
+	return 0;
+}
+
 void uwsgi_cache_sync_from_nodes(struct uwsgi_cache *uc) {
 	struct uwsgi_string_list *usl = uc->sync_nodes;
 	while(usl) {
@@ -1884,7 +3308,7 @@ void uwsgi_cache_sync_from_nodes(struct uwsgi_cache *uc) {
                 }
 
 		// reset the hashtable
-		memset(uc->hashtable, 0, sizeof(uint64_t) * UMAX16);
+		uwsgi_cache_reset_index(uc);
 		// re-fill the hashtable
                 uwsgi_cache_fix(uc);
 
@@ -1920,6 +3344,35 @@ void uwsgi_cache_setup_nodes(struct uwsgi_cache *uc) {
 
 struct uwsgi_cache_item *uwsgi_cache_keys(struct uwsgi_cache *uc, uint64_t *pos, struct uwsgi_cache_item **uci) {
 
+	// for sharded caches the upper 24 bits of pos are the shard
+	if (uc->shards_n) {
+		uint64_t shard = *pos >> 40;
+		while(shard < uc->shards_n) {
+			uint64_t shard_pos = *pos & 0xffffffffffLLU;
+			struct uwsgi_cache_item *item = uwsgi_cache_keys(&uc->shards[shard], &shard_pos, uci);
+			if (item) {
+				*pos = (shard << 40) | shard_pos;
+				return item;
+			}
+			shard++;
+			*pos = shard << 40;
+			*uci = NULL;
+		}
+		return NULL;
+	}
+
+	// with the open index, pos is the bucket entry to start from
+	if (uc->use_open_index) {
+		for(;*pos<uc->buckets_n * 8;(*pos)++) {
+			struct uwsgi_cache_bucket *ucb = &uc->buckets[*pos / 8];
+			if (ucb->tags[*pos % 8] <= UWSGI_CACHE_TAG_DELETED) continue;
+			*uci = cache_item(ucb->slots[*pos % 8]);
+			(*pos)++;
+			return *uci;
+		}
+		return NULL;
+	}
+
 	// security check
 	if (*pos >= uc->hashsize) return NULL;
 	// iterate hashtable
@@ -1940,11 +3393,26 @@ struct uwsgi_cache_item *uwsgi_cache_keys(struct uwsgi_cache *uc, uint64_t *pos,
 	return NULL;
 }
 
+// for sharded caches all of the shards are locked (always in the same order)
 void uwsgi_cache_rlock(struct uwsgi_cache *uc) {
+	if (uc->shards_n) {
+		uint64_t i;
+		for(i=0;i<uc->shards_n;i++) {
+			uwsgi_rlock(uc->shards[i].lock);
+		}
+		return;
+	}
 	uwsgi_rlock(uc->lock);
 }
 
 void uwsgi_cache_rwunlock(struct uwsgi_cache *uc) {
+	if (uc->shards_n) {
+		uint64_t i;
+		for(i=0;i<uc->shards_n;i++) {
+			uwsgi_rwunlock(uc->shards[i].lock);
+		}
+		return;
+	}
 	uwsgi_rwunlock(uc->lock);
 }
 
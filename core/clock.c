@@ -16,6 +16,17 @@ uint64_t uwsgi_micros() {
 	return uwsgi.clock->microseconds();
 }
 
+// a monotonic high resolution timer, only meaningful for measuring intervals
+uint64_t uwsgi_nanos() {
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	if (!clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+	}
+#endif
+	return uwsgi_micros() * 1000;
+}
+
 
 void uwsgi_register_clock(struct uwsgi_clock *clock) {
 	struct uwsgi_clock *clocks = uwsgi.clocks;
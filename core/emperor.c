@@ -2057,6 +2057,7 @@ void uwsgi_master_manage_emperor() {
                 if (byte == 0) {
 			uwsgi_hooks_run(uwsgi.hook_emperor_stop, "emperor-stop", 0);
                         close(uwsgi.emperor_fd);
+			uwsgi_master_fd_closed(uwsgi.emperor_fd);
                         if (!uwsgi.status.brutally_reloading)
                                 kill_them_all(0);
                 }
@@ -163,11 +163,11 @@ int event_queue_del_fd(int eq, int fd, int event) {
 	pthread_mutex_unlock(&upe->lock);
 	return ret;
 }
-int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
+int event_queue_wait_multi_ms(int eq, int timeout, void *events, int nevents) {
 	struct uwsgi_poll_event *upe = uwsgi_poll_event_queue[eq];
 	pthread_mutex_lock(&upe->lock);
         uwsgi_poll_queue_rebuild(upe);
-        int ret = poll(upe->poll, upe->nevents, timeout * 1000);
+        int ret = poll(upe->poll, upe->nevents, timeout);
 	int cnt = 0;
         if (ret > 0) {
                 int i;
@@ -397,7 +397,7 @@ int event_queue_interesting_fd(void *events, int id) {
 	return fd;
 }
 
-int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
+int event_queue_wait_multi_ms(int eq, int timeout, void *events, int nevents) {
 
 	int ret;
 	uint_t nget = 1;
@@ -405,8 +405,8 @@ int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
 	
 
 	if (timeout >= 0) {
-		ts.tv_sec = timeout;
-		ts.tv_nsec = 0;
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
 		ret = port_getn(eq, events, nevents, &nget, &ts);
 	}
 	else {
@@ -485,13 +485,933 @@ int event_queue_wait(int eq, int timeout, int *interesting_fd) {
 #endif
 
 
-#ifdef UWSGI_EVENT_USE_EPOLL
+#if defined(UWSGI_EVENT_USE_EPOLL) || defined(UWSGI_EVENT_USE_IO_URING)
 
 #include <sys/epoll.h>
 
 #define UWSGI_EVENT_IN EPOLLIN
 #define UWSGI_EVENT_OUT EPOLLOUT
 
+#ifdef UWSGI_EVENT_USE_IO_URING
+
+/*
+
+	how the io_uring event engine works:
+
+	readiness is still tracked by an epoll instance (so closing a file descriptor
+	automatically drops its registration, as the whole uWSGI codebase expects),
+	but every epoll instance gets an io_uring ring attached. The ring is used for:
+
+	1) epoll changes batching
+
+	Additions are always applied synchronously (callers check their result and
+	they need to be ordered against file descriptor reuse), while modifications
+	and removals (the fd_*_to_* transitions the routers and the offload engine
+	do for every chunk of data) are queued as IORING_OP_EPOLL_CTL sqes
+	and submitted as a single hardlinked chain with one io_uring_enter() just before
+	the next epoll_wait() (or before the next addition).
+
+	A queued modification could hit a file descriptor number that has been closed
+	and reused in the meantime, but as reuse always passes through an addition (that flushes the queue)
+	the worst case is an harmless ENOENT/EBADF.
+
+	As queued changes always "succeed", a real failure of one of them (anything but the harmless ones above)
+	is reported by the next wait of the queue as an EPOLLIN|EPOLLERR|EPOLLHUP event for its file descriptor,
+	so the owner of the fd runs its error path exactly as if the peer had failed.
+
+	2) multishot accept
+
+	event_queue_add_fd_accept() arms a multishot IORING_OP_ACCEPT on a listening socket instead of
+	adding it to the epoll set (the ring descriptor is added instead, it is readable when completions are available).
+	Accepted connections are queued and the listening socket is reported as readable until the queue is empty,
+	the owner gets them with event_queue_accepted() instead of calling accept(). Every connection is accepted
+	by a single ring, so processes sharing a listening socket are not woken up for nothing.
+	The request is armed again when the kernel ends it (cancellation, completion queue overflow), while kernels
+	without multishot accept (and EMFILE/ENFILE conditions) give the socket back to epoll.
+	Removing the socket from the queue cancels the request, connections already accepted are served after
+	the next addition.
+
+	3) reads into registered buffers
+
+	File descriptors read with event_queue_fd_read() (the corerouter peers) become ring readers. When a wait returns
+	two or more of them as readable, an IORING_OP_READ_FIXED for each one (in a pool of buffers registered with the ring)
+	is submitted with a single io_uring_enter(), and the following event_queue_fd_read() calls are served from the buffers.
+	Data not consumed (the owner asked for less) is reported again by the next waits, as long as the fd is
+	registered for reading. event_queue_fd_forget() must be called before closing a ring reader.
+
+	Writes are still done by the owner after a writability event: the routers account the written bytes
+	immediately and reuse their buffers, so a deferred write would need a copy and per-fd ordering.
+
+	Only the thread (and the process) waiting on the queue uses the ring, all of the others
+	(and any kernel without io_uring support) fall back to plain epoll.
+
+*/
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+
+#define UWSGI_IO_URING_ENTRIES 64
+// bursts of accepted connections must not overflow the completion queue
+#define UWSGI_IO_URING_CQ_ENTRIES 1024
+#define UWSGI_IO_URING_BUFFERS 32
+#define UWSGI_IO_URING_BUFFER_SIZE 16384
+
+// the kind of request is stored in the upper byte of the sqe user_data
+#define UWSGI_IO_URING_CTL 0
+#define UWSGI_IO_URING_ACCEPT 1
+#define UWSGI_IO_URING_READ 2
+#define UWSGI_IO_URING_CANCEL 3
+#define uwsgi_io_uring_data(x, y) (((uint64_t) (x) << 56) | (uint64_t) (uint32_t) (y))
+#define uwsgi_io_uring_kind(x) ((x) >> 56)
+#define uwsgi_io_uring_arg(x) ((int) ((x) & 0xffffffff))
+
+struct uwsgi_io_uring_op {
+	int op;
+	int fd;
+	struct epoll_event ee;
+};
+
+struct uwsgi_io_uring_acceptor {
+	int fd;
+	// the socket is part of the queue
+	int active;
+	// the multishot accept is in flight
+	int armed;
+	// the multishot accept ended and must be submitted again
+	int rearm;
+	// the socket has been given back to epoll
+	int fallback;
+	// accepted connections (fifo)
+	int *accepted;
+	unsigned accepted_head;
+	unsigned accepted_cnt;
+	unsigned accepted_size;
+	struct uwsgi_io_uring_acceptor *next;
+};
+
+struct uwsgi_io_uring_fd {
+	// the current epoll interest
+	uint32_t events;
+	// the fd is read with event_queue_fd_read()
+	uint8_t reader;
+	// the registered buffer holding its data (+1, 0 if none)
+	uint8_t buffer;
+	// size of the last read
+	uint32_t want;
+	// result of the ring read (bytes, 0 on EOF, -errno)
+	int32_t res;
+	// bytes already consumed
+	uint32_t off;
+};
+
+struct uwsgi_io_uring {
+	int fd;
+	unsigned entries;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	char *sq_ring;
+	size_t sq_size;
+	char *cq_ring;
+	size_t cq_size;
+	size_t sqes_size;
+	pthread_t owner;
+	int has_owner;
+	uint64_t fork_generation;
+	unsigned pending;
+	struct uwsgi_io_uring_op *ops;
+	// file descriptors whose queued change failed (reported by the next wait)
+	int *failed;
+	unsigned failed_cnt;
+	// changes are applied with plain epoll_ctl()
+	int no_ctl;
+	struct uwsgi_io_uring_acceptor *acceptors;
+	int ring_in_epoll;
+	// ring readers (allocated with the buffers)
+	struct uwsgi_io_uring_fd *fds;
+	char *buffers;
+	int no_buffers;
+	uint8_t free_buffers[UWSGI_IO_URING_BUFFERS];
+	unsigned free_buffers_cnt;
+	// ring readers holding data
+	int prefetched[UWSGI_IO_URING_BUFFERS];
+	unsigned prefetched_cnt;
+};
+
+static struct uwsgi_io_uring **uwsgi_io_uring_table;
+static uint64_t uwsgi_io_uring_fork_generation;
+
+static void uwsgi_io_uring_atfork_child(void) {
+	uwsgi_io_uring_fork_generation++;
+}
+
+static struct uwsgi_io_uring *uwsgi_io_uring_new(void) {
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(struct io_uring_params));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = UWSGI_IO_URING_CQ_ENTRIES;
+
+	int fd = syscall(__NR_io_uring_setup, UWSGI_IO_URING_ENTRIES, &p);
+	// IORING_SETUP_CQSIZE is not known by old kernels
+	if (fd < 0 && errno == EINVAL) {
+		memset(&p, 0, sizeof(struct io_uring_params));
+		fd = syscall(__NR_io_uring_setup, UWSGI_IO_URING_ENTRIES, &p);
+	}
+	if (fd < 0) {
+		static int warned = 0;
+		if (!warned) {
+			uwsgi_error("io_uring_setup()");
+			uwsgi_log("*** io_uring not available, falling back to plain epoll ***\n");
+			warned = 1;
+		}
+		return NULL;
+	}
+
+	size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cq_size > sq_size) sq_size = cq_size;
+		cq_size = sq_size;
+	}
+
+	char *sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED) {
+		uwsgi_error("io_uring mmap()");
+		close(fd);
+		return NULL;
+	}
+
+	char *cq = sq;
+	if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+		cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED) {
+			uwsgi_error("io_uring mmap()");
+			munmap(sq, sq_size);
+			close(fd);
+			return NULL;
+		}
+	}
+
+	struct io_uring_sqe *sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		uwsgi_error("io_uring mmap()");
+		munmap(sq, sq_size);
+		if (cq != sq) munmap(cq, cq_size);
+		close(fd);
+		return NULL;
+	}
+
+	struct uwsgi_io_uring *ur = uwsgi_calloc(sizeof(struct uwsgi_io_uring));
+	ur->fd = fd;
+	ur->entries = p.sq_entries;
+	ur->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+	ur->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+	ur->cq_head = (unsigned *) (cq + p.cq_off.head);
+	ur->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+	ur->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+	ur->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+	ur->sqes = sqes;
+	ur->sq_ring = sq;
+	ur->sq_size = sq_size;
+	ur->cq_ring = cq;
+	ur->cq_size = cq_size;
+	ur->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ur->fork_generation = uwsgi_io_uring_fork_generation;
+	ur->ops = uwsgi_malloc(sizeof(struct uwsgi_io_uring_op) * ur->entries);
+	ur->failed = uwsgi_malloc(sizeof(int) * ur->entries);
+
+	// the submission queue is always fully consumed, so the index array is an identity map
+	unsigned *sq_array = (unsigned *) (sq + p.sq_off.array);
+	unsigned i;
+	for (i = 0; i < ur->entries; i++) {
+		sq_array[i] = i;
+	}
+
+	return ur;
+}
+
+static void uwsgi_io_uring_free(struct uwsgi_io_uring *ur) {
+	munmap(ur->sqes, ur->sqes_size);
+	if (ur->cq_ring != ur->sq_ring) munmap(ur->cq_ring, ur->cq_size);
+	munmap(ur->sq_ring, ur->sq_size);
+	// an inherited ring descriptor number (or accepted connection) could have been already reused by the new process
+	int owned = ur->fork_generation == uwsgi_io_uring_fork_generation;
+	if (owned) {
+		close(ur->fd);
+	}
+	struct uwsgi_io_uring_acceptor *ua = ur->acceptors;
+	while (ua) {
+		struct uwsgi_io_uring_acceptor *next = ua->next;
+		while (owned && ua->accepted_cnt > 0) {
+			close(ua->accepted[ua->accepted_head++]);
+			ua->accepted_cnt--;
+		}
+		free(ua->accepted);
+		free(ua);
+		ua = next;
+	}
+	free(ur->fds);
+	free(ur->buffers);
+	free(ur->ops);
+	free(ur->failed);
+	free(ur);
+}
+
+// returns the ring attached to the queue only if it belongs to this process
+static struct uwsgi_io_uring *uwsgi_io_uring_lookup(int eq) {
+	if (!uwsgi_io_uring_table || eq < 0 || eq >= (int) uwsgi.max_fd) return NULL;
+	struct uwsgi_io_uring *ur = uwsgi_io_uring_table[eq];
+	if (!ur || ur->fork_generation != uwsgi_io_uring_fork_generation) return NULL;
+	return ur;
+}
+
+// the ring can be used only by the thread waiting on the queue (or by anyone before the first wait)
+static int uwsgi_io_uring_is_owner(struct uwsgi_io_uring *ur) {
+	return !ur->has_owner || pthread_equal(ur->owner, pthread_self());
+}
+
+static struct uwsgi_io_uring_acceptor *uwsgi_io_uring_acceptor_get(struct uwsgi_io_uring *ur, int fd) {
+	struct uwsgi_io_uring_acceptor *ua = ur->acceptors;
+	while (ua) {
+		if (ua->fd == fd) return ua;
+		ua = ua->next;
+	}
+	return NULL;
+}
+
+// EBADF/ENOENT mean the file descriptor has been closed after the change has been queued
+static int uwsgi_io_uring_ctl_failed(struct uwsgi_io_uring *ur, struct uwsgi_io_uring_op *op, int err) {
+	if (err == EBADF || err == ENOENT) return 0;
+	if (err == EEXIST && op->op == EPOLL_CTL_ADD) return 0;
+	uwsgi_log("epoll_ctl() on fd %d: %s\n", op->fd, strerror(err));
+	// the caller has already been told the change succeeded
+	unsigned i;
+	for (i = 0; i < ur->failed_cnt; i++) {
+		if (ur->failed[i] == op->fd) return -1;
+	}
+	if (ur->failed_cnt < ur->entries) {
+		ur->failed[ur->failed_cnt++] = op->fd;
+	}
+	return -1;
+}
+
+static void uwsgi_io_uring_ctl_done(int eq, struct uwsgi_io_uring *ur, struct uwsgi_io_uring_op *op, int res) {
+	if (res >= 0) return;
+	// EINVAL here means the kernel does not know about IORING_OP_EPOLL_CTL
+	if (res == -EINVAL) {
+		if (!ur->no_ctl) {
+			uwsgi_log("*** io_uring IORING_OP_EPOLL_CTL not usable, falling back to plain epoll_ctl() ***\n");
+			ur->no_ctl = 1;
+		}
+		if (epoll_ctl(eq, op->op, op->fd, &op->ee)) {
+			uwsgi_io_uring_ctl_failed(ur, op, errno);
+		}
+		return;
+	}
+	uwsgi_io_uring_ctl_failed(ur, op, -res);
+}
+
+// give the listening socket back to epoll
+static int uwsgi_io_uring_accept_fallback(int eq, struct uwsgi_io_uring_acceptor *ua) {
+	ua->fallback = 1;
+	if (!ua->active) return 0;
+	struct epoll_event ee;
+	memset(&ee, 0, sizeof(struct epoll_event));
+	ee.events = EPOLLIN;
+	ee.data.fd = ua->fd;
+	if (epoll_ctl(eq, EPOLL_CTL_ADD, ua->fd, &ee)) {
+		uwsgi_error("epoll_ctl()");
+		return -1;
+	}
+	return 0;
+}
+
+static void uwsgi_io_uring_accepted(int eq, struct uwsgi_io_uring *ur, int fd, int res, unsigned flags) {
+	struct uwsgi_io_uring_acceptor *ua = uwsgi_io_uring_acceptor_get(ur, fd);
+	if (!ua) {
+		if (res >= 0) close(res);
+		return;
+	}
+	if (res >= 0) {
+		if (ua->accepted_head + ua->accepted_cnt >= ua->accepted_size) {
+			if (ua->accepted_head > 0) {
+				memmove(ua->accepted, ua->accepted + ua->accepted_head, sizeof(int) * ua->accepted_cnt);
+				ua->accepted_head = 0;
+			}
+			else {
+				unsigned size = ua->accepted_size ? ua->accepted_size * 2 : 64;
+				int *tmp = realloc(ua->accepted, sizeof(int) * size);
+				if (!tmp) {
+					uwsgi_error("uwsgi_io_uring_accepted()/realloc()");
+					close(res);
+					goto end;
+				}
+				ua->accepted = tmp;
+				ua->accepted_size = size;
+			}
+		}
+		ua->accepted[ua->accepted_head + ua->accepted_cnt] = res;
+		ua->accepted_cnt++;
+	}
+end:
+	if (flags & IORING_CQE_F_MORE) return;
+	ua->armed = 0;
+	if (!ua->active) return;
+	if (res == -EINVAL || res == -EMFILE || res == -ENFILE) {
+		if (res == -EINVAL) {
+			uwsgi_log("*** io_uring multishot accept not available, falling back to epoll ***\n");
+		}
+		else {
+			uwsgi_log("io_uring accept on fd %d: %s, falling back to epoll\n", fd, strerror(-res));
+		}
+		uwsgi_io_uring_accept_fallback(eq, ua);
+		return;
+	}
+	// the socket has been closed
+	if (res == -EBADF || res == -ENOTSOCK) {
+		ua->active = 0;
+		return;
+	}
+	ua->rearm = 1;
+}
+
+static void uwsgi_io_uring_release(struct uwsgi_io_uring *ur, int fd) {
+	struct uwsgi_io_uring_fd *uf = &ur->fds[fd];
+	if (!uf->buffer) return;
+	ur->free_buffers[ur->free_buffers_cnt++] = uf->buffer - 1;
+	uf->buffer = 0;
+	unsigned i;
+	for (i = 0; i < ur->prefetched_cnt; i++) {
+		if (ur->prefetched[i] == fd) {
+			ur->prefetched[i] = ur->prefetched[--ur->prefetched_cnt];
+			break;
+		}
+	}
+}
+
+static void uwsgi_io_uring_read_done(struct uwsgi_io_uring *ur, int fd, int res) {
+	// not readable anymore, the owner will get EAGAIN by itself
+	if (res == -EAGAIN || res == -EINTR) {
+		uwsgi_io_uring_release(ur, fd);
+		return;
+	}
+	// IORING_OP_READ_FIXED is not usable on this kernel (or file), the owner will read by itself
+	if (res == -EINVAL) {
+		if (!ur->no_buffers) {
+			uwsgi_log("*** io_uring fixed reads not available, ring reads disabled ***\n");
+			ur->no_buffers = 1;
+		}
+		uwsgi_io_uring_release(ur, fd);
+		return;
+	}
+	ur->fds[fd].res = res;
+	ur->fds[fd].off = 0;
+	ur->prefetched[ur->prefetched_cnt++] = fd;
+}
+
+// consume the available completions, returns how many of them belong to synchronous (ctl and read) requests
+static unsigned uwsgi_io_uring_reap(int eq, struct uwsgi_io_uring *ur) {
+	unsigned completed = 0;
+	unsigned head = *ur->cq_head;
+	unsigned cq_tail = __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE);
+	while (head != cq_tail) {
+		struct io_uring_cqe *cqe = &ur->cqes[head & *ur->cq_mask];
+		uint64_t data = cqe->user_data;
+		int res = cqe->res;
+		unsigned flags = cqe->flags;
+		head++;
+		__atomic_store_n(ur->cq_head, head, __ATOMIC_RELEASE);
+		switch (uwsgi_io_uring_kind(data)) {
+		case UWSGI_IO_URING_CTL:
+			uwsgi_io_uring_ctl_done(eq, ur, &ur->ops[uwsgi_io_uring_arg(data)], res);
+			completed++;
+			break;
+		case UWSGI_IO_URING_ACCEPT:
+			uwsgi_io_uring_accepted(eq, ur, uwsgi_io_uring_arg(data), res, flags);
+			break;
+		case UWSGI_IO_URING_READ:
+			uwsgi_io_uring_read_done(ur, uwsgi_io_uring_arg(data), res);
+			completed++;
+			break;
+		default:
+			break;
+		}
+	}
+	return completed;
+}
+
+// the ring cannot be used anymore
+static void uwsgi_io_uring_break(int eq, struct uwsgi_io_uring *ur) {
+	uwsgi_log("*** io_uring not usable, falling back to plain epoll ***\n");
+	ur->no_ctl = 1;
+	ur->no_buffers = 1;
+	struct uwsgi_io_uring_acceptor *ua = ur->acceptors;
+	while (ua) {
+		if (!ua->fallback) uwsgi_io_uring_accept_fallback(eq, ua);
+		ua = ua->next;
+	}
+}
+
+// submit the last n sqes and wait for their completions, returns -1 if the ring is not usable (and nothing has been submitted)
+static int uwsgi_io_uring_submit_and_wait(int eq, struct uwsgi_io_uring *ur, unsigned n) {
+	unsigned to_submit = n;
+	unsigned completed = 0;
+	for (;;) {
+		completed += uwsgi_io_uring_reap(eq, ur);
+		if (completed >= n) return 0;
+
+		int ret = syscall(__NR_io_uring_enter, ur->fd, to_submit, n - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+			uwsgi_error("io_uring_enter()");
+			uwsgi_io_uring_break(eq, ur);
+			if (to_submit == n) {
+				__atomic_store_n(ur->sq_tail, *ur->sq_tail - n, __ATOMIC_RELEASE);
+				return -1;
+			}
+			return 0;
+		}
+		to_submit -= ret > (int) to_submit ? to_submit : (unsigned) ret;
+	}
+}
+
+// submit a single sqe without waiting for it
+static int uwsgi_io_uring_submit(int eq, struct uwsgi_io_uring *ur, struct io_uring_sqe *sqe) {
+	unsigned tail = *ur->sq_tail;
+	memcpy(&ur->sqes[tail & *ur->sq_mask], sqe, sizeof(struct io_uring_sqe));
+	__atomic_store_n(ur->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	for (;;) {
+		int ret = syscall(__NR_io_uring_enter, ur->fd, 1, 0, 0, NULL, 0);
+		if (ret == 1) return 0;
+		if (ret < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY)) {
+			// make room in the completion queue
+			uwsgi_io_uring_reap(eq, ur);
+			continue;
+		}
+		uwsgi_error("io_uring_enter()");
+		__atomic_store_n(ur->sq_tail, tail, __ATOMIC_RELEASE);
+		return -1;
+	}
+}
+
+static void uwsgi_io_uring_flush(int eq, struct uwsgi_io_uring *ur) {
+	if (!ur->pending) return;
+
+	unsigned i, n = ur->pending;
+	ur->pending = 0;
+
+	// a single change costs the same syscall, avoid the ring round-trip
+	if (n == 1 || ur->no_ctl) {
+		for (i = 0; i < n; i++) {
+			if (epoll_ctl(eq, ur->ops[i].op, ur->ops[i].fd, &ur->ops[i].ee)) {
+				uwsgi_io_uring_ctl_failed(ur, &ur->ops[i], errno);
+			}
+		}
+		return;
+	}
+
+	unsigned tail = *ur->sq_tail;
+	for (i = 0; i < n; i++) {
+		struct io_uring_sqe *sqe = &ur->sqes[(tail + i) & *ur->sq_mask];
+		memset(sqe, 0, sizeof(struct io_uring_sqe));
+		sqe->opcode = IORING_OP_EPOLL_CTL;
+		sqe->fd = eq;
+		sqe->len = ur->ops[i].op;
+		sqe->off = ur->ops[i].fd;
+		sqe->addr = (uint64_t) (uintptr_t) &ur->ops[i].ee;
+		sqe->user_data = uwsgi_io_uring_data(UWSGI_IO_URING_CTL, i);
+		// changes must be applied in order even if some of them fail
+		if (i < n - 1) {
+			sqe->flags = IOSQE_IO_HARDLINK;
+		}
+	}
+	__atomic_store_n(ur->sq_tail, tail + n, __ATOMIC_RELEASE);
+
+	// the ring is unusable, apply the changes the old way
+	if (uwsgi_io_uring_submit_and_wait(eq, ur, n)) {
+		for (i = 0; i < n; i++) {
+			if (epoll_ctl(eq, ur->ops[i].op, ur->ops[i].fd, &ur->ops[i].ee)) {
+				uwsgi_io_uring_ctl_failed(ur, &ur->ops[i], errno);
+			}
+		}
+	}
+}
+
+static int uwsgi_io_uring_arm_accept(int eq, struct uwsgi_io_uring *ur, struct uwsgi_io_uring_acceptor *ua) {
+	// the submission queue is empty only out of a flush
+	uwsgi_io_uring_flush(eq, ur);
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(struct io_uring_sqe));
+	sqe.opcode = IORING_OP_ACCEPT;
+	sqe.fd = ua->fd;
+	sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe.accept_flags = SOCK_NONBLOCK;
+	sqe.user_data = uwsgi_io_uring_data(UWSGI_IO_URING_ACCEPT, ua->fd);
+	if (uwsgi_io_uring_submit(eq, ur, &sqe)) return -1;
+	ua->armed = 1;
+	return 0;
+}
+
+static int uwsgi_io_uring_activate(int eq, struct uwsgi_io_uring *ur, struct uwsgi_io_uring_acceptor *ua) {
+	ua->active = 1;
+	if (ua->armed) return 0;
+	if (!ur->ring_in_epoll) {
+		struct epoll_event ee;
+		memset(&ee, 0, sizeof(struct epoll_event));
+		ee.events = EPOLLIN;
+		ee.data.fd = ur->fd;
+		if (epoll_ctl(eq, EPOLL_CTL_ADD, ur->fd, &ee)) {
+			uwsgi_error("epoll_ctl()");
+			return uwsgi_io_uring_accept_fallback(eq, ua);
+		}
+		ur->ring_in_epoll = 1;
+	}
+	if (uwsgi_io_uring_arm_accept(eq, ur, ua)) {
+		return uwsgi_io_uring_accept_fallback(eq, ua);
+	}
+	return 0;
+}
+
+static void uwsgi_io_uring_deactivate(int eq, struct uwsgi_io_uring *ur, struct uwsgi_io_uring_acceptor *ua) {
+	ua->active = 0;
+	if (!ua->armed) return;
+	uwsgi_io_uring_flush(eq, ur);
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(struct io_uring_sqe));
+	sqe.opcode = IORING_OP_ASYNC_CANCEL;
+	sqe.addr = uwsgi_io_uring_data(UWSGI_IO_URING_ACCEPT, ua->fd);
+	sqe.user_data = uwsgi_io_uring_data(UWSGI_IO_URING_CANCEL, ua->fd);
+	// on failure new connections are simply queued until the next activation
+	uwsgi_io_uring_submit(eq, ur, &sqe);
+}
+
+// submit again the multishot accepts ended by the kernel
+static void uwsgi_io_uring_rearm(int eq, struct uwsgi_io_uring *ur) {
+	struct uwsgi_io_uring_acceptor *ua = ur->acceptors;
+	while (ua) {
+		if (ua->rearm) {
+			ua->rearm = 0;
+			if (ua->active && !ua->armed && !ua->fallback && uwsgi_io_uring_arm_accept(eq, ur, ua)) {
+				uwsgi_io_uring_accept_fallback(eq, ua);
+			}
+		}
+		ua = ua->next;
+	}
+}
+
+static int uwsgi_io_uring_buffers_init(struct uwsgi_io_uring *ur) {
+	struct iovec iov[UWSGI_IO_URING_BUFFERS];
+	ur->buffers = uwsgi_malloc(UWSGI_IO_URING_BUFFERS * UWSGI_IO_URING_BUFFER_SIZE);
+	int i;
+	for (i = 0; i < UWSGI_IO_URING_BUFFERS; i++) {
+		iov[i].iov_base = ur->buffers + (i * UWSGI_IO_URING_BUFFER_SIZE);
+		iov[i].iov_len = UWSGI_IO_URING_BUFFER_SIZE;
+		ur->free_buffers[i] = i;
+	}
+	if (syscall(__NR_io_uring_register, ur->fd, IORING_REGISTER_BUFFERS, iov, UWSGI_IO_URING_BUFFERS) < 0) {
+		uwsgi_error("io_uring_register()");
+		uwsgi_log("*** io_uring registered buffers not available, ring reads disabled ***\n");
+		free(ur->buffers);
+		ur->buffers = NULL;
+		ur->no_buffers = 1;
+		return -1;
+	}
+	ur->free_buffers_cnt = UWSGI_IO_URING_BUFFERS;
+	ur->fds = uwsgi_calloc(sizeof(struct uwsgi_io_uring_fd) * uwsgi.max_fd);
+	return 0;
+}
+
+// read the ring readers of a batch with a single syscall
+static void uwsgi_io_uring_prefetch(int eq, struct uwsgi_io_uring *ur, struct epoll_event *events, int n) {
+	int fds[UWSGI_IO_URING_ENTRIES];
+	unsigned k = 0;
+	int i;
+	for (i = 0; i < n && k < UWSGI_IO_URING_ENTRIES && k < ur->entries && ur->free_buffers_cnt > 0; i++) {
+		int fd = events[i].data.fd;
+		if (!(events[i].events & EPOLLIN) || fd < 0 || fd >= (int) uwsgi.max_fd) continue;
+		struct uwsgi_io_uring_fd *uf = &ur->fds[fd];
+		if (!uf->reader || uf->buffer || !uf->want) continue;
+		uf->buffer = ur->free_buffers[--ur->free_buffers_cnt] + 1;
+		fds[k++] = fd;
+	}
+
+	// a single read costs the same syscall, avoid the ring round-trip
+	if (k < 2) {
+		if (k) uwsgi_io_uring_release(ur, fds[0]);
+		return;
+	}
+
+	unsigned tail = *ur->sq_tail;
+	unsigned j;
+	for (j = 0; j < k; j++) {
+		struct uwsgi_io_uring_fd *uf = &ur->fds[fds[j]];
+		struct io_uring_sqe *sqe = &ur->sqes[(tail + j) & *ur->sq_mask];
+		memset(sqe, 0, sizeof(struct io_uring_sqe));
+		sqe->opcode = IORING_OP_READ_FIXED;
+		sqe->fd = fds[j];
+		sqe->addr = (uint64_t) (uintptr_t) (ur->buffers + ((uf->buffer - 1) * UWSGI_IO_URING_BUFFER_SIZE));
+		sqe->len = uf->want < UWSGI_IO_URING_BUFFER_SIZE ? uf->want : UWSGI_IO_URING_BUFFER_SIZE;
+		sqe->buf_index = uf->buffer - 1;
+		sqe->user_data = uwsgi_io_uring_data(UWSGI_IO_URING_READ, fds[j]);
+	}
+	__atomic_store_n(ur->sq_tail, tail + k, __ATOMIC_RELEASE);
+
+	// nothing has been read, the owner will do it by itself
+	if (uwsgi_io_uring_submit_and_wait(eq, ur, k)) {
+		for (j = 0; j < k; j++) {
+			uwsgi_io_uring_release(ur, fds[j]);
+		}
+	}
+}
+
+static int uwsgi_epoll_ctl(int eq, int op, int fd, struct epoll_event *ee) {
+	struct uwsgi_io_uring *ur = uwsgi_io_uring_lookup(eq);
+	if (!ur) return epoll_ctl(eq, op, fd, ee);
+
+	int owner = uwsgi_io_uring_is_owner(ur);
+
+	if (owner && ur->acceptors) {
+		// listening sockets managed by a multishot accept are not in the epoll set
+		struct uwsgi_io_uring_acceptor *ua = uwsgi_io_uring_acceptor_get(ur, fd);
+		if (ua) {
+			if (op == EPOLL_CTL_ADD) {
+				if (!ua->fallback) return uwsgi_io_uring_activate(eq, ur, ua);
+				ua->active = 1;
+			}
+			else if (op == EPOLL_CTL_DEL) {
+				if (!ua->fallback) {
+					uwsgi_io_uring_deactivate(eq, ur, ua);
+					return 0;
+				}
+				ua->active = 0;
+			}
+			else if (!ua->fallback) {
+				return 0;
+			}
+		}
+	}
+
+	if (owner && ur->fds && fd >= 0 && fd < (int) uwsgi.max_fd) {
+		ur->fds[fd].events = op == EPOLL_CTL_DEL ? 0 : ee->events;
+	}
+
+	if (ur->no_ctl || op == EPOLL_CTL_ADD || !ur->has_owner || !owner) {
+		uwsgi_io_uring_flush(eq, ur);
+		return epoll_ctl(eq, op, fd, ee);
+	}
+
+	if (ur->pending >= ur->entries) {
+		uwsgi_io_uring_flush(eq, ur);
+	}
+
+	struct uwsgi_io_uring_op *uop = &ur->ops[ur->pending++];
+	uop->op = op;
+	uop->fd = fd;
+	uop->ee = *ee;
+	return 0;
+}
+
+static int uwsgi_epoll_has_event(struct epoll_event *events, int n, int fd) {
+	int i;
+	for (i = 0; i < n; i++) {
+		if (events[i].data.fd == fd) return 1;
+	}
+	return 0;
+}
+
+// called by the waiter (it becomes the owner of the queue), returns the number of events generated by the ring
+static int uwsgi_epoll_prepare_wait(int eq, struct epoll_event *events, int nevents) {
+	struct uwsgi_io_uring *ur = uwsgi_io_uring_lookup(eq);
+	if (!ur) return 0;
+	if (!ur->has_owner) {
+		ur->owner = pthread_self();
+		ur->has_owner = 1;
+	}
+	uwsgi_io_uring_flush(eq, ur);
+	if (ur->acceptors) {
+		uwsgi_io_uring_reap(eq, ur);
+		uwsgi_io_uring_rearm(eq, ur);
+	}
+
+	int n = 0;
+	while (ur->failed_cnt > 0 && n < nevents) {
+		memset(&events[n], 0, sizeof(struct epoll_event));
+		events[n].events = EPOLLIN | EPOLLERR | EPOLLHUP;
+		events[n].data.fd = ur->failed[--ur->failed_cnt];
+		n++;
+	}
+
+	// listening sockets with connections already accepted
+	struct uwsgi_io_uring_acceptor *ua = ur->acceptors;
+	while (ua && n < nevents) {
+		if (ua->active && ua->accepted_cnt > 0) {
+			memset(&events[n], 0, sizeof(struct epoll_event));
+			events[n].events = EPOLLIN;
+			events[n].data.fd = ua->fd;
+			n++;
+		}
+		ua = ua->next;
+	}
+
+	// ring readers with data still to consume
+	unsigned i;
+	for (i = 0; i < ur->prefetched_cnt && n < nevents; i++) {
+		int fd = ur->prefetched[i];
+		if (ur->fds[fd].events & EPOLLIN) {
+			memset(&events[n], 0, sizeof(struct epoll_event));
+			events[n].events = EPOLLIN;
+			events[n].data.fd = fd;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+// manage the events of the ring itself and read the ring readers, returns the new number of events
+static int uwsgi_epoll_complete_wait(int eq, struct epoll_event *events, int first, int n, int nevents) {
+	struct uwsgi_io_uring *ur = uwsgi_io_uring_lookup(eq);
+	if (!ur) return n;
+
+	int i, j;
+	// a file descriptor already reported by the ring must appear only once
+	for (i = first; i < n; i++) {
+		for (j = 0; j < first; j++) {
+			if (events[j].data.fd == events[i].data.fd) {
+				events[j].events |= events[i].events;
+				events[i--] = events[--n];
+				break;
+			}
+		}
+	}
+
+	if (ur->ring_in_epoll) {
+		for (i = first; i < n; i++) {
+			if (events[i].data.fd != ur->fd) continue;
+			events[i] = events[n - 1];
+			n--;
+			uwsgi_io_uring_reap(eq, ur);
+			uwsgi_io_uring_rearm(eq, ur);
+			struct uwsgi_io_uring_acceptor *ua = ur->acceptors;
+			while (ua && n < nevents) {
+				if (ua->active && ua->accepted_cnt > 0 && !uwsgi_epoll_has_event(events, n, ua->fd)) {
+					memset(&events[n], 0, sizeof(struct epoll_event));
+					events[n].events = EPOLLIN;
+					events[n].data.fd = ua->fd;
+					n++;
+				}
+				ua = ua->next;
+			}
+			break;
+		}
+	}
+
+	if (ur->fds && !ur->no_buffers) {
+		uwsgi_io_uring_prefetch(eq, ur, events + first, n - first);
+	}
+	return n;
+}
+
+int event_queue_add_fd_accept(int eq, int fd) {
+	struct uwsgi_io_uring *ur = uwsgi_io_uring_lookup(eq);
+	if (!ur || !uwsgi_io_uring_is_owner(ur)) return event_queue_add_fd_read(eq, fd);
+	if (!uwsgi_io_uring_acceptor_get(ur, fd)) {
+		// buffers are registered before any request is in flight
+		if (!ur->fds && !ur->no_buffers) uwsgi_io_uring_buffers_init(ur);
+		struct uwsgi_io_uring_acceptor *ua = uwsgi_calloc(sizeof(struct uwsgi_io_uring_acceptor));
+		ua->fd = fd;
+		ua->next = ur->acceptors;
+		ur->acceptors = ua;
+	}
+	// the acceptor intercepts the addition
+	return event_queue_add_fd_read(eq, fd);
+}
+
+/*
+	returns a connection already accepted by the queue for the listening socket 'fd' (its address is stored in 'addr'),
+	-1 if the queue does not accept for the socket (the caller has to accept() by itself) or -2 if there are no more connections
+*/
+int event_queue_accepted(int eq, int fd, struct sockaddr *addr, socklen_t *addr_len) {
+	struct uwsgi_io_uring *ur = uwsgi_io_uring_lookup(eq);
+	if (!ur || !ur->acceptors) return -1;
+	struct uwsgi_io_uring_acceptor *ua = uwsgi_io_uring_acceptor_get(ur, fd);
+	if (!ua) return -1;
+	if (!ua->accepted_cnt) return ua->fallback ? -1 : -2;
+	int new_fd = ua->accepted[ua->accepted_head++];
+	ua->accepted_cnt--;
+	if (!ua->accepted_cnt) ua->accepted_head = 0;
+	// multishot accept does not report the address
+	if (getpeername(new_fd, addr, addr_len)) {
+		// the peer could be already gone, the first read will fail
+		memset(addr, 0, *addr_len);
+	}
+	return new_fd;
+}
+
+ssize_t event_queue_fd_read(int eq, int fd, char *buf, size_t len) {
+	struct uwsgi_io_uring *ur = uwsgi_io_uring_lookup(eq);
+	if (!ur || ur->no_buffers || fd < 0 || fd >= (int) uwsgi.max_fd || !ur->has_owner || !pthread_equal(ur->owner, pthread_self())) {
+		return read(fd, buf, len);
+	}
+	if (!ur->fds && uwsgi_io_uring_buffers_init(ur)) return read(fd, buf, len);
+
+	struct uwsgi_io_uring_fd *uf = &ur->fds[fd];
+	if (!uf->reader) {
+		uf->reader = 1;
+		// we are managing a read event
+		if (!uf->events) uf->events = EPOLLIN;
+	}
+	uf->want = len < UWSGI_IO_URING_BUFFER_SIZE ? len : UWSGI_IO_URING_BUFFER_SIZE;
+	if (!uf->buffer) return read(fd, buf, len);
+
+	if (uf->res <= 0) {
+		int res = uf->res;
+		uwsgi_io_uring_release(ur, fd);
+		if (res < 0) {
+			errno = -res;
+			return -1;
+		}
+		return 0;
+	}
+
+	size_t available = uf->res - uf->off;
+	if (len > available) len = available;
+	memcpy(buf, ur->buffers + ((uf->buffer - 1) * UWSGI_IO_URING_BUFFER_SIZE) + uf->off, len);
+	uf->off += len;
+	if (uf->off >= (uint32_t) uf->res) {
+		uwsgi_io_uring_release(ur, fd);
+	}
+	return len;
+}
+
+void event_queue_fd_forget(int eq, int fd) {
+	struct uwsgi_io_uring *ur = uwsgi_io_uring_lookup(eq);
+	if (!ur || !ur->fds || fd < 0 || fd >= (int) uwsgi.max_fd) return;
+	uwsgi_io_uring_release(ur, fd);
+	memset(&ur->fds[fd], 0, sizeof(struct uwsgi_io_uring_fd));
+}
+
+#else
+#define uwsgi_epoll_ctl epoll_ctl
+#define uwsgi_epoll_prepare_wait(x, y, z) 0
+#define uwsgi_epoll_complete_wait(a, b, c, d, e) (d)
+#endif
+
 int event_queue_init() {
 
 	int epfd;
@@ -504,6 +1424,20 @@ int event_queue_init() {
 		return -1;
 	}
 
+#ifdef UWSGI_EVENT_USE_IO_URING
+	if (!uwsgi_io_uring_table) {
+		uwsgi_io_uring_table = uwsgi_calloc(sizeof(struct uwsgi_io_uring *) * uwsgi.max_fd);
+		pthread_atfork(NULL, NULL, uwsgi_io_uring_atfork_child);
+	}
+	if (epfd < (int) uwsgi.max_fd) {
+		// the descriptor number could have been used by a queue closed (or inherited) before
+		if (uwsgi_io_uring_table[epfd]) {
+			uwsgi_io_uring_free(uwsgi_io_uring_table[epfd]);
+		}
+		uwsgi_io_uring_table[epfd] = uwsgi_io_uring_new();
+	}
+#endif
+
 	return epfd;
 }
 
@@ -516,7 +1450,7 @@ int event_queue_add_fd_read(int eq, int fd) {
 	ee.events = EPOLLIN;
 	ee.data.fd = fd;
 
-	if (epoll_ctl(eq, EPOLL_CTL_ADD, fd, &ee)) {
+	if (uwsgi_epoll_ctl(eq, EPOLL_CTL_ADD, fd, &ee)) {
 		uwsgi_error("epoll_ctl()");
 		return -1;
 	}
@@ -532,7 +1466,7 @@ int event_queue_fd_write_to_read(int eq, int fd) {
 	ee.events = EPOLLIN;
 	ee.data.fd = fd;
 
-	if (epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
+	if (uwsgi_epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
 		uwsgi_error("epoll_ctl()");
 		return -1;
 	}
@@ -548,7 +1482,7 @@ int event_queue_fd_read_to_write(int eq, int fd) {
 	ee.events = EPOLLOUT;
 	ee.data.fd = fd;
 
-	if (epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
+	if (uwsgi_epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
 		uwsgi_error("epoll_ctl()");
 		return -1;
 	}
@@ -564,7 +1498,7 @@ int event_queue_fd_readwrite_to_read(int eq, int fd) {
 	ee.events = EPOLLIN;
 	ee.data.fd = fd;
 
-	if (epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
+	if (uwsgi_epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
 		uwsgi_error("epoll_ctl()");
 		return -1;
 	}
@@ -580,7 +1514,7 @@ int event_queue_fd_readwrite_to_write(int eq, int fd) {
 	ee.events = EPOLLOUT;
 	ee.data.fd = fd;
 
-	if (epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
+	if (uwsgi_epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
 		uwsgi_error("epoll_ctl()");
 		return -1;
 	}
@@ -597,7 +1531,7 @@ int event_queue_fd_read_to_readwrite(int eq, int fd) {
 	ee.events = EPOLLIN | EPOLLOUT;
 	ee.data.fd = fd;
 
-	if (epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
+	if (uwsgi_epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
 		uwsgi_error("epoll_ctl()");
 		return -1;
 	}
@@ -613,7 +1547,7 @@ int event_queue_fd_write_to_readwrite(int eq, int fd) {
 	ee.events = EPOLLIN | EPOLLOUT;
 	ee.data.fd = fd;
 
-	if (epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
+	if (uwsgi_epoll_ctl(eq, EPOLL_CTL_MOD, fd, &ee)) {
 		uwsgi_error("epoll_ctl()");
 		return -1;
 	}
@@ -631,7 +1565,7 @@ int event_queue_del_fd(int eq, int fd, int event) {
 	ee.data.fd = fd;
 	ee.events = event;
 
-	if (epoll_ctl(eq, EPOLL_CTL_DEL, fd, &ee)) {
+	if (uwsgi_epoll_ctl(eq, EPOLL_CTL_DEL, fd, &ee)) {
 		uwsgi_error("epoll_ctl()");
 		return -1;
 	}
@@ -647,7 +1581,7 @@ int event_queue_add_fd_write(int eq, int fd) {
 	ee.events = EPOLLOUT;
 	ee.data.fd = fd;
 
-	if (epoll_ctl(eq, EPOLL_CTL_ADD, fd, &ee)) {
+	if (uwsgi_epoll_ctl(eq, EPOLL_CTL_ADD, fd, &ee)) {
 		uwsgi_error("epoll_ctl()");
 		return -1;
 	}
@@ -690,21 +1624,22 @@ int event_queue_interesting_fd_is_write(void *events, int id) {
 }
 
 
-int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
+int event_queue_wait_multi_ms(int eq, int timeout, void *events, int nevents) {
 
 	int ret;
 
-	if (timeout > 0) {
-		timeout = timeout * 1000;
-	}
+	int synthetic = uwsgi_epoll_prepare_wait(eq, (struct epoll_event *) events, nevents);
+	if (synthetic >= nevents) return synthetic;
 
-	ret = epoll_wait(eq, (struct epoll_event *) events, nevents, timeout);
+	ret = epoll_wait(eq, ((struct epoll_event *) events) + synthetic, nevents - synthetic, synthetic ? 0 : timeout);
 	if (ret < 0) {
 		if (errno != EINTR)
 			uwsgi_error("epoll_wait()");
+		if (synthetic) return synthetic;
+		return ret;
 	}
 
-	return ret;
+	return uwsgi_epoll_complete_wait(eq, (struct epoll_event *) events, synthetic, ret + synthetic, nevents);
 }
 
 int event_queue_wait(int eq, int timeout, int *interesting_fd) {
@@ -716,11 +1651,19 @@ int event_queue_wait(int eq, int timeout, int *interesting_fd) {
 		timeout = timeout * 1000;
 	}
 
+	if (uwsgi_epoll_prepare_wait(eq, &ee, 1)) {
+		*interesting_fd = ee.data.fd;
+		return 1;
+	}
+
 	ret = epoll_wait(eq, &ee, 1, timeout);
 	if (ret < 0) {
 		if (errno != EINTR)
 			uwsgi_error("epoll_wait()");
 	}
+	else {
+		ret = uwsgi_epoll_complete_wait(eq, &ee, 0, ret, 1);
+	}
 
 	if (ret > 0) {
 		*interesting_fd = ee.data.fd;
@@ -885,7 +1828,7 @@ void *event_queue_alloc(int nevents) {
 	return uwsgi_malloc(sizeof(struct kevent) * nevents);
 }
 
-int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
+int event_queue_wait_multi_ms(int eq, int timeout, void *events, int nevents) {
 
 	int ret;
 	struct timespec ts;
@@ -895,7 +1838,8 @@ int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
 	}
 	else {
 		memset(&ts, 0, sizeof(struct timespec));
-		ts.tv_sec = timeout;
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
 		ret = kevent(eq, NULL, 0, (struct kevent *) events, nevents, &ts);
 	}
 
@@ -1412,6 +2356,44 @@ int event_queue_read() {
 	return UWSGI_EVENT_IN;
 }
 
+// counters are updated without locking, a bit of inaccuracy is better than contention
+void uwsgi_events_histogram_add(struct uwsgi_events_histogram *ueh, int nevents) {
+	if (nevents < 0) return;
+	int bucket = 0;
+	while (nevents >> bucket && bucket < UWSGI_EVENTS_HISTOGRAM_BUCKETS - 1) {
+		bucket++;
+	}
+	ueh->wakeups++;
+	ueh->events += nevents;
+	ueh->buckets[bucket]++;
+}
+
 int event_queue_write() {
 	return UWSGI_EVENT_OUT;
 }
+
+// the timeout is in seconds (-1 waits forever)
+int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
+	if (timeout > 0) {
+		timeout = timeout * 1000;
+	}
+	return event_queue_wait_multi_ms(eq, timeout, events, nevents);
+}
+
+#ifndef UWSGI_EVENT_USE_IO_URING
+// only the io_uring engine accepts and reads by itself
+int event_queue_add_fd_accept(int eq, int fd) {
+	return event_queue_add_fd_read(eq, fd);
+}
+
+int event_queue_accepted(int eq, int fd, struct sockaddr *addr, socklen_t *addr_len) {
+	return -1;
+}
+
+ssize_t event_queue_fd_read(int eq, int fd, char *buf, size_t len) {
+	return read(fd, buf, len);
+}
+
+void event_queue_fd_forget(int eq, int fd) {
+}
+#endif
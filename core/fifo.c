@@ -123,6 +123,7 @@ int uwsgi_master_fifo_manage(int fd) {
 	// fifo destroyed, recreate it
 	else if (rlen == 0) {
 		close(fd);
+		uwsgi_master_fd_closed(fd);
 		uwsgi.master_fifo_fd = uwsgi_master_fifo();
 		event_queue_add_fd_read(uwsgi.master_queue, uwsgi.master_fifo_fd);
 		return 0;
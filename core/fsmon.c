@@ -77,6 +77,14 @@ static void fsmon_signal(struct uwsgi_fsmon *fs) {
 	uwsgi_route_signal(atoi((char *) fs->data));
 }
 
+static void fsmon_static_open_cache(struct uwsgi_fsmon *fs) {
+	uwsgi_static_open_cache_invalidate();
+}
+
+static void fsmon_static_store(struct uwsgi_fsmon *fs) {
+	uwsgi_static_store_schedule_reload();
+}
+
 void uwsgi_fsmon_setup() {
 	struct uwsgi_string_list *usl = NULL;
 	uwsgi_foreach(usl, uwsgi.fs_reload) {
@@ -96,6 +104,12 @@ void uwsgi_fsmon_setup() {
 		*space = 0;
 		uwsgi_register_fsmon(copy, fsmon_signal, space + 1);
 	}
+	uwsgi_foreach(usl, uwsgi.static_open_cache_monitor) {
+		uwsgi_register_fsmon(usl->value, fsmon_static_open_cache, NULL);
+	}
+	uwsgi_foreach(usl, uwsgi.static_store_monitored) {
+		uwsgi_register_fsmon(usl->value, fsmon_static_store, NULL);
+	}
 
 	struct uwsgi_fsmon *fs = uwsgi.fsmon;
 	while (fs) {
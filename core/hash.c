@@ -74,6 +74,352 @@ static uint32_t rr_hash(char *key, uint64_t keylen) {
 	return ret;
 }
 
+/*
+	64bit helpers for the modern hashes (results are truncated to 32bit)
+*/
+
+#if defined(__x86_64__) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define UWSGI_HASH_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+static inline uint64_t hash_read64(uint8_t *p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+#if __BYTE_ORDER == __BIG_ENDIAN
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline uint32_t hash_read32(uint8_t *p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+#if __BYTE_ORDER == __BIG_ENDIAN
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+static inline void hash_mul128(uint64_t a, uint64_t b, uint64_t *lo, uint64_t *hi) {
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t) a * b;
+	*lo = (uint64_t) r;
+	*hi = (uint64_t) (r >> 64);
+#else
+	uint64_t lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+	uint64_t hi_lo = (a >> 32) * (b & 0xffffffff);
+	uint64_t lo_hi = (a & 0xffffffff) * (b >> 32);
+	uint64_t hi_hi = (a >> 32) * (b >> 32);
+	uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+	*hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+	*lo = (cross << 32) | (lo_lo & 0xffffffff);
+#endif
+}
+
+static inline uint64_t hash_mul128_fold64(uint64_t a, uint64_t b) {
+	uint64_t lo, hi;
+	hash_mul128(a, b, &lo, &hi);
+	return lo ^ hi;
+}
+
+#define hash_rotl64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+// wyhash (final version 4) by Wang Yi, public domain
+
+static const uint64_t wyhash_secret[4] = {0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL};
+
+static inline uint64_t wyhash_mix(uint64_t a, uint64_t b) {
+	return hash_mul128_fold64(a, b);
+}
+
+static uint64_t wyhash64(uint8_t *p, uint64_t len, uint64_t seed) {
+	const uint64_t *secret = wyhash_secret;
+	uint64_t a, b;
+	seed ^= wyhash_mix(seed ^ secret[0], secret[1]);
+	if (len <= 16) {
+		if (len >= 4) {
+			a = ((uint64_t) hash_read32(p) << 32) | hash_read32(p + ((len >> 3) << 2));
+			b = ((uint64_t) hash_read32(p + len - 4) << 32) | hash_read32(p + len - 4 - ((len >> 3) << 2));
+		}
+		else if (len > 0) {
+			a = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+			b = 0;
+		}
+		else {
+			a = b = 0;
+		}
+	}
+	else {
+		uint64_t i = len;
+		if (i > 48) {
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = wyhash_mix(hash_read64(p) ^ secret[1], hash_read64(p + 8) ^ seed);
+				see1 = wyhash_mix(hash_read64(p + 16) ^ secret[2], hash_read64(p + 24) ^ see1);
+				see2 = wyhash_mix(hash_read64(p + 32) ^ secret[3], hash_read64(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = wyhash_mix(hash_read64(p) ^ secret[1], hash_read64(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = hash_read64(p + i - 16);
+		b = hash_read64(p + i - 8);
+	}
+	a ^= secret[1];
+	b ^= seed;
+	hash_mul128(a, b, &a, &b);
+	return wyhash_mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+static uint32_t wyhash_hash(char *key, uint64_t keylen) {
+	return (uint32_t) wyhash64((uint8_t *) key, keylen, 0);
+}
+
+/*
+	XXH3 (64bit, seed 0) by Yann Collet, BSD 2-Clause License
+
+	keys up to 240 bytes (the common case) are hashed with scalar code,
+	longer ones use 8 64bit accumulators, updated with SSE2 or AVX2 when available (checked at runtime)
+*/
+
+#define XXH_PRIME32_1 0x9E3779B1U
+#define XXH_PRIME32_2 0x85EBCA77U
+#define XXH_PRIME32_3 0xC2B2AE3DU
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+#define XXH_PRIME_MX1 0x165667919E3779F9ULL
+#define XXH_PRIME_MX2 0x9FB21C651E98DF25ULL
+
+#define XXH3_SECRET_SIZE 192
+#define XXH3_STRIPE_LEN 64
+#define XXH3_STRIPES_PER_BLOCK ((XXH3_SECRET_SIZE - XXH3_STRIPE_LEN) / 8)
+#define XXH3_BLOCK_LEN (XXH3_STRIPE_LEN * XXH3_STRIPES_PER_BLOCK)
+
+static uint8_t xxh3_secret[XXH3_SECRET_SIZE] __attribute__ ((aligned (64))) = {
+	0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+	0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+	0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+	0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+	0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+	0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+	0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+	0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+	0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+	0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+	0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+	0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline uint64_t xxh64_avalanche(uint64_t h) {
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+static inline uint64_t xxh3_avalanche(uint64_t h) {
+	h ^= h >> 37;
+	h *= XXH_PRIME_MX1;
+	h ^= h >> 32;
+	return h;
+}
+
+static inline uint64_t xxh3_rrmxmx(uint64_t h, uint64_t len) {
+	h ^= hash_rotl64(h, 49) ^ hash_rotl64(h, 24);
+	h *= XXH_PRIME_MX2;
+	h ^= (h >> 35) + len;
+	h *= XXH_PRIME_MX2;
+	return h ^ (h >> 28);
+}
+
+static inline uint64_t xxh3_mix16(uint8_t *p, uint8_t *secret) {
+	return hash_mul128_fold64(hash_read64(p) ^ hash_read64(secret), hash_read64(p + 8) ^ hash_read64(secret + 8));
+}
+
+static uint64_t xxh3_0to16(uint8_t *p, uint64_t len) {
+	uint8_t *secret = xxh3_secret;
+	if (len > 8) {
+		uint64_t lo = hash_read64(p) ^ (hash_read64(secret + 24) ^ hash_read64(secret + 32));
+		uint64_t hi = hash_read64(p + len - 8) ^ (hash_read64(secret + 40) ^ hash_read64(secret + 48));
+		return xxh3_avalanche(len + __builtin_bswap64(lo) + hi + hash_mul128_fold64(lo, hi));
+	}
+	if (len >= 4) {
+		uint64_t in64 = hash_read32(p + len - 4) + ((uint64_t) hash_read32(p) << 32);
+		return xxh3_rrmxmx(in64 ^ (hash_read64(secret + 8) ^ hash_read64(secret + 16)), len);
+	}
+	if (len > 0) {
+		uint32_t combined = ((uint32_t) p[0] << 16) | ((uint32_t) p[len >> 1] << 24) | ((uint32_t) p[len - 1]) | ((uint32_t) len << 8);
+		return xxh64_avalanche((uint64_t) combined ^ (hash_read32(secret) ^ hash_read32(secret + 4)));
+	}
+	return xxh64_avalanche(hash_read64(secret + 56) ^ hash_read64(secret + 64));
+}
+
+static uint64_t xxh3_17to128(uint8_t *p, uint64_t len) {
+	uint8_t *secret = xxh3_secret;
+	uint64_t acc = len * XXH_PRIME64_1;
+	if (len > 32) {
+		if (len > 64) {
+			if (len > 96) {
+				acc += xxh3_mix16(p + 48, secret + 96);
+				acc += xxh3_mix16(p + len - 64, secret + 112);
+			}
+			acc += xxh3_mix16(p + 32, secret + 64);
+			acc += xxh3_mix16(p + len - 48, secret + 80);
+		}
+		acc += xxh3_mix16(p + 16, secret + 32);
+		acc += xxh3_mix16(p + len - 32, secret + 48);
+	}
+	acc += xxh3_mix16(p, secret);
+	acc += xxh3_mix16(p + len - 16, secret + 16);
+	return xxh3_avalanche(acc);
+}
+
+static uint64_t xxh3_129to240(uint8_t *p, uint64_t len) {
+	uint8_t *secret = xxh3_secret;
+	uint64_t acc = len * XXH_PRIME64_1;
+	uint64_t rounds = len / 16;
+	uint64_t i;
+	for (i = 0; i < 8; i++) {
+		acc += xxh3_mix16(p + (16 * i), secret + (16 * i));
+	}
+	acc = xxh3_avalanche(acc);
+	for (i = 8; i < rounds; i++) {
+		acc += xxh3_mix16(p + (16 * i), secret + (16 * (i - 8)) + 3);
+	}
+	acc += xxh3_mix16(p + len - 16, secret + 136 - 17);
+	return xxh3_avalanche(acc);
+}
+
+// consume n stripes of input, then (if requested) scramble the accumulators
+static void xxh3_accumulate_scalar(uint64_t *acc, uint8_t *p, uint8_t *secret, uint64_t n, int scramble) {
+	uint64_t s, i;
+	for (s = 0; s < n; s++) {
+		uint8_t *in = p + (s * XXH3_STRIPE_LEN);
+		uint8_t *key = secret + (s * 8);
+		for (i = 0; i < 8; i++) {
+			uint64_t data = hash_read64(in + (8 * i));
+			uint64_t data_key = data ^ hash_read64(key + (8 * i));
+			acc[i ^ 1] += data;
+			acc[i] += (data_key & 0xffffffff) * (data_key >> 32);
+		}
+	}
+	if (!scramble) return;
+	for (i = 0; i < 8; i++) {
+		uint64_t a = acc[i];
+		a ^= a >> 47;
+		a ^= hash_read64(xxh3_secret + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN + (8 * i));
+		acc[i] = a * XXH_PRIME32_1;
+	}
+}
+
+#ifdef UWSGI_HASH_X86_DISPATCH
+__attribute__ ((target ("sse2")))
+static void xxh3_accumulate_sse2(uint64_t *acc, uint8_t *p, uint8_t *secret, uint64_t n, int scramble) {
+	__m128i xacc[4];
+	uint64_t s;
+	int i;
+	for (i = 0; i < 4; i++) xacc[i] = _mm_loadu_si128((__m128i *) (acc + (2 * i)));
+	for (s = 0; s < n; s++) {
+		uint8_t *in = p + (s * XXH3_STRIPE_LEN);
+		uint8_t *key = secret + (s * 8);
+		for (i = 0; i < 4; i++) {
+			__m128i data = _mm_loadu_si128((__m128i *) (in + (16 * i)));
+			__m128i data_key = _mm_xor_si128(data, _mm_loadu_si128((__m128i *) (key + (16 * i))));
+			__m128i product = _mm_mul_epu32(data_key, _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)));
+			__m128i sum = _mm_add_epi64(xacc[i], _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)));
+			xacc[i] = _mm_add_epi64(product, sum);
+		}
+	}
+	if (scramble) {
+		__m128i prime = _mm_set1_epi32((int) XXH_PRIME32_1);
+		for (i = 0; i < 4; i++) {
+			__m128i a = _mm_xor_si128(xacc[i], _mm_srli_epi64(xacc[i], 47));
+			__m128i data_key = _mm_xor_si128(a, _mm_loadu_si128((__m128i *) (xxh3_secret + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN + (16 * i))));
+			__m128i lo = _mm_mul_epu32(data_key, prime);
+			__m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+			xacc[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+		}
+	}
+	for (i = 0; i < 4; i++) _mm_storeu_si128((__m128i *) (acc + (2 * i)), xacc[i]);
+}
+
+__attribute__ ((target ("avx2")))
+static void xxh3_accumulate_avx2(uint64_t *acc, uint8_t *p, uint8_t *secret, uint64_t n, int scramble) {
+	__m256i xacc[2];
+	uint64_t s;
+	int i;
+	for (i = 0; i < 2; i++) xacc[i] = _mm256_loadu_si256((__m256i *) (acc + (4 * i)));
+	for (s = 0; s < n; s++) {
+		uint8_t *in = p + (s * XXH3_STRIPE_LEN);
+		uint8_t *key = secret + (s * 8);
+		for (i = 0; i < 2; i++) {
+			__m256i data = _mm256_loadu_si256((__m256i *) (in + (32 * i)));
+			__m256i data_key = _mm256_xor_si256(data, _mm256_loadu_si256((__m256i *) (key + (32 * i))));
+			__m256i product = _mm256_mul_epu32(data_key, _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)));
+			__m256i sum = _mm256_add_epi64(xacc[i], _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)));
+			xacc[i] = _mm256_add_epi64(product, sum);
+		}
+	}
+	if (scramble) {
+		__m256i prime = _mm256_set1_epi32((int) XXH_PRIME32_1);
+		for (i = 0; i < 2; i++) {
+			__m256i a = _mm256_xor_si256(xacc[i], _mm256_srli_epi64(xacc[i], 47));
+			__m256i data_key = _mm256_xor_si256(a, _mm256_loadu_si256((__m256i *) (xxh3_secret + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN + (32 * i))));
+			__m256i lo = _mm256_mul_epu32(data_key, prime);
+			__m256i hi = _mm256_mul_epu32(_mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+			xacc[i] = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+		}
+	}
+	for (i = 0; i < 2; i++) _mm256_storeu_si256((__m256i *) (acc + (4 * i)), xacc[i]);
+}
+#endif
+
+// selected by uwsgi_hash_algo_register_all()
+static void (*xxh3_accumulate)(uint64_t *, uint8_t *, uint8_t *, uint64_t, int) = xxh3_accumulate_scalar;
+
+static uint64_t xxh3_long(uint8_t *p, uint64_t len) {
+	uint64_t acc[8] = { XXH_PRIME32_3, XXH_PRIME64_1, XXH_PRIME64_2, XXH_PRIME64_3, XXH_PRIME64_4, XXH_PRIME32_2, XXH_PRIME64_5, XXH_PRIME32_1 };
+	uint64_t blocks = (len - 1) / XXH3_BLOCK_LEN;
+	uint64_t i;
+	for (i = 0; i < blocks; i++) {
+		xxh3_accumulate(acc, p + (i * XXH3_BLOCK_LEN), xxh3_secret, XXH3_STRIPES_PER_BLOCK, 1);
+	}
+	// last partial block
+	uint64_t stripes = ((len - 1) - (blocks * XXH3_BLOCK_LEN)) / XXH3_STRIPE_LEN;
+	xxh3_accumulate(acc, p + (blocks * XXH3_BLOCK_LEN), xxh3_secret, stripes, 0);
+	// last stripe
+	xxh3_accumulate(acc, p + len - XXH3_STRIPE_LEN, xxh3_secret + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN - 7, 1, 0);
+
+	// merge the accumulators
+	uint64_t result = len * XXH_PRIME64_1;
+	for (i = 0; i < 4; i++) {
+		result += hash_mul128_fold64(acc[2 * i] ^ hash_read64(xxh3_secret + 11 + (16 * i)), acc[(2 * i) + 1] ^ hash_read64(xxh3_secret + 11 + (16 * i) + 8));
+	}
+	return xxh3_avalanche(result);
+}
+
+static uint64_t xxh3_64(uint8_t *p, uint64_t len) {
+	if (len <= 16) return xxh3_0to16(p, len);
+	if (len <= 128) return xxh3_17to128(p, len);
+	if (len <= 240) return xxh3_129to240(p, len);
+	return xxh3_long(p, len);
+}
+
+static uint32_t xxh3_hash(char *key, uint64_t keylen) {
+	return (uint32_t) xxh3_64((uint8_t *) key, keylen);
+}
+
 struct uwsgi_hash_algo *uwsgi_hash_algo_get(char *name) {
 	struct uwsgi_hash_algo *uha = uwsgi.hash_algos;
 	while(uha) {
@@ -110,4 +456,16 @@ void uwsgi_hash_algo_register_all() {
 	uwsgi_hash_algo_register("random", random_hash);
 	uwsgi_hash_algo_register("rand", random_hash);
 	uwsgi_hash_algo_register("rr", rr_hash);
+	uwsgi_hash_algo_register("wyhash", wyhash_hash);
+	uwsgi_hash_algo_register("xxh3", xxh3_hash);
+
+#ifdef UWSGI_HASH_X86_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		xxh3_accumulate = xxh3_accumulate_avx2;
+	}
+	else if (__builtin_cpu_supports("sse2")) {
+		xxh3_accumulate = xxh3_accumulate_sse2;
+	}
+#endif
 }
@@ -0,0 +1,229 @@
+/* HTTP/1.x request parser (shared by --http-socket and the http router) */
+
+#include <uwsgi.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* how the request parser works:
+
+	the request is scanned 16 bytes at a time (SSE2, always available on x86_64) instead of
+	a byte at a time: every chunk is compared against the interesting characters
+	(CR, LF, space, '?'...) and the resulting bitmask gives the position of the first match
+	with a single ctz. Other platforms use the scalar loops.
+	The last bytes of a buffer (less than a vector) are always scanned with the scalar code,
+	so nothing after the end of the data is ever read.
+
+	The end of the headers (\r\n\r\n) is searched comparing 4 overlapping loads at once
+	(32 bytes at a time when the build enables AVX2, like CFLAGS=-march=haswell, tokens and header
+	lines are too short to gain anything from wider vectors).
+	Header keys are uppercased (and '-' is mapped to '_') in the same pass looking for the colon.
+
+	Headers are translated to uwsgi vars in the same way by both consumers:
+
+	Key-Name: value -> HTTP_KEY_NAME=value (CONTENT_LENGTH and CONTENT_TYPE have no prefix)
+
+	spaces before the value are skipped and continuation lines (starting with a space or a tab)
+	are part of the value. A request line without the 3 tokens, a header without a key
+	or a CR not followed by LF invalidate the whole request.
+
+*/
+
+#ifdef __SSE2__
+#define UWSGI_HTTP_VEC 16
+typedef __m128i http_vec;
+#define http_vec_load(x) _mm_loadu_si128((__m128i *) (x))
+#define http_vec_store(x, y) _mm_storeu_si128((__m128i *) (x), y)
+#define http_vec_set1(x) _mm_set1_epi8(x)
+#define http_vec_eq(x, y) _mm_cmpeq_epi8(x, y)
+#define http_vec_gt(x, y) _mm_cmpgt_epi8(x, y)
+#define http_vec_and(x, y) _mm_and_si128(x, y)
+#define http_vec_andnot(x, y) _mm_andnot_si128(x, y)
+#define http_vec_or(x, y) _mm_or_si128(x, y)
+#define http_vec_xor(x, y) _mm_xor_si128(x, y)
+#define http_vec_mask(x) (uint32_t) _mm_movemask_epi8(x)
+#endif
+
+#ifdef UWSGI_HTTP_VEC
+static const char http_vec_index[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+#endif
+
+// returns the first char in [ptr, end) matching one of c0..c3 (or NULL)
+static inline char *http_find(char *ptr, char *end, char c0, char c1, char c2, char c3) {
+#ifdef UWSGI_HTTP_VEC
+	http_vec v0 = http_vec_set1(c0);
+	http_vec v1 = http_vec_set1(c1);
+	http_vec v2 = http_vec_set1(c2);
+	http_vec v3 = http_vec_set1(c3);
+	while (end - ptr >= UWSGI_HTTP_VEC) {
+		http_vec v = http_vec_load(ptr);
+		uint32_t mask = http_vec_mask(http_vec_or(http_vec_or(http_vec_eq(v, v0), http_vec_eq(v, v1)), http_vec_or(http_vec_eq(v, v2), http_vec_eq(v, v3))));
+		if (mask) return ptr + __builtin_ctz(mask);
+		ptr += UWSGI_HTTP_VEC;
+	}
+#endif
+	while (ptr < end) {
+		char c = *ptr;
+		if (c == c0 || c == c1 || c == c2 || c == c3) return ptr;
+		ptr++;
+	}
+	return NULL;
+}
+
+// uppercases the key (mapping '-' to '_') in place, returns the colon (or NULL)
+static char *http_header_key(char *ptr, char *end) {
+#ifdef UWSGI_HTTP_VEC
+	http_vec colon = http_vec_set1(':');
+	http_vec dash = http_vec_set1('-');
+	http_vec before_a = http_vec_set1('a' - 1);
+	http_vec after_z = http_vec_set1('z' + 1);
+	http_vec flip_case = http_vec_set1(0x20);
+	http_vec flip_dash = http_vec_set1('-' ^ '_');
+	while (end - ptr >= UWSGI_HTTP_VEC) {
+		http_vec v = http_vec_load(ptr);
+		// bytes >= 0x80 are negative, so they are never in the a-z range
+		http_vec lower = http_vec_and(http_vec_gt(v, before_a), http_vec_gt(after_z, v));
+		http_vec key = http_vec_xor(v, http_vec_or(http_vec_and(lower, flip_case), http_vec_and(http_vec_eq(v, dash), flip_dash)));
+		uint32_t mask = http_vec_mask(http_vec_eq(v, colon));
+		if (mask) {
+			int i = __builtin_ctz(mask);
+			// the bytes after the colon are part of the value, leave them untouched
+			http_vec keep = http_vec_gt(http_vec_set1(i), http_vec_load(http_vec_index));
+			http_vec_store(ptr, http_vec_or(http_vec_and(keep, key), http_vec_andnot(keep, v)));
+			return ptr + i;
+		}
+		http_vec_store(ptr, key);
+		ptr += UWSGI_HTTP_VEC;
+	}
+#endif
+	while (ptr < end) {
+		char c = *ptr;
+		if (c == ':') return ptr;
+		if (c >= 'a' && c <= 'z') {
+			*ptr = c - 0x20;
+		}
+		else if (c == '-') {
+			*ptr = '_';
+		}
+		ptr++;
+	}
+	return NULL;
+}
+
+// returns the offset after the first \r\n\r\n in buf (the search starts at pos), -1 if not found
+ssize_t uwsgi_http_headers_end(char *buf, size_t len, size_t pos) {
+	char *ptr = buf + pos;
+	char *end = buf + len;
+#ifdef __AVX2__
+	__m256i cr32 = _mm256_set1_epi8('\r');
+	__m256i lf32 = _mm256_set1_epi8('\n');
+	while (end - ptr >= 32 + 3) {
+		__m256i first = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i *) ptr), cr32), _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i *) (ptr + 1)), lf32));
+		__m256i second = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i *) (ptr + 2)), cr32), _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i *) (ptr + 3)), lf32));
+		uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_and_si256(first, second));
+		if (mask) return (ptr - buf) + __builtin_ctz(mask) + 4;
+		ptr += 32;
+	}
+#endif
+#ifdef UWSGI_HTTP_VEC
+	http_vec cr = http_vec_set1('\r');
+	http_vec lf = http_vec_set1('\n');
+	while (end - ptr >= UWSGI_HTTP_VEC + 3) {
+		http_vec first = http_vec_and(http_vec_eq(http_vec_load(ptr), cr), http_vec_eq(http_vec_load(ptr + 1), lf));
+		http_vec second = http_vec_and(http_vec_eq(http_vec_load(ptr + 2), cr), http_vec_eq(http_vec_load(ptr + 3), lf));
+		uint32_t mask = http_vec_mask(http_vec_and(first, second));
+		if (mask) return (ptr - buf) + __builtin_ctz(mask) + 4;
+		ptr += UWSGI_HTTP_VEC;
+	}
+#endif
+	while (end - ptr >= 4) {
+		if (ptr[0] == '\r' && ptr[1] == '\n' && ptr[2] == '\r' && ptr[3] == '\n') return (ptr - buf) + 4;
+		ptr++;
+	}
+	return -1;
+}
+
+// parses "METHOD URI PROTOCOL\r\n", returns the start of the headers (or NULL)
+char *uwsgi_http_parse_request_line(char *ptr, char *watermark, struct uwsgi_http_request_line *uhrl) {
+
+	// REQUEST_METHOD
+	char *base = ptr;
+	ptr = http_find(ptr, watermark, ' ', '\r', '\n', '\n');
+	if (!ptr || *ptr != ' ') return NULL;
+	uhrl->method = base;
+	uhrl->method_len = ptr - base;
+
+	// REQUEST_URI / PATH_INFO / QUERY_STRING
+	base = ++ptr;
+	ptr = http_find(ptr, watermark, ' ', '?', '\r', '\n');
+	if (!ptr) return NULL;
+	uhrl->path = base;
+	uhrl->path_len = ptr - base;
+	uhrl->query_string = NULL;
+	uhrl->query_string_len = 0;
+	if (*ptr == '?') {
+		uhrl->query_string = ptr + 1;
+		ptr = http_find(ptr + 1, watermark, ' ', '\r', '\n', '\n');
+		if (!ptr) return NULL;
+		uhrl->query_string_len = ptr - uhrl->query_string;
+	}
+	if (*ptr != ' ') return NULL;
+	uhrl->uri = base;
+	uhrl->uri_len = ptr - base;
+
+	// SERVER_PROTOCOL
+	base = ++ptr;
+	ptr = http_find(ptr, watermark, '\r', '\n', '\n', '\n');
+	if (!ptr || *ptr != '\r' || ptr + 1 >= watermark || ptr[1] != '\n') return NULL;
+	uhrl->protocol = base;
+	uhrl->protocol_len = ptr - base;
+
+	return ptr + 2;
+}
+
+/*
+	parses the header at *ptr (translating the key in place) and moves *ptr to the next one,
+	returns 1 on success, 0 at the end of the headers (the empty line) and -1 on error
+*/
+int uwsgi_http_parse_header(char **ptr, char *watermark, struct uwsgi_http_header *uhh) {
+	char *base = *ptr;
+	char *eol = base;
+
+	if (watermark - base < 2) return -1;
+	if (base[0] == '\r' && base[1] == '\n') {
+		*ptr = base + 2;
+		return 0;
+	}
+
+	for (;;) {
+		eol = http_find(eol, watermark, '\r', '\r', '\r', '\r');
+		if (!eol || eol + 1 >= watermark || eol[1] != '\n') return -1;
+		// multiline header ?
+		if (eol + 2 < watermark && (eol[2] == ' ' || eol[2] == '\t')) {
+			eol += 2;
+			continue;
+		}
+		break;
+	}
+
+	if (eol - base > UMAX16) return -1;
+
+	char *colon = http_header_key(base, eol);
+	if (!colon || colon == base) return -1;
+
+	uhh->key = base;
+	uhh->keylen = colon - base;
+
+	char *val = colon + 1;
+	while (val < eol && *val == ' ') val++;
+	uhh->val = val;
+	uhh->vallen = eol - val;
+
+	uhh->prefix = uwsgi_strncmp("CONTENT_LENGTH", 14, uhh->key, uhh->keylen) && uwsgi_strncmp("CONTENT_TYPE", 12, uhh->key, uhh->keylen);
+
+	*ptr = eol + 2;
+	return 1;
+}
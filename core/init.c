@@ -87,7 +87,11 @@ void uwsgi_init_default() {
 	uwsgi.emperor_pid = -1;
 
 	uwsgi.subscribe_freq = 10;
+	uwsgi.subscribe_delta_refresh = 6;
 	uwsgi.subscription_tolerance = 17;
+	uwsgi.subscription_ewma_decay = 10000;
+	uwsgi.subscription_ring_vnodes = 160;
+	uwsgi.subscription_ring_load = 125;
 
 	uwsgi.cores = 1;
 	uwsgi.threads = 1;
@@ -96,6 +100,7 @@ void uwsgi_init_default() {
 	uwsgi.rpc_max = 64;
 
 	uwsgi.offload_threads_events = 64;
+	uwsgi.event_batch = 64;
 
 	uwsgi.default_app = -1;
 
@@ -111,6 +116,10 @@ void uwsgi_init_default() {
 	uwsgi.cheaper_overload = 3;
 
 	uwsgi.log_master_bufsize = 8192;
+	uwsgi.req_log_ring_freq = 10;
+
+	uwsgi.static_open_cache_ttl = 10;
+	uwsgi.static_store_max_file = 1024 * 1024;
 
 	uwsgi.worker_reload_mercy = 60;
 
@@ -711,8 +711,10 @@ void uwsgi_logit_simple(struct wsgi_request *wsgi_req) {
 	logvec[logvecpos].iov_base = logpkt;
 	logvec[logvecpos].iov_len = rlen;
 
-	// do not check for errors
-	rlen = writev(uwsgi.req_log_fd, logvec, logvecpos + 1);
+	if (uwsgi_req_log_ring_push(wsgi_req, logvec, logvecpos + 1)) {
+		// do not check for errors
+		rlen = writev(uwsgi.req_log_fd, logvec, logvecpos + 1);
+	}
 }
 
 void get_memusage(uint64_t * rss, uint64_t * vsz) {
@@ -927,83 +929,150 @@ struct uwsgi_logger *uwsgi_get_logger_from_id(char *id) {
 }
 
 
+/*
+
+	how the logformat is applied:
+
+	--logformat is parsed in a list of logchunks (raw text, request fields, logvars, vars, metrics, functions),
+	the list is then compiled in a flat array of uwsgi_logop (adjacent raw texts, included the trailing
+	newline, are merged). At request time the array is run against a per-core uwsgi_buffer,
+	the built-in chunks write numbers and times directly in it, so (after the first requests
+	have sized the buffer) no memory is allocated. The line is then sent with a single write (or pushed to the request log ring).
+
+	Time based chunks (ctime, ltime, ftime) are cached per-core and per-second.
+
+	Chunks registered with uwsgi_register_logchunk() (returning a newly allocated buffer) are still supported.
+
+*/
+
 void uwsgi_logit_lf(struct wsgi_request *wsgi_req) {
-	struct uwsgi_logchunk *logchunk = uwsgi.logchunks;
-	ssize_t rlen = 0;
-	const char *empty_var = "-";
-	while (logchunk) {
-		int pos = logchunk->vec;
-		// raw string
-		if (logchunk->type == 0) {
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = logchunk->ptr;
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = logchunk->len;
-		}
-		// offsetof
-		else if (logchunk->type == 1) {
-			char **var = (char **) (((char *) wsgi_req) + logchunk->pos);
-			uint16_t *varlen = (uint16_t *) (((char *) wsgi_req) + logchunk->pos_len);
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = *var;
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = *varlen;
-		}
-		// logvar
-		else if (logchunk->type == 2) {
-			struct uwsgi_logvar *lv = uwsgi_logvar_get(wsgi_req, logchunk->ptr, logchunk->len);
-			if (lv) {
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = lv->val;
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = lv->vallen;
+	struct uwsgi_buffer *ub = uwsgi.logbuffers[wsgi_req->async_id];
+	ub->pos = 0;
+	int i;
+	for (i = 0; i < uwsgi.logops_cnt; i++) {
+		struct uwsgi_logop *op = &uwsgi.logops[i];
+		size_t pos = ub->pos;
+		switch(op->type) {
+			// raw string
+			case 0:
+				uwsgi_buffer_append(ub, op->ptr, op->len);
+				continue;
+			// offsetof
+			case 1: {
+				char **var = (char **) (((char *) wsgi_req) + op->pos);
+				uint16_t *varlen = (uint16_t *) (((char *) wsgi_req) + op->pos_len);
+				if (*var) uwsgi_buffer_append(ub, *var, *varlen);
+				break;
 			}
-			else {
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = NULL;
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = 0;
+			// logvar
+			case 2: {
+				struct uwsgi_logvar *lv = uwsgi_logvar_get(wsgi_req, op->ptr, op->len);
+				if (lv) uwsgi_buffer_append(ub, lv->val, lv->vallen);
+				break;
 			}
-		}
-		// func
-		else if (logchunk->type == 3) {
-			rlen = logchunk->func(wsgi_req, (char **) &uwsgi.logvectors[wsgi_req->async_id][pos].iov_base);
-			if (rlen > 0) {
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = rlen;
+			// func (allocating a new buffer)
+			case 3: {
+				char *buf = NULL;
+				ssize_t rlen = op->func(wsgi_req, &buf);
+				if (rlen > 0) uwsgi_buffer_append(ub, buf, rlen);
+				if (op->free && buf) free(buf);
+				break;
 			}
-			else {
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = 0;
+			// metric
+			case 4:
+				uwsgi_buffer_num64(ub, uwsgi_metric_get(op->ptr, NULL));
+				break;
+			// var
+			case 5: {
+				uint16_t value_len = 0;
+				char *value = uwsgi_get_var(wsgi_req, op->ptr, op->len, &value_len);
+				if (value) uwsgi_buffer_append(ub, value, value_len);
+				break;
 			}
+			// func (writing to the buffer)
+			case 6:
+				op->bfunc(wsgi_req, ub);
+				break;
+			default:
+				break;
 		}
-		// var
-		else if (logchunk->type == 5) {
-			uint16_t value_len = 0;
-			char *value = uwsgi_get_var(wsgi_req, logchunk->ptr, logchunk->len, &value_len);
-			// could be NULL
-                        uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = value;
-                        uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = (size_t) value_len;
-                }
-		// metric
-		else if (logchunk->type == 4) {
-			int64_t metric = uwsgi_metric_get(logchunk->ptr, NULL);
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = uwsgi_64bit2str(metric);
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = strlen(uwsgi.logvectors[wsgi_req->async_id][pos].iov_base);
+		if (ub->pos == pos) {
+			uwsgi_buffer_append(ub, "-", 1);
 		}
+	}
 
-		if (uwsgi.logvectors[wsgi_req->async_id][pos].iov_len == 0 && logchunk->type != 0) {
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = (char *) empty_var;
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = 1;	
-		}
+	struct iovec iov;
+	iov.iov_base = ub->buf;
+	iov.iov_len = ub->pos;
+	if (uwsgi_req_log_ring_push(wsgi_req, &iov, 1)) {
+		// do not check for errors
+		ssize_t rlen = write(uwsgi.req_log_fd, ub->buf, ub->pos);
+		(void) rlen;
+	}
+}
+
+// per-core/per-second cache of the formatted times
+struct uwsgi_logtime {
+	time_t t;
+	size_t len;
+	char buf[64];
+};
+
+#define UWSGI_LOGTIME_CTIME 0
+#define UWSGI_LOGTIME_LTIME 1
+#define UWSGI_LOGTIME_FTIME 2
+#define UWSGI_LOGTIME_N 3
+
+static struct uwsgi_logtime *uwsgi_logtimes;
+
+static void uwsgi_compile_log_format() {
+	int cnt = 0;
+	struct uwsgi_logchunk *logchunk = uwsgi.logchunks;
+	while (logchunk) {
+		cnt++;
 		logchunk = logchunk->next;
 	}
 
-	// do not check for errors
-	rlen = writev(uwsgi.req_log_fd, uwsgi.logvectors[wsgi_req->async_id], uwsgi.logformat_vectors);
+	// +1 for "\n"
+	uwsgi.logops = uwsgi_calloc(sizeof(struct uwsgi_logop) * (cnt + 1));
+	uwsgi.logops_cnt = 0;
 
-	// free allocated memory
 	logchunk = uwsgi.logchunks;
-	while (logchunk) {
-		if (logchunk->free) {
-			if (uwsgi.logvectors[wsgi_req->async_id][logchunk->vec].iov_len > 0) {
-				if (uwsgi.logvectors[wsgi_req->async_id][logchunk->vec].iov_base != empty_var) {
-					free(uwsgi.logvectors[wsgi_req->async_id][logchunk->vec].iov_base);
-				}
-			}
+	for (;;) {
+		char *ptr = logchunk ? logchunk->ptr : "\n";
+		size_t len = logchunk ? logchunk->len : 1;
+		int type = logchunk ? logchunk->type : 0;
+		if (type == 0 && len == 0) goto next;
+		struct uwsgi_logop *last = uwsgi.logops_cnt > 0 ? &uwsgi.logops[uwsgi.logops_cnt - 1] : NULL;
+		// merge adjacent raw strings
+		if (type == 0 && last && last->type == 0) {
+			char *merged = uwsgi_concat2n(last->ptr, last->len, ptr, len);
+			last->ptr = merged;
+			last->len += len;
+			goto next;
+		}
+		struct uwsgi_logop *op = &uwsgi.logops[uwsgi.logops_cnt++];
+		op->type = type;
+		op->ptr = ptr;
+		op->len = len;
+		if (logchunk) {
+			op->pos = logchunk->pos;
+			op->pos_len = logchunk->pos_len;
+			op->free = logchunk->free;
+			op->func = logchunk->func;
+			op->bfunc = logchunk->bfunc;
 		}
+next:
+		if (!logchunk) break;
 		logchunk = logchunk->next;
 	}
+
+	int i;
+	uwsgi.logbuffers = uwsgi_malloc(sizeof(struct uwsgi_buffer *) * uwsgi.cores);
+	for (i = 0; i < uwsgi.cores; i++) {
+		uwsgi.logbuffers[i] = uwsgi_buffer_new(uwsgi.page_size);
+	}
+	uwsgi_logtimes = uwsgi_calloc(sizeof(struct uwsgi_logtime) * uwsgi.cores * UWSGI_LOGTIME_N);
 }
 
 void uwsgi_build_log_format(char *format) {
@@ -1027,8 +1096,7 @@ void uwsgi_build_log_format(char *format) {
 		// end of the variable
 		else if (*ptr == ')') {
 			if (logvar) {
-				uwsgi_add_logchunk(1, uwsgi.logformat_vectors, logvar, ptr - logvar);
-				uwsgi.logformat_vectors++;
+				uwsgi_add_logchunk(1, logvar, ptr - logvar);
 				state = 0;
 				logvar = NULL;
 				current = ptr + 1;
@@ -1036,8 +1104,7 @@ void uwsgi_build_log_format(char *format) {
 		}
 		else {
 			if (state == 2) {
-				uwsgi_add_logchunk(0, uwsgi.logformat_vectors, current, (ptr - current) - 2);
-				uwsgi.logformat_vectors++;
+				uwsgi_add_logchunk(0, current, (ptr - current) - 2);
 				logvar = ptr;
 			}
 			state = 0;
@@ -1046,187 +1113,167 @@ void uwsgi_build_log_format(char *format) {
 	}
 
 	if (ptr - current > 0) {
-		uwsgi_add_logchunk(0, uwsgi.logformat_vectors, current, ptr - current);
-		uwsgi.logformat_vectors++;
+		uwsgi_add_logchunk(0, current, ptr - current);
 	}
 
-	// +1 for "\n"
-
-	uwsgi.logformat_vectors++;
-
+	uwsgi_compile_log_format();
 }
 
-static ssize_t uwsgi_lf_status(struct wsgi_request *wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->status);
-	return strlen(*buf);
+// append an unsigned number without passing through snprintf
+static ssize_t uwsgi_lf_num(struct uwsgi_buffer *ub, uint64_t n) {
+	char buf[sizeof(UMAX64_STR)];
+	char *ptr = buf + sizeof(buf);
+	do {
+		*--ptr = '0' + (n % 10);
+		n /= 10;
+	} while (n);
+	size_t len = (buf + sizeof(buf)) - ptr;
+	if (uwsgi_buffer_append(ub, ptr, len)) return -1;
+	return len;
 }
 
-
-static ssize_t uwsgi_lf_rsize(struct wsgi_request *wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->response_size);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_status(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->status);
 }
 
-static ssize_t uwsgi_lf_hsize(struct wsgi_request *wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->headers_size);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_rsize(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->response_size);
 }
 
-static ssize_t uwsgi_lf_size(struct wsgi_request *wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->headers_size+wsgi_req->response_size);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_hsize(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->headers_size);
 }
 
-static ssize_t uwsgi_lf_cl(struct wsgi_request *wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->post_cl);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_size(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->headers_size + wsgi_req->response_size);
 }
 
+static ssize_t uwsgi_lf_cl(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->post_cl);
+}
 
-static ssize_t uwsgi_lf_epoch(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi_now());
-	return strlen(*buf);
+static ssize_t uwsgi_lf_epoch(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, uwsgi_now());
 }
 
-static ssize_t uwsgi_lf_ctime(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_malloc(26);
-#if defined(__sun__) && !defined(__clang__)
-	ctime_r((const time_t *) &wsgi_req->start_of_request_in_sec, *buf, 26);
-#else
-	ctime_r((const time_t *) &wsgi_req->start_of_request_in_sec, *buf);
-#endif
-	return 24;
+static ssize_t uwsgi_lf_time(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->start_of_request / 1000000);
 }
 
-static ssize_t uwsgi_lf_time(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->start_of_request / 1000000);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_tmsecs(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->start_of_request / 1000);
 }
 
+static ssize_t uwsgi_lf_tmicros(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->start_of_request);
+}
 
-static ssize_t uwsgi_lf_ltime(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_malloc(64);
-	time_t now = wsgi_req->start_of_request / 1000000;
-	size_t ret = strftime(*buf, 64, "%d/%b/%Y:%H:%M:%S %z", localtime(&now));
-	if (ret == 0) {
-		*buf[0] = 0;
-		return 0;
-	}
-	return ret;
+static ssize_t uwsgi_lf_micros(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->end_of_request - wsgi_req->start_of_request);
 }
 
-static ssize_t uwsgi_lf_ftime(struct wsgi_request * wsgi_req, char **buf) {
-	if (!uwsgi.log_strftime) {
-		return uwsgi_lf_ltime(wsgi_req, buf);
-	}
-	*buf = uwsgi_malloc(64);
-	time_t now = wsgi_req->start_of_request / 1000000;
-	size_t ret = strftime(*buf, 64, uwsgi.log_strftime, localtime(&now));
-	if (ret == 0) {
-		*buf[0] = 0;
-		return 0;
-	}
-	return ret;
+static ssize_t uwsgi_lf_msecs(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, (wsgi_req->end_of_request - wsgi_req->start_of_request) / 1000);
 }
 
-static ssize_t uwsgi_lf_tmsecs(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_64bit2str(wsgi_req->start_of_request / (int64_t) 1000);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_pid(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, uwsgi.mypid);
 }
 
-static ssize_t uwsgi_lf_tmicros(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_64bit2str(wsgi_req->start_of_request);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_wid(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, uwsgi.mywid);
 }
 
-static ssize_t uwsgi_lf_micros(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->end_of_request - wsgi_req->start_of_request);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_switches(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->switches);
 }
 
-static ssize_t uwsgi_lf_msecs(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str((wsgi_req->end_of_request - wsgi_req->start_of_request) / 1000);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_vars(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->var_cnt);
 }
 
-static ssize_t uwsgi_lf_pid(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.mypid);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_core(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->async_id);
 }
 
-static ssize_t uwsgi_lf_wid(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.mywid);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_vsz(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, uwsgi.workers[uwsgi.mywid].vsz_size);
 }
 
-static ssize_t uwsgi_lf_switches(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->switches);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_rss(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, uwsgi.workers[uwsgi.mywid].rss_size);
 }
 
-static ssize_t uwsgi_lf_vars(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->var_cnt);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_vszM(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, uwsgi.workers[uwsgi.mywid].vsz_size / 1024 / 1024);
 }
 
-static ssize_t uwsgi_lf_core(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->async_id);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_rssM(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, uwsgi.workers[uwsgi.mywid].rss_size / 1024 / 1024);
 }
 
-static ssize_t uwsgi_lf_vsz(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.workers[uwsgi.mywid].vsz_size);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_pktsize(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->uh->pktsize);
 }
 
-static ssize_t uwsgi_lf_rss(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.workers[uwsgi.mywid].rss_size);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_modifier1(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->uh->modifier1);
 }
 
-static ssize_t uwsgi_lf_vszM(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.workers[uwsgi.mywid].vsz_size / 1024 / 1024);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_modifier2(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->uh->modifier2);
 }
 
-static ssize_t uwsgi_lf_rssM(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.workers[uwsgi.mywid].rss_size / 1024 / 1024);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_headers(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->header_cnt);
 }
 
-static ssize_t uwsgi_lf_pktsize(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->uh->pktsize);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_werr(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->write_errors);
 }
 
-static ssize_t uwsgi_lf_modifier1(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->uh->modifier1);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_rerr(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->read_errors);
 }
 
-static ssize_t uwsgi_lf_modifier2(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->uh->modifier2);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_ioerr(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_num(ub, wsgi_req->write_errors + wsgi_req->read_errors);
 }
 
-static ssize_t uwsgi_lf_headers(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->header_cnt);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_cached_time(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub, int kind, time_t t) {
+	struct uwsgi_logtime *lt = &uwsgi_logtimes[(wsgi_req->async_id * UWSGI_LOGTIME_N) + kind];
+	if (lt->t != t || !lt->len) {
+		lt->t = t;
+		lt->len = 0;
+		if (kind == UWSGI_LOGTIME_CTIME) {
+#if defined(__sun__) && !defined(__clang__)
+			ctime_r(&t, lt->buf, 26);
+#else
+			ctime_r(&t, lt->buf);
+#endif
+			lt->len = 24;
+		}
+		else {
+			struct tm tm;
+			char *fmt = "%d/%b/%Y:%H:%M:%S %z";
+			if (kind == UWSGI_LOGTIME_FTIME && uwsgi.log_strftime) fmt = uwsgi.log_strftime;
+			lt->len = strftime(lt->buf, 64, fmt, localtime_r(&t, &tm));
+		}
+	}
+	if (uwsgi_buffer_append(ub, lt->buf, lt->len)) return -1;
+	return lt->len;
 }
 
-static ssize_t uwsgi_lf_werr(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str((int) wsgi_req->write_errors);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_ctime(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_cached_time(wsgi_req, ub, UWSGI_LOGTIME_CTIME, (time_t) wsgi_req->start_of_request_in_sec);
 }
 
-static ssize_t uwsgi_lf_rerr(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str((int) wsgi_req->read_errors);
-	return strlen(*buf);
+static ssize_t uwsgi_lf_ltime(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_cached_time(wsgi_req, ub, UWSGI_LOGTIME_LTIME, (time_t) (wsgi_req->start_of_request / 1000000));
 }
 
-static ssize_t uwsgi_lf_ioerr(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str((int) (wsgi_req->write_errors + wsgi_req->read_errors));
-	return strlen(*buf);
+static ssize_t uwsgi_lf_ftime(struct wsgi_request *wsgi_req, struct uwsgi_buffer *ub) {
+	return uwsgi_lf_cached_time(wsgi_req, ub, UWSGI_LOGTIME_FTIME, (time_t) (wsgi_req->start_of_request / 1000000));
 }
 
 struct uwsgi_logchunk *uwsgi_register_logchunk(char *name, ssize_t (*func)(struct wsgi_request *, char **), int need_free) {
@@ -1246,11 +1293,20 @@ struct uwsgi_logchunk *uwsgi_register_logchunk(char *name, ssize_t (*func)(struc
 	}
 found:
 	logchunk->func = func;
+	logchunk->bfunc = NULL;
 	logchunk->free = need_free;
 	logchunk->type = 3;
 	return logchunk;	
 }
 
+// register a logchunk writing directly to the per-core log buffer
+struct uwsgi_logchunk *uwsgi_register_logchunk_buffer(char *name, ssize_t (*bfunc)(struct wsgi_request *, struct uwsgi_buffer *)) {
+	struct uwsgi_logchunk *logchunk = uwsgi_register_logchunk(name, NULL, 0);
+	logchunk->bfunc = bfunc;
+	logchunk->type = 6;
+	return logchunk;
+}
+
 struct uwsgi_logchunk *uwsgi_get_logchunk_by_name(char *name, size_t name_len) {
 	struct uwsgi_logchunk *logchunk = uwsgi.registered_logchunks;
 	while(logchunk) {
@@ -1262,7 +1318,7 @@ struct uwsgi_logchunk *uwsgi_get_logchunk_by_name(char *name, size_t name_len) {
 	return NULL;
 }
 
-void uwsgi_add_logchunk(int variable, int pos, char *ptr, size_t len) {
+void uwsgi_add_logchunk(int variable, char *ptr, size_t len) {
 
 	struct uwsgi_logchunk *logchunk = uwsgi.logchunks;
 
@@ -1288,10 +1344,10 @@ void uwsgi_add_logchunk(int variable, int pos, char *ptr, size_t len) {
 	   3 -> func
 	   4 -> metric
 	   5 -> request variable
+	   6 -> func (writing to the log buffer)
 	 */
 
 	logchunk->type = variable;
-	logchunk->vec = pos;
 	// normal text
 	logchunk->ptr = ptr;
 	logchunk->len = len;
@@ -1308,6 +1364,10 @@ void uwsgi_add_logchunk(int variable, int pos, char *ptr, size_t len) {
 				logchunk->func = rlc->func;
 				logchunk->free = rlc->free;
 			}
+			else if (rlc->type == 6) {
+				logchunk->type = 6;
+				logchunk->bfunc = rlc->bfunc;
+			}
 		}
 		// var
 		else if (!uwsgi_starts_with(ptr, len, "var.", 4)) {
@@ -1329,6 +1389,9 @@ void uwsgi_add_logchunk(int variable, int pos, char *ptr, size_t len) {
 	}
 }
 
+// the logger the encoders are currently working for
+static struct uwsgi_logger *uwsgi_log_encoding_for = NULL;
+
 static void uwsgi_log_func_do(struct uwsgi_string_list *encoders, struct uwsgi_logger *ul, char *msg, size_t len) {
 	struct uwsgi_string_list *usl = encoders;
 	// note: msg must not be freed !!!
@@ -1347,10 +1410,13 @@ static void uwsgi_log_func_do(struct uwsgi_string_list *encoders, struct uwsgi_l
 			}
 		}
 		size_t rlen = 0;
+		uwsgi_log_encoding_for = ul;
 		char *buf = ule->func(ule, new_msg, new_msg_len, &rlen);
 		if (new_msg != msg) {
                 	free(new_msg);
         	}
+		// the message has been dropped or retained (batching)
+		if (!buf) return;
 		new_msg = buf;
 		new_msg_len = rlen;
 next:
@@ -1434,50 +1500,190 @@ next:
         return -1;
 }
 
-int uwsgi_master_req_log(void) {
-
-        ssize_t rlen = read(uwsgi.shared->worker_req_log_pipe[0], uwsgi.log_master_buf, uwsgi.log_master_bufsize);
-        if (rlen > 0) {
+static void uwsgi_req_log_dispatch(char *buf, size_t len) {
 #ifdef UWSGI_PCRE
-                struct uwsgi_regexp_list *url = uwsgi.log_req_route;
-                int finish = 0;
-                while (url) {
-                        if (uwsgi_regexp_match(url->pattern, url->pattern_extra, uwsgi.log_master_buf, rlen) >= 0) {
-                                struct uwsgi_logger *ul_route = (struct uwsgi_logger *) url->custom_ptr;
-                                if (ul_route) {
-                                        uwsgi_log_func_do(uwsgi.requested_log_req_encoders, ul_route, uwsgi.log_master_buf, rlen);
-                                        finish = 1;
-                                }
-                        }
-                        url = url->next;
-                }
-                if (finish)
-                        return 0;
+	struct uwsgi_regexp_list *url = uwsgi.log_req_route;
+	int finish = 0;
+	while (url) {
+		if (uwsgi_regexp_match(url->pattern, url->pattern_extra, buf, len) >= 0) {
+			struct uwsgi_logger *ul_route = (struct uwsgi_logger *) url->custom_ptr;
+			if (ul_route) {
+				uwsgi_log_func_do(uwsgi.requested_log_req_encoders, ul_route, buf, len);
+				finish = 1;
+			}
+		}
+		url = url->next;
+	}
+	if (finish)
+		return;
 #endif
 
-                int raw_log = 1;
+	int raw_log = 1;
 
-                struct uwsgi_logger *ul = uwsgi.choosen_req_logger;
-                while (ul) {
-                        // check for named logger
-                        if (ul->id) {
-                                goto next;
-                        }
-                        uwsgi_log_func_do(uwsgi.requested_log_req_encoders, ul, uwsgi.log_master_buf, rlen);
-                        raw_log = 0;
+	struct uwsgi_logger *ul = uwsgi.choosen_req_logger;
+	while (ul) {
+		// check for named logger
+		if (ul->id) {
+			goto next;
+		}
+		uwsgi_log_func_do(uwsgi.requested_log_req_encoders, ul, buf, len);
+		raw_log = 0;
 next:
-                        ul = ul->next;
-                }
+		ul = ul->next;
+	}
 
-                if (raw_log) {
-			uwsgi_log_func_do(uwsgi.requested_log_req_encoders, NULL, uwsgi.log_master_buf, rlen);
-                }
+	if (raw_log) {
+		uwsgi_log_func_do(uwsgi.requested_log_req_encoders, NULL, buf, len);
+	}
+}
+
+int uwsgi_master_req_log(void) {
+
+        ssize_t rlen = read(uwsgi.shared->worker_req_log_pipe[0], uwsgi.log_master_buf, uwsgi.log_master_bufsize);
+        if (rlen > 0) {
+		uwsgi_req_log_dispatch(uwsgi.log_master_buf, rlen);
                 return 0;
         }
 
         return -1;
 }
 
+/*
+
+	how request log rings work:
+
+	each worker core gets a ring of --req-log-ring bytes in shared memory.
+	The core is the only writer of 'head' and the consumer (the master or the threaded logger)
+	is the only writer of 'tail', so no lock (and no syscall) is needed on the request path.
+
+	Lines are still formatted by the core (the request memory is gone when the consumer runs),
+	each record is a native uint32 length followed by the line. When the ring is full the line is dropped
+	and accounted, a worker never waits for the logger.
+
+	The consumer drains all of the rings every --req-log-ring-freq milliseconds (the master caps
+	its event timeout to it when there is no threaded logger). When lines go to the raw log fd without encoders or routes they are batched
+	in the master log buffer and written with a single syscall.
+
+*/
+
+void uwsgi_req_log_rings_init() {
+	int i, j;
+	uint64_t size = 4096;
+	while (size < uwsgi.req_log_ring) size <<= 1;
+	uwsgi.req_log_ring = size;
+
+	for (i = 1; i <= uwsgi.numproc; i++) {
+		for (j = 0; j < uwsgi.cores; j++) {
+			struct uwsgi_req_log_ring *ring = uwsgi_calloc_shared(sizeof(struct uwsgi_req_log_ring) + size);
+			ring->size = size;
+			uwsgi.workers[i].cores[j].log_ring = ring;
+		}
+	}
+
+	uwsgi_log("allocated %llu bytes of request log rings for %d cores\n", (unsigned long long) (size * uwsgi.numproc * uwsgi.cores), uwsgi.numproc * uwsgi.cores);
+}
+
+static void uwsgi_req_log_ring_copy(struct uwsgi_req_log_ring *ring, uint64_t pos, char *buf, size_t len) {
+	uint64_t off = pos & (ring->size - 1);
+	size_t first = ring->size - off;
+	if (first >= len) {
+		memcpy(ring->buf + off, buf, len);
+		return;
+	}
+	memcpy(ring->buf + off, buf, first);
+	memcpy(ring->buf, buf + first, len - first);
+}
+
+static void uwsgi_req_log_ring_peek(struct uwsgi_req_log_ring *ring, uint64_t pos, char *buf, size_t len) {
+	uint64_t off = pos & (ring->size - 1);
+	size_t first = ring->size - off;
+	if (first >= len) {
+		memcpy(buf, ring->buf + off, len);
+		return;
+	}
+	memcpy(buf, ring->buf + off, first);
+	memcpy(buf + first, ring->buf, len - first);
+}
+
+// returns -1 if the current process has no ring (the caller should fallback to the req log fd)
+int uwsgi_req_log_ring_push(struct wsgi_request *wsgi_req, struct iovec *iov, int iovcnt) {
+	if (!uwsgi.req_log_ring || uwsgi.mywid <= 0 || uwsgi.mywid > uwsgi.numproc) return -1;
+	struct uwsgi_req_log_ring *ring = uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].log_ring;
+	if (!ring) return -1;
+
+	int i;
+	uint32_t len = 0;
+	for (i = 0; i < iovcnt; i++) {
+		len += iov[i].iov_len;
+	}
+
+	uint64_t head = ring->head;
+	uint64_t used = head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if (used + sizeof(uint32_t) + len > ring->size) {
+		ring->drops++;
+		return 0;
+	}
+
+	uwsgi_req_log_ring_copy(ring, head, (char *) &len, sizeof(uint32_t));
+	uint64_t pos = head + sizeof(uint32_t);
+	for (i = 0; i < iovcnt; i++) {
+		if (!iov[i].iov_len) continue;
+		uwsgi_req_log_ring_copy(ring, pos, iov[i].iov_base, iov[i].iov_len);
+		pos += iov[i].iov_len;
+	}
+
+	__atomic_store_n(&ring->head, pos, __ATOMIC_RELEASE);
+	ring->records++;
+	if (pos - ring->tail > ring->high_water) {
+		ring->high_water = pos - ring->tail;
+	}
+	return 0;
+}
+
+void uwsgi_req_log_rings_drain() {
+	int i, j;
+	size_t batched = 0;
+	// without routes, loggers and encoders, lines can be merged in a single write()
+	int can_batch = !uwsgi.choosen_req_logger && !uwsgi.requested_log_req_encoders;
+#ifdef UWSGI_PCRE
+	if (uwsgi.log_req_route) can_batch = 0;
+#endif
+
+	for (i = 1; i <= uwsgi.numproc; i++) {
+		for (j = 0; j < uwsgi.cores; j++) {
+			struct uwsgi_req_log_ring *ring = uwsgi.workers[i].cores[j].log_ring;
+			if (!ring) continue;
+			uint64_t tail = ring->tail;
+			uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+			while (tail < head) {
+				uint32_t len = 0;
+				uwsgi_req_log_ring_peek(ring, tail, (char *) &len, sizeof(uint32_t));
+				tail += sizeof(uint32_t);
+				// bigger log lines are truncated
+				size_t rlen = len > uwsgi.log_master_bufsize ? uwsgi.log_master_bufsize : len;
+				if (can_batch) {
+					if (batched + rlen > uwsgi.log_master_bufsize) {
+						uwsgi_req_log_dispatch(uwsgi.log_master_buf, batched);
+						batched = 0;
+					}
+					uwsgi_req_log_ring_peek(ring, tail, uwsgi.log_master_buf + batched, rlen);
+					batched += rlen;
+				}
+				else {
+					uwsgi_req_log_ring_peek(ring, tail, uwsgi.log_master_buf, rlen);
+					uwsgi_req_log_dispatch(uwsgi.log_master_buf, rlen);
+				}
+				tail += len;
+			}
+			__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+		}
+	}
+
+	if (batched > 0) {
+		uwsgi_req_log_dispatch(uwsgi.log_master_buf, batched);
+	}
+}
+
 static void *logger_thread_loop(void *noarg) {
         struct pollfd logpoll[2];
 
@@ -1494,11 +1700,21 @@ static void *logger_thread_loop(void *noarg) {
         if (uwsgi.req_log_master) {
                 logpoll[1].events = POLLIN;
                 logpoll[1].fd = uwsgi.shared->worker_req_log_pipe[0];
+                logpolls = 2;
         }
 
+        int timeout = uwsgi.req_log_ring ? uwsgi.req_log_ring_freq : -1;
+        int flush_freq = uwsgi_log_encoders_flush_freq();
+        if (flush_freq > 0 && (timeout < 0 || flush_freq < timeout)) timeout = flush_freq;
 
         for (;;) {
-                int ret = poll(logpoll, logpolls, -1);
+                int ret = poll(logpoll, logpolls, timeout);
+                if (timeout >= 0) {
+                        pthread_mutex_lock(&uwsgi.threaded_logger_lock);
+                        if (uwsgi.req_log_ring) uwsgi_req_log_rings_drain();
+                        uwsgi_log_encoders_flush(0);
+                        pthread_mutex_unlock(&uwsgi.threaded_logger_lock);
+                }
                 if (ret > 0) {
                         if (logpoll[0].revents & POLLIN) {
                                 pthread_mutex_lock(&uwsgi.threaded_logger_lock);
@@ -1566,6 +1782,170 @@ struct uwsgi_log_encoder *uwsgi_log_encoder_by_name(char *name) {
 	return NULL;
 }
 
+/*
+
+	how batching log encoders work:
+
+	"batch" and "batch-gzip" retain messages (returning NULL) until 'lines' messages or 'size' bytes
+	have been accumulated (or the oldest one is 'msecs' old), then they return a single block
+	of newline-terminated messages (newline delimited JSON when used after the json encoder),
+	"batch-gzip" compresses every block as a gzip member (a file of concatenated members is a valid gzip file).
+	Blocks are passed to the following encoders and to the logger as a single message.
+
+	As an encoder can be used by multiple loggers, a block is kept for each logger.
+	Time-expired blocks are flushed every 'msecs' (the lowest of the configured ones) via uwsgi_log_encoders_flush()
+	by the threaded logger or by the master (capping its event timeout).
+
+	--log-req-encoder "batch lines=1000,msecs=500"
+
+*/
+
+struct uwsgi_log_batch {
+	struct uwsgi_logger *ul;
+	struct uwsgi_buffer *ub;
+	uint64_t lines;
+	uint64_t since;
+	struct uwsgi_log_batch *next;
+};
+
+struct uwsgi_log_batch_config {
+	uint64_t lines;
+	uint64_t msecs;
+	uint64_t size;
+	int gzip;
+	struct uwsgi_log_batch *batches;
+};
+
+// the lowest 'msecs' of the configured batch encoders
+static uint64_t uwsgi_log_batch_freq = 0;
+
+static void uwsgi_log_encoder_batch_configure(struct uwsgi_log_encoder *ule, int gzip) {
+	char *lines = NULL, *msecs = NULL, *size = NULL;
+	if (uwsgi_kvlist_parse(ule->args, strlen(ule->args), ',', '=',
+			"lines", &lines,
+			"msecs", &msecs,
+			"size", &size,
+			NULL)) {
+		uwsgi_log("[log-encoder] invalid batch options: %s\n", ule->args);
+		exit(1);
+	}
+	struct uwsgi_log_batch_config *ulbc = uwsgi_calloc(sizeof(struct uwsgi_log_batch_config));
+	ulbc->lines = lines ? strtoull(lines, NULL, 10) : 100;
+	ulbc->msecs = msecs ? strtoull(msecs, NULL, 10) : 1000;
+	ulbc->size = size ? strtoull(size, NULL, 10) : 32768;
+	ulbc->gzip = gzip;
+	if (!ulbc->lines) ulbc->lines = 1;
+	if (!ulbc->msecs) ulbc->msecs = 1;
+	if (!uwsgi_log_batch_freq || ulbc->msecs < uwsgi_log_batch_freq) uwsgi_log_batch_freq = ulbc->msecs;
+	ule->data = ulbc;
+	ule->configured = 1;
+	if (lines) free(lines);
+	if (msecs) free(msecs);
+	if (size) free(size);
+}
+
+// return the block and reset the batch
+static char *uwsgi_log_batch_pop(struct uwsgi_log_batch_config *ulbc, struct uwsgi_log_batch *ulb, size_t *rlen) {
+	char *buf = NULL;
+#ifdef UWSGI_ZLIB
+	if (ulbc->gzip) {
+		struct uwsgi_buffer *gz = uwsgi_gzip(ulb->ub->buf, ulb->ub->pos);
+		if (gz) {
+			buf = gz->buf;
+			*rlen = gz->pos;
+			gz->buf = NULL;
+			uwsgi_buffer_destroy(gz);
+		}
+		ulb->ub->pos = 0;
+		ulb->lines = 0;
+		return buf;
+	}
+#endif
+	buf = ulb->ub->buf;
+	*rlen = ulb->ub->pos;
+	ulb->ub->buf = NULL;
+	uwsgi_buffer_destroy(ulb->ub);
+	ulb->ub = uwsgi_buffer_new(ulbc->size);
+	ulb->lines = 0;
+	return buf;
+}
+
+static char *uwsgi_log_encoder_batch(struct uwsgi_log_encoder *ule, char *msg, size_t len, size_t *rlen) {
+	struct uwsgi_log_batch_config *ulbc = (struct uwsgi_log_batch_config *) ule->data;
+	struct uwsgi_log_batch *ulb = ulbc->batches;
+	while (ulb) {
+		if (ulb->ul == uwsgi_log_encoding_for) break;
+		ulb = ulb->next;
+	}
+	if (!ulb) {
+		ulb = uwsgi_calloc(sizeof(struct uwsgi_log_batch));
+		ulb->ul = uwsgi_log_encoding_for;
+		ulb->ub = uwsgi_buffer_new(ulbc->size);
+		ulb->next = ulbc->batches;
+		ulbc->batches = ulb;
+	}
+
+	if (!ulb->lines) ulb->since = uwsgi_micros();
+	if (uwsgi_buffer_append(ulb->ub, msg, len)) return NULL;
+	if (len == 0 || msg[len-1] != '\n') {
+		if (uwsgi_buffer_append(ulb->ub, "\n", 1)) return NULL;
+	}
+	ulb->lines++;
+
+	if (ulb->lines >= ulbc->lines || ulb->ub->pos >= ulbc->size) {
+		return uwsgi_log_batch_pop(ulbc, ulb, rlen);
+	}
+	return NULL;
+}
+
+#ifdef UWSGI_ZLIB
+static char *uwsgi_log_encoder_batch_gzip(struct uwsgi_log_encoder *ule, char *msg, size_t len, size_t *rlen) {
+	return uwsgi_log_encoder_batch(ule, msg, len, rlen);
+}
+#endif
+
+static int uwsgi_log_encoder_is_batch(struct uwsgi_log_encoder *ule) {
+	if (ule->func == uwsgi_log_encoder_batch) return 1;
+#ifdef UWSGI_ZLIB
+	if (ule->func == uwsgi_log_encoder_batch_gzip) return 2;
+#endif
+	return 0;
+}
+
+static void uwsgi_log_encoders_flush_list(struct uwsgi_string_list *encoders, uint64_t now, int force) {
+	struct uwsgi_string_list *usl = NULL;
+	uwsgi_foreach(usl, encoders) {
+		struct uwsgi_log_encoder *ule = (struct uwsgi_log_encoder *) usl->custom_ptr;
+		if (!uwsgi_log_encoder_is_batch(ule)) continue;
+		struct uwsgi_log_batch_config *ulbc = (struct uwsgi_log_batch_config *) ule->data;
+		struct uwsgi_log_batch *ulb = ulbc->batches;
+		while (ulb) {
+			if (ulb->lines > 0 && (force || now - ulb->since >= ulbc->msecs * 1000)) {
+				size_t rlen = 0;
+				char *buf = uwsgi_log_batch_pop(ulbc, ulb, &rlen);
+				if (buf) {
+					// pass the block to the following encoders
+					uwsgi_log_func_do(usl->next, ulb->ul, buf, rlen);
+					free(buf);
+				}
+			}
+			ulb = ulb->next;
+		}
+	}
+}
+
+// returns the flush frequency (in milliseconds) required by batching encoders (0 if none)
+int uwsgi_log_encoders_flush_freq() {
+	return (int) uwsgi_log_batch_freq;
+}
+
+void uwsgi_log_encoders_flush(int force) {
+	if (!uwsgi_log_batch_freq) return;
+	uint64_t now = uwsgi_micros();
+	uwsgi_log_encoders_flush_list(uwsgi.requested_log_encoders, now, force);
+	uwsgi_log_encoders_flush_list(uwsgi.requested_log_req_encoders, now, force);
+}
+
 void uwsgi_setup_log_encoders() {
 	struct uwsgi_string_list *usl = NULL;
 	uwsgi_foreach(usl, uwsgi.requested_log_encoders) {
@@ -1593,6 +1973,9 @@ void uwsgi_setup_log_encoders() {
 			ule2->args = uwsgi_str("");
 		}
 
+		int batch = uwsgi_log_encoder_is_batch(ule2);
+		if (batch) uwsgi_log_encoder_batch_configure(ule2, batch == 2);
+
 		usl->custom_ptr = ule2;
 		uwsgi_log("[log-encoder] registered %s\n", usl->value);
 	}
@@ -1621,6 +2004,9 @@ void uwsgi_setup_log_encoders() {
                 else {
                         ule2->args = uwsgi_str("");
                 }
+		int batch = uwsgi_log_encoder_is_batch(ule2);
+		if (batch) uwsgi_log_encoder_batch_configure(ule2, batch == 2);
+
                 usl->custom_ptr = ule2;
 		uwsgi_log("[log-req-encoder] registered %s\n", usl->value);
         }
@@ -1892,7 +2278,7 @@ end:
         return buf;
 }
 
-#define r_logchunk(x) uwsgi_register_logchunk(#x, uwsgi_lf_ ## x, 1)
+#define r_logchunk(x) uwsgi_register_logchunk_buffer(#x, uwsgi_lf_ ## x)
 #define r_logchunk_offset(x, y) { struct uwsgi_logchunk *lc = uwsgi_register_logchunk(#x, NULL, 0); lc->pos = offsetof(struct wsgi_request, y); lc->pos_len = offsetof(struct wsgi_request, y ## _len); lc->type = 1; lc->free=0;}
 void uwsgi_register_logchunks() {
 	// offsets
@@ -1944,8 +2330,10 @@ void uwsgi_log_encoders_register_embedded() {
 	uwsgi_register_log_encoder("nl", uwsgi_log_encoder_nl);
 	uwsgi_register_log_encoder("format", uwsgi_log_encoder_format);
 	uwsgi_register_log_encoder("json", uwsgi_log_encoder_json);
+	uwsgi_register_log_encoder("batch", uwsgi_log_encoder_batch);
 #ifdef UWSGI_ZLIB
 	uwsgi_register_log_encoder("gzip", uwsgi_log_encoder_gzip);
 	uwsgi_register_log_encoder("compress", uwsgi_log_encoder_compress);
+	uwsgi_register_log_encoder("batch-gzip", uwsgi_log_encoder_batch_gzip);
 #endif
 }
@@ -323,6 +323,10 @@ int master_loop(char **argv, char **environ) {
 
 	uwsgi.master_queue = event_queue_init();
 
+	// events are drained in batches, a single wakeup could report many loglines, stats requests...
+	if (uwsgi.event_batch < 1) uwsgi.event_batch = 1;
+	void *events = event_queue_alloc(uwsgi.event_batch);
+
 	/* route signals to workers... */
 #ifdef UWSGI_DEBUG
 	uwsgi_log("adding %d to signal poll\n", uwsgi.shared->worker_signal_pipe[0]);
@@ -678,8 +682,6 @@ int master_loop(char **argv, char **environ) {
 				}
 			}
 
-			int interesting_fd = -1;
-
 			if (ushared->rb_timers_cnt > 0) {
 				min_timeout = uwsgi_min_rb_timer(rb_timers, NULL);
 				if (min_timeout) {
@@ -694,8 +696,28 @@ int master_loop(char **argv, char **environ) {
 				}
 			}
 
-			// wait for event
-			rlen = event_queue_wait(uwsgi.master_queue, check_interval, &interesting_fd);
+			// the request log rings and the batching log encoders are managed here (unless the threaded logger is doing it),
+			// do not sleep longer than their frequency
+			int wait_ms = check_interval * 1000;
+			if (uwsgi.log_master && !uwsgi.threaded_logger) {
+				if (uwsgi.req_log_ring && uwsgi.req_log_ring_freq > 0 && uwsgi.req_log_ring_freq < wait_ms) {
+					wait_ms = uwsgi.req_log_ring_freq;
+				}
+				int flush_freq = uwsgi_log_encoders_flush_freq();
+				if (flush_freq > 0 && flush_freq < wait_ms) {
+					wait_ms = flush_freq;
+				}
+			}
+
+			// rebuild the static store if its directories have settled
+			int static_store_ms = uwsgi_static_store_reload_due();
+			if (static_store_ms >= 0 && static_store_ms < wait_ms) {
+				wait_ms = static_store_ms;
+			}
+
+			// wait for events
+			rlen = event_queue_wait_multi_ms(uwsgi.master_queue, wait_ms, events, uwsgi.event_batch);
+			uwsgi_events_histogram_add(&uwsgi.shared->master_events, rlen);
 
 			if (rlen == 0) {
 				if (ushared->rb_timers_cnt > 0) {
@@ -717,13 +739,23 @@ int master_loop(char **argv, char **environ) {
 			}
 
 			// some event returned
-			if (rlen > 0) {
+			uwsgi.master_batch_closed_cnt = 0;
+			for (i = 0; i < rlen; i++) {
+				int interesting_fd = event_queue_interesting_fd(events, i);
+				// the fd has been closed (and maybe reused) by a previous event of the batch
+				if (uwsgi.master_batch_closed_cnt && uwsgi_master_fd_is_stale(interesting_fd)) continue;
 				// if the following function returns -1, a new worker has just spawned
 				if (uwsgi_master_manage_events(interesting_fd)) {
 					return 0;
 				}
 			}
 
+			// drain request log rings and flush batching log encoders (unless the threaded logger is doing it)
+			if (uwsgi.log_master && !uwsgi.threaded_logger) {
+				if (uwsgi.req_log_ring) uwsgi_req_log_rings_drain();
+				uwsgi_log_encoders_flush(0);
+			}
+
 			now = uwsgi_now();
 			if (now - uwsgi.current_time < 1) {
 				continue;
@@ -745,6 +777,11 @@ int master_loop(char **argv, char **environ) {
 			// check for idle
 			uwsgi_master_check_idle();
 
+			// close stuck stats clients
+			if (uwsgi.stats_clients) {
+				uwsgi_stats_clients_check_deadline();
+			}
+
 			check_interval = uwsgi.master_interval;
 			if (!check_interval) {
 				check_interval = 1;
@@ -2,6 +2,15 @@
 
 extern struct uwsgi_server uwsgi;
 
+// flush the request log rings of dead workers and the batching log encoders before exiting/reloading
+static void uwsgi_master_flush_logs() {
+	if (!uwsgi.log_master) return;
+	if (uwsgi.threaded_logger) pthread_mutex_lock(&uwsgi.threaded_logger_lock);
+	if (uwsgi.req_log_ring) uwsgi_req_log_rings_drain();
+	uwsgi_log_encoders_flush(1);
+	if (uwsgi.threaded_logger) pthread_mutex_unlock(&uwsgi.threaded_logger_lock);
+}
+
 // check if all of the workers are dead and exit uWSGI
 void uwsgi_master_check_death() {
 	if (uwsgi_instance_is_dying) {
@@ -11,6 +20,7 @@ void uwsgi_master_check_death() {
 				return;
 			}
 		}
+		uwsgi_master_flush_logs();
 		uwsgi_log("goodbye to uWSGI.\n");
 		exit(0);
 	}
@@ -25,6 +35,7 @@ int uwsgi_master_check_reload(char **argv) {
                                 return 0;
                         }
                 }
+		uwsgi_master_flush_logs();
 		uwsgi_reload(argv);
 		// never here (unless in shared library mode)
 		return -1;
@@ -2,6 +2,37 @@
 
 extern struct uwsgi_server uwsgi;
 
+/*
+	how stale events are managed:
+
+	the master manages a batch of events for each wakeup, so a handler could close an fd (and
+	even get the same number back from open()/accept()) while later events of the batch still
+	refer to the old one. Handlers closing an fd of the master queue call uwsgi_master_fd_closed()
+	and the master loop skips the remaining events of the batch for it. The list is reset
+	at every wakeup (it is generally empty, so the check costs nothing).
+*/
+
+void uwsgi_master_fd_closed(int fd) {
+	if (uwsgi.master_batch_closed_cnt >= uwsgi.master_batch_closed_size) {
+		uwsgi.master_batch_closed_size = uwsgi.master_batch_closed_size ? uwsgi.master_batch_closed_size * 2 : 8;
+		int *tmp = realloc(uwsgi.master_batch_closed, sizeof(int) * uwsgi.master_batch_closed_size);
+		if (!tmp) {
+			uwsgi_error("uwsgi_master_fd_closed()/realloc()");
+			exit(1);
+		}
+		uwsgi.master_batch_closed = tmp;
+	}
+	uwsgi.master_batch_closed[uwsgi.master_batch_closed_cnt++] = fd;
+}
+
+int uwsgi_master_fd_is_stale(int fd) {
+	int i;
+	for (i = 0; i < uwsgi.master_batch_closed_cnt; i++) {
+		if (uwsgi.master_batch_closed[i] == fd) return 1;
+	}
+	return 0;
+}
+
 int uwsgi_master_manage_events(int interesting_fd) {
 
 	// is a logline ?
@@ -32,6 +63,9 @@ int uwsgi_master_manage_events(int interesting_fd) {
 			uwsgi_send_stats(uwsgi.stats_fd, uwsgi_master_generate_stats);
 			return 0;
 		}
+		if (uwsgi.stats_clients && uwsgi_stats_client_event(interesting_fd)) {
+			return 0;
+		}
 	}
 
 	// a zerg connection ?
@@ -218,6 +252,7 @@ int uwsgi_master_manage_events(int interesting_fd) {
 			// TODO restart workers here
 			uwsgi_log_verbose("lost connection with workers !!!\n");
 			close(interesting_fd);
+			uwsgi_master_fd_closed(interesting_fd);
 		}
 		return 0;
 	}
@@ -236,6 +271,7 @@ int uwsgi_master_manage_events(int interesting_fd) {
 				// TODO restart spoolers here
 				uwsgi_log_verbose("lost connection with spoolers\n");
 				close(interesting_fd);
+				uwsgi_master_fd_closed(interesting_fd);
 			}
 			return 0;
 		}
@@ -256,6 +292,7 @@ int uwsgi_master_manage_events(int interesting_fd) {
 				// TODO respawn mules here
 				uwsgi_log_verbose("lost connection with mules\n");
 				close(interesting_fd);
+				uwsgi_master_fd_closed(interesting_fd);
 			}
 			// return 0;
 		}
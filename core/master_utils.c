@@ -721,11 +721,120 @@ int uwsgi_respawn_worker(int wid) {
 	return 0;
 }
 
+// "key": {"wakeups": N, "events": N, "histogram": {"0": N, "1": N, "2-3": N, ... "64+": N}}
+static int uwsgi_stats_events_histogram(struct uwsgi_stats *us, char *key, struct uwsgi_events_histogram *ueh) {
+	if (uwsgi_stats_key(us, key))
+		return -1;
+	if (uwsgi_stats_object_open(us))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "wakeups", (unsigned long long) ueh->wakeups))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "events", (unsigned long long) ueh->events))
+		return -1;
+	if (uwsgi_stats_key(us, "histogram"))
+		return -1;
+	if (uwsgi_stats_object_open(us))
+		return -1;
+	int i;
+	for (i = 0; i < UWSGI_EVENTS_HISTOGRAM_BUCKETS; i++) {
+		char bucket[32];
+		int lo = i ? 1 << (i - 1) : 0;
+		int hi = i ? (1 << i) - 1 : 0;
+		if (i == UWSGI_EVENTS_HISTOGRAM_BUCKETS - 1) {
+			snprintf(bucket, 32, "%d+", lo);
+		}
+		else if (lo == hi) {
+			snprintf(bucket, 32, "%d", lo);
+		}
+		else {
+			snprintf(bucket, 32, "%d-%d", lo, hi);
+		}
+		if (i < UWSGI_EVENTS_HISTOGRAM_BUCKETS - 1) {
+			if (uwsgi_stats_keylong_comma(us, bucket, (unsigned long long) ueh->buckets[i]))
+				return -1;
+		}
+		else {
+			if (uwsgi_stats_keylong(us, bucket, (unsigned long long) ueh->buckets[i]))
+				return -1;
+		}
+	}
+	if (uwsgi_stats_object_close(us))
+		return -1;
+	if (uwsgi_stats_object_close(us))
+		return -1;
+	return 0;
+}
+
+#ifdef UWSGI_ROUTING
+static int uwsgi_stats_routes(struct uwsgi_stats *us, char *chain, struct uwsgi_route *ur, int *first) {
+	for(;ur;ur = ur->next) {
+		if (!ur->stats) continue;
+		if (!*first) {
+			if (uwsgi_stats_comma(us))
+				return -1;
+		}
+		*first = 0;
+
+		uint64_t evaluations = 0, matches = 0, ns = 0;
+		int i;
+		for(i=0;i<=uwsgi.numproc;i++) {
+			evaluations += ur->stats[i].evaluations;
+			matches += ur->stats[i].matches;
+			ns += ur->stats[i].ns;
+		}
+
+		if (uwsgi_stats_object_open(us))
+			return -1;
+		if (uwsgi_stats_keyval_comma(us, "chain", chain))
+			return -1;
+		if (uwsgi_stats_keylong_comma(us, "pos", (unsigned long long) ur->pos))
+			return -1;
+		if (uwsgi_stats_keyval_comma(us, "subject", ur->subject_str ? ur->subject_str : ""))
+			return -1;
+		char *regexp = ur->regexp ? ur->regexp : "";
+		char *e_regexp = uwsgi_malloc((strlen(regexp) * 2) + 1);
+		escape_json(regexp, strlen(regexp), e_regexp);
+		int ret = uwsgi_stats_keyval_comma(us, "regexp", e_regexp);
+		free(e_regexp);
+		if (ret)
+			return -1;
+		char *action = ur->action ? ur->action : "";
+		char *e_action = uwsgi_malloc((strlen(action) * 2) + 1);
+		escape_json(action, strlen(action), e_action);
+		ret = uwsgi_stats_keyval_comma(us, "action", e_action);
+		free(e_action);
+		if (ret)
+			return -1;
+		if (uwsgi_stats_keylong_comma(us, "jit", (unsigned long long) (ur->pattern ? uwsgi_regexp_jitted(ur->pattern, ur->pattern_extra) : 0)))
+			return -1;
+		if (uwsgi_stats_keylong_comma(us, "evaluations", (unsigned long long) evaluations))
+			return -1;
+		if (uwsgi_stats_keylong_comma(us, "matches", (unsigned long long) matches))
+			return -1;
+		if (uwsgi_stats_keylong(us, "ns", (unsigned long long) ns))
+			return -1;
+		if (uwsgi_stats_object_close(us))
+			return -1;
+	}
+	return 0;
+}
+#endif
+
 struct uwsgi_stats *uwsgi_master_generate_stats() {
+	return uwsgi_master_generate_stats_query(NULL, -1);
+}
+
+/*
+	generate the master stats, only the sections/items requested by 'query' (see uwsgi_stats_want())
+	are added. If 'fd' is valid, the json is streamed to it while generated.
+*/
+struct uwsgi_stats *uwsgi_master_generate_stats_query(char *query, int fd) {
 
 	int i;
 
 	struct uwsgi_stats *us = uwsgi_stats_new(8192);
+	us->query = query;
+	us->fd = fd;
 
 	if (uwsgi_stats_keyval_comma(us, "version", UWSGI_VERSION))
 		goto end;
@@ -747,6 +856,10 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 
 	if (uwsgi_stats_keylong_comma(us, "load", (unsigned long long) uwsgi.shared->load))
 		goto end;
+	if (uwsgi_stats_events_histogram(us, "master_events", &uwsgi.shared->master_events))
+		goto end;
+	if (uwsgi_stats_comma(us))
+		goto end;
 	if (uwsgi_stats_keylong_comma(us, "pid", (unsigned long long) getpid()))
 		goto end;
 	if (uwsgi_stats_keylong_comma(us, "uid", (unsigned long long) getuid()))
@@ -761,7 +874,7 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 	}
 	free(cwd);
 
-	if (uwsgi.daemons) {
+	if (uwsgi.daemons && uwsgi_stats_want(us, "daemons", NULL)) {
 		if (uwsgi_stats_key(us, "daemons"))
 			goto end;
 		if (uwsgi_stats_list_open(us))
@@ -800,32 +913,34 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 			goto end;
 	}
 
-	if (uwsgi_stats_key(us, "locks"))
-		goto end;
-	if (uwsgi_stats_list_open(us))
-		goto end;
-
-	struct uwsgi_lock_item *uli = uwsgi.registered_locks;
-	while (uli) {
-		if (uwsgi_stats_object_open(us))
+	if (uwsgi_stats_want(us, "locks", NULL)) {
+		if (uwsgi_stats_key(us, "locks"))
 			goto end;
-		if (uwsgi_stats_keylong(us, uli->id, (unsigned long long) uli->pid))
-			goto end;
-		if (uwsgi_stats_object_close(us))
+		if (uwsgi_stats_list_open(us))
 			goto end;
-		if (uli->next) {
-			if (uwsgi_stats_comma(us))
+
+		struct uwsgi_lock_item *uli = uwsgi.registered_locks;
+		while (uli) {
+			if (uwsgi_stats_object_open(us))
+				goto end;
+			if (uwsgi_stats_keylong(us, uli->id, (unsigned long long) uli->pid))
 				goto end;
+			if (uwsgi_stats_object_close(us))
+				goto end;
+			if (uli->next) {
+				if (uwsgi_stats_comma(us))
+					goto end;
+			}
+			uli = uli->next;
 		}
-		uli = uli->next;
-	}
 
-	if (uwsgi_stats_list_close(us))
-		goto end;
-	if (uwsgi_stats_comma(us))
-		goto end;
+		if (uwsgi_stats_list_close(us))
+			goto end;
+		if (uwsgi_stats_comma(us))
+			goto end;
+	}
 
-	if (uwsgi.caches) {
+	if (uwsgi.caches && uwsgi_stats_want(us, "caches", "cache")) {
 
 		
 		if (uwsgi_stats_key(us, "caches"))
@@ -834,16 +949,54 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 		if (uwsgi_stats_list_open(us)) goto end;
 
 		struct uwsgi_cache *uc = uwsgi.caches;
+		int first = 1;
 		while(uc) {
+			char *uc_name = uc->name ? uc->name : "default";
+			if (!uwsgi_stats_want_item(us, "caches", "cache", uc_name, strlen(uc_name))) {
+				uc = uc->next;
+				continue;
+			}
+			if (!first) {
+				if (uwsgi_stats_comma(us))
+					goto end;
+			}
+			first = 0;
+			// sharded caches report the sum of their shards
+			uint64_t n_items = uc->n_items;
+			uint64_t hits = uc->hits;
+			uint64_t miss = uc->miss;
+			uint64_t full = uc->full;
+			uint64_t lockless_fallbacks = uc->lockless_fallbacks;
+			uint64_t evictions = uc->evictions;
+			uint64_t rejected = uc->rejected;
+			uint64_t policy_agings = uc->policy_agings;
+			time_t last_modified_at = uc->last_modified_at;
+			uint64_t i;
+			for(i=0;i<uc->shards_n;i++) {
+				struct uwsgi_cache *ucs = &uc->shards[i];
+				n_items += ucs->n_items;
+				hits += ucs->hits;
+				miss += ucs->miss;
+				full += ucs->full;
+				lockless_fallbacks += ucs->lockless_fallbacks;
+				evictions += ucs->evictions;
+				rejected += ucs->rejected;
+				policy_agings += ucs->policy_agings;
+				if (ucs->last_modified_at > last_modified_at) last_modified_at = ucs->last_modified_at;
+			}
+
 			if (uwsgi_stats_object_open(us))
                         	goto end;
 
-			if (uwsgi_stats_keyval_comma(us, "name", uc->name ? uc->name : "default"))
+			if (uwsgi_stats_keyval_comma(us, "name", uc_name))
                         	goto end;
 
 			if (uwsgi_stats_keyval_comma(us, "hash", uc->hash->name))
                         	goto end;
 
+			if (uwsgi_stats_keyval_comma(us, "index", uc->use_open_index ? "open" : "chain"))
+                        	goto end;
+
 			if (uwsgi_stats_keylong_comma(us, "hashsize", (unsigned long long) uc->hashsize))
 				goto end;
 
@@ -859,28 +1012,127 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 			if (uwsgi_stats_keylong_comma(us, "blocksize", (unsigned long long) uc->blocksize))
 				goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "items", (unsigned long long) uc->n_items))
+			if (uc->use_slabs) {
+				// the slab layout is the same for every shard
+				struct uwsgi_cache *ucl = uc->shards_n ? &uc->shards[0] : uc;
+				uint64_t pages = 0, pages_used = 0, allocated = 0, requested = 0, free_bytes = 0;
+				uint64_t j;
+				for(j=0;j<(uc->shards_n ? uc->shards_n : 1);j++) {
+					struct uwsgi_cache *ucs = uc->shards_n ? &uc->shards[j] : uc;
+					pages += ucs->slab_pages;
+					pages_used += ucs->slab_pages_used;
+					free_bytes += (ucs->slab_pages - ucs->slab_pages_used) * ucs->slab_page_blocks * ucs->blocksize;
+					for(i=0;i<ucs->slabs_n;i++) {
+						struct uwsgi_cache_slab_class *usc = &ucs->slabs[i];
+						allocated += usc->used * usc->chunk_blocks * ucs->blocksize;
+						requested += usc->requested;
+						free_bytes += (usc->free + ((usc->carve_end - usc->carve) / usc->chunk_blocks)) * usc->chunk_blocks * ucs->blocksize;
+					}
+				}
+
+				if (uwsgi_stats_keylong_comma(us, "slab_pages", (unsigned long long) pages))
+					goto end;
+				if (uwsgi_stats_keylong_comma(us, "slab_pages_used", (unsigned long long) pages_used))
+					goto end;
+				if (uwsgi_stats_keylong_comma(us, "slab_allocated_bytes", (unsigned long long) allocated))
+					goto end;
+				if (uwsgi_stats_keylong_comma(us, "slab_requested_bytes", (unsigned long long) requested))
+					goto end;
+				if (uwsgi_stats_keylong_comma(us, "slab_free_bytes", (unsigned long long) free_bytes))
+					goto end;
+				// percentage of the allocated memory wasted by chunks bigger than their values
+				if (uwsgi_stats_keylong_comma(us, "fragmentation", (unsigned long long) (allocated ? ((allocated - requested) * 100) / allocated : 0)))
+					goto end;
+
+				if (uwsgi_stats_key(us, "slabs"))
+					goto end;
+				if (uwsgi_stats_list_open(us))
+					goto end;
+				for(i=0;i<ucl->slabs_n;i++) {
+					uint64_t class_pages = 0, class_used = 0, class_free = 0, class_requested = 0;
+					for(j=0;j<(uc->shards_n ? uc->shards_n : 1);j++) {
+						struct uwsgi_cache_slab_class *usc = uc->shards_n ? &uc->shards[j].slabs[i] : &uc->slabs[i];
+						class_pages += usc->pages;
+						class_used += usc->used;
+						class_free += usc->free;
+						class_requested += usc->requested;
+					}
+					if (uwsgi_stats_object_open(us))
+						goto end;
+					if (uwsgi_stats_keylong_comma(us, "chunk_size", (unsigned long long) ucl->slabs[i].chunk_blocks * ucl->blocksize))
+						goto end;
+					if (uwsgi_stats_keylong_comma(us, "pages", (unsigned long long) class_pages))
+						goto end;
+					if (uwsgi_stats_keylong_comma(us, "used", (unsigned long long) class_used))
+						goto end;
+					if (uwsgi_stats_keylong_comma(us, "free", (unsigned long long) class_free))
+						goto end;
+					if (uwsgi_stats_keylong(us, "requested_bytes", (unsigned long long) class_requested))
+						goto end;
+					if (uwsgi_stats_object_close(us))
+						goto end;
+					if (i + 1 < ucl->slabs_n) {
+						if (uwsgi_stats_comma(us))
+							goto end;
+					}
+				}
+				if (uwsgi_stats_list_close(us))
+					goto end;
+				if (uwsgi_stats_comma(us))
+					goto end;
+			}
+
+			if (uwsgi_stats_keylong_comma(us, "shards", (unsigned long long) uc->shards_n))
+				goto end;
+
+			if (uwsgi_stats_keylong_comma(us, "items", (unsigned long long) n_items))
 				goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "hits", (unsigned long long) uc->hits))
+			if (uwsgi_stats_keylong_comma(us, "hits", (unsigned long long) hits))
 				goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "miss", (unsigned long long) uc->miss))
+			if (uwsgi_stats_keylong_comma(us, "miss", (unsigned long long) miss))
 				goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "full", (unsigned long long) uc->full))
+			if (uwsgi_stats_keylong_comma(us, "full", (unsigned long long) full))
+				goto end;
+
+			if (uwsgi_stats_keylong_comma(us, "lockless_fallbacks", (unsigned long long) lockless_fallbacks))
+				goto end;
+
+			// counters of the eviction policy (and of the admission filter)
+			if (uwsgi_stats_key(us, "policy"))
+				goto end;
+			if (uwsgi_stats_object_open(us))
+				goto end;
+			if (uwsgi_stats_keyval_comma(us, "name", uc->policy ? uc->policy->name : "none"))
+				goto end;
+			if (uwsgi_stats_keyval_comma(us, "admission", uc->use_tinylfu ? "tinylfu" : "none"))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "hits", (unsigned long long) (uc->policy ? hits : 0)))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "misses", (unsigned long long) (uc->policy ? miss : 0)))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "evictions", (unsigned long long) evictions))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "rejected", (unsigned long long) rejected))
+				goto end;
+			if (uwsgi_stats_keylong(us, "agings", (unsigned long long) policy_agings))
+				goto end;
+			if (uwsgi_stats_object_close(us))
+				goto end;
+			if (uwsgi_stats_comma(us))
 				goto end;
 
-			if (uwsgi_stats_keylong(us, "last_modified_at", (unsigned long long) uc->last_modified_at))
+			if (uwsgi_stats_keylong(us, "last_modified_at", (unsigned long long) last_modified_at))
 				goto end;
 
 			if (uwsgi_stats_object_close(us))
 				goto end;
 
-			if (uc->next) {
-				if (uwsgi_stats_comma(us))
-					goto end;
-			}
+			if (uwsgi_stats_stream(us))
+				goto end;
+
 			uc = uc->next;
 		}
 
@@ -891,7 +1143,7 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 		goto end;
 	}
 
-	if (uwsgi.has_metrics) {
+	if (uwsgi.has_metrics && uwsgi_stats_want(us, "metrics", NULL)) {
 		if (uwsgi_stats_key(us, "metrics"))
                 	goto end;
 
@@ -955,249 +1207,352 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 		goto end;
 	}
 
-	if (uwsgi_stats_key(us, "sockets"))
-		goto end;
-
-	if (uwsgi_stats_list_open(us))
-		goto end;
-
-	struct uwsgi_socket *uwsgi_sock = uwsgi.sockets;
-	while (uwsgi_sock) {
-		if (uwsgi_stats_object_open(us))
+	if (uwsgi.offload_threads > 0 && uwsgi_stats_want(us, "offload_engines", NULL)) {
+		if (uwsgi_stats_key(us, "offload_engines"))
 			goto end;
-
-		if (uwsgi_stats_keyval_comma(us, "name", uwsgi_sock->name))
+		if (uwsgi_stats_list_open(us))
 			goto end;
-
-		if (uwsgi_stats_keyval_comma(us, "proto", uwsgi_sock->proto_name ? uwsgi_sock->proto_name : "uwsgi"))
+		struct uwsgi_offload_engine *uoe = uwsgi.offload_engines;
+		while (uoe) {
+			if (uwsgi_stats_object_open(us))
+				goto end;
+			if (uwsgi_stats_keyval_comma(us, "name", uoe->name))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "requests", (unsigned long long) uoe->counters->requests))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "active", (unsigned long long) uoe->counters->active))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "bytes", (unsigned long long) uoe->counters->bytes))
+				goto end;
+			if (uwsgi_stats_keylong(us, "errors", (unsigned long long) uoe->counters->errors))
+				goto end;
+			if (uwsgi_stats_object_close(us))
+				goto end;
+			uoe = uoe->next;
+			if (uoe) {
+				if (uwsgi_stats_comma(us))
+					goto end;
+			}
+		}
+		if (uwsgi_stats_list_close(us))
 			goto end;
-
-		if (uwsgi_stats_keylong_comma(us, "queue", (unsigned long long) uwsgi_sock->queue))
+		if (uwsgi_stats_comma(us))
 			goto end;
+	}
 
-		if (uwsgi_stats_keylong_comma(us, "max_queue", (unsigned long long) uwsgi_sock->max_queue))
+#ifdef UWSGI_ROUTING
+	if (uwsgi.routing_stats && uwsgi_stats_want(us, "routes", NULL)) {
+		if (uwsgi_stats_key(us, "routes"))
 			goto end;
-
-		if (uwsgi_stats_keylong_comma(us, "shared", (unsigned long long) uwsgi_sock->shared))
+		if (uwsgi_stats_list_open(us))
+			goto end;
+		int first = 1;
+		if (uwsgi_stats_routes(us, "request", uwsgi.routes, &first))
+			goto end;
+		if (uwsgi_stats_routes(us, "error", uwsgi.error_routes, &first))
+			goto end;
+		if (uwsgi_stats_routes(us, "response", uwsgi.response_routes, &first))
+			goto end;
+		if (uwsgi_stats_routes(us, "final", uwsgi.final_routes, &first))
 			goto end;
+		if (uwsgi_stats_list_close(us))
+			goto end;
+		if (uwsgi_stats_comma(us))
+			goto end;
+	}
+#endif
 
-		if (uwsgi_stats_keylong(us, "can_offload", (unsigned long long) uwsgi_sock->can_offload))
+	if (uwsgi_stats_want(us, "sockets", NULL)) {
+		if (uwsgi_stats_key(us, "sockets"))
 			goto end;
 
-		if (uwsgi_stats_object_close(us))
+		if (uwsgi_stats_list_open(us))
 			goto end;
 
-		uwsgi_sock = uwsgi_sock->next;
-		if (uwsgi_sock) {
-			if (uwsgi_stats_comma(us))
+		struct uwsgi_socket *uwsgi_sock = uwsgi.sockets;
+		while (uwsgi_sock) {
+			if (uwsgi_stats_object_open(us))
 				goto end;
-		}
-	}
 
-	if (uwsgi_stats_list_close(us))
-		goto end;
-
-	if (uwsgi_stats_comma(us))
-		goto end;
-
-	if (uwsgi_stats_key(us, "workers"))
-		goto end;
-	if (uwsgi_stats_list_open(us))
-		goto end;
+			if (uwsgi_stats_keyval_comma(us, "name", uwsgi_sock->name))
+				goto end;
 
-	for (i = 0; i < uwsgi.numproc; i++) {
-		if (uwsgi_stats_object_open(us))
-			goto end;
+			if (uwsgi_stats_keyval_comma(us, "proto", uwsgi_sock->proto_name ? uwsgi_sock->proto_name : "uwsgi"))
+				goto end;
 
-		if (uwsgi_stats_keylong_comma(us, "id", (unsigned long long) uwsgi.workers[i + 1].id))
-			goto end;
-		if (uwsgi_stats_keylong_comma(us, "pid", (unsigned long long) uwsgi.workers[i + 1].pid))
-			goto end;
-		if (uwsgi_stats_keylong_comma(us, "accepting", (unsigned long long) uwsgi.workers[i + 1].accepting))
-			goto end;
-		if (uwsgi_stats_keylong_comma(us, "requests", (unsigned long long) uwsgi.workers[i + 1].requests))
-			goto end;
-		if (uwsgi_stats_keylong_comma(us, "delta_requests", (unsigned long long) uwsgi.workers[i + 1].delta_requests))
-			goto end;
-		if (uwsgi_stats_keylong_comma(us, "exceptions", (unsigned long long) uwsgi_worker_exceptions(i + 1)))
-			goto end;
-		if (uwsgi_stats_keylong_comma(us, "harakiri_count", (unsigned long long) uwsgi.workers[i + 1].harakiri_count))
-			goto end;
-		if (uwsgi_stats_keylong_comma(us, "signals", (unsigned long long) uwsgi.workers[i + 1].signals))
-			goto end;
+			if (uwsgi_stats_keylong_comma(us, "queue", (unsigned long long) uwsgi_sock->queue))
+				goto end;
 
-		if (ioctl(uwsgi.workers[i + 1].signal_pipe[1], FIONREAD, &signal_queue)) {
-			uwsgi_error("uwsgi_master_generate_stats() -> ioctl()\n");
-		}
+			if (uwsgi_stats_keylong_comma(us, "max_queue", (unsigned long long) uwsgi_sock->max_queue))
+				goto end;
 
-		if (uwsgi_stats_keylong_comma(us, "signal_queue", (unsigned long long) signal_queue))
-			goto end;
+			if (uwsgi_stats_keylong_comma(us, "shared", (unsigned long long) uwsgi_sock->shared))
+				goto end;
 
-		if (uwsgi.workers[i + 1].cheaped) {
-			if (uwsgi_stats_keyval_comma(us, "status", "cheap"))
+			if (uwsgi_stats_keylong(us, "can_offload", (unsigned long long) uwsgi_sock->can_offload))
 				goto end;
-		}
-		else if (uwsgi.workers[i + 1].suspended && !uwsgi_worker_is_busy(i+1)) {
-			if (uwsgi_stats_keyval_comma(us, "status", "pause"))
+
+			if (uwsgi_stats_object_close(us))
 				goto end;
-		}
-		else {
-			if (uwsgi.workers[i + 1].sig) {
-				if (uwsgi_stats_keyvalnum_comma(us, "status", "sig", (unsigned long long) uwsgi.workers[i + 1].signum))
-					goto end;
-			}
-			else if (uwsgi_worker_is_busy(i+1)) {
-				if (uwsgi_stats_keyval_comma(us, "status", "busy"))
-					goto end;
-			}
-			else {
-				if (uwsgi_stats_keyval_comma(us, "status", "idle"))
+
+			uwsgi_sock = uwsgi_sock->next;
+			if (uwsgi_sock) {
+				if (uwsgi_stats_comma(us))
 					goto end;
 			}
 		}
 
-		if (uwsgi_stats_keylong_comma(us, "rss", (unsigned long long) uwsgi.workers[i + 1].rss_size))
-			goto end;
-		if (uwsgi_stats_keylong_comma(us, "vsz", (unsigned long long) uwsgi.workers[i + 1].vsz_size))
+		if (uwsgi_stats_list_close(us))
 			goto end;
 
-		if (uwsgi_stats_keylong_comma(us, "running_time", (unsigned long long) uwsgi.workers[i + 1].running_time))
-			goto end;
-		if (uwsgi_stats_keylong_comma(us, "last_spawn", (unsigned long long) uwsgi.workers[i + 1].last_spawn))
-			goto end;
-		if (uwsgi_stats_keylong_comma(us, "respawn_count", (unsigned long long) uwsgi.workers[i + 1].respawn_count))
+		if (uwsgi_stats_comma(us))
 			goto end;
 
-		if (uwsgi_stats_keylong_comma(us, "tx", (unsigned long long) uwsgi.workers[i + 1].tx))
-			goto end;
-		if (uwsgi_stats_keylong_comma(us, "avg_rt", (unsigned long long) uwsgi.workers[i + 1].avg_response_time))
+		if (uwsgi_stats_stream(us))
 			goto end;
+	}
 
-		// applications list
-		if (uwsgi_stats_key(us, "apps"))
+	if (uwsgi_stats_want(us, "workers", "worker")) {
+		if (uwsgi_stats_key(us, "workers"))
 			goto end;
 		if (uwsgi_stats_list_open(us))
 			goto end;
 
-		int j;
-
-		for (j = 0; j < uwsgi.workers[i + 1].apps_cnt; j++) {
-			struct uwsgi_app *ua = &uwsgi.workers[i + 1].apps[j];
+		int first_worker = 1;
+		for (i = 0; i < uwsgi.numproc; i++) {
+			char wid[sizeof(UMAX64_STR)+1];
+			int wid_len = uwsgi_long2str2n(uwsgi.workers[i + 1].id, wid, sizeof(UMAX64_STR)+1);
+			if (!uwsgi_stats_want_item(us, "workers", "worker", wid, wid_len))
+				continue;
+			if (!first_worker) {
+				if (uwsgi_stats_comma(us))
+					goto end;
+			}
+			first_worker = 0;
 
 			if (uwsgi_stats_object_open(us))
 				goto end;
-			if (uwsgi_stats_keylong_comma(us, "id", (unsigned long long) j))
+
+			if (uwsgi_stats_keylong_comma(us, "id", (unsigned long long) uwsgi.workers[i + 1].id))
 				goto end;
-			if (uwsgi_stats_keylong_comma(us, "modifier1", (unsigned long long) ua->modifier1))
+			if (uwsgi_stats_keylong_comma(us, "pid", (unsigned long long) uwsgi.workers[i + 1].pid))
 				goto end;
-
-			if (uwsgi_stats_keyvaln_comma(us, "mountpoint", ua->mountpoint, ua->mountpoint_len))
+			if (uwsgi_stats_keylong_comma(us, "accepting", (unsigned long long) uwsgi.workers[i + 1].accepting))
 				goto end;
-			if (uwsgi_stats_keylong_comma(us, "startup_time", ua->startup_time))
+			if (uwsgi_stats_keylong_comma(us, "requests", (unsigned long long) uwsgi.workers[i + 1].requests))
 				goto end;
-
-			if (uwsgi_stats_keylong_comma(us, "requests", ua->requests))
+			if (uwsgi_stats_keylong_comma(us, "delta_requests", (unsigned long long) uwsgi.workers[i + 1].delta_requests))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "exceptions", (unsigned long long) uwsgi_worker_exceptions(i + 1)))
 				goto end;
-			if (uwsgi_stats_keylong_comma(us, "exceptions", ua->exceptions))
+			if (uwsgi_stats_keylong_comma(us, "harakiri_count", (unsigned long long) uwsgi.workers[i + 1].harakiri_count))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "signals", (unsigned long long) uwsgi.workers[i + 1].signals))
+				goto end;
+
+			if (ioctl(uwsgi.workers[i + 1].signal_pipe[1], FIONREAD, &signal_queue)) {
+				uwsgi_error("uwsgi_master_generate_stats() -> ioctl()\n");
+			}
+
+			if (uwsgi_stats_keylong_comma(us, "signal_queue", (unsigned long long) signal_queue))
 				goto end;
 
-			if (*ua->chdir) {
-				if (uwsgi_stats_keyval(us, "chdir", ua->chdir))
+			if (uwsgi.workers[i + 1].cheaped) {
+				if (uwsgi_stats_keyval_comma(us, "status", "cheap"))
 					goto end;
 			}
-			else {
-				if (uwsgi_stats_keyval(us, "chdir", ""))
+			else if (uwsgi.workers[i + 1].suspended && !uwsgi_worker_is_busy(i+1)) {
+				if (uwsgi_stats_keyval_comma(us, "status", "pause"))
 					goto end;
 			}
+			else {
+				if (uwsgi.workers[i + 1].sig) {
+					if (uwsgi_stats_keyvalnum_comma(us, "status", "sig", (unsigned long long) uwsgi.workers[i + 1].signum))
+						goto end;
+				}
+				else if (uwsgi_worker_is_busy(i+1)) {
+					if (uwsgi_stats_keyval_comma(us, "status", "busy"))
+						goto end;
+				}
+				else {
+					if (uwsgi_stats_keyval_comma(us, "status", "idle"))
+						goto end;
+				}
+			}
 
-			if (uwsgi_stats_object_close(us))
+			if (uwsgi_stats_keylong_comma(us, "rss", (unsigned long long) uwsgi.workers[i + 1].rss_size))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "vsz", (unsigned long long) uwsgi.workers[i + 1].vsz_size))
 				goto end;
 
-			if (j < uwsgi.workers[i + 1].apps_cnt - 1) {
+			if (uwsgi_stats_keylong_comma(us, "running_time", (unsigned long long) uwsgi.workers[i + 1].running_time))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "last_spawn", (unsigned long long) uwsgi.workers[i + 1].last_spawn))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "respawn_count", (unsigned long long) uwsgi.workers[i + 1].respawn_count))
+				goto end;
+
+			if (uwsgi_stats_keylong_comma(us, "tx", (unsigned long long) uwsgi.workers[i + 1].tx))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "avg_rt", (unsigned long long) uwsgi.workers[i + 1].avg_response_time))
+				goto end;
+
+			if (uwsgi.async > 1) {
+				if (uwsgi_stats_events_histogram(us, "async_events", &uwsgi.workers[i + 1].async_events))
+					goto end;
+				if (uwsgi_stats_comma(us))
+					goto end;
+			}
+			if (uwsgi.offload_threads > 0) {
+				if (uwsgi_stats_events_histogram(us, "offload_events", &uwsgi.workers[i + 1].offload_events))
+					goto end;
 				if (uwsgi_stats_comma(us))
 					goto end;
 			}
-		}
 
+			// applications list
+			if (uwsgi_stats_key(us, "apps"))
+				goto end;
+			if (uwsgi_stats_list_open(us))
+				goto end;
 
-		if (uwsgi_stats_list_close(us))
-			goto end;
+			int j;
 
-		if (uwsgi_stats_comma(us))
-			goto end;
+			for (j = 0; j < uwsgi.workers[i + 1].apps_cnt; j++) {
+				struct uwsgi_app *ua = &uwsgi.workers[i + 1].apps[j];
 
-		// cores list
-		if (uwsgi_stats_key(us, "cores"))
-			goto end;
-		if (uwsgi_stats_list_open(us))
-			goto end;
+				if (uwsgi_stats_object_open(us))
+					goto end;
+				if (uwsgi_stats_keylong_comma(us, "id", (unsigned long long) j))
+					goto end;
+				if (uwsgi_stats_keylong_comma(us, "modifier1", (unsigned long long) ua->modifier1))
+					goto end;
 
-		for (j = 0; j < uwsgi.cores; j++) {
-			struct uwsgi_core *uc = &uwsgi.workers[i + 1].cores[j];
-			if (uwsgi_stats_object_open(us))
-				goto end;
-			if (uwsgi_stats_keylong_comma(us, "id", (unsigned long long) j))
-				goto end;
+				if (uwsgi_stats_keyvaln_comma(us, "mountpoint", ua->mountpoint, ua->mountpoint_len))
+					goto end;
+				if (uwsgi_stats_keylong_comma(us, "startup_time", ua->startup_time))
+					goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "requests", (unsigned long long) uc->requests))
-				goto end;
+				if (uwsgi_stats_keylong_comma(us, "requests", ua->requests))
+					goto end;
+				if (uwsgi_stats_keylong_comma(us, "exceptions", ua->exceptions))
+					goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "static_requests", (unsigned long long) uc->static_requests))
-				goto end;
+				if (*ua->chdir) {
+					if (uwsgi_stats_keyval(us, "chdir", ua->chdir))
+						goto end;
+				}
+				else {
+					if (uwsgi_stats_keyval(us, "chdir", ""))
+						goto end;
+				}
 
-			if (uwsgi_stats_keylong_comma(us, "routed_requests", (unsigned long long) uc->routed_requests))
-				goto end;
+				if (uwsgi_stats_object_close(us))
+					goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "offloaded_requests", (unsigned long long) uc->offloaded_requests))
-				goto end;
+				if (j < uwsgi.workers[i + 1].apps_cnt - 1) {
+					if (uwsgi_stats_comma(us))
+						goto end;
+				}
+			}
 
-			if (uwsgi_stats_keylong_comma(us, "write_errors", (unsigned long long) uc->write_errors))
-				goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "read_errors", (unsigned long long) uc->read_errors))
+			if (uwsgi_stats_list_close(us))
 				goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "in_request", (unsigned long long) uc->in_request))
+			if (uwsgi_stats_comma(us))
 				goto end;
 
-			if (uwsgi_stats_key(us, "vars"))
+			// cores list
+			if (uwsgi_stats_key(us, "cores"))
 				goto end;
-
 			if (uwsgi_stats_list_open(us))
-                        	goto end;
+				goto end;
 
-			if (uwsgi_stats_dump_vars(us, uc)) goto end;
+			for (j = 0; j < uwsgi.cores; j++) {
+				struct uwsgi_core *uc = &uwsgi.workers[i + 1].cores[j];
+				if (uwsgi_stats_object_open(us))
+					goto end;
+				if (uwsgi_stats_keylong_comma(us, "id", (unsigned long long) j))
+					goto end;
 
-			if (uwsgi_stats_list_close(us))
-				goto end;
+				if (uwsgi_stats_keylong_comma(us, "requests", (unsigned long long) uc->requests))
+					goto end;
 
+				if (uwsgi_stats_keylong_comma(us, "static_requests", (unsigned long long) uc->static_requests))
+					goto end;
 
-			if (uwsgi_stats_object_close(us))
-				goto end;
+				if (uwsgi.static_open_cache) {
+					if (uwsgi_stats_keylong_comma(us, "static_open_cache_hits", (unsigned long long) uc->static_open_cache_hits))
+						goto end;
+					if (uwsgi_stats_keylong_comma(us, "static_open_cache_misses", (unsigned long long) uc->static_open_cache_misses))
+						goto end;
+				}
 
-			if (j < uwsgi.cores - 1) {
-				if (uwsgi_stats_comma(us))
+				if (uwsgi_stats_keylong_comma(us, "routed_requests", (unsigned long long) uc->routed_requests))
+					goto end;
+
+				if (uwsgi_stats_keylong_comma(us, "offloaded_requests", (unsigned long long) uc->offloaded_requests))
+					goto end;
+
+				if (uwsgi_stats_keylong_comma(us, "write_errors", (unsigned long long) uc->write_errors))
+					goto end;
+
+				if (uwsgi_stats_keylong_comma(us, "read_errors", (unsigned long long) uc->read_errors))
+					goto end;
+
+				if (uwsgi_stats_keylong_comma(us, "in_request", (unsigned long long) uc->in_request))
+					goto end;
+
+				if (uc->log_ring) {
+					if (uwsgi_stats_keylong_comma(us, "log_ring_records", (unsigned long long) uc->log_ring->records))
+						goto end;
+					if (uwsgi_stats_keylong_comma(us, "log_ring_drops", (unsigned long long) uc->log_ring->drops))
+						goto end;
+					if (uwsgi_stats_keylong_comma(us, "log_ring_high_water", (unsigned long long) uc->log_ring->high_water))
+						goto end;
+				}
+
+				if (uwsgi_stats_key(us, "vars"))
+					goto end;
+
+				if (uwsgi_stats_list_open(us))
+	                        	goto end;
+
+				if (uwsgi_stats_dump_vars(us, uc)) goto end;
+
+				if (uwsgi_stats_list_close(us))
+					goto end;
+
+
+				if (uwsgi_stats_object_close(us))
 					goto end;
+
+				if (j < uwsgi.cores - 1) {
+					if (uwsgi_stats_comma(us))
+						goto end;
+				}
 			}
-		}
 
-		if (uwsgi_stats_list_close(us))
-			goto end;
+			if (uwsgi_stats_list_close(us))
+				goto end;
 
-		if (uwsgi_stats_object_close(us))
-			goto end;
+			if (uwsgi_stats_object_close(us))
+				goto end;
 
-		if (i < uwsgi.numproc - 1) {
-			if (uwsgi_stats_comma(us))
+			if (uwsgi_stats_stream(us))
 				goto end;
 		}
-	}
 
-	if (uwsgi_stats_list_close(us))
-		goto end;
+		if (uwsgi_stats_list_close(us))
+			goto end;
+	}
+	else {
+		uwsgi_stats_uncomma(us);
+	}
 
 	struct uwsgi_spooler *uspool = uwsgi.spoolers;
-	if (uspool) {
+	if (uspool && uwsgi_stats_want(us, "spoolers", NULL)) {
 		if (uwsgi_stats_comma(us))
 			goto end;
 		if (uwsgi_stats_key(us, "spoolers"))
@@ -1236,7 +1591,7 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 	}
 
 	struct uwsgi_cron *ucron = uwsgi.crons;
-	if (ucron) {
+	if (ucron && uwsgi_stats_want(us, "crons", NULL)) {
 		if (uwsgi_stats_comma(us))
 			goto end;
 		if (uwsgi_stats_key(us, "crons"))
@@ -1299,7 +1654,7 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 
 #ifdef UWSGI_SSL
 	struct uwsgi_legion *legion = NULL;
-	if (uwsgi.legions) {
+	if (uwsgi.legions && uwsgi_stats_want(us, "legions", NULL)) {
 
 		if (uwsgi_stats_comma(us))
 			goto end;
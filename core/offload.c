@@ -15,6 +15,15 @@
 
 	between 2 and 3 you can set specific values
 
+	each offload thread maps every file descriptor of its requests to the request itself,
+	so events are dispatched in constant time.
+
+	new requests are assigned to the offload thread with less active requests
+	(round robin is used between equally loaded threads)
+
+	the pipe and transfer engines move data with splice() (via a per-request kernel pipe)
+	when available, falling back to a userspace buffer
+
 */
 
 
@@ -36,6 +45,8 @@ void uwsgi_offload_setup(struct uwsgi_offload_engine *uoe, struct uwsgi_offload_
 	// an engine could changes behaviour based on pipe anf takeover values
 	uor->pipe[0] = -1;
 	uor->pipe[1] = -1;
+	uor->splice_pipe[0] = -1;
+	uor->splice_pipe[1] = -1;
 	uor->takeover = takeover;
 
 }
@@ -43,13 +54,21 @@ void uwsgi_offload_setup(struct uwsgi_offload_engine *uoe, struct uwsgi_offload_
 static int uwsgi_offload_enqueue(struct wsgi_request *wsgi_req, struct uwsgi_offload_request *uor) {
 	struct uwsgi_core *uc = &uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id];
 	uc->offloaded_requests++;
-	// round robin
-	if (uc->offload_rr >= uwsgi.offload_threads) {
-		uc->offload_rr = 0;
+	// choose the least loaded thread, starting from the round robin slot
+	int i, best = 0, best_active = -1;
+	for (i = 0; i < uwsgi.offload_threads; i++) {
+		int slot = (uc->offload_rr + i) % uwsgi.offload_threads;
+		int active = uwsgi.offload_thread[slot]->offload_active;
+		if (best_active == -1 || active < best_active) {
+			best = slot;
+			best_active = active;
+		}
 	}
-	struct uwsgi_thread *ut = uwsgi.offload_thread[uc->offload_rr];
-	uc->offload_rr++;
+	uc->offload_rr = best + 1;
+	struct uwsgi_thread *ut = uwsgi.offload_thread[best];
+	__sync_add_and_fetch(&ut->offload_active, 1);
 	if (write(ut->pipe[0], uor, sizeof(struct uwsgi_offload_request)) != sizeof(struct uwsgi_offload_request)) {
+		__sync_sub_and_fetch(&ut->offload_active, 1);
 		if (uor->takeover) {
 			wsgi_req->fd_closed = 0;
 		}
@@ -158,7 +177,28 @@ static int u_offload_sendfile_prepare(struct wsgi_request *wsgi_req, struct uwsg
 	return 0;
 }
 
+void uwsgi_offload_account(struct uwsgi_offload_request *uor, ssize_t len) {
+	__sync_add_and_fetch(&uor->engine->counters->bytes, len);
+}
+
+void uwsgi_offload_error(struct uwsgi_offload_request *uor, char *msg) {
+	uwsgi_error(msg);
+	__sync_add_and_fetch(&uor->engine->counters->errors, 1);
+}
+
+static void uwsgi_offload_table_set(struct uwsgi_thread *ut, int fd, struct uwsgi_offload_request *uor, struct uwsgi_offload_request *old) {
+	if (fd < 0 || fd >= (int) uwsgi.max_fd) return;
+	if (ut->offload_table[fd] == old) {
+		ut->offload_table[fd] = uor;
+	}
+}
+
 static void uwsgi_offload_close(struct uwsgi_thread *ut, struct uwsgi_offload_request *uor) {
+	// remove the request from the fd table
+	uwsgi_offload_table_set(ut, uor->s, NULL, uor);
+	uwsgi_offload_table_set(ut, uor->fd, NULL, uor);
+	uwsgi_offload_table_set(ut, uor->fd2, NULL, uor);
+
 	// close the socket and the file descriptor
 	if (uor->takeover && uor->s > -1) {
 		close(uor->s);
@@ -169,25 +209,6 @@ static void uwsgi_offload_close(struct uwsgi_thread *ut, struct uwsgi_offload_re
 	if (uor->fd2 != -1) {
 		close(uor->fd2);
 	}
-	// remove the structure from the linked list;
-	struct uwsgi_offload_request *prev = uor->prev;
-	struct uwsgi_offload_request *next = uor->next;
-
-	if (uor == ut->offload_requests_head) {
-		ut->offload_requests_head = next;
-	}
-
-	if (uor == ut->offload_requests_tail) {
-		ut->offload_requests_tail = prev;
-	}
-
-	if (prev) {
-		prev->next = next;
-	}
-
-	if (next) {
-		next->prev = prev;
-	}
 
 	if (uor->buf) {
 		free(uor->buf);
@@ -202,42 +223,38 @@ static void uwsgi_offload_close(struct uwsgi_thread *ut, struct uwsgi_offload_re
 		close(uor->pipe[0]);
 	}
 
+	if (uor->splice_pipe[0] != -1) {
+		close(uor->splice_pipe[1]);
+		close(uor->splice_pipe[0]);
+	}
+
+	__sync_sub_and_fetch(&uor->engine->counters->active, 1);
+	__sync_sub_and_fetch(&ut->offload_active, 1);
+
 	free(uor);
 }
 
 static void uwsgi_offload_append(struct uwsgi_thread *ut, struct uwsgi_offload_request *uor) {
-
-	if (!ut->offload_requests_head) {
-		ut->offload_requests_head = uor;
-	}
-
-	if (ut->offload_requests_tail) {
-		ut->offload_requests_tail->next = uor;
-		uor->prev = ut->offload_requests_tail;
-	}
-
-	ut->offload_requests_tail = uor;
+	uwsgi_offload_table_set(ut, uor->s, uor, NULL);
+	uwsgi_offload_table_set(ut, uor->fd, uor, NULL);
+	uwsgi_offload_table_set(ut, uor->fd2, uor, NULL);
 }
 
 static struct uwsgi_offload_request *uwsgi_offload_get_by_fd(struct uwsgi_thread *ut, int s) {
-	struct uwsgi_offload_request *uor = ut->offload_requests_head;
-	while (uor) {
-		if (uor->s == s || uor->fd == s || uor->fd2 == s) {
-			return uor;
-		}
-		uor = uor->next;
-	}
-
-	return NULL;
+	if (s < 0 || s >= (int) uwsgi.max_fd) return NULL;
+	return ut->offload_table[s];
 }
 
 static void uwsgi_offload_loop(struct uwsgi_thread *ut) {
 
 	int i;
+	if (uwsgi.offload_threads_events < 1) uwsgi.offload_threads_events = 1;
 	void *events = event_queue_alloc(uwsgi.offload_threads_events);
+	ut->offload_table = uwsgi_calloc(sizeof(struct uwsgi_offload_request *) * uwsgi.max_fd);
 
 	for (;;) {
 		int nevents = event_queue_wait_multi(ut->queue, -1, events, uwsgi.offload_threads_events);
+		uwsgi_events_histogram_add(&uwsgi.workers[uwsgi.mywid].offload_events, nevents);
 		for (i = 0; i < nevents; i++) {
 			int interesting_fd = event_queue_interesting_fd(events, i);
 			if (interesting_fd == ut->pipe[1]) {
@@ -246,14 +263,20 @@ static void uwsgi_offload_loop(struct uwsgi_thread *ut) {
 				if (len != sizeof(struct uwsgi_offload_request)) {
 					uwsgi_error("read()");
 					free(uor);
+					// the enqueued request is lost (unless the read was spurious)
+					if (len >= 0 || !uwsgi_is_again()) {
+						__sync_sub_and_fetch(&ut->offload_active, 1);
+					}
 					continue;
 				}
+				__sync_add_and_fetch(&uor->engine->counters->requests, 1);
+				__sync_add_and_fetch(&uor->engine->counters->active, 1);
+				// the request must be indexed before the first call (it could register its fds)
+				uwsgi_offload_append(ut, uor);
 				// cal the event function for the first time
 				if (uor->engine->event_func(ut, uor, -1)) {
 					uwsgi_offload_close(ut, uor);
-					continue;
 				}
-				uwsgi_offload_append(ut, uor);
 				continue;
 			}
 
@@ -293,6 +316,7 @@ static int u_offload_memory_do(struct uwsgi_thread *ut, struct uwsgi_offload_req
 	ssize_t rlen = write(uor->s, uor->buf + uor->written, uor->len - uor->written);
 	if (rlen > 0) {
 		uor->written += rlen;
+		uwsgi_offload_account(uor, rlen);
 		if (uor->written >= uor->len) {
 			return -1;
 		}
@@ -300,7 +324,7 @@ static int u_offload_memory_do(struct uwsgi_thread *ut, struct uwsgi_offload_req
 	}
         else if (rlen < 0) {
 		uwsgi_offload_retry
-                uwsgi_error("u_offload_memory_do()");
+                uwsgi_offload_error(uor, "u_offload_memory_do()");
 	}
 	return -1;
 }
@@ -324,9 +348,10 @@ static int u_offload_sendfile_do(struct uwsgi_thread *ut, struct uwsgi_offload_r
 		return 0;
 	}
 #if defined(__linux__) || defined(__sun__) || defined(__GNU_kFreeBSD__)
-	ssize_t len = sendfile(uor->fd2, uor->fd, &uor->pos, 128 * 1024);
+	ssize_t len = sendfile(uor->fd2, uor->fd, &uor->pos, UMIN(128 * 1024, uor->len - uor->written));
 	if (len > 0) {
         	uor->written += len;
+		uwsgi_offload_account(uor, len);
                 if (uor->written >= uor->len) {
 			return -1;
 		}
@@ -334,31 +359,102 @@ static int u_offload_sendfile_do(struct uwsgi_thread *ut, struct uwsgi_offload_r
 	}
         else if (len < 0) {
 		uwsgi_offload_retry
-                uwsgi_error("u_offload_sendfile_do()");
+                uwsgi_offload_error(uor, "u_offload_sendfile_do()");
 	}
 #elif defined(__FreeBSD__) || defined(__DragonFly__)
 	off_t sbytes = 0;
-	int ret = sendfile(uor->fd, uor->fd2, uor->pos, 0, NULL, &sbytes, 0);
+	int ret = sendfile(uor->fd, uor->fd2, uor->pos, uor->len - uor->written, NULL, &sbytes, 0);
 	// transfer finished
 	if (ret == -1) {
 		uor->pos += sbytes;
+		uor->written += sbytes;
+		uwsgi_offload_account(uor, sbytes);
 		uwsgi_offload_retry
-                uwsgi_error("u_offload_sendfile_do()");
+                uwsgi_offload_error(uor, "u_offload_sendfile_do()");
 	}
 #elif defined(__APPLE__) && !defined(NO_SENDFILE)
-	off_t len = 0;
+	off_t len = uor->len - uor->written;
         int ret = sendfile(uor->fd, uor->fd2, uor->pos, &len, NULL, 0);
         // transfer finished
         if (ret == -1) {
                 uor->pos += len;
+                uor->written += len;
+                uwsgi_offload_account(uor, len);
                 uwsgi_offload_retry
-                uwsgi_error("u_offload_sendfile_do()");
+                uwsgi_offload_error(uor, "u_offload_sendfile_do()");
         }
 #endif
 	return -1;
 
 }
 
+/*
+
+	data is moved between two file descriptors in chunks:
+
+	uwsgi_offload_fill() loads a chunk from a descriptor (returns 0 on EOF)
+	uwsgi_offload_drain() writes (part of) the current chunk to another one (uor->to_write is the remaining part)
+
+	on Linux the chunk lives in a kernel pipe (splice()) and never reaches userspace,
+	if the source does not support splice() the request falls back to a 4k userspace buffer
+
+*/
+
+#define UWSGI_OFFLOAD_SPLICE_CHUNK (64 * 1024)
+
+static ssize_t uwsgi_offload_fill(struct uwsgi_offload_request *uor, int from) {
+	ssize_t rlen;
+#ifdef __linux__
+	if (uor->splice_pipe[0] == -1 && !uor->buf) {
+		if (pipe2(uor->splice_pipe, O_NONBLOCK | O_CLOEXEC)) {
+			uwsgi_error("uwsgi_offload_fill()/pipe2()");
+			uor->splice_pipe[0] = -1;
+			uor->splice_pipe[1] = -1;
+		}
+	}
+	if (uor->splice_pipe[0] != -1) {
+		rlen = splice(from, NULL, uor->splice_pipe[1], NULL, UWSGI_OFFLOAD_SPLICE_CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (rlen >= 0 || errno != EINVAL) {
+			if (rlen > 0) {
+				uor->to_write = rlen;
+			}
+			return rlen;
+		}
+		// the pipe is empty, we can safely switch to the userspace buffer
+		close(uor->splice_pipe[0]);
+		close(uor->splice_pipe[1]);
+		uor->splice_pipe[0] = -1;
+		uor->splice_pipe[1] = -1;
+	}
+#endif
+	if (!uor->buf) {
+		uor->buf = uwsgi_malloc(4096);
+	}
+	rlen = read(from, uor->buf, 4096);
+	if (rlen > 0) {
+		uor->to_write = rlen;
+		uor->pos = 0;
+	}
+	return rlen;
+}
+
+static ssize_t uwsgi_offload_drain(struct uwsgi_offload_request *uor, int to) {
+	ssize_t rlen;
+#ifdef __linux__
+	if (uor->splice_pipe[0] != -1) {
+		rlen = splice(uor->splice_pipe[0], NULL, to, NULL, uor->to_write, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	}
+	else
+#endif
+	rlen = write(to, uor->buf + uor->pos, uor->to_write);
+	if (rlen > 0) {
+		uor->to_write -= rlen;
+		uor->pos += rlen;
+		uwsgi_offload_account(uor, rlen);
+	}
+	return rlen;
+}
+
 /*
 
 	pipe offloading
@@ -373,20 +469,15 @@ static int u_offload_pipe_do(struct uwsgi_thread *ut, struct uwsgi_offload_reque
 
 	// setup
 	if (fd == -1) {
-		event_queue_add_fd_read(ut->queue, uor->fd);
+		if (event_queue_add_fd_read(ut->queue, uor->fd)) return -1;
 		return 0;
 	}
 
 	switch(uor->status) {
 		// read event from fd
 		case 0:
-			if (!uor->buf) {
-				uor->buf = uwsgi_malloc(4096);
-			}
-			rlen = read(uor->fd, uor->buf, 4096);
+			rlen = uwsgi_offload_fill(uor, uor->fd);
 			if (rlen > 0) {
-				uor->to_write = rlen;
-				uor->pos = 0;
 				if (event_queue_del_fd(ut->queue, uor->fd, event_queue_read())) return -1;
 				if (event_queue_add_fd_write(ut->queue, uor->s)) return -1;
 				uor->status = 1;
@@ -394,15 +485,13 @@ static int u_offload_pipe_do(struct uwsgi_thread *ut, struct uwsgi_offload_reque
 			}
 			if (rlen < 0) {
 				uwsgi_offload_retry
-				uwsgi_error("u_offload_pipe_do() -> read()");
+				uwsgi_offload_error(uor, "u_offload_pipe_do() -> read()");
 			}
 			return -1;
 		// write event on s
 		case 1:
-			rlen = write(uor->s, uor->buf + uor->pos, uor->to_write);
+			rlen = uwsgi_offload_drain(uor, uor->s);
 			if (rlen > 0) {
-				uor->to_write -= rlen;
-				uor->pos += rlen;
 				if (uor->to_write == 0) {
 					if (event_queue_del_fd(ut->queue, uor->s, event_queue_write())) return -1;
 					if (event_queue_add_fd_read(ut->queue, uor->fd)) return -1;
@@ -412,7 +501,7 @@ static int u_offload_pipe_do(struct uwsgi_thread *ut, struct uwsgi_offload_reque
 			}
 			else if (rlen < 0) {
 				uwsgi_offload_retry
-				uwsgi_error("u_offload_pipe_do() -> write()");
+				uwsgi_offload_error(uor, "u_offload_pipe_do() -> write()");
 			}
 			return -1;
 		default:
@@ -440,7 +529,7 @@ static int u_offload_transfer_do(struct uwsgi_thread *ut, struct uwsgi_offload_r
 
 	// setup
 	if (fd == -1) {
-		event_queue_add_fd_write(ut->queue, uor->fd);
+		if (event_queue_add_fd_write(ut->queue, uor->fd)) return -1;
 		return 0;
 	}
 
@@ -459,6 +548,7 @@ static int u_offload_transfer_do(struct uwsgi_thread *ut, struct uwsgi_offload_r
 				rlen = write(uor->fd, uor->ubuf->buf + uor->written, uor->ubuf->pos-uor->written);	
 				if (rlen > 0) {
 					uor->written += rlen;
+					uwsgi_offload_account(uor, rlen);
 					if (uor->written >= (size_t)uor->ubuf->pos) {
 						uor->status = 2;
 						if (event_queue_add_fd_read(ut->queue, uor->s)) return -1;
@@ -468,50 +558,41 @@ static int u_offload_transfer_do(struct uwsgi_thread *ut, struct uwsgi_offload_r
 				}
 				else if (rlen < 0) {
 					uwsgi_offload_retry
-					uwsgi_error("u_offload_transfer_do() -> write()");
+					uwsgi_offload_error(uor, "u_offload_transfer_do() -> write()");
 				}
 			}	
 			return -1;
 		// read event from s or fd
 		case 2:
-			if (!uor->buf) {
-				uor->buf = uwsgi_malloc(4096);
-			}
 			if (fd == uor->fd) {
-				rlen = read(uor->fd, uor->buf, 4096);
+				rlen = uwsgi_offload_fill(uor, uor->fd);
 				if (rlen > 0) {
-					uor->to_write = rlen;
-					uor->pos = 0;
 					uwsgi_offload_0r_1w(uor->fd, uor->s)
 					uor->status = 3;
 					return 0;
 				}
 				if (rlen < 0) {
 					uwsgi_offload_retry
-					uwsgi_error("u_offload_transfer_do() -> read()/fd");
+					uwsgi_offload_error(uor, "u_offload_transfer_do() -> read()/fd");
 				}
 			}
 			else if (fd == uor->s) {
-				rlen = read(uor->s, uor->buf, 4096);
+				rlen = uwsgi_offload_fill(uor, uor->s);
 				if (rlen > 0) {
-					uor->to_write = rlen;
-					uor->pos = 0;
 					uwsgi_offload_0r_1w(uor->s, uor->fd)
 					uor->status = 4;
 					return 0;
 				}
 				if (rlen < 0) {
 					uwsgi_offload_retry
-					uwsgi_error("u_offload_transfer_do() -> read()/s");
+					uwsgi_offload_error(uor, "u_offload_transfer_do() -> read()/s");
 				}
 			}
 			return -1;
 		// write event on s
 		case 3:
-			rlen = write(uor->s, uor->buf + uor->pos, uor->to_write);
+			rlen = uwsgi_offload_drain(uor, uor->s);
 			if (rlen > 0) {
-				uor->to_write -= rlen;
-				uor->pos += rlen;
 				if (uor->to_write == 0) {
 					if (event_queue_fd_write_to_read(ut->queue, uor->s)) return -1;
 					if (event_queue_add_fd_read(ut->queue, uor->fd)) return -1;
@@ -521,15 +602,13 @@ static int u_offload_transfer_do(struct uwsgi_thread *ut, struct uwsgi_offload_r
 			}
 			else if (rlen < 0) {
 				uwsgi_offload_retry
-				uwsgi_error("u_offload_transfer_do() -> write()/s");
+				uwsgi_offload_error(uor, "u_offload_transfer_do() -> write()/s");
 			}
 			return -1;
 		// write event on fd
 		case 4:
-			rlen = write(uor->fd, uor->buf + uor->pos, uor->to_write);
+			rlen = uwsgi_offload_drain(uor, uor->fd);
 			if (rlen > 0) {
-				uor->to_write -= rlen;
-				uor->pos += rlen;
 				if (uor->to_write == 0) {
 					if (event_queue_fd_write_to_read(ut->queue, uor->fd)) return -1;
 					if (event_queue_add_fd_read(ut->queue, uor->s)) return -1;
@@ -539,7 +618,7 @@ static int u_offload_transfer_do(struct uwsgi_thread *ut, struct uwsgi_offload_r
 			}
 			else if (rlen < 0) {
 				uwsgi_offload_retry
-				uwsgi_error("u_offload_transfer_do() -> write()/fd");
+				uwsgi_offload_error(uor, "u_offload_transfer_do() -> write()/fd");
 			}
 			return -1;
 		default:
@@ -588,6 +667,7 @@ struct uwsgi_offload_engine *uwsgi_offload_engine_by_name(char *name) {
 		if (!strcmp(name, uoe->name)) {
 			return uoe;
 		}
+		uoe = uoe->next;
 	}
 	return NULL;
 }
@@ -607,6 +687,8 @@ struct uwsgi_offload_engine *uwsgi_offload_register_engine(char *name, int (*pre
 	engine->name = name;
 	engine->prepare_func = prepare_func;
 	engine->event_func = event_func;
+	// engines are registered before forking, so the counters are shared by all of the workers
+	engine->counters = uwsgi_calloc_shared(sizeof(struct uwsgi_offload_engine_counters));
 
 	if (old_engine) {
 		old_engine->next = engine;
@@ -626,9 +708,15 @@ void uwsgi_offload_engines_register_all() {
 }
 
 int uwsgi_offload_request_sendfile_do(struct wsgi_request *wsgi_req, int fd, size_t len) {
+	return uwsgi_offload_request_sendfile_pos_do(wsgi_req, fd, 0, len);
+}
+
+// the file offset of fd is never touched, so the descriptor can be shared (see the static file cache)
+int uwsgi_offload_request_sendfile_pos_do(struct wsgi_request *wsgi_req, int fd, size_t pos, size_t len) {
 	struct uwsgi_offload_request uor;
 	uwsgi_offload_setup(uwsgi.offload_engine_sendfile, &uor, wsgi_req, 1);
 	uor.fd = fd;
+	uor.pos = pos;
 	uor.len = len;
 	return uwsgi_offload_run(wsgi_req, &uor, NULL);
 }
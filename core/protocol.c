@@ -127,6 +127,8 @@ int uwsgi_parse_array(char *buffer, uint16_t size, char **argv, uint16_t argvs[]
 int uwsgi_simple_parse_vars(struct wsgi_request *wsgi_req, char *ptrbuf, char *bufferend) {
 
 	uint16_t strsize;
+	// a var uses 2 iovecs, the limit is computed once out of the loop
+	int vec_limit = uwsgi.vec_size - (4 + 1) - 2;
 
 	while (ptrbuf < bufferend) {
 		if (ptrbuf + 2 < bufferend) {
@@ -154,25 +156,15 @@ int uwsgi_simple_parse_vars(struct wsgi_request *wsgi_req, char *ptrbuf, char *b
 #endif
 					ptrbuf += 2;
 					if (ptrbuf + strsize <= bufferend) {
-
-						if (wsgi_req->var_cnt < uwsgi.vec_size - (4 + 1)) {
-							wsgi_req->var_cnt++;
-						}
-						else {
+						if (wsgi_req->var_cnt > vec_limit) {
 							uwsgi_log("max vec size reached. skip this header.\n");
 							return -1;
 						}
+						wsgi_req->var_cnt++;
 						// var value
 						wsgi_req->hvec[wsgi_req->var_cnt].iov_base = ptrbuf;
 						wsgi_req->hvec[wsgi_req->var_cnt].iov_len = strsize;
-
-						if (wsgi_req->var_cnt < uwsgi.vec_size - (4 + 1)) {
-							wsgi_req->var_cnt++;
-						}
-						else {
-							uwsgi_log("max vec size reached. skip this var.\n");
-							return -1;
-						}
+						wsgi_req->var_cnt++;
 						ptrbuf += strsize;
 					}
 					else {
@@ -191,6 +183,19 @@ int uwsgi_simple_parse_vars(struct wsgi_request *wsgi_req, char *ptrbuf, char *b
 	return 0;
 }
 
+/*
+	how the well-known keys are recognized:
+
+	the keys managed by the core are recognized by a perfect hash: the first level is the key size
+	(uwsgi.proto_hooks is indexed by it), the second one is a switch on one (or the sum of two) of the key
+	chars chosen to be different for every key of that size. So every var is compared (with a constant size
+	memcmp(), that the compiler turns in a couple of word comparisons) at most with a single key, instead of
+	with all of the keys of the same size.
+
+	when adding a key choose a char (or a couple of chars) still unique for its size, the compiler
+	will complain about duplicated case values otherwise.
+*/
+
 #define uwsgi_proto_key(x, y) memcmp(x, key, y)
 
 static int uwsgi_proto_check_5(struct wsgi_request *wsgi_req, char *key, char *buf, uint16_t len) {
@@ -206,23 +211,26 @@ static int uwsgi_proto_check_5(struct wsgi_request *wsgi_req, char *key, char *b
 
 static int uwsgi_proto_check_9(struct wsgi_request *wsgi_req, char *key, char *buf, uint16_t len) {
 
-	if (!uwsgi_proto_key("PATH_INFO", 9)) {
-		wsgi_req->path_info = buf;
-		wsgi_req->path_info_len = len;
-		wsgi_req->path_info_pos = wsgi_req->var_cnt + 1;
+	switch (key[0]) {
+	case 'P':
+		if (!uwsgi_proto_key("PATH_INFO", 9)) {
+			wsgi_req->path_info = buf;
+			wsgi_req->path_info_len = len;
+			wsgi_req->path_info_pos = wsgi_req->var_cnt + 1;
 #ifdef UWSGI_DEBUG
-		uwsgi_debug("PATH_INFO=%.*s\n", wsgi_req->path_info_len, wsgi_req->path_info);
+			uwsgi_debug("PATH_INFO=%.*s\n", wsgi_req->path_info_len, wsgi_req->path_info);
 #endif
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("HTTP_HOST", 9)) {
-		wsgi_req->host = buf;
-		wsgi_req->host_len = len;
+		}
+		break;
+	case 'H':
+		if (!uwsgi_proto_key("HTTP_HOST", 9)) {
+			wsgi_req->host = buf;
+			wsgi_req->host_len = len;
 #ifdef UWSGI_DEBUG
-		uwsgi_debug("HTTP_HOST=%.*s\n", wsgi_req->host_len, wsgi_req->host);
+			uwsgi_debug("HTTP_HOST=%.*s\n", wsgi_req->host_len, wsgi_req->host);
 #endif
-		return 0;
+		}
+		break;
 	}
 
 	return 0;
@@ -258,22 +266,27 @@ static void uwsgi_parse_http_range(char *buf, uint16_t len, size_t *from, size_t
 
 static int uwsgi_proto_check_10(struct wsgi_request *wsgi_req, char *key, char *buf, uint16_t len) {
 
-	if (uwsgi.honour_range && !uwsgi_proto_key("HTTP_RANGE", 10)) {
-		uwsgi_parse_http_range(buf, len, &wsgi_req->range_from, &wsgi_req->range_to);
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("UWSGI_FILE", 10)) {
-		wsgi_req->file = buf;
-		wsgi_req->file_len = len;
-		wsgi_req->dynamic = 1;
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("UWSGI_HOME", 10)) {
-		wsgi_req->home = buf;
-		wsgi_req->home_len = len;
-		return 0;
+	switch (key[6]) {
+	case 'A':
+		if (uwsgi.honour_range && !uwsgi_proto_key("HTTP_RANGE", 10)) {
+			uwsgi_parse_http_range(buf, len, &wsgi_req->range_from, &wsgi_req->range_to);
+			wsgi_req->range = buf;
+			wsgi_req->range_len = len;
+		}
+		break;
+	case 'F':
+		if (!uwsgi_proto_key("UWSGI_FILE", 10)) {
+			wsgi_req->file = buf;
+			wsgi_req->file_len = len;
+			wsgi_req->dynamic = 1;
+		}
+		break;
+	case 'H':
+		if (!uwsgi_proto_key("UWSGI_HOME", 10)) {
+			wsgi_req->home = buf;
+			wsgi_req->home_len = len;
+		}
+		break;
 	}
 
 	return 0;
@@ -281,128 +294,135 @@ static int uwsgi_proto_check_10(struct wsgi_request *wsgi_req, char *key, char *
 
 static int uwsgi_proto_check_11(struct wsgi_request *wsgi_req, char *key, char *buf, uint16_t len) {
 
-	if (!uwsgi_proto_key("SCRIPT_NAME", 11)) {
-		wsgi_req->script_name = buf;
-		wsgi_req->script_name_len = len;
-		wsgi_req->script_name_pos = wsgi_req->var_cnt + 1;
+	switch (key[1] + key[7]) {
+	case 'C' + 'N':
+		if (!uwsgi_proto_key("SCRIPT_NAME", 11)) {
+			wsgi_req->script_name = buf;
+			wsgi_req->script_name_len = len;
+			wsgi_req->script_name_pos = wsgi_req->var_cnt + 1;
 #ifdef UWSGI_DEBUG
-		uwsgi_debug("SCRIPT_NAME=%.*s\n", wsgi_req->script_name_len, wsgi_req->script_name);
+			uwsgi_debug("SCRIPT_NAME=%.*s\n", wsgi_req->script_name_len, wsgi_req->script_name);
 #endif
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("REQUEST_URI", 11)) {
-		wsgi_req->uri = buf;
-		wsgi_req->uri_len = len;
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("REMOTE_USER", 11)) {
-		wsgi_req->remote_user = buf;
-		wsgi_req->remote_user_len = len;
-		return 0;
-	}
-
-	if (wsgi_req->host_len == 0 && !uwsgi_proto_key("SERVER_NAME", 11)) {
-		wsgi_req->host = buf;
-		wsgi_req->host_len = len;
+		}
+		break;
+	case 'E' + '_':
+		if (!uwsgi_proto_key("REQUEST_URI", 11)) {
+			wsgi_req->uri = buf;
+			wsgi_req->uri_len = len;
+		}
+		break;
+	case 'E' + 'U':
+		if (!uwsgi_proto_key("REMOTE_USER", 11)) {
+			wsgi_req->remote_user = buf;
+			wsgi_req->remote_user_len = len;
+		}
+		break;
+	case 'E' + 'N':
+		if (wsgi_req->host_len == 0 && !uwsgi_proto_key("SERVER_NAME", 11)) {
+			wsgi_req->host = buf;
+			wsgi_req->host_len = len;
 #ifdef UWSGI_DEBUG
-		uwsgi_debug("SERVER_NAME=%.*s\n", wsgi_req->host_len, wsgi_req->host);
+			uwsgi_debug("SERVER_NAME=%.*s\n", wsgi_req->host_len, wsgi_req->host);
 #endif
-		return 0;
-	}
-
-	if (wsgi_req->remote_addr_len == 0 && !uwsgi_proto_key("REMOTE_ADDR", 11)) {
-		wsgi_req->remote_addr = buf;
-                wsgi_req->remote_addr_len = len;
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("HTTP_COOKIE", 11)) {
-		wsgi_req->cookie = buf;
-		wsgi_req->cookie_len = len;
-		return 0;
-	}
-
-
-	if (!uwsgi_proto_key("UWSGI_APPID", 11)) {
-		wsgi_req->appid = buf;
-		wsgi_req->appid_len = len;
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("UWSGI_CHDIR", 11)) {
-		wsgi_req->chdir = buf;
-		wsgi_req->chdir_len = len;
-		return 0;
+		}
+		break;
+	case 'E' + 'A':
+		if (wsgi_req->remote_addr_len == 0 && !uwsgi_proto_key("REMOTE_ADDR", 11)) {
+			wsgi_req->remote_addr = buf;
+			wsgi_req->remote_addr_len = len;
+		}
+		break;
+	case 'T' + 'O':
+		if (!uwsgi_proto_key("HTTP_COOKIE", 11)) {
+			wsgi_req->cookie = buf;
+			wsgi_req->cookie_len = len;
+		}
+		break;
+	case 'W' + 'P':
+		if (!uwsgi_proto_key("UWSGI_APPID", 11)) {
+			wsgi_req->appid = buf;
+			wsgi_req->appid_len = len;
+		}
+		break;
+	case 'W' + 'H':
+		if (!uwsgi_proto_key("UWSGI_CHDIR", 11)) {
+			wsgi_req->chdir = buf;
+			wsgi_req->chdir_len = len;
+		}
+		break;
+	case 'T' + 'I':
+		if (!uwsgi_proto_key("HTTP_ORIGIN", 11)) {
+			wsgi_req->http_origin = buf;
+			wsgi_req->http_origin_len = len;
+		}
+		break;
 	}
 
-	if (!uwsgi_proto_key("HTTP_ORIGIN", 11)) {
-                wsgi_req->http_origin = buf;
-                wsgi_req->http_origin_len = len;
-                return 0;
-        }
-
 	return 0;
 }
 
 static int uwsgi_proto_check_12(struct wsgi_request *wsgi_req, char *key, char *buf, uint16_t len) {
-	if (!uwsgi_proto_key("QUERY_STRING", 12)) {
-		wsgi_req->query_string = buf;
-		wsgi_req->query_string_len = len;
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("CONTENT_TYPE", 12)) {
-		wsgi_req->content_type = buf;
-		wsgi_req->content_type_len = len;
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("HTTP_REFERER", 12)) {
-                wsgi_req->referer = buf;
-                wsgi_req->referer_len = len;
-                return 0;
-        }
-
-	if (!uwsgi_proto_key("UWSGI_SCHEME", 12)) {
-		wsgi_req->scheme = buf;
-		wsgi_req->scheme_len = len;
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("UWSGI_SCRIPT", 12)) {
-		wsgi_req->script = buf;
-		wsgi_req->script_len = len;
-		wsgi_req->dynamic = 1;
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("UWSGI_MODULE", 12)) {
-		wsgi_req->module = buf;
-		wsgi_req->module_len = len;
-		wsgi_req->dynamic = 1;
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("UWSGI_PYHOME", 12)) {
-		wsgi_req->home = buf;
-		wsgi_req->home_len = len;
-		return 0;
-	}
 
-	if (!uwsgi_proto_key("UWSGI_SETENV", 12)) {
-		char *env_value = memchr(buf, '=', len);
-		if (env_value) {
-			env_value[0] = 0;
-			env_value = uwsgi_concat2n(env_value + 1, len - ((env_value + 1) - buf), "", 0);
-			if (setenv(buf, env_value, 1)) {
-				uwsgi_error("setenv()");
+	switch (key[6] + key[11]) {
+	case 'S' + 'G':
+		if (!uwsgi_proto_key("QUERY_STRING", 12)) {
+			wsgi_req->query_string = buf;
+			wsgi_req->query_string_len = len;
+		}
+		break;
+	case 'T' + 'E':
+		if (!uwsgi_proto_key("CONTENT_TYPE", 12)) {
+			wsgi_req->content_type = buf;
+			wsgi_req->content_type_len = len;
+		}
+		break;
+	case 'E' + 'R':
+		if (!uwsgi_proto_key("HTTP_REFERER", 12)) {
+			wsgi_req->referer = buf;
+			wsgi_req->referer_len = len;
+		}
+		break;
+	case 'S' + 'E':
+		if (!uwsgi_proto_key("UWSGI_SCHEME", 12)) {
+			wsgi_req->scheme = buf;
+			wsgi_req->scheme_len = len;
+		}
+		break;
+	case 'S' + 'T':
+		if (!uwsgi_proto_key("UWSGI_SCRIPT", 12)) {
+			wsgi_req->script = buf;
+			wsgi_req->script_len = len;
+			wsgi_req->dynamic = 1;
+		}
+		break;
+	case 'M' + 'E':
+		if (!uwsgi_proto_key("UWSGI_MODULE", 12)) {
+			wsgi_req->module = buf;
+			wsgi_req->module_len = len;
+			wsgi_req->dynamic = 1;
+		}
+		break;
+	case 'P' + 'E':
+		if (!uwsgi_proto_key("UWSGI_PYHOME", 12)) {
+			wsgi_req->home = buf;
+			wsgi_req->home_len = len;
+		}
+		break;
+	case 'S' + 'V':
+		if (!uwsgi_proto_key("UWSGI_SETENV", 12)) {
+			char *env_value = memchr(buf, '=', len);
+			if (env_value) {
+				env_value[0] = 0;
+				env_value = uwsgi_concat2n(env_value + 1, len - ((env_value + 1) - buf), "", 0);
+				if (setenv(buf, env_value, 1)) {
+					uwsgi_error("setenv()");
+				}
+				free(env_value);
 			}
-			free(env_value);
 		}
-		return 0;
+		break;
 	}
+
 	return 0;
 }
 
@@ -416,38 +436,42 @@ static int uwsgi_proto_check_13(struct wsgi_request *wsgi_req, char *key, char *
 }
 
 static int uwsgi_proto_check_14(struct wsgi_request *wsgi_req, char *key, char *buf, uint16_t len) {
-	if (!uwsgi_proto_key("REQUEST_METHOD", 14)) {
-		wsgi_req->method = buf;
-		wsgi_req->method_len = len;
-		return 0;
-	}
 
-	if (!uwsgi_proto_key("CONTENT_LENGTH", 14)) {
-		wsgi_req->post_cl = get_content_length(buf, len);
-		if (uwsgi.limit_post) {
-			if (wsgi_req->post_cl > uwsgi.limit_post) {
-				uwsgi_log("Invalid (too big) CONTENT_LENGTH. skip.\n");
-				return -1;
+	switch (key[10]) {
+	case 'T':
+		if (!uwsgi_proto_key("REQUEST_METHOD", 14)) {
+			wsgi_req->method = buf;
+			wsgi_req->method_len = len;
+		}
+		break;
+	case 'N':
+		if (!uwsgi_proto_key("CONTENT_LENGTH", 14)) {
+			wsgi_req->post_cl = get_content_length(buf, len);
+			if (uwsgi.limit_post) {
+				if (wsgi_req->post_cl > uwsgi.limit_post) {
+					uwsgi_log("Invalid (too big) CONTENT_LENGTH. skip.\n");
+					return -1;
+				}
 			}
 		}
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("UWSGI_POSTFILE", 14)) {
-		char *postfile = uwsgi_concat2n(buf, len, "", 0);
-		wsgi_req->post_file = fopen(postfile, "r");
-		if (!wsgi_req->post_file) {
-			uwsgi_error_open(postfile);
+		break;
+	case 'F':
+		if (!uwsgi_proto_key("UWSGI_POSTFILE", 14)) {
+			char *postfile = uwsgi_concat2n(buf, len, "", 0);
+			wsgi_req->post_file = fopen(postfile, "r");
+			if (!wsgi_req->post_file) {
+				uwsgi_error_open(postfile);
+			}
+			free(postfile);
 		}
-		free(postfile);
-		return 0;
-	}
-
-	if (!uwsgi_proto_key("UWSGI_CALLABLE", 14)) {
-		wsgi_req->callable = buf;
-		wsgi_req->callable_len = len;
-		wsgi_req->dynamic = 1;
-		return 0;
+		break;
+	case 'A':
+		if (!uwsgi_proto_key("UWSGI_CALLABLE", 14)) {
+			wsgi_req->callable = buf;
+			wsgi_req->callable_len = len;
+			wsgi_req->dynamic = 1;
+		}
+		break;
 	}
 
 	return 0;
@@ -455,38 +479,52 @@ static int uwsgi_proto_check_14(struct wsgi_request *wsgi_req, char *key, char *
 
 
 static int uwsgi_proto_check_15(struct wsgi_request *wsgi_req, char *key, char *buf, uint16_t len) {
-	if (!uwsgi_proto_key("SERVER_PROTOCOL", 15)) {
-		wsgi_req->protocol = buf;
-		wsgi_req->protocol_len = len;
-		return 0;
-	}
 
-	if (!uwsgi_proto_key("HTTP_USER_AGENT", 15)) {
-		wsgi_req->user_agent = buf;
-		wsgi_req->user_agent_len = len;
-		return 0;
-	}
-
-	if (uwsgi.caches && !uwsgi_proto_key("UWSGI_CACHE_GET", 15)) {
-		wsgi_req->cache_get = buf;
-		wsgi_req->cache_get_len = len;
-		return 0;
+	switch (key[0]) {
+	case 'S':
+		if (!uwsgi_proto_key("SERVER_PROTOCOL", 15)) {
+			wsgi_req->protocol = buf;
+			wsgi_req->protocol_len = len;
+		}
+		break;
+	case 'H':
+		if (!uwsgi_proto_key("HTTP_USER_AGENT", 15)) {
+			wsgi_req->user_agent = buf;
+			wsgi_req->user_agent_len = len;
+		}
+		break;
+	case 'U':
+		if (uwsgi.caches && !uwsgi_proto_key("UWSGI_CACHE_GET", 15)) {
+			wsgi_req->cache_get = buf;
+			wsgi_req->cache_get_len = len;
+		}
+		break;
 	}
 
 	return 0;
 }
 
 static int uwsgi_proto_check_18(struct wsgi_request *wsgi_req, char *key, char *buf, uint16_t len) {
-	if (!uwsgi_proto_key("HTTP_AUTHORIZATION", 18)) {
-		wsgi_req->authorization = buf;
-		wsgi_req->authorization_len = len;
-		return 0;
-	}
 
-	if (!uwsgi_proto_key("UWSGI_TOUCH_RELOAD", 18)) {
-		wsgi_req->touch_reload = buf;
-		wsgi_req->touch_reload_len = len;
-		return 0;
+	switch (key[5]) {
+	case 'A':
+		if (!uwsgi_proto_key("HTTP_AUTHORIZATION", 18)) {
+			wsgi_req->authorization = buf;
+			wsgi_req->authorization_len = len;
+		}
+		break;
+	case '_':
+		if (!uwsgi_proto_key("UWSGI_TOUCH_RELOAD", 18)) {
+			wsgi_req->touch_reload = buf;
+			wsgi_req->touch_reload_len = len;
+		}
+		break;
+	case 'I':
+		if (!uwsgi_proto_key("HTTP_IF_NONE_MATCH", 18)) {
+			wsgi_req->if_none_match = buf;
+			wsgi_req->if_none_match_len = len;
+		}
+		break;
 	}
 
 	return 0;
@@ -494,37 +532,46 @@ static int uwsgi_proto_check_18(struct wsgi_request *wsgi_req, char *key, char *
 
 
 static int uwsgi_proto_check_20(struct wsgi_request *wsgi_req, char *key, char *buf, uint16_t len) {
-	if (uwsgi.logging_options.log_x_forwarded_for && !uwsgi_proto_key("HTTP_X_FORWARDED_FOR", 20)) {
-		wsgi_req->remote_addr = buf;
-		wsgi_req->remote_addr_len = len;
-		return 0;
-	}
 
-	if (!uwsgi_proto_key("HTTP_X_FORWARDED_SSL", 20)) {
-		wsgi_req->https = buf;
-                wsgi_req->https_len = len;
-	}
-
-	if (!uwsgi_proto_key("HTTP_ACCEPT_ENCODING", 20)) {
-		wsgi_req->encoding = buf;
-		wsgi_req->encoding_len = len;
-		return 0;
+	switch (key[17]) {
+	case 'F':
+		if (uwsgi.logging_options.log_x_forwarded_for && !uwsgi_proto_key("HTTP_X_FORWARDED_FOR", 20)) {
+			wsgi_req->remote_addr = buf;
+			wsgi_req->remote_addr_len = len;
+		}
+		break;
+	case 'S':
+		if (!uwsgi_proto_key("HTTP_X_FORWARDED_SSL", 20)) {
+			wsgi_req->https = buf;
+			wsgi_req->https_len = len;
+		}
+		break;
+	case 'I':
+		if (!uwsgi_proto_key("HTTP_ACCEPT_ENCODING", 20)) {
+			wsgi_req->encoding = buf;
+			wsgi_req->encoding_len = len;
+		}
+		break;
 	}
 
 	return 0;
 }
 
 static int uwsgi_proto_check_22(struct wsgi_request *wsgi_req, char *key, char *buf, uint16_t len) {
-	if (!uwsgi_proto_key("HTTP_IF_MODIFIED_SINCE", 22)) {
-		wsgi_req->if_modified_since = buf;
-		wsgi_req->if_modified_since_len = len;
-		return 0;
-	}
 
-	if (!uwsgi_proto_key("HTTP_SEC_WEBSOCKET_KEY", 22)) {
-		wsgi_req->http_sec_websocket_key = buf;
-		wsgi_req->http_sec_websocket_key_len = len;
-		return 0;
+	switch (key[5]) {
+	case 'I':
+		if (!uwsgi_proto_key("HTTP_IF_MODIFIED_SINCE", 22)) {
+			wsgi_req->if_modified_since = buf;
+			wsgi_req->if_modified_since_len = len;
+		}
+		break;
+	case 'S':
+		if (!uwsgi_proto_key("HTTP_SEC_WEBSOCKET_KEY", 22)) {
+			wsgi_req->http_sec_websocket_key = buf;
+			wsgi_req->http_sec_websocket_key_len = len;
+		}
+		break;
 	}
 
 	return 0;
@@ -596,6 +643,9 @@ int uwsgi_parse_vars(struct wsgi_request *wsgi_req) {
 	wsgi_req->script_name_pos = -1;
 	wsgi_req->path_info_pos = -1;
 
+	// a var uses 2 iovecs, the limit is computed once (the hooks could write to the global memory)
+	int vec_limit = uwsgi.vec_size - (4 + 1) - 2;
+
 	while (ptrbuf < bufferend) {
 		if (ptrbuf + 2 < bufferend) {
 			memcpy(&strsize, ptrbuf, 2);
@@ -622,6 +672,10 @@ int uwsgi_parse_vars(struct wsgi_request *wsgi_req) {
 #endif
 					ptrbuf += 2;
 					if (ptrbuf + strsize <= bufferend) {
+						if (wsgi_req->var_cnt > vec_limit) {
+							uwsgi_log("max vec size reached. skip this var.\n");
+							return -1;
+						}
 						if (wsgi_req->hvec[wsgi_req->var_cnt].iov_len > UWSGI_PROTO_MIN_CHECK &&
 							wsgi_req->hvec[wsgi_req->var_cnt].iov_len < UWSGI_PROTO_MAX_CHECK &&
 								uwsgi.proto_hooks[wsgi_req->hvec[wsgi_req->var_cnt].iov_len]) {
@@ -631,24 +685,12 @@ int uwsgi_parse_vars(struct wsgi_request *wsgi_req) {
 						}
 						//uwsgi_log("uwsgi %.*s = %.*s\n", wsgi_req->hvec[wsgi_req->var_cnt].iov_len, wsgi_req->hvec[wsgi_req->var_cnt].iov_base, strsize, ptrbuf);
 
-						if (wsgi_req->var_cnt < uwsgi.vec_size - (4 + 1)) {
-							wsgi_req->var_cnt++;
-						}
-						else {
-							uwsgi_log("max vec size reached. skip this var.\n");
-							return -1;
-						}
+						wsgi_req->var_cnt++;
 						// var value
 						wsgi_req->hvec[wsgi_req->var_cnt].iov_base = ptrbuf;
 						wsgi_req->hvec[wsgi_req->var_cnt].iov_len = strsize;
 						//uwsgi_log("%.*s = %.*s\n", wsgi_req->hvec[wsgi_req->var_cnt-1].iov_len, wsgi_req->hvec[wsgi_req->var_cnt-1].iov_base, wsgi_req->hvec[wsgi_req->var_cnt].iov_len, wsgi_req->hvec[wsgi_req->var_cnt].iov_base);
-						if (wsgi_req->var_cnt < uwsgi.vec_size - (4 + 1)) {
-							wsgi_req->var_cnt++;
-						}
-						else {
-							uwsgi_log("max vec size reached. skip this var.\n");
-							return -1;
-						}
+						wsgi_req->var_cnt++;
 						ptrbuf += strsize;
 					}
 					else {
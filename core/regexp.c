@@ -13,6 +13,50 @@ void uwsgi_opt_pcre_jit(char *opt, char *value, void *foobar) {
 #endif
 }
 
+#ifdef PCRE_STUDY_JIT_COMPILE
+/*
+	JIT code runs on its own stack (the default one, 32k on the machine stack, is too small for complex patterns).
+	pcre_exec() never gives control back to another core of the same thread (async, coroutines...),
+	so a stack for each thread (shared by all of the patterns) is enough.
+*/
+#define UWSGI_PCRE_JIT_STACK_START (32 * 1024)
+#define UWSGI_PCRE_JIT_STACK_MAX (1024 * 1024)
+
+static pthread_key_t uwsgi_regexp_jit_stack_key;
+static pthread_once_t uwsgi_regexp_jit_stack_once = PTHREAD_ONCE_INIT;
+
+static void uwsgi_regexp_jit_stack_key_create() {
+	if (pthread_key_create(&uwsgi_regexp_jit_stack_key, NULL)) {
+		uwsgi_error("uwsgi_regexp_jit_stack_key_create()/pthread_key_create()");
+		exit(1);
+	}
+}
+
+static pcre_jit_stack *uwsgi_regexp_jit_stack(void *foobar) {
+	pcre_jit_stack *stack = pthread_getspecific(uwsgi_regexp_jit_stack_key);
+	if (!stack) {
+		stack = pcre_jit_stack_alloc(UWSGI_PCRE_JIT_STACK_START, UWSGI_PCRE_JIT_STACK_MAX);
+		// NULL means "use the machine stack"
+		if (stack) {
+			pthread_setspecific(uwsgi_regexp_jit_stack_key, stack);
+		}
+	}
+	return stack;
+}
+#endif
+
+int uwsgi_regexp_jitted(pcre * pattern, pcre_extra * pattern_extra) {
+#if defined(PCRE_STUDY_JIT_COMPILE) && defined(PCRE_INFO_JIT)
+	int jitted = 0;
+	if (!pattern_extra) return 0;
+	if (pcre_fullinfo((const pcre *) pattern, (const pcre_extra *) pattern_extra, PCRE_INFO_JIT, &jitted))
+		return 0;
+	return jitted;
+#else
+	return 0;
+#endif
+}
+
 int uwsgi_regexp_build(char *re, pcre ** pattern, pcre_extra ** pattern_extra) {
 
 	const char *errstr;
@@ -33,6 +77,18 @@ int uwsgi_regexp_build(char *re, pcre ** pattern, pcre_extra ** pattern_extra) {
 		return -1;
 	}
 
+#ifdef PCRE_STUDY_JIT_COMPILE
+	if (opt) {
+		if (!uwsgi_regexp_jitted(*pattern, *pattern_extra)) {
+			uwsgi_log("pcre jit: unable to compile \"%s\", it will be interpreted\n", re);
+		}
+		else {
+			pthread_once(&uwsgi_regexp_jit_stack_once, uwsgi_regexp_jit_stack_key_create);
+			pcre_assign_jit_stack(*pattern_extra, uwsgi_regexp_jit_stack, NULL);
+		}
+	}
+#endif
+
 	return 0;
 
 }
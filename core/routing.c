@@ -150,6 +150,281 @@ error:
 	return NULL;
 }
 
+/*
+
+	how compiled routing works:
+
+	at fixup time the regexp routes of every chain are grouped by subject (PATH_INFO, REQUEST_URI, HTTP_HOST...)
+	and the literal strings anchored at the start ("^/static/") or at the end ("\.php$") of each regexp
+	are merged in two tries (one for prefixes and one, walked backward, for suffixes).
+
+	At request time, the first route of a subject walks the two tries with the subject value, filling
+	a per-core bitmap of candidate routes. A route not in the bitmap cannot match, so its pcre_exec() is skipped.
+	Routes without an anchored literal (or with an alternation/option we do not understand) are always candidates.
+
+	Routes are still evaluated one by one in order, so first-match, goto and labels behave as before.
+	The bitmap is rebuilt after each action, as actions are allowed to change the subject.
+
+*/
+
+struct uwsgi_route_trie_node {
+	unsigned char c;
+	uint32_t child;
+	uint32_t sibling;
+	// routes whose literal ends at this node
+	uint32_t *ids;
+	uint8_t *exact;
+	uint32_t ids_cnt;
+};
+
+struct uwsgi_route_trie {
+	struct uwsgi_route_trie_node *nodes;
+	uint32_t nodes_cnt;
+};
+
+struct uwsgi_route_matcher {
+	size_t subject;
+	size_t subject_len;
+	uint32_t routes;
+	struct uwsgi_route_trie prefixes;
+	struct uwsgi_route_trie suffixes;
+	// one for each core
+	uint64_t *epoch;
+	uint64_t **candidates;
+	struct uwsgi_route_matcher *next;
+};
+
+// bumped at every routing pass and after every action, one for each core
+static uint64_t *uwsgi_route_epoch;
+
+static void uwsgi_route_trie_add(struct uwsgi_route_trie *trie, char *literal, size_t len, int reverse, uint32_t id, int exact) {
+	if (!trie->nodes) {
+		trie->nodes = uwsgi_calloc(sizeof(struct uwsgi_route_trie_node));
+		trie->nodes_cnt = 1;
+	}
+	uint32_t node = 0;
+	size_t i;
+	for(i=0;i<len;i++) {
+		unsigned char c = (unsigned char) (reverse ? literal[len - 1 - i] : literal[i]);
+		uint32_t child = trie->nodes[node].child;
+		while(child) {
+			if (trie->nodes[child].c == c) break;
+			child = trie->nodes[child].sibling;
+		}
+		if (!child) {
+			trie->nodes = realloc(trie->nodes, sizeof(struct uwsgi_route_trie_node) * (trie->nodes_cnt + 1));
+			if (!trie->nodes) {
+				uwsgi_error("uwsgi_route_trie_add()/realloc()");
+				exit(1);
+			}
+			child = trie->nodes_cnt++;
+			memset(&trie->nodes[child], 0, sizeof(struct uwsgi_route_trie_node));
+			trie->nodes[child].c = c;
+			trie->nodes[child].sibling = trie->nodes[node].child;
+			trie->nodes[node].child = child;
+		}
+		node = child;
+	}
+	struct uwsgi_route_trie_node *utn = &trie->nodes[node];
+	utn->ids = realloc(utn->ids, sizeof(uint32_t) * (utn->ids_cnt + 1));
+	utn->exact = realloc(utn->exact, sizeof(uint8_t) * (utn->ids_cnt + 1));
+	if (!utn->ids || !utn->exact) {
+		uwsgi_error("uwsgi_route_trie_add()/realloc()");
+		exit(1);
+	}
+	utn->ids[utn->ids_cnt] = id;
+	utn->exact[utn->ids_cnt] = exact;
+	utn->ids_cnt++;
+}
+
+static void uwsgi_route_trie_walk(struct uwsgi_route_trie *trie, char *subject, uint16_t subject_len, int reverse, uint64_t *candidates) {
+	if (!trie->nodes) return;
+	uint32_t node = 0;
+	uint16_t i;
+	for(i=0;i<subject_len;i++) {
+		unsigned char c = (unsigned char) (reverse ? subject[subject_len - 1 - i] : subject[i]);
+		uint32_t child = trie->nodes[node].child;
+		while(child) {
+			if (trie->nodes[child].c == c) break;
+			child = trie->nodes[child].sibling;
+		}
+		if (!child) return;
+		node = child;
+		struct uwsgi_route_trie_node *utn = &trie->nodes[node];
+		uint32_t j;
+		for(j=0;j<utn->ids_cnt;j++) {
+			// "^literal$", remember "$" matches before a trailing newline too
+			if (utn->exact[j] && i + 1 != subject_len && !(i + 2 == subject_len && subject[subject_len - 1] == '\n')) continue;
+			candidates[utn->ids[j] / 64] |= (uint64_t) 1 << (utn->ids[j] % 64);
+		}
+	}
+}
+
+static int uwsgi_route_is_candidate(struct uwsgi_route *ur, struct wsgi_request *wsgi_req, char *subject, uint16_t subject_len) {
+	struct uwsgi_route_matcher *urm = ur->matcher;
+	int core = wsgi_req->async_id;
+	uint64_t *candidates = urm->candidates[core];
+	if (urm->epoch[core] != uwsgi_route_epoch[core]) {
+		memset(candidates, 0, sizeof(uint64_t) * ((urm->routes + 63) / 64));
+		uwsgi_route_trie_walk(&urm->prefixes, subject, subject_len, 0, candidates);
+		uwsgi_route_trie_walk(&urm->suffixes, subject, subject_len, 1, candidates);
+		if (subject_len > 0 && subject[subject_len - 1] == '\n') {
+			uwsgi_route_trie_walk(&urm->suffixes, subject, subject_len - 1, 1, candidates);
+		}
+		urm->epoch[core] = uwsgi_route_epoch[core];
+	}
+	return candidates[ur->matcher_id / 64] & ((uint64_t) 1 << (ur->matcher_id % 64)) ? 1 : 0;
+}
+
+static int uwsgi_route_regexp_meta(char c) {
+	return c && strchr("\\^$.|?*+()[]{}", c) != NULL;
+}
+
+// returns 1 if the regexp has a top level alternation or options changing the meaning of anchors and literals
+static int uwsgi_route_regexp_complex(char *re) {
+	int depth = 0;
+	char *p = re;
+	while(*p) {
+		if (*p == '\\') {
+			if (p[1] == 'Q') return 1;
+			if (!p[1]) return 1;
+			p += 2;
+			continue;
+		}
+		if (*p == '[') {
+			p++;
+			if (*p == '^') p++;
+			if (*p == ']') p++;
+			while(*p && *p != ']') {
+				if (*p == '\\' && p[1]) p++;
+				p++;
+			}
+			if (!*p) return 1;
+		}
+		else if (*p == '(') {
+			if (p[1] == '*') return 1;
+			if (p[1] == '?' && (isalpha((int) (unsigned char) p[2]) || p[2] == '-')) return 1;
+			depth++;
+		}
+		else if (*p == ')') {
+			depth--;
+		}
+		else if (*p == '|' && depth <= 0) {
+			return 1;
+		}
+		p++;
+	}
+	return 0;
+}
+
+// the literal following "^" (exact is set for "^literal$")
+static size_t uwsgi_route_regexp_prefix(char *re, char *buf, int *exact) {
+	size_t len = 0;
+	*exact = 0;
+	if (re[0] != '^') return 0;
+	char *p = re + 1;
+	while(*p) {
+		char c = *p;
+		size_t skip = 1;
+		if (c == '\\') {
+			if (!p[1] || isalnum((int) (unsigned char) p[1])) break;
+			c = p[1];
+			skip = 2;
+		}
+		else if (uwsgi_route_regexp_meta(c)) {
+			if (c == '$' && !p[1]) *exact = 1;
+			break;
+		}
+		char q = p[skip];
+		// optional or repeated char
+		if (q == '?' || q == '*' || q == '{') break;
+		buf[len++] = c;
+		p += skip;
+		if (q == '+') break;
+	}
+	return len;
+}
+
+static size_t uwsgi_route_regexp_backslashes(char *re, size_t pos) {
+	size_t n = 0;
+	while(pos > 0 && re[pos - 1] == '\\') {
+		n++;
+		pos--;
+	}
+	return n;
+}
+
+// the literal preceding "$"
+static size_t uwsgi_route_regexp_suffix(char *re, char *buf) {
+	size_t rlen = strlen(re);
+	size_t len = 0;
+	if (rlen < 2 || re[rlen - 1] != '$') return 0;
+	// "\$" is a literal dollar
+	if (uwsgi_route_regexp_backslashes(re, rlen - 1) % 2) return 0;
+	char q = re[rlen - 2];
+	if (q == '?' || q == '*' || q == '+' || q == '}') return 0;
+	ssize_t i = rlen - 2;
+	while(i >= 0) {
+		char c = re[i];
+		size_t b = uwsgi_route_regexp_backslashes(re, i);
+		if (b % 2) {
+			if (isalnum((int) (unsigned char) c)) break;
+			buf[len++] = c;
+			if (b > 1) break;
+			i -= 2;
+			continue;
+		}
+		if (uwsgi_route_regexp_meta(c)) break;
+		buf[len++] = c;
+		if (b) break;
+		i--;
+	}
+	// buf has been filled backward
+	size_t j;
+	for(j=0;j<len/2;j++) {
+		char tmp = buf[j];
+		buf[j] = buf[len - 1 - j];
+		buf[len - 1 - j] = tmp;
+	}
+	return len;
+}
+
+static int uwsgi_route_compile(struct uwsgi_route *ur, struct uwsgi_route_matcher **matchers) {
+	if (uwsgi_route_regexp_complex(ur->orig_route)) return 0;
+
+	char *buf = uwsgi_malloc(strlen(ur->orig_route) + 1);
+	int exact = 0;
+	size_t prefix_len = uwsgi_route_regexp_prefix(ur->orig_route, buf, &exact);
+	int reverse = 0;
+	if (!prefix_len) {
+		prefix_len = uwsgi_route_regexp_suffix(ur->orig_route, buf);
+		reverse = 1;
+	}
+	if (!prefix_len) {
+		free(buf);
+		return 0;
+	}
+
+	struct uwsgi_route_matcher *urm = *matchers;
+	while(urm) {
+		if (urm->subject == ur->subject && urm->subject_len == ur->subject_len) break;
+		urm = urm->next;
+	}
+	if (!urm) {
+		urm = uwsgi_calloc(sizeof(struct uwsgi_route_matcher));
+		urm->subject = ur->subject;
+		urm->subject_len = ur->subject_len;
+		urm->next = *matchers;
+		*matchers = urm;
+	}
+
+	ur->matcher = urm;
+	ur->matcher_id = urm->routes++;
+	uwsgi_route_trie_add(reverse ? &urm->suffixes : &urm->prefixes, buf, prefix_len, reverse, ur->matcher_id, exact);
+	free(buf);
+	return 1;
+}
+
 static void uwsgi_routing_reset_memory(struct wsgi_request *wsgi_req, struct uwsgi_route *routes) {
 	// free dynamic memory structures
 	if (routes->if_func) {
@@ -176,6 +451,8 @@ int uwsgi_apply_routes_do(struct uwsgi_route *routes, struct wsgi_request *wsgi_
 	uint32_t *r_goto = &wsgi_req->route_goto;
 	uint32_t *r_pc = &wsgi_req->route_pc;
 
+	if (uwsgi_route_epoch) uwsgi_route_epoch[wsgi_req->async_id]++;
+
 	if (routes == uwsgi.error_routes) {
 		r_goto = &wsgi_req->error_route_goto;
 		r_pc = &wsgi_req->error_route_pc;
@@ -199,6 +476,9 @@ int uwsgi_apply_routes_do(struct uwsgi_route *routes, struct wsgi_request *wsgi_
 
 		*r_goto = 0;
 
+		uint64_t t0 = 0;
+		if (routes->stats) t0 = uwsgi_nanos();
+
 		if (!routes->if_func) {
 			// could be a "run"
 			if (!routes->subject) {
@@ -211,6 +491,7 @@ int uwsgi_apply_routes_do(struct uwsgi_route *routes, struct wsgi_request *wsgi_
 				subject = *subject2 ;
 				subject_len = *subject_len2;
 			}
+			if (routes->matcher && !uwsgi_route_is_candidate(routes, wsgi_req, subject, subject_len)) goto next;
 			n = uwsgi_regexp_match_ovec(routes->pattern, routes->pattern_extra, subject, subject_len, routes->ovector[wsgi_req->async_id], routes->ovn[wsgi_req->async_id]);
 		}
 		else {
@@ -224,25 +505,38 @@ int uwsgi_apply_routes_do(struct uwsgi_route *routes, struct wsgi_request *wsgi_
 			if (!routes->if_negate) {
 				if (ret == 0) {
 					uwsgi_routing_reset_memory(wsgi_req, routes);
-					goto next;	
+					n = -1;
+				}
+				else {
+					n = ret;
 				}
-				n = ret;
 			}
 			else {
 				if (ret > 0) {
 					uwsgi_routing_reset_memory(wsgi_req, routes);
-					goto next;	
+					n = -1;
+				}
+				else {
+					n = 1;
 				}
-				n = 1;
 			}
 		}
 
 run:
+		if (routes->stats) {
+			struct uwsgi_route_stats *urs = &routes->stats[uwsgi.mywid];
+			__sync_add_and_fetch(&urs->evaluations, 1);
+			if (n >= 0) __sync_add_and_fetch(&urs->matches, 1);
+			if (t0) __sync_add_and_fetch(&urs->ns, uwsgi_nanos() - t0);
+		}
+
 		if (n >= 0) {
 			wsgi_req->is_routing = 1;
 			int ret = routes->func(wsgi_req, routes);
 			uwsgi_routing_reset_memory(wsgi_req, routes);
 			wsgi_req->is_routing = 0;
+			// the action could have changed the subjects
+			if (uwsgi_route_epoch) uwsgi_route_epoch[wsgi_req->async_id]++;
 			if (ret == UWSGI_ROUTE_BREAK) {
 				uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].routed_requests++;
 				return ret;
@@ -497,12 +791,18 @@ done:
 }
 
 void uwsgi_fixup_routes(struct uwsgi_route *ur) {
+	struct uwsgi_route_matcher *matchers = NULL;
+	uint32_t regexps = 0, compiled = 0;
 	while(ur) {
 		// prepare the main pointers
 		ur->ovn = uwsgi_calloc(sizeof(int) * uwsgi.cores);
 		ur->ovector = uwsgi_calloc(sizeof(int *) * uwsgi.cores);
 		ur->condition_ub = uwsgi_calloc( sizeof(struct uwsgi_buffer *) * uwsgi.cores);
 
+		if (uwsgi.routing_stats && !ur->label) {
+			ur->stats = uwsgi_calloc_shared(sizeof(struct uwsgi_route_stats) * (uwsgi.numproc + 1));
+		}
+
 		// fill them if needed... (this is an optimization for route with a static subject)
 		if (ur->subject && ur->subject_len) {
                 	if (uwsgi_regexp_build(ur->orig_route, &ur->pattern, &ur->pattern_extra)) {
@@ -516,9 +816,31 @@ void uwsgi_fixup_routes(struct uwsgi_route *ur) {
                         		ur->ovector[i] = uwsgi_calloc(sizeof(int) * (3 * (ur->ovn[i] + 1)));
                 		}
 			}
+
+			regexps++;
+			compiled += uwsgi_route_compile(ur, &matchers);
 		}
 		ur = ur->next;
         }
+
+	if (!matchers) return;
+
+	if (!uwsgi_route_epoch) {
+		uwsgi_route_epoch = uwsgi_calloc(sizeof(uint64_t) * uwsgi.cores);
+	}
+
+	struct uwsgi_route_matcher *urm = matchers;
+	while(urm) {
+		urm->epoch = uwsgi_calloc(sizeof(uint64_t) * uwsgi.cores);
+		urm->candidates = uwsgi_calloc(sizeof(uint64_t *) * uwsgi.cores);
+		int i;
+		for(i=0;i<uwsgi.cores;i++) {
+			urm->candidates[i] = uwsgi_calloc(sizeof(uint64_t) * ((urm->routes + 63) / 64));
+		}
+		urm = urm->next;
+	}
+
+	uwsgi_log("routing: %u/%u regexp routes indexed by literal anchors\n", compiled, regexps);
 }
 
 int uwsgi_route_api_func(struct wsgi_request *wsgi_req, char *router, char *args) {
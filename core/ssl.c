@@ -47,13 +47,14 @@ int uwsgi_ssl_session_new_cb(SSL *ssl, SSL_SESSION *sess) {
         i2d_SSL_SESSION(sess, &p);
 
         // ok let's write the value to the cache
-        uwsgi_wlock(uwsgi.ssl_sessions_cache->lock);
-        if (uwsgi_cache_set2(uwsgi.ssl_sessions_cache, (char *) sess->session_id, sess->session_id_length, session_blob, len, uwsgi.ssl_sessions_timeout, 0)) {
+        struct uwsgi_cache *ucs = uwsgi_cache_shard(uwsgi.ssl_sessions_cache, (char *) sess->session_id, sess->session_id_length);
+        uwsgi_wlock(ucs->lock);
+        if (uwsgi_cache_set2(ucs, (char *) sess->session_id, sess->session_id_length, session_blob, len, uwsgi.ssl_sessions_timeout, 0)) {
                 if (uwsgi.ssl_verbose) {
                         uwsgi_log("[uwsgi-ssl] unable to store session of size %d in the cache\n", len);
                 }
         }
-        uwsgi_rwunlock(uwsgi.ssl_sessions_cache->lock);
+        uwsgi_rwunlock(ucs->lock);
         return 0;
 }
 
@@ -62,10 +63,11 @@ SSL_SESSION *uwsgi_ssl_session_get_cb(SSL *ssl, unsigned char *key, int keylen,
         uint64_t valsize = 0;
 
         *copy = 0;
-        uwsgi_rlock(uwsgi.ssl_sessions_cache->lock);
-        char *value = uwsgi_cache_get2(uwsgi.ssl_sessions_cache, (char *)key, keylen, &valsize);
+        struct uwsgi_cache *ucs = uwsgi_cache_shard(uwsgi.ssl_sessions_cache, (char *) key, keylen);
+        uwsgi_rlock(ucs->lock);
+        char *value = uwsgi_cache_get2(ucs, (char *)key, keylen, &valsize);
         if (!value) {
-                uwsgi_rwunlock(uwsgi.ssl_sessions_cache->lock);
+                uwsgi_rwunlock(ucs->lock);
                 if (uwsgi.ssl_verbose) {
                         uwsgi_log("[uwsgi-ssl] cache miss\n");
                 }
@@ -76,18 +78,19 @@ SSL_SESSION *uwsgi_ssl_session_get_cb(SSL *ssl, unsigned char *key, int keylen,
 #else
         SSL_SESSION *sess = d2i_SSL_SESSION(NULL, (unsigned char **)&value, valsize);
 #endif
-        uwsgi_rwunlock(uwsgi.ssl_sessions_cache->lock);
+        uwsgi_rwunlock(ucs->lock);
         return sess;
 }
 
 void uwsgi_ssl_session_remove_cb(SSL_CTX *ctx, SSL_SESSION *sess) {
-        uwsgi_wlock(uwsgi.ssl_sessions_cache->lock);
-        if (uwsgi_cache_del2(uwsgi.ssl_sessions_cache, (char *) sess->session_id, sess->session_id_length, 0, 0)) {
+        struct uwsgi_cache *ucs = uwsgi_cache_shard(uwsgi.ssl_sessions_cache, (char *) sess->session_id, sess->session_id_length);
+        uwsgi_wlock(ucs->lock);
+        if (uwsgi_cache_del2(ucs, (char *) sess->session_id, sess->session_id_length, 0, 0)) {
                 if (uwsgi.ssl_verbose) {
                         uwsgi_log("[uwsgi-ssl] error removing cache item\n");
                 }
         }
-        uwsgi_rwunlock(uwsgi.ssl_sessions_cache->lock);
+        uwsgi_rwunlock(ucs->lock);
 }
 
 #ifdef SSL_CTRL_SET_TLSEXT_HOSTNAME
@@ -2,20 +2,19 @@
 
 extern struct uwsgi_server uwsgi;
 
-int uwsgi_static_want_gzip(struct wsgi_request *wsgi_req, char *filename, size_t *filename_len, struct stat *st) {
+// check if a gzip variant of the file should be searched (only the configuration is checked here)
+static int uwsgi_static_gzip_configured(char *filename, size_t filename_len) {
 	// check for filename size
-	if (*filename_len + 4 > PATH_MAX) return 0;
-	// check for supported encodings
-	if (!uwsgi_contains_n(wsgi_req->encoding, wsgi_req->encoding_len, "gzip", 4) ) return 0;
+	if (filename_len + 4 > PATH_MAX) return 0;
 
 	// check for 'all'
-	if (uwsgi.static_gzip_all) goto gzip;
+	if (uwsgi.static_gzip_all) return 1;
 
 	// check for dirs/prefix
 	struct uwsgi_string_list *usl = uwsgi.static_gzip_dir;
 	while(usl) {
-		if (!uwsgi_starts_with(filename, *filename_len, usl->value, usl->len)) {
-			goto gzip;
+		if (!uwsgi_starts_with(filename, filename_len, usl->value, usl->len)) {
+			return 1;
 		}
 		usl = usl->next;
 	} 
@@ -23,8 +22,8 @@ int uwsgi_static_want_gzip(struct wsgi_request *wsgi_req, char *filename, size_t
 	// check for ext/suffix
 	usl = uwsgi.static_gzip_ext;
         while(usl) {
-		if (!uwsgi_strncmp(filename + (*filename_len - usl->len), usl->len, usl->value, usl->len)) {
-			goto gzip;
+		if (!uwsgi_strncmp(filename + (filename_len - usl->len), usl->len, usl->value, usl->len)) {
+			return 1;
 		}
                 usl = usl->next;
         }
@@ -33,15 +32,20 @@ int uwsgi_static_want_gzip(struct wsgi_request *wsgi_req, char *filename, size_t
 	// check for regexp
 	struct uwsgi_regexp_list *url = uwsgi.static_gzip;
 	while(url) {
-		if (uwsgi_regexp_match(url->pattern, url->pattern_extra, filename, *filename_len) >= 0) {
-			goto gzip;
+		if (uwsgi_regexp_match(url->pattern, url->pattern_extra, filename, filename_len) >= 0) {
+			return 1;
 		}
 		url = url->next;
 	}
 #endif
 	return 0;
+}
 
-gzip:
+int uwsgi_static_want_gzip(struct wsgi_request *wsgi_req, char *filename, size_t *filename_len, struct stat *st) {
+	// check for supported encodings
+	if (!uwsgi_contains_n(wsgi_req->encoding, wsgi_req->encoding_len, "gzip", 4) ) return 0;
+
+	if (!uwsgi_static_gzip_configured(filename, *filename_len)) return 0;
 
 	memcpy(filename + *filename_len, ".gz\0", 4);
 	*filename_len += 3;
@@ -168,6 +172,146 @@ static time_t parse_http_date(char *date, uint16_t len) {
 }
 
 
+// strong ETag built from mtime, size and inode (suffix marks variants not backed by their own file)
+static int uwsgi_static_etag(struct stat *st, char *suffix, char *buf, size_t len) {
+	int ret = snprintf(buf, len, "\"%llx-%llx-%llx%s\"", (unsigned long long) st->st_mtime, (unsigned long long) st->st_size, (unsigned long long) st->st_ino, suffix ? suffix : "");
+	if (ret <= 0 || (size_t) ret >= len) return 0;
+	return ret;
+}
+
+// If-None-Match uses the weak comparison function (W/ prefixes are ignored)
+static int uwsgi_static_etag_match(struct wsgi_request *wsgi_req, char *etag, size_t etag_len) {
+	char *ptr = wsgi_req->if_none_match;
+	char *end = ptr + wsgi_req->if_none_match_len;
+	while (ptr < end) {
+		// skip separators
+		if (*ptr == ' ' || *ptr == '\t' || *ptr == ',') {
+			ptr++;
+			continue;
+		}
+		if (*ptr == '*') return 1;
+		if (end - ptr > 2 && !memcmp(ptr, "W/", 2)) ptr += 2;
+		char *comma = memchr(ptr, ',', end - ptr);
+		size_t len = (comma ? comma : end) - ptr;
+		// strip trailing spaces
+		while (len > 0 && (ptr[len - 1] == ' ' || ptr[len - 1] == '\t')) len--;
+		if (!uwsgi_strncmp(ptr, len, etag, etag_len)) return 1;
+		if (!comma) break;
+		ptr = comma + 1;
+	}
+	return 0;
+}
+
+static int uwsgi_static_not_modified(struct wsgi_request *wsgi_req, char *etag, size_t etag_len) {
+	if (uwsgi_response_prepare_headers(wsgi_req, "304 Not Modified", 16))
+		return -1;
+	if (etag_len > 0) {
+		if (uwsgi_response_add_header(wsgi_req, "ETag", 4, etag, etag_len)) return -1;
+	}
+	return uwsgi_response_write_headers_do(wsgi_req);
+}
+
+// check If-None-Match (when an ETag is available) or If-Modified-Since
+static int uwsgi_static_is_modified(struct wsgi_request *wsgi_req, time_t mtime, char *etag, size_t etag_len) {
+	if (etag_len > 0 && wsgi_req->if_none_match_len) {
+		return !uwsgi_static_etag_match(wsgi_req, etag, etag_len);
+	}
+	if (wsgi_req->if_modified_since_len) {
+		time_t ims = parse_http_date(wsgi_req->if_modified_since, wsgi_req->if_modified_since_len);
+		if (mtime <= ims) return 0;
+	}
+	return 1;
+}
+
+#define UWSGI_STATIC_MAX_RANGES 16
+
+// an inclusive byte range
+struct uwsgi_static_range {
+	uint64_t from;
+	uint64_t to;
+};
+
+static int uwsgi_static_range_num(char *buf, size_t len, uint64_t *n) {
+	size_t i;
+	if (len == 0) return -1;
+	*n = 0;
+	for (i = 0; i < len; i++) {
+		if (!isdigit((int) buf[i])) return -1;
+		*n = (*n * 10) + (buf[i] - '0');
+	}
+	return 0;
+}
+
+/*
+	parse a "bytes=" Range header in a list of satisfiable ranges (clamped to the file size),
+	invalid headers or too many ranges return 0 (the Range header is ignored)
+*/
+static int uwsgi_static_parse_ranges(char *buf, uint16_t len, uint64_t size, struct uwsgi_static_range *ranges) {
+	int n = 0;
+	if (len < 6 || memcmp(buf, "bytes=", 6)) return 0;
+	char *ptr = buf + 6;
+	char *end = buf + len;
+	while (ptr < end) {
+		if (*ptr == ' ' || *ptr == '\t' || *ptr == ',') {
+			ptr++;
+			continue;
+		}
+		char *comma = memchr(ptr, ',', end - ptr);
+		size_t tlen = (comma ? comma : end) - ptr;
+		while (tlen > 0 && (ptr[tlen - 1] == ' ' || ptr[tlen - 1] == '\t')) tlen--;
+		char *dash = memchr(ptr, '-', tlen);
+		if (!dash) return 0;
+		uint64_t from = 0, to = 0;
+		// -N (the last N bytes)
+		if (dash == ptr) {
+			if (uwsgi_static_range_num(dash + 1, tlen - 1, &to)) return 0;
+			if (to == 0 || size == 0) goto next;
+			from = to < size ? size - to : 0;
+			to = size - 1;
+		}
+		else {
+			if (uwsgi_static_range_num(ptr, dash - ptr, &from)) return 0;
+			size_t to_len = tlen - ((dash + 1) - ptr);
+			if (to_len == 0) {
+				to = size - 1;
+			}
+			else {
+				if (uwsgi_static_range_num(dash + 1, to_len, &to)) return 0;
+				if (to < from) return 0;
+				if (to >= size) to = size - 1;
+			}
+			// unsatisfiable
+			if (from >= size) goto next;
+		}
+		if (n >= UWSGI_STATIC_MAX_RANGES) return 0;
+		ranges[n].from = from;
+		ranges[n].to = to;
+		n++;
+next:
+		if (!comma) break;
+		ptr = comma + 1;
+	}
+	return n;
+}
+
+// send the multipart/byteranges body (the file descriptor is not closed)
+static int uwsgi_static_send_ranges(struct wsgi_request *wsgi_req, int fd, char *boundary, char *part_headers, struct uwsgi_static_range *ranges, int nranges, uint64_t size) {
+	char buf[512];
+	int i;
+	// the transfers must be ordered with the parts headers
+	wsgi_req->no_offload = 1;
+	for (i = 0; i < nranges; i++) {
+		int ret = snprintf(buf, sizeof(buf), "\r\n--%s\r\n%sContent-Range: bytes %llu-%llu/%llu\r\n\r\n", boundary, part_headers,
+			(unsigned long long) ranges[i].from, (unsigned long long) ranges[i].to, (unsigned long long) size);
+		if (ret <= 0 || ret >= (int) sizeof(buf)) return -1;
+		if (uwsgi_response_write_body_do(wsgi_req, buf, ret) < 0) return -1;
+		if (uwsgi_response_sendfile_do_can_close(wsgi_req, fd, ranges[i].from, (ranges[i].to - ranges[i].from) + 1, 0) < 0) return -1;
+	}
+	int ret = snprintf(buf, sizeof(buf), "\r\n--%s--\r\n", boundary);
+	if (ret <= 0 || ret >= (int) sizeof(buf)) return -1;
+	return uwsgi_response_write_body_do(wsgi_req, buf, ret);
+}
+
 
 int uwsgi_add_expires_type(struct wsgi_request *wsgi_req, char *mime_type, int mime_type_len, struct stat *st) {
 
@@ -436,29 +580,218 @@ static int uwsgi_static_stat(struct wsgi_request *wsgi_req, char *filename, size
 	return -1;
 }
 
-int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, size_t real_filename_len, struct stat *st) {
+/*
+	how the static open file cache works:
 
-	size_t mime_type_size = 0;
-	char http_last_modified[49];
-	int use_gzip = 0;
+	each worker has its own table of --static-open-cache slots (file descriptors cannot be shared
+	between processes), the slot is chosen by hashing the translated filename (docroot + PATH_INFO) so
+	a hit skips realpath(), stat(), the index lookup, the gzip variant probing, the mime type lookup
+	and the open() of the file. The Last-Modified and ETag values are formatted only when the item is created.
 
-	char *mime_type = uwsgi_get_mime_type(real_filename, real_filename_len, &mime_type_size);
+	an item is valid for --static-open-cache-ttl seconds or until the master bumps the shared generation
+	(triggered by the --static-open-cache-monitor filesystem monitors).
 
-	// here we need to choose if we want the gzip variant;
-	if (uwsgi_static_want_gzip(wsgi_req, real_filename, &real_filename_len, st)) use_gzip = 1;
+	cores of the same worker share the table (under lock_static when multithreaded). Items are
+	refcounted as a transfer could be suspended (async modes) while another core invalidates or evicts
+	it: a referenced item is never replaced and its descriptors are closed by the last release.
+*/
 
-	if (wsgi_req->if_modified_since_len) {
-		time_t ims = parse_http_date(wsgi_req->if_modified_since, wsgi_req->if_modified_since_len);
-		if (st->st_mtime <= ims) {
-			if (uwsgi_response_prepare_headers(wsgi_req, "304 Not Modified", 16))
-				return -1;
-			return uwsgi_response_write_headers_do(wsgi_req);
+void uwsgi_static_open_cache_init() {
+	uwsgi.static_open_cache_table = uwsgi_calloc(sizeof(struct uwsgi_static_file) * uwsgi.static_open_cache);
+	uint64_t i;
+	for(i=0;i<uwsgi.static_open_cache;i++) {
+		uwsgi.static_open_cache_table[i].plain.fd = -1;
+		uwsgi.static_open_cache_table[i].gzip.fd = -1;
+	}
+}
+
+// called by the master (fsmon)
+void uwsgi_static_open_cache_invalidate() {
+	__atomic_add_fetch(&uwsgi.shared->static_open_cache_generation, 1, __ATOMIC_RELEASE);
+}
+
+static void uwsgi_static_file_clear(struct uwsgi_static_file *usf) {
+	if (usf->plain.fd > -1) close(usf->plain.fd);
+	if (usf->gzip.fd > -1) close(usf->gzip.fd);
+	usf->plain.fd = -1;
+	usf->gzip.fd = -1;
+	usf->has_gzip = 0;
+	usf->key_len = 0;
+	usf->stale = 0;
+}
+
+static int uwsgi_static_file_variant_open(struct uwsgi_static_file_variant *usfv, char *filename) {
+	usfv->last_modified_len = uwsgi_http_date(usfv->st.st_mtime, usfv->last_modified);
+	if (uwsgi.static_etag) {
+		usfv->etag_len = uwsgi_static_etag(&usfv->st, NULL, usfv->etag, sizeof(usfv->etag));
+	}
+	usfv->fd = -1;
+	// in X-Sendfile/X-Accel-Redirect modes the file is never read by uWSGI
+	if (uwsgi.file_serve_mode) return 0;
+	usfv->fd = open(filename, O_RDONLY);
+	if (usfv->fd < 0) return -1;
+	return 0;
+}
+
+static struct uwsgi_static_file *uwsgi_static_open_cache_get(struct wsgi_request *wsgi_req, char *filename, size_t filename_len) {
+	uint32_t hash = djb33x_hash(filename, filename_len);
+	struct uwsgi_static_file *usf = &uwsgi.static_open_cache_table[hash % uwsgi.static_open_cache];
+	uint64_t generation = __atomic_load_n(&uwsgi.shared->static_open_cache_generation, __ATOMIC_ACQUIRE);
+
+	if (uwsgi.threads > 1)
+		pthread_mutex_lock(&uwsgi.lock_static);
+
+	if (!usf->key_len || usf->stale || usf->hash != hash || usf->key_len != filename_len || memcmp(usf->key, filename, filename_len)) {
+		usf = NULL;
+		goto end;
+	}
+
+	if (usf->generation != generation || uwsgi_now() >= usf->expires) {
+		if (usf->refs > 0) {
+			usf->stale = 1;
+		}
+		else {
+			uwsgi_static_file_clear(usf);
 		}
+		usf = NULL;
+		goto end;
+	}
+
+	usf->refs++;
+end:
+	if (uwsgi.threads > 1)
+		pthread_mutex_unlock(&uwsgi.lock_static);
+
+	if (usf) {
+		uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].static_open_cache_hits++;
+	}
+	else {
+		uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].static_open_cache_misses++;
+	}
+	return usf;
+}
+
+/*
+	fill the slot for filename with the resolved file, if the slot is referenced by another core
+	the item is built in tmp (its descriptors will be closed by uwsgi_static_open_cache_release())
+*/
+static struct uwsgi_static_file *uwsgi_static_open_cache_add(char *filename, size_t filename_len, char *real_filename, size_t real_filename_len, struct stat *st, struct uwsgi_string_list *index, struct uwsgi_static_file *tmp) {
+	uint32_t hash = djb33x_hash(filename, filename_len);
+	struct uwsgi_static_file *usf = &uwsgi.static_open_cache_table[hash % uwsgi.static_open_cache];
+	uint64_t generation = __atomic_load_n(&uwsgi.shared->static_open_cache_generation, __ATOMIC_ACQUIRE);
+
+	memset(tmp, 0, sizeof(struct uwsgi_static_file));
+	tmp->plain.fd = -1;
+	tmp->gzip.fd = -1;
+	tmp->plain.st = *st;
+	if (uwsgi_static_file_variant_open(&tmp->plain, real_filename)) return NULL;
+
+	if (uwsgi_static_gzip_configured(real_filename, real_filename_len)) {
+		memcpy(real_filename + real_filename_len, ".gz\0", 4);
+		if (!stat(real_filename, &tmp->gzip.st) && !uwsgi_static_file_variant_open(&tmp->gzip, real_filename)) {
+			tmp->has_gzip = 1;
+		}
+		real_filename[real_filename_len] = 0;
+	}
+
+	tmp->mime_type = uwsgi_get_mime_type(real_filename, real_filename_len, &tmp->mime_type_len);
+	tmp->index = index;
+	tmp->hash = hash;
+	tmp->generation = generation;
+	tmp->expires = uwsgi_now() + uwsgi.static_open_cache_ttl;
+	tmp->refs = 1;
+
+	if (uwsgi.threads > 1)
+		pthread_mutex_lock(&uwsgi.lock_static);
+
+	if (usf->refs > 0) {
+		if (uwsgi.threads > 1)
+			pthread_mutex_unlock(&uwsgi.lock_static);
+		tmp->stale = 1;
+		return tmp;
+	}
+
+	uwsgi_static_file_clear(usf);
+	if (usf->buf_size < filename_len + 1 + real_filename_len + 1) {
+		free(usf->key);
+		usf->buf_size = filename_len + 1 + real_filename_len + 1;
+		usf->key = uwsgi_malloc(usf->buf_size);
+	}
+	char *key = usf->key;
+	size_t buf_size = usf->buf_size;
+	*usf = *tmp;
+	usf->key = key;
+	usf->buf_size = buf_size;
+	memcpy(usf->key, filename, filename_len);
+	usf->key[filename_len] = 0;
+	usf->key_len = filename_len;
+	usf->real_filename = usf->key + filename_len + 1;
+	memcpy(usf->real_filename, real_filename, real_filename_len + 1);
+	usf->real_filename_len = real_filename_len;
+
+	if (uwsgi.threads > 1)
+		pthread_mutex_unlock(&uwsgi.lock_static);
+	return usf;
+}
+
+static void uwsgi_static_open_cache_release(struct uwsgi_static_file *usf) {
+	if (uwsgi.threads > 1)
+		pthread_mutex_lock(&uwsgi.lock_static);
+	usf->refs--;
+	if (usf->refs == 0 && usf->stale) {
+		uwsgi_static_file_clear(usf);
+	}
+	if (uwsgi.threads > 1)
+		pthread_mutex_unlock(&uwsgi.lock_static);
+}
+
+// if usfv is not NULL the stat, the Last-Modified and ETag values and the file descriptor are taken from it
+static int uwsgi_static_file_do(struct wsgi_request *wsgi_req, char *real_filename, size_t real_filename_len, struct stat *st, char *mime_type, size_t mime_type_size, int use_gzip, struct uwsgi_static_file_variant *usfv) {
+
+	char http_last_modified[49];
+	char *last_modified = http_last_modified;
+	int last_modified_len = 0;
+	char http_etag[64];
+	char *etag = http_etag;
+	int etag_len = 0;
+	struct uwsgi_static_range ranges[UWSGI_STATIC_MAX_RANGES];
+	int nranges = 0;
+	char boundary[33];
+
+	if (usfv) {
+		st = &usfv->st;
+		etag = usfv->etag;
+		etag_len = usfv->etag_len;
+	}
+	else if (uwsgi.static_etag) {
+		etag_len = uwsgi_static_etag(st, NULL, http_etag, sizeof(http_etag));
+	}
+
+	if (!uwsgi_static_is_modified(wsgi_req, st->st_mtime, etag, etag_len)) {
+		return uwsgi_static_not_modified(wsgi_req, etag, etag_len);
 	}
 #ifdef UWSGI_DEBUG
 	uwsgi_log("[uwsgi-fileserve] file %s found\n", real_filename);
 #endif
 
+	if (usfv) {
+		last_modified = usfv->last_modified;
+		last_modified_len = usfv->last_modified_len;
+	}
+	else {
+		last_modified_len = uwsgi_http_date(st->st_mtime, http_last_modified);
+	}
+
+	// multiple ranges are managed only in raw mode (a single range follows the classic path)
+	if (!uwsgi.file_serve_mode && wsgi_req->range_len) {
+		nranges = uwsgi_static_parse_ranges(wsgi_req->range, wsgi_req->range_len, st->st_size, ranges);
+		// the parts headers are body for the transformations, while the file segments are not: send the whole file
+		if (nranges > 1 && wsgi_req->transformations) {
+			nranges = 0;
+			wsgi_req->range_from = 0;
+			wsgi_req->range_to = 0;
+		}
+	}
 
 	size_t fsize = st->st_size;
         if (wsgi_req->range_to) {
@@ -479,7 +812,7 @@ int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, si
 	}
 
 	// HTTP status
-	if (fsize > 0 && (wsgi_req->range_from || wsgi_req->range_to)) {
+	if (nranges > 1 || (fsize > 0 && (wsgi_req->range_from || wsgi_req->range_to))) {
 		if (uwsgi_response_prepare_headers(wsgi_req, "206 Partial Content", 19)) return -1;
 	}
 	else {
@@ -496,13 +829,26 @@ int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, si
 		if (uwsgi_response_add_header(wsgi_req, "Content-Encoding", 16, "gzip", 4)) return -1;
 	}
 
+	if (nranges > 1) {
+		char content_type[64];
+		snprintf(boundary, sizeof(boundary), "%016llx%016llx", (unsigned long long) uwsgi_micros(), (unsigned long long) st->st_ino);
+		int ret = snprintf(content_type, sizeof(content_type), "multipart/byteranges; boundary=%s", boundary);
+		if (uwsgi_response_add_content_type(wsgi_req, content_type, ret)) return -1;
+		if (mime_type_size > 0 && mime_type) {
+			uwsgi_add_expires_type(wsgi_req, mime_type, mime_type_size, st);
+		}
+	}
 	// Content-Type (if available)
-	if (mime_type_size > 0 && mime_type) {
+	else if (mime_type_size > 0 && mime_type) {
 		if (uwsgi_response_add_content_type(wsgi_req, mime_type, mime_type_size)) return -1;
 		// check for content-type related headers
 		uwsgi_add_expires_type(wsgi_req, mime_type, mime_type_size, st);
 	}
 
+	if (etag_len > 0) {
+		if (uwsgi_response_add_header(wsgi_req, "ETag", 4, etag, etag_len)) return -1;
+	}
+
 	// increase static requests counter
 	uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].static_requests++;
 
@@ -510,15 +856,52 @@ int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, si
 	if (uwsgi.file_serve_mode == 1) {
 		if (uwsgi_response_add_header(wsgi_req, "X-Accel-Redirect", 16, real_filename, real_filename_len)) return -1;
 		// this is the final header (\r\n added)
-		int size = uwsgi_http_date(st->st_mtime, http_last_modified);
-		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, http_last_modified, size)) return -1;
+		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, last_modified, last_modified_len)) return -1;
 	}
 	// apache
 	else if (uwsgi.file_serve_mode == 2) {
 		if (uwsgi_response_add_header(wsgi_req, "X-Sendfile", 10, real_filename, real_filename_len)) return -1;
 		// this is the final header (\r\n added)
-		int size = uwsgi_http_date(st->st_mtime, http_last_modified);
-		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, http_last_modified, size)) return -1;
+		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, last_modified, last_modified_len)) return -1;
+	}
+	// multiple ranges
+	else if (nranges > 1) {
+		char part_headers[256];
+		int part_headers_len = 0;
+		if (mime_type_size > 0 && mime_type) {
+			part_headers_len = snprintf(part_headers, sizeof(part_headers), "Content-Type: %.*s\r\n", (int) mime_type_size, mime_type);
+			if (part_headers_len <= 0 || part_headers_len >= (int) sizeof(part_headers)) return -1;
+		}
+		part_headers[part_headers_len] = 0;
+
+		// compute the size of the multipart body
+		uint64_t cl = 0;
+		int i;
+		for (i = 0; i < nranges; i++) {
+			char tmp[sizeof(UMAX64_STR) * 3 + 4];
+			int ret = snprintf(tmp, sizeof(tmp), "%llu-%llu/%llu", (unsigned long long) ranges[i].from, (unsigned long long) ranges[i].to, (unsigned long long) st->st_size);
+			// \r\n--boundary\r\n + part headers + Content-Range: bytes + range + \r\n\r\n + data
+			cl += 2 + 2 + strlen(boundary) + 2 + part_headers_len + 21 + ret + 4 + (ranges[i].to - ranges[i].from) + 1;
+		}
+		// \r\n--boundary--\r\n
+		cl += 2 + 2 + strlen(boundary) + 2 + 2;
+
+		if (uwsgi_response_add_content_length(wsgi_req, cl)) return -1;
+		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, last_modified, last_modified_len)) return -1;
+
+		// if it is a HEAD request just skip transfer
+		if (!uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "HEAD", 4)) {
+			return 0;
+		}
+
+		if (usfv) {
+			return uwsgi_static_send_ranges(wsgi_req, usfv->fd, boundary, part_headers, ranges, nranges, st->st_size);
+		}
+		int fd = open(real_filename, O_RDONLY);
+		if (fd < 0) return -1;
+		int ret = uwsgi_static_send_ranges(wsgi_req, fd, boundary, part_headers, ranges, nranges, st->st_size);
+		close(fd);
+		return ret;
 	}
 	// raw
 	else {
@@ -528,8 +911,7 @@ int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, si
 			// here use the original size !!!
 			if (uwsgi_response_add_content_range(wsgi_req, wsgi_req->range_from, wsgi_req->range_to, st->st_size)) return -1;
 		}
-		int size = uwsgi_http_date(st->st_mtime, http_last_modified);
-		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, http_last_modified, size)) return -1;
+		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, last_modified, last_modified_len)) return -1;
 
 		// if it is a HEAD request just skip transfer
 		if (!uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "HEAD", 4)) {
@@ -539,16 +921,407 @@ int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, si
 
 		// Ok, the file must be transferred from uWSGI
 		// offloading will be automatically managed
-		int fd = open(real_filename, O_RDONLY);
-		if (fd < 0) return -1;
-		// fd will be closed in the following function
-		uwsgi_response_sendfile_do(wsgi_req, fd, wsgi_req->range_from, fsize);
+		if (usfv) {
+			// the cached descriptor is never closed (it is dup()'ed when offloading)
+			uwsgi_response_sendfile_do_can_close(wsgi_req, usfv->fd, wsgi_req->range_from, fsize, 0);
+		}
+		else {
+			int fd = open(real_filename, O_RDONLY);
+			if (fd < 0) return -1;
+			// fd will be closed in the following function
+			uwsgi_response_sendfile_do(wsgi_req, fd, wsgi_req->range_from, fsize);
+		}
 	}
 
 	wsgi_req->status = 200;
 	return 0;
 }
 
+int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, size_t real_filename_len, struct stat *st) {
+
+	size_t mime_type_size = 0;
+	int use_gzip = 0;
+
+	char *mime_type = uwsgi_get_mime_type(real_filename, real_filename_len, &mime_type_size);
+
+	// here we need to choose if we want the gzip variant;
+	if (uwsgi_static_want_gzip(wsgi_req, real_filename, &real_filename_len, st)) use_gzip = 1;
+
+	return uwsgi_static_file_do(wsgi_req, real_filename, real_filename_len, st, mime_type, mime_type_size, use_gzip, NULL);
+}
+
+// serve a file from the static open file cache
+static int uwsgi_static_file_serve_cached(struct wsgi_request *wsgi_req, struct uwsgi_static_file *usf, char *real_filename, size_t real_filename_len) {
+	if (usf->has_gzip && uwsgi_contains_n(wsgi_req->encoding, wsgi_req->encoding_len, "gzip", 4)) {
+		memcpy(real_filename + real_filename_len, ".gz\0", 4);
+		return uwsgi_static_file_do(wsgi_req, real_filename, real_filename_len + 3, NULL, usf->mime_type, usf->mime_type_len, 1, &usf->gzip);
+	}
+	return uwsgi_static_file_do(wsgi_req, real_filename, real_filename_len, NULL, usf->mime_type, usf->mime_type_len, 0, &usf->plain);
+}
+
+
+/*
+	how the static store works:
+
+	the files of the --static-store directories (up to --static-store-max-file bytes) are loaded
+	by the master in a single shared memory area (mapped before fork(), so every worker sees the same
+	pages at the same address). Each file is indexed by the hash of its resolved path and carries up
+	to three bodies (identity, gzip and brotli) each one with its preformatted response headers.
+
+	the gzip variant is taken from the .gz file on disk or (when zlib is available) compressed at load
+	time, the brotli variant is loaded only from a .br file on disk.
+
+	a stored file is sent with the prebuilt headers and the body in a single writev(). Range requests
+	are left to the disk path.
+
+	a SIGHUP rebuilds the store (the whole instance is reloaded) while a change in one of the scanned
+	directories makes the master build a new area and reload the workers. As changes come in bursts
+	(a deploy copies a lot of files) the rebuild waits for UWSGI_STATIC_STORE_SETTLE milliseconds
+	without changes, so a burst costs a single rebuild and a single reload.
+*/
+
+#define UWSGI_STATIC_STORE_SETTLE 1000
+
+// a file loaded from disk, waiting for the shared area to be built
+struct uwsgi_static_store_file {
+	char *path;
+	size_t path_len;
+	time_t mtime;
+	char *mime_type;
+	size_t mime_type_len;
+	struct uwsgi_buffer *bodies[3];
+	char etags[3][64];
+	int etags_len[3];
+	struct uwsgi_static_store_file *next;
+};
+
+static char *uwsgi_static_store_encodings[] = { NULL, "gzip", "br" };
+
+static int uwsgi_static_store_has_variant(char *path, char *ext) {
+	struct stat st;
+	char *variant = uwsgi_concat2(path, ext);
+	int ret = !stat(variant, &st) && S_ISREG(st.st_mode);
+	free(variant);
+	return ret;
+}
+
+static void uwsgi_static_store_load_variant(struct uwsgi_static_store_file *ussf, char *path, char *ext, int id) {
+	char *variant = uwsgi_concat2(path, ext);
+	struct stat st;
+	if (!stat(variant, &st) && S_ISREG(st.st_mode) && (uint64_t) st.st_size <= uwsgi.static_store_max_file) {
+		ussf->bodies[id] = uwsgi_buffer_from_file(variant);
+		if (ussf->bodies[id] && uwsgi.static_etag) {
+			ussf->etags_len[id] = uwsgi_static_etag(&st, NULL, ussf->etags[id], sizeof(ussf->etags[id]));
+		}
+	}
+	free(variant);
+}
+
+static void uwsgi_static_store_scan(char *dir, struct uwsgi_static_store_file **files, int monitor) {
+	DIR *d = opendir(dir);
+	if (!d) {
+		uwsgi_error_open(dir);
+		return;
+	}
+
+	if (monitor) {
+		uwsgi_string_new_list(&uwsgi.static_store_monitored, uwsgi_str(dir));
+	}
+
+	struct dirent *de;
+	while ((de = readdir(d)) != NULL) {
+		// skip hidden files (and . and ..)
+		if (de->d_name[0] == '.') continue;
+		char *path = uwsgi_concat3(dir, "/", de->d_name);
+		struct stat st;
+		if (stat(path, &st)) goto next;
+
+		if (S_ISDIR(st.st_mode)) {
+			uwsgi_static_store_scan(path, files, monitor);
+			goto next;
+		}
+
+		if (!S_ISREG(st.st_mode) || (uint64_t) st.st_size > uwsgi.static_store_max_file) goto next;
+
+		// .gz and .br files are loaded as variants of the original file (if it exists)
+		size_t path_len = strlen(path);
+		if (path_len > 3 && (!strcmp(path + path_len - 3, ".gz") || !strcmp(path + path_len - 3, ".br"))) {
+			path[path_len - 3] = 0;
+			int is_variant = uwsgi_static_store_has_variant(path, "");
+			path[path_len - 3] = '.';
+			if (is_variant) goto next;
+		}
+
+		char real_path[PATH_MAX + 1];
+		if (!realpath(path, real_path)) goto next;
+
+		struct uwsgi_static_store_file *ussf = uwsgi_calloc(sizeof(struct uwsgi_static_store_file));
+		ussf->bodies[UWSGI_STATIC_STORE_IDENTITY] = uwsgi_buffer_from_file(path);
+		if (!ussf->bodies[UWSGI_STATIC_STORE_IDENTITY]) {
+			uwsgi_error_open(path);
+			free(ussf);
+			goto next;
+		}
+		ussf->path = uwsgi_str(real_path);
+		ussf->path_len = strlen(real_path);
+		ussf->mtime = st.st_mtime;
+		ussf->mime_type = uwsgi_get_mime_type(ussf->path, ussf->path_len, &ussf->mime_type_len);
+		if (uwsgi.static_etag) {
+			ussf->etags_len[UWSGI_STATIC_STORE_IDENTITY] = uwsgi_static_etag(&st, NULL, ussf->etags[UWSGI_STATIC_STORE_IDENTITY], sizeof(ussf->etags[0]));
+		}
+
+		uwsgi_static_store_load_variant(ussf, path, ".gz", UWSGI_STATIC_STORE_GZIP);
+#ifdef UWSGI_ZLIB
+		if (!ussf->bodies[UWSGI_STATIC_STORE_GZIP] && ussf->bodies[UWSGI_STATIC_STORE_IDENTITY]->pos > 0) {
+			struct uwsgi_buffer *ub = ussf->bodies[UWSGI_STATIC_STORE_IDENTITY];
+			struct uwsgi_buffer *gz = uwsgi_gzip(ub->buf, ub->pos);
+			// keep the compressed body only if it saves at least 1/8 of the size
+			if (gz && gz->pos < ub->pos - (ub->pos / 8)) {
+				ussf->bodies[UWSGI_STATIC_STORE_GZIP] = gz;
+				if (uwsgi.static_etag) {
+					// the compressed body has no file of its own
+					ussf->etags_len[UWSGI_STATIC_STORE_GZIP] = uwsgi_static_etag(&st, "-gz", ussf->etags[UWSGI_STATIC_STORE_GZIP], sizeof(ussf->etags[0]));
+				}
+			}
+			else if (gz) {
+				uwsgi_buffer_destroy(gz);
+			}
+		}
+#endif
+		uwsgi_static_store_load_variant(ussf, path, ".br", UWSGI_STATIC_STORE_BR);
+
+		ussf->next = *files;
+		*files = ussf;
+next:
+		free(path);
+	}
+
+	closedir(d);
+}
+
+static size_t uwsgi_static_store_headers(struct uwsgi_static_store_file *ussf, int variant, char *buf, size_t len, int *cnt) {
+	char last_modified[31];
+	int last_modified_len = uwsgi_http_date(ussf->mtime, last_modified);
+	char *encoding = uwsgi_static_store_encodings[variant];
+	*cnt = 2;
+
+	int ret = 0;
+	if (ussf->mime_type) {
+		ret = snprintf(buf, len, "Content-Type: %.*s\r\n", (int) ussf->mime_type_len, ussf->mime_type);
+		if (ret <= 0 || (size_t) ret >= len) return 0;
+		*cnt = 3;
+	}
+
+	int ret2 = snprintf(buf + ret, len - ret, "Content-Length: %llu\r\nLast-Modified: %.*s\r\n", (unsigned long long) ussf->bodies[variant]->pos, last_modified_len, last_modified);
+	if (ret2 <= 0 || (size_t) (ret + ret2) >= len) return 0;
+	ret += ret2;
+
+	if (encoding) {
+		ret2 = snprintf(buf + ret, len - ret, "Content-Encoding: %s\r\n", encoding);
+		if (ret2 <= 0 || (size_t) (ret + ret2) >= len) return 0;
+		ret += ret2;
+		(*cnt)++;
+	}
+
+	if (ussf->etags_len[variant] > 0) {
+		ret2 = snprintf(buf + ret, len - ret, "ETag: %.*s\r\n", ussf->etags_len[variant], ussf->etags[variant]);
+		if (ret2 <= 0 || (size_t) (ret + ret2) >= len) return 0;
+		ret += ret2;
+		(*cnt)++;
+	}
+
+	return ret;
+}
+
+static struct uwsgi_static_store *uwsgi_static_store_build(int monitor) {
+	struct uwsgi_static_store_file *files = NULL, *ussf;
+	struct uwsgi_string_list *usl;
+	char headers[512];
+	int cnt;
+	int i;
+
+	uwsgi_foreach(usl, uwsgi.static_store) {
+		char *dir = uwsgi_expand_path(usl->value, usl->len, NULL);
+		if (!dir) {
+			uwsgi_log("[uwsgi-static] unable to find static store directory %s\n", usl->value);
+			continue;
+		}
+		uwsgi_static_store_scan(dir, &files, monitor);
+		free(dir);
+	}
+
+	// compute the size of the area
+	uint64_t items = 0;
+	uint64_t buckets = 1;
+	size_t data_size = 0;
+	for (ussf = files; ussf; ussf = ussf->next) {
+		items++;
+		data_size += ussf->path_len + 1;
+		for (i = 0; i < 3; i++) {
+			if (!ussf->bodies[i]) continue;
+			data_size += uwsgi_static_store_headers(ussf, i, headers, sizeof(headers), &cnt) + ussf->etags_len[i] + ussf->bodies[i]->pos;
+		}
+	}
+	while (buckets < items) buckets <<= 1;
+
+	size_t size = sizeof(struct uwsgi_static_store) + (sizeof(struct uwsgi_static_store_item *) * buckets) + (sizeof(struct uwsgi_static_store_item) * items) + data_size;
+	struct uwsgi_static_store *uss = uwsgi_calloc_shared(size);
+	uss->size = size;
+	uss->items = items;
+	uss->buckets = buckets;
+	uss->table = (struct uwsgi_static_store_item **) (((char *) uss) + sizeof(struct uwsgi_static_store));
+	struct uwsgi_static_store_item *ussi = (struct uwsgi_static_store_item *) (((char *) uss->table) + (sizeof(struct uwsgi_static_store_item *) * buckets));
+	char *data = (char *) (ussi + items);
+
+	ussf = files;
+	while (ussf) {
+		ussi->path = data;
+		memcpy(data, ussf->path, ussf->path_len + 1);
+		data += ussf->path_len + 1;
+		ussi->path_len = ussf->path_len;
+		ussi->hash = djb33x_hash(ussi->path, ussi->path_len);
+		ussi->mtime = ussf->mtime;
+		ussi->mime_type = ussf->mime_type;
+		ussi->mime_type_len = ussf->mime_type_len;
+		for (i = 0; i < 3; i++) {
+			struct uwsgi_buffer *ub = ussf->bodies[i];
+			if (!ub) continue;
+			struct uwsgi_static_store_variant *ussv = &ussi->variants[i];
+			ussv->headers_len = uwsgi_static_store_headers(ussf, i, headers, sizeof(headers), &ussv->headers_cnt);
+			ussv->headers = data;
+			memcpy(data, headers, ussv->headers_len);
+			data += ussv->headers_len;
+			ussv->etag = data;
+			ussv->etag_len = ussf->etags_len[i];
+			memcpy(data, ussf->etags[i], ussv->etag_len);
+			data += ussv->etag_len;
+			ussv->body = data;
+			ussv->len = ub->pos;
+			if (ub->pos > 0) memcpy(data, ub->buf, ub->pos);
+			data += ub->pos;
+			uss->bytes += ub->pos;
+			uwsgi_buffer_destroy(ub);
+		}
+		ussi->next = uss->table[ussi->hash & (buckets - 1)];
+		uss->table[ussi->hash & (buckets - 1)] = ussi;
+		ussi++;
+
+		struct uwsgi_static_store_file *old_ussf = ussf;
+		ussf = ussf->next;
+		free(old_ussf->path);
+		free(old_ussf);
+	}
+
+	uwsgi_log("[uwsgi-static] stored %llu files (%llu bytes) in memory\n", (unsigned long long) uss->items, (unsigned long long) uss->bytes);
+	return uss;
+}
+
+void uwsgi_static_store_init() {
+	uwsgi.static_store_arena = uwsgi_static_store_build(1);
+}
+
+// called by the master (fsmon): the new area is inherited by the respawned workers
+void uwsgi_static_store_reload() {
+	struct uwsgi_static_store *old_uss = uwsgi.static_store_arena;
+	uwsgi_log_verbose("[uwsgi-static] reloading static store...\n");
+	uwsgi.static_store_arena = uwsgi_static_store_build(0);
+	// the running workers have their own mapping of the old area
+	munmap(old_uss, old_uss->size);
+	uwsgi_reload_workers();
+}
+
+// called by the master (fsmon): every change postpones the rebuild
+void uwsgi_static_store_schedule_reload() {
+	uwsgi.static_store_reload_at = uwsgi_micros() + (UWSGI_STATIC_STORE_SETTLE * 1000);
+}
+
+// called by the master before waiting for events: rebuilds the store when due, returns the milliseconds to wait for it (-1 if none is scheduled)
+int uwsgi_static_store_reload_due() {
+	if (!uwsgi.static_store_reload_at) return -1;
+	uint64_t now = uwsgi_micros();
+	if (now >= uwsgi.static_store_reload_at) {
+		uwsgi.static_store_reload_at = 0;
+		uwsgi_static_store_reload();
+		return -1;
+	}
+	return ((uwsgi.static_store_reload_at - now) + 999) / 1000;
+}
+
+static struct uwsgi_static_store_item *uwsgi_static_store_get(char *path, size_t path_len) {
+	struct uwsgi_static_store *uss = uwsgi.static_store_arena;
+	uint32_t hash = djb33x_hash(path, path_len);
+	struct uwsgi_static_store_item *ussi = uss->table[hash & (uss->buckets - 1)];
+	while (ussi) {
+		if (ussi->hash == hash && !uwsgi_strncmp(ussi->path, ussi->path_len, path, path_len)) {
+			return ussi;
+		}
+		ussi = ussi->next;
+	}
+	return NULL;
+}
+
+static int uwsgi_static_store_serve(struct wsgi_request *wsgi_req, struct uwsgi_static_store_item *ussi) {
+
+	struct uwsgi_static_store_variant *ussv = &ussi->variants[UWSGI_STATIC_STORE_IDENTITY];
+	if (ussi->variants[UWSGI_STATIC_STORE_BR].headers && uwsgi_contains_n(wsgi_req->encoding, wsgi_req->encoding_len, "br", 2)) {
+		ussv = &ussi->variants[UWSGI_STATIC_STORE_BR];
+	}
+	else if (ussi->variants[UWSGI_STATIC_STORE_GZIP].headers && uwsgi_contains_n(wsgi_req->encoding, wsgi_req->encoding_len, "gzip", 4)) {
+		ussv = &ussi->variants[UWSGI_STATIC_STORE_GZIP];
+	}
+
+	if (!uwsgi_static_is_modified(wsgi_req, ussi->mtime, ussv->etag, ussv->etag_len)) {
+		return uwsgi_static_not_modified(wsgi_req, ussv->etag, ussv->etag_len);
+	}
+
+	if (uwsgi_response_prepare_headers(wsgi_req, "200 OK", 6)) return -1;
+
+	// the Expires helpers only need the mtime
+	struct stat st;
+	memset(&st, 0, sizeof(struct stat));
+	st.st_mtime = ussi->mtime;
+
+#ifdef UWSGI_PCRE
+	uwsgi_add_expires(wsgi_req, ussi->path, ussi->path_len, &st);
+	uwsgi_add_expires_path_info(wsgi_req, &st);
+	uwsgi_add_expires_uri(wsgi_req, &st);
+#endif
+	if (ussi->mime_type) {
+		uwsgi_add_expires_type(wsgi_req, ussi->mime_type, ussi->mime_type_len, &st);
+	}
+
+	// headers could be collected or removed, add them one by one
+	if (uwsgi.collect_headers || uwsgi.remove_headers || wsgi_req->remove_headers) {
+		char *line = ussv->headers;
+		char *end = ussv->headers + ussv->headers_len;
+		while (line < end) {
+			char *colon = memchr(line, ':', end - line);
+			char *crlf = memchr(line, '\r', end - line);
+			if (!colon || !crlf || colon > crlf) return -1;
+			if (uwsgi_response_add_header(wsgi_req, line, colon - line, colon + 2, crlf - (colon + 2))) return -1;
+			line = crlf + 2;
+		}
+	}
+	else {
+		if (uwsgi_buffer_append(wsgi_req->headers, ussv->headers, ussv->headers_len)) {
+			wsgi_req->write_errors++;
+			return -1;
+		}
+		wsgi_req->header_cnt += ussv->headers_cnt;
+	}
+
+	// increase static requests counter
+	uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].static_requests++;
+	wsgi_req->status = 200;
+
+	// if it is a HEAD request just skip transfer
+	if (!uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "HEAD", 4)) {
+		return 0;
+	}
+
+	// headers and body are sent with a single writev()
+	return uwsgi_response_write_body_do(wsgi_req, ussv->body, ussv->len);
+}
 
 int uwsgi_file_serve(struct wsgi_request *wsgi_req, char *document_root, uint16_t document_root_len, char *path_info, uint16_t path_info_len, int is_a_file) {
 
@@ -557,8 +1330,14 @@ int uwsgi_file_serve(struct wsgi_request *wsgi_req, char *document_root, uint16_
 	size_t real_filename_len = 0;
 	char *filename = NULL;
 	size_t filename_len = 0;
+	int ret = -1;
 
 	struct uwsgi_string_list *index = NULL;
+	struct uwsgi_static_file *usf = NULL;
+	struct uwsgi_static_file tmp_usf;
+	struct uwsgi_static_store_item *ussi = NULL;
+	// range requests are never served from the static store
+	int use_store = uwsgi.static_store_arena && !wsgi_req->range_len;
 
 	if (!is_a_file) {
 		filename = uwsgi_concat3n(document_root, document_root_len, "/", 1, path_info, path_info_len);
@@ -573,18 +1352,37 @@ int uwsgi_file_serve(struct wsgi_request *wsgi_req, char *document_root, uint16_
 	uwsgi_log("[uwsgi-fileserve] checking for %s\n", filename);
 #endif
 
+	if (use_store) {
+		ussi = uwsgi_static_store_get(filename, filename_len);
+		if (ussi) {
+			memcpy(real_filename, ussi->path, ussi->path_len + 1);
+			real_filename_len = ussi->path_len;
+			goto found;
+		}
+	}
+
+	if (uwsgi.static_open_cache_table) {
+		usf = uwsgi_static_open_cache_get(wsgi_req, filename, filename_len);
+		if (usf) {
+			memcpy(real_filename, usf->real_filename, usf->real_filename_len + 1);
+			real_filename_len = usf->real_filename_len;
+			goto found;
+		}
+	}
+
 	if (uwsgi.static_cache_paths) {
-		uwsgi_rlock(uwsgi.static_cache_paths->lock);
+		struct uwsgi_cache *ucs = uwsgi_cache_shard(uwsgi.static_cache_paths, filename, filename_len);
+		uwsgi_rlock(ucs->lock);
 		uint64_t item_len;
-		char *item = uwsgi_cache_get2(uwsgi.static_cache_paths, filename, filename_len, &item_len);
+		char *item = uwsgi_cache_get2(ucs, filename, filename_len, &item_len);
 		if (item && item_len > 0 && item_len <= PATH_MAX) {
 			memcpy(real_filename, item, item_len);
 			real_filename_len = item_len;
 			real_filename[real_filename_len] = 0;
-			uwsgi_rwunlock(uwsgi.static_cache_paths->lock);
+			uwsgi_rwunlock(ucs->lock);
 			goto found;
 		}
-		uwsgi_rwunlock(uwsgi.static_cache_paths->lock);
+		uwsgi_rwunlock(ucs->lock);
 	}
 
 	if (!realpath(filename, real_filename)) {
@@ -597,13 +1395,13 @@ int uwsgi_file_serve(struct wsgi_request *wsgi_req, char *document_root, uint16_
 	real_filename_len = strlen(real_filename);
 
 	if (uwsgi.static_cache_paths) {
-		uwsgi_wlock(uwsgi.static_cache_paths->lock);
-		uwsgi_cache_set2(uwsgi.static_cache_paths, filename, filename_len, real_filename, real_filename_len, uwsgi.use_static_cache_paths, UWSGI_CACHE_FLAG_UPDATE);
-		uwsgi_rwunlock(uwsgi.static_cache_paths->lock);
+		struct uwsgi_cache *ucs = uwsgi_cache_shard(uwsgi.static_cache_paths, filename, filename_len);
+		uwsgi_wlock(ucs->lock);
+		uwsgi_cache_set2(ucs, filename, filename_len, real_filename, real_filename_len, uwsgi.use_static_cache_paths, UWSGI_CACHE_FLAG_UPDATE);
+		uwsgi_rwunlock(ucs->lock);
 	}
 
 found:
-	free(filename);
 
 	if (uwsgi_starts_with(real_filename, real_filename_len, document_root, document_root_len)) {
 		struct uwsgi_string_list *safe = uwsgi.static_safe;
@@ -614,47 +1412,69 @@ found:
 			safe = safe->next;
 		}
 		uwsgi_log("[uwsgi-fileserve] security error: %s is not under %.*s or a safe path\n", real_filename, document_root_len, document_root);
-		return -1;
+		goto end;
 	}
 
 safe:
 
-	if (!uwsgi_static_stat(wsgi_req, real_filename, &real_filename_len, &st, &index)) {
+	if (usf) {
+		index = usf->index;
+	}
+	else if (!ussi) {
+		if (uwsgi_static_stat(wsgi_req, real_filename, &real_filename_len, &st, &index)) goto end;
+		// the resolved file could be in the static store
+		if (use_store) {
+			ussi = uwsgi_static_store_get(real_filename, real_filename_len);
+		}
+		if (!ussi && uwsgi.static_open_cache_table) {
+			usf = uwsgi_static_open_cache_add(filename, filename_len, real_filename, real_filename_len, &st, index, &tmp_usf);
+		}
+	}
 
-		if (index) {
-			// if we are here the PATH_INFO need to be changed
-			if (uwsgi_req_append_path_info_with_index(wsgi_req, index->value, index->len)) {
-                        	return -1;
-                        }
+	if (index) {
+		// if we are here the PATH_INFO need to be changed
+		if (uwsgi_req_append_path_info_with_index(wsgi_req, index->value, index->len)) {
+			goto end;
 		}
+	}
 
-		// skip methods other than GET and HEAD
-        	if (uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "GET", 3) && uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "HEAD", 4)) {
-			return -1;
-        	}
+	// skip methods other than GET and HEAD
+	if (uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "GET", 3) && uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "HEAD", 4)) {
+		goto end;
+	}
 
-		// check for skippable ext
-		struct uwsgi_string_list *sse = uwsgi.static_skip_ext;
-		while (sse) {
-			if (real_filename_len >= sse->len) {
-				if (!uwsgi_strncmp(real_filename + (real_filename_len - sse->len), sse->len, sse->value, sse->len)) {
-					return -1;
-				}
+	// check for skippable ext
+	struct uwsgi_string_list *sse = uwsgi.static_skip_ext;
+	while (sse) {
+		if (real_filename_len >= sse->len) {
+			if (!uwsgi_strncmp(real_filename + (real_filename_len - sse->len), sse->len, sse->value, sse->len)) {
+				goto end;
 			}
-			sse = sse->next;
 		}
+		sse = sse->next;
+	}
 
 #ifdef UWSGI_ROUTING
-		// before sending the file, we need to check if some rule applies
-		if (!wsgi_req->is_routing && uwsgi_apply_routes_do(uwsgi.routes, wsgi_req, NULL, 0) == UWSGI_ROUTE_BREAK) {
-			return 0;
-		}
-		wsgi_req->routes_applied = 1;
+	// before sending the file, we need to check if some rule applies
+	if (!wsgi_req->is_routing && uwsgi_apply_routes_do(uwsgi.routes, wsgi_req, NULL, 0) == UWSGI_ROUTE_BREAK) {
+		ret = 0;
+		goto end;
+	}
+	wsgi_req->routes_applied = 1;
 #endif
 
-		return uwsgi_real_file_serve(wsgi_req, real_filename, real_filename_len, &st);
+	if (ussi) {
+		ret = uwsgi_static_store_serve(wsgi_req, ussi);
+	}
+	else if (usf) {
+		ret = uwsgi_static_file_serve_cached(wsgi_req, usf, real_filename, real_filename_len);
+	}
+	else {
+		ret = uwsgi_real_file_serve(wsgi_req, real_filename, real_filename_len, &st);
 	}
 
-	return -1;
-
+end:
+	if (usf) uwsgi_static_open_cache_release(usf);
+	free(filename);
+	return ret;
 }
@@ -5,6 +5,8 @@
 
 extern struct uwsgi_server uwsgi;
 
+static int uwsgi_stats_write(struct uwsgi_stats *, off_t);
+
 struct uwsgi_stats *uwsgi_stats_new(size_t chunk_size) {
 	struct uwsgi_stats *us = uwsgi_malloc(sizeof(struct uwsgi_stats));
 	us->base = uwsgi_malloc(chunk_size);
@@ -14,6 +16,8 @@ struct uwsgi_stats *uwsgi_stats_new(size_t chunk_size) {
 	us->size = chunk_size;
 	us->tabs = 1;
 	us->dirty = 0;
+	us->fd = -1;
+	us->query = NULL;
 	us->minified = uwsgi.stats_minified;
 	if (!us->minified) {
 		us->base[1] = '\n';
@@ -85,6 +89,111 @@ int uwsgi_stats_object_close(struct uwsgi_stats *us) {
 	return uwsgi_stats_symbol(us, '}');
 }
 
+// in streaming mode send the json generated so far (call it only when no lock is held)
+int uwsgi_stats_stream(struct uwsgi_stats *us) {
+	if (us->fd < 0 || (size_t) us->pos < us->chunk)
+		return 0;
+	// a trailing comma could still be removed by uwsgi_stats_uncomma(), keep it in the buffer
+	off_t end = us->pos;
+	off_t keep = 0;
+	if (keep < end && us->base[end - 1 - keep] == '\n')
+		keep++;
+	if (keep < end && us->base[end - 1 - keep] == ',')
+		keep++;
+	else
+		keep = 0;
+	return uwsgi_stats_write(us, end - keep);
+}
+
+// write (and discard) the first 'len' bytes of the generated json, what the (non blocking) fd does not accept stays in the buffer
+static int uwsgi_stats_write(struct uwsgi_stats *us, off_t len) {
+	off_t pos = 0;
+	while (pos < len) {
+		ssize_t res = write(us->fd, us->base + pos, len - pos);
+		if (res < 0) {
+			if (uwsgi_is_again())
+				break;
+			uwsgi_error("uwsgi_stats_write()/write()");
+			return -1;
+		}
+		if (res == 0)
+			return -1;
+		pos += res;
+	}
+	if (pos > 0) {
+		memmove(us->base, us->base + pos, us->pos - pos);
+		us->pos -= pos;
+	}
+	return 0;
+}
+
+// write the generated json to the streaming fd (without blocking, us->pos > 0 if something is left)
+int uwsgi_stats_flush(struct uwsgi_stats *us) {
+	if (us->fd < 0)
+		return 0;
+	return uwsgi_stats_write(us, us->pos);
+}
+
+// remove a trailing comma (used when the following section has been filtered out)
+void uwsgi_stats_uncomma(struct uwsgi_stats *us) {
+	off_t pos = us->pos;
+	if (pos > 0 && us->base[pos - 1] == '\n')
+		pos--;
+	if (pos > 0 && us->base[pos - 1] == ',')
+		us->pos = pos - 1;
+}
+
+/*
+	stats query filters: a list of '&' separated items, a section name (workers, sockets, caches...)
+	selects the whole section, a "key=value" pair (worker=1, cache=name...) selects a single item of a section.
+	Without a query everything is shown.
+	The query string is taken from the http request, so filters are available only with --stats-http
+	(clients of the raw stats socket send nothing and always get the whole document).
+*/
+static int uwsgi_stats_query_has(struct uwsgi_stats *us, char *key, char *value, size_t value_len) {
+	size_t key_len = strlen(key);
+	char *ptr = us->query;
+	while (ptr && *ptr) {
+		char *amp = strchr(ptr, '&');
+		size_t len = amp ? (size_t) (amp - ptr) : strlen(ptr);
+		if (!value) {
+			if (len == key_len && !memcmp(ptr, key, key_len))
+				return 1;
+			if (len > key_len && !memcmp(ptr, key, key_len) && ptr[key_len] == '=')
+				return 1;
+		}
+		else {
+			if (len == key_len + 1 + value_len && !memcmp(ptr, key, key_len) && ptr[key_len] == '=' && !memcmp(ptr + key_len + 1, value, value_len))
+				return 1;
+		}
+		ptr = amp ? amp + 1 : NULL;
+	}
+	return 0;
+}
+
+// check if a section has been requested ("item" is the name of the per-item filter)
+int uwsgi_stats_want(struct uwsgi_stats *us, char *section, char *item) {
+	if (!us->query)
+		return 1;
+	if (uwsgi_stats_query_has(us, section, NULL, 0))
+		return 1;
+	if (item && uwsgi_stats_query_has(us, item, NULL, 0))
+		return 1;
+	return 0;
+}
+
+// check if an item of a section has been requested
+int uwsgi_stats_want_item(struct uwsgi_stats *us, char *section, char *item, char *value, size_t value_len) {
+	if (!us->query)
+		return 1;
+	if (uwsgi_stats_query_has(us, section, NULL, 0))
+		return 1;
+	// no per-item filter
+	if (!uwsgi_stats_query_has(us, item, NULL, 0))
+		return 1;
+	return uwsgi_stats_query_has(us, item, value, value_len);
+}
+
 int uwsgi_stats_list_open(struct uwsgi_stats *us) {
 	us->tabs++;
 	return uwsgi_stats_symbol_nl(us, '[');
@@ -354,6 +463,61 @@ int uwsgi_stats_keyslong_comma(struct uwsgi_stats *us, char *key, long long num)
 }
 
 
+/*
+	how the master serves stats clients:
+
+	the master must never block on a client, so accepted connections are non blocking and are
+	registered in the master queue. With --stats-http the request is read when the socket is
+	readable, then the json is generated (and streamed with --stats-stream). What the client
+	does not accept is kept in memory and written back when the socket is writable.
+	Clients not making progress for --socket-timeout seconds are closed by
+	uwsgi_stats_clients_check_deadline().
+*/
+
+static void uwsgi_stats_client_close(struct uwsgi_stats_client *usc) {
+	struct uwsgi_stats_client *prev = NULL, *current = uwsgi.stats_clients;
+	while (current) {
+		if (current == usc) {
+			if (prev) {
+				prev->next = usc->next;
+			}
+			else {
+				uwsgi.stats_clients = usc->next;
+			}
+			break;
+		}
+		prev = current;
+		current = current->next;
+	}
+	close(usc->fd);
+	uwsgi_master_fd_closed(usc->fd);
+	if (usc->us) {
+		free(usc->us->base);
+		free(usc->us);
+	}
+	free(usc);
+}
+
+// generate the stats for the client, returns 0 if all of the json has been sent
+static int uwsgi_stats_client_run(struct uwsgi_stats_client *usc, char *query) {
+	// the master stats can be streamed and filtered
+	if (usc->func == uwsgi_master_generate_stats) {
+		usc->us = uwsgi_master_generate_stats_query(query && query[0] ? query : NULL, uwsgi.stats_stream ? usc->fd : -1);
+	}
+	else {
+		usc->us = usc->func();
+	}
+	if (!usc->us)
+		return -1;
+
+	usc->us->fd = usc->fd;
+	if (uwsgi_stats_flush(usc->us))
+		return -1;
+	if (usc->us->pos == 0)
+		return 0;
+	return 1;
+}
+
 void uwsgi_send_stats(int fd, struct uwsgi_stats *(*func) (void)) {
 
 	struct sockaddr_un client_src;
@@ -365,41 +529,88 @@ void uwsgi_send_stats(int fd, struct uwsgi_stats *(*func) (void)) {
 		return;
 	}
 
+	uwsgi_socket_nb(client_fd);
+
+	struct uwsgi_stats_client *usc = uwsgi_calloc(sizeof(struct uwsgi_stats_client));
+	usc->fd = client_fd;
+	usc->func = func;
+	usc->last_activity = uwsgi_now();
+	usc->next = uwsgi.stats_clients;
+	uwsgi.stats_clients = usc;
+
+	// wait for the request
 	if (uwsgi.stats_http) {
-		if (uwsgi_send_http_stats(client_fd)) {
-			close(client_fd);
-			return;
-		}
+		if (event_queue_add_fd_read(uwsgi.master_queue, client_fd))
+			goto end;
+		usc->reading = 1;
+		return;
 	}
 
-	struct uwsgi_stats *us = func();
-	if (!us)
+	int ret = uwsgi_stats_client_run(usc, NULL);
+	if (ret < 0)
 		goto end;
+	if (ret > 0) {
+		if (event_queue_add_fd_write(uwsgi.master_queue, client_fd))
+			goto end;
+		return;
+	}
 
-	size_t remains = us->pos;
-	off_t pos = 0;
-	while (remains > 0) {
-		int ret = uwsgi_waitfd_write(client_fd, uwsgi.socket_timeout);
-		if (ret <= 0) {
-			goto end0;
-		}
-		ssize_t res = write(client_fd, us->base + pos, remains);
-		if (res <= 0) {
-			if (res < 0) {
-				uwsgi_error("write()");
-			}
-			goto end0;
+end:
+	uwsgi_stats_client_close(usc);
+}
+
+// manage an event of a stats client (returns 0 if the fd is not a stats client)
+int uwsgi_stats_client_event(int fd) {
+	struct uwsgi_stats_client *usc = uwsgi.stats_clients;
+	while (usc) {
+		if (usc->fd == fd)
+			break;
+		usc = usc->next;
+	}
+	if (!usc)
+		return 0;
+
+	usc->last_activity = uwsgi_now();
+
+	if (usc->reading) {
+		char query[1024];
+		query[0] = 0;
+		if (uwsgi_send_http_stats_query(fd, query, sizeof(query)))
+			goto end;
+		usc->reading = 0;
+		int ret = uwsgi_stats_client_run(usc, query);
+		if (ret < 0)
+			goto end;
+		if (ret > 0) {
+			if (event_queue_fd_read_to_write(uwsgi.master_queue, fd))
+				goto end;
+			return 1;
 		}
-		pos += res;
-		remains -= res;
+		goto end;
 	}
 
-end0:
-	free(us->base);
-	free(us);
+	if (uwsgi_stats_flush(usc->us))
+		goto end;
+	if (usc->us->pos > 0)
+		return 1;
 
 end:
-	close(client_fd);
+	uwsgi_stats_client_close(usc);
+	return 1;
+}
+
+// close the clients not making progress
+void uwsgi_stats_clients_check_deadline() {
+	time_t now = uwsgi_now();
+	struct uwsgi_stats_client *usc = uwsgi.stats_clients;
+	while (usc) {
+		struct uwsgi_stats_client *next = usc->next;
+		if (now - usc->last_activity >= uwsgi.socket_timeout) {
+			uwsgi_log_verbose("stats client (fd: %d) timed out\n", usc->fd);
+			uwsgi_stats_client_close(usc);
+		}
+		usc = next;
+	}
 }
 
 struct uwsgi_stats_pusher *uwsgi_stats_pusher_get(char *name) {
@@ -6,9 +6,7 @@
 
 	each subscription slot is as an hashed item in a dictionary
 
-	each slot has a circular linked list containing the nodes names
-
-	the structure and system is very similar to uwsgi_dyn_dict already used by the mime type parser
+	each slot has a linked list containing the nodes names
 
 	This system is not mean to run on shared memory. If you have multiple processes for the same app, you have to create
 	a new subscriptions slot list.
@@ -65,61 +63,377 @@ int uwsgi_subscription_credentials_check(struct uwsgi_subscribe_slot *slot, stru
         return 0;
 }
 
-struct uwsgi_subscribe_slot *uwsgi_get_subscribe_slot(struct uwsgi_subscribe_slot **slot, char *key, uint16_t keylen) {
+/*
+
+	how the slots table works:
+
+	slots are indexed by an open addressing (linear probing) table of {hash, slot} buckets,
+	so a lookup compares 32bit hashes walking contiguous memory and dereferences only the slots
+	with the same hash. Lookups do not write to buckets or slots.
+
+	The table doubles when it is half full and halves when less than 1/8 of it is used
+	(never going below UWSGI_SUBSCRIBE_TABLE_MIN buckets). Removals shift back the following
+	buckets of the same cluster (instead of leaving tombstones), so churn does not make probe sequences longer.
+
+	The lookup stats reported by the routers are sampled: only one lookup every
+	UWSGI_SUBSCRIBE_LOOKUP_SAMPLING (counted by a per-thread countdown) reads the clock and updates
+	the counters of the table, so the lookup path is read-only for the others and the cores routing
+	requests do not dirty the same cache line. The number of lookups is an estimate
+	(sampled lookups * UWSGI_SUBSCRIBE_LOOKUP_SAMPLING).
+
+*/
+
+#define UWSGI_SUBSCRIBE_TABLE_MIN 256
+static __thread uint32_t uwsgi_subscribe_lookups_countdown;
+
+static struct uwsgi_hash_algo *uwsgi_subscription_hash_algo() {
+	static struct uwsgi_hash_algo *uha = NULL;
+	if (!uha) {
+		char *name = uwsgi.subscription_hash ? uwsgi.subscription_hash : "xxh3";
+		uha = uwsgi_hash_algo_get(name);
+		if (!uha) {
+			uwsgi_log("unable to find hash algo \"%s\" for the subscription system\n", name);
+			exit(1);
+		}
+		// random and rr are not suitable for indexing
+		if (uha->func("uwsgi", 5) != uha->func("uwsgi", 5)) {
+			uwsgi_log("hash algo \"%s\" cannot be used by the subscription system\n", name);
+			exit(1);
+		}
+	}
+	return uha;
+}
+
+static uint32_t uwsgi_subscribe_table_hash(struct uwsgi_subscribe_table *ust, char *key, uint16_t keylen) {
+	if (!ust->hash) {
+		ust->hash = uwsgi_subscription_hash_algo();
+	}
+	return ust->hash->func(key, keylen);
+}
+
+static void uwsgi_subscribe_table_resize(struct uwsgi_subscribe_table *ust, uint64_t size) {
+	struct uwsgi_subscribe_bucket *buckets = uwsgi_calloc(sizeof(struct uwsgi_subscribe_bucket) * size);
+	uint64_t mask = size - 1;
+	uint64_t i;
+	for(i=0;i<ust->size;i++) {
+		if (!ust->buckets[i].slot) continue;
+		uint64_t pos = ust->buckets[i].hash & mask;
+		while(buckets[pos].slot) {
+			pos = (pos + 1) & mask;
+		}
+		buckets[pos] = ust->buckets[i];
+	}
+	free(ust->buckets);
+	ust->buckets = buckets;
+	ust->size = size;
+	ust->resizes++;
+}
+
+static void uwsgi_subscribe_table_insert(struct uwsgi_subscribe_table *ust, struct uwsgi_subscribe_slot *slot) {
+	if ((ust->items + 1) * 2 > ust->size) {
+		uwsgi_subscribe_table_resize(ust, ust->size * 2);
+	}
+	uint64_t mask = ust->size - 1;
+	uint64_t pos = slot->hash & mask;
+	while(ust->buckets[pos].slot) {
+		pos = (pos + 1) & mask;
+	}
+	ust->buckets[pos].hash = slot->hash;
+	ust->buckets[pos].slot = slot;
+	ust->items++;
+}
+
+static void uwsgi_subscribe_table_remove(struct uwsgi_subscribe_table *ust, struct uwsgi_subscribe_slot *slot) {
+	uint64_t mask = ust->size - 1;
+	uint64_t i = slot->hash & mask;
+	while(ust->buckets[i].slot != slot) {
+		if (!ust->buckets[i].slot) return;
+		i = (i + 1) & mask;
+	}
+
+	// move back the following items of the cluster that could have been stored in the freed bucket
+	uint64_t j = i;
+	for(;;) {
+		j = (j + 1) & mask;
+		if (!ust->buckets[j].slot) break;
+		uint64_t home = ust->buckets[j].hash & mask;
+		// is home in the circular range (i, j] ?
+		int in_range = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+		if (!in_range) {
+			ust->buckets[i] = ust->buckets[j];
+			i = j;
+		}
+	}
+	ust->buckets[i].hash = 0;
+	ust->buckets[i].slot = NULL;
+	ust->items--;
+
+	if (ust->size > UWSGI_SUBSCRIBE_TABLE_MIN && ust->items * 8 < ust->size) {
+		uwsgi_subscribe_table_resize(ust, ust->size / 2);
+	}
+}
+
+// grow the table in advance for n new slots (batched subscriptions), so it is resized at most once
+void uwsgi_subscribe_table_reserve(struct uwsgi_subscribe_table *ust, uint64_t n) {
+	uint64_t size = ust->size;
+	while ((ust->items + n) * 2 > size) {
+		size *= 2;
+	}
+	if (size != ust->size) {
+		uwsgi_subscribe_table_resize(ust, size);
+	}
+}
+
+struct uwsgi_subscribe_slot *uwsgi_get_subscribe_slot(struct uwsgi_subscribe_table *ust, char *key, uint16_t keylen) {
 
 	if (keylen > 0xff)
 		return NULL;
 
-	uint32_t hash = djb33x_hash(key, keylen);
-	int hash_key = hash % 0xffff;
+	uint64_t start = 0;
+	if (uwsgi_subscribe_lookups_countdown == 0) {
+		uwsgi_subscribe_lookups_countdown = UWSGI_SUBSCRIBE_LOOKUP_SAMPLING;
+		start = uwsgi_nanos();
+	}
+	uwsgi_subscribe_lookups_countdown--;
+	uint32_t hash = uwsgi_subscribe_table_hash(ust, key, keylen);
+	uint64_t mask = ust->size - 1;
+	uint64_t pos = hash & mask;
+	uint64_t probes = 1;
+	struct uwsgi_subscribe_slot *current_slot = NULL;
+
+	// the table is never full, an empty bucket is always found
+	while (ust->buckets[pos].slot) {
+		struct uwsgi_subscribe_bucket *usb = &ust->buckets[pos];
+		if (usb->hash == hash && !uwsgi_strncmp(key, keylen, usb->slot->key, usb->slot->keylen)) {
+			current_slot = usb->slot;
+			break;
+		}
+		pos = (pos + 1) & mask;
+		probes++;
+	}
 
-	struct uwsgi_subscribe_slot *current_slot = slot[hash_key];
+	if (start) {
+		ust->lookup_ns += uwsgi_nanos() - start;
+		ust->sampled_lookups++;
+		ust->probes += probes;
+	}
 
+	return current_slot;
+}
 
-#ifdef UWSGI_DEBUG
-	uwsgi_log("****************************\n");
-	while (current_slot) {
-		uwsgi_log("slot %.*s %d\n", current_slot->keylen, current_slot->key, current_slot->hits);
-		current_slot = current_slot->next;
+/*
+
+	how the consistent hash ring works:
+
+	every node gets subscription_ring_vnodes * weight points (the hash of "name-N") on a 32bit circle,
+	kept in a sorted array of the slot. A request is mapped to the first point >= the hash of its affinity key
+	(see the --*-affinity-var options of the corerouters), so adding or removing a node only moves the keys
+	of the arcs owned by it. The array is never rebuilt: the sorted points of a new node are merged in place,
+	the points of a removed node are compacted out (a weight change is a removal followed by an add).
+	Dead nodes keep their points (they are only skipped) until they are removed, so a flapping node gets
+	its keys back.
+
+	The bounded variant caps every node to subscription_ring_load percent of its (weighted) share
+	of the requests in flight, spilling the excess to the next points of the circle.
+	The requests in flight and the weights of the ring are running totals of the slot (updated when a node
+	is picked/released and when it enters/leaves the ring), so a pick does not walk every node.
+	Dead nodes are part of both until they are removed (that happens as soon as their last request ends).
+
+*/
+
+#define UWSGI_SUBSCRIBE_RING_MAX_POINTS 16384
+
+// every request routed to a node is accounted in the slot too (the bounded ring needs the total)
+static void uwsgi_subscribe_node_ref(struct uwsgi_subscribe_node *node) {
+	node->reference++;
+	node->slot->in_flight++;
+}
+
+void uwsgi_subscribe_node_unref(struct uwsgi_subscribe_node *node) {
+	node->reference--;
+	node->slot->in_flight--;
+}
+
+static int uwsgi_subscribe_ring_cmp(const void *a, const void *b) {
+	const struct uwsgi_subscribe_ring_point *p1 = (const struct uwsgi_subscribe_ring_point *) a;
+	const struct uwsgi_subscribe_ring_point *p2 = (const struct uwsgi_subscribe_ring_point *) b;
+	if (p1->hash != p2->hash)
+		return p1->hash < p2->hash ? -1 : 1;
+	// collisions are ordered by name, so every router builds the same ring
+	uint16_t len = p1->node->len < p2->node->len ? p1->node->len : p2->node->len;
+	int ret = memcmp(p1->node->name, p2->node->name, len);
+	if (ret)
+		return ret;
+	return (int) p1->node->len - (int) p2->node->len;
+}
+
+static void uwsgi_subscribe_ring_add(struct uwsgi_subscribe_slot *current_slot, struct uwsgi_subscribe_node *node) {
+	struct uwsgi_hash_algo *uha = uwsgi_subscription_hash_algo();
+	uint64_t vnodes = uwsgi.subscription_ring_vnodes > 0 ? uwsgi.subscription_ring_vnodes : 1;
+	uint64_t n = vnodes * node->weight;
+	if (n == 0 || n > UWSGI_SUBSCRIBE_RING_MAX_POINTS)
+		n = UWSGI_SUBSCRIBE_RING_MAX_POINTS;
+
+	struct uwsgi_subscribe_ring_point *points = uwsgi_malloc(sizeof(struct uwsgi_subscribe_ring_point) * n);
+	char buf[0xff + 22];
+	uint64_t i;
+	for(i=0;i<n;i++) {
+		int len = snprintf(buf, sizeof(buf), "%.*s-%llu", (int) node->len, node->name, (unsigned long long) i);
+		points[i].hash = uha->func(buf, len);
+		points[i].node = node;
+	}
+	qsort(points, n, sizeof(struct uwsgi_subscribe_ring_point), uwsgi_subscribe_ring_cmp);
+
+	if (current_slot->ring_cnt + n > current_slot->ring_size) {
+		current_slot->ring_size = current_slot->ring_cnt + n;
+		current_slot->ring = realloc(current_slot->ring, sizeof(struct uwsgi_subscribe_ring_point) * current_slot->ring_size);
+		if (!current_slot->ring) {
+			uwsgi_error("uwsgi_subscribe_ring_add()/realloc()");
+			exit(1);
+		}
 	}
-	uwsgi_log("****************************\n");
-	current_slot = slot[hash_key];
-#endif
 
-	while (current_slot) {
-		if (!uwsgi_strncmp(key, keylen, current_slot->key, current_slot->keylen)) {
-			// auto optimization
-			if (current_slot->prev) {
-				if (current_slot->hits > current_slot->prev->hits) {
-					struct uwsgi_subscribe_slot *slot_parent = current_slot->prev->prev, *slot_prev = current_slot->prev;
-					if (slot_parent) {
-						slot_parent->next = current_slot;
-					}
-					else {
-						slot[hash_key] = current_slot;
-					}
-
-					if (current_slot->next) {
-						current_slot->next->prev = slot_prev;
-					}
-
-					slot_prev->prev = current_slot;
-					slot_prev->next = current_slot->next;
-
-					current_slot->next = slot_prev;
-					current_slot->prev = slot_parent;
+	// merge from the tail, so no temporary array is needed
+	int64_t r = (int64_t) current_slot->ring_cnt - 1;
+	int64_t p = (int64_t) n - 1;
+	int64_t k = (int64_t) (current_slot->ring_cnt + n) - 1;
+	while (p >= 0) {
+		if (r >= 0 && uwsgi_subscribe_ring_cmp(&current_slot->ring[r], &points[p]) > 0) {
+			current_slot->ring[k--] = current_slot->ring[r--];
+		}
+		else {
+			current_slot->ring[k--] = points[p--];
+		}
+	}
+	current_slot->ring_cnt += n;
+	node->ring_weight = node->weight;
+	current_slot->ring_weights += node->ring_weight;
+	free(points);
+}
 
-				}
-			}
-			return current_slot;
+static void uwsgi_subscribe_ring_del(struct uwsgi_subscribe_slot *current_slot, struct uwsgi_subscribe_node *node) {
+	uint64_t i, j = 0;
+	for(i=0;i<current_slot->ring_cnt;i++) {
+		if (current_slot->ring[i].node == node)
+			continue;
+		current_slot->ring[j++] = current_slot->ring[i];
+	}
+	current_slot->ring_cnt = j;
+	current_slot->ring_weights -= node->ring_weight;
+}
+
+static struct uwsgi_subscribe_node *uwsgi_subscription_ring_get(struct uwsgi_subscribe_slot *current_slot, uint32_t hash) {
+	uint64_t n = current_slot->ring_cnt;
+	if (n == 0)
+		return NULL;
+
+	// first point >= hash (wrapping around)
+	uint64_t lo = 0, hi = n;
+	while (lo < hi) {
+		uint64_t mid = lo + ((hi - lo) / 2);
+		if (current_slot->ring[mid].hash < hash) {
+			lo = mid + 1;
 		}
-		current_slot = current_slot->next;
-		// check for loopy optimization
-		if (current_slot == slot[hash_key])
+		else {
+			hi = mid;
+		}
+	}
+	if (lo == n)
+		lo = 0;
+
+	double load = 0;
+	if (uwsgi.subscription_ring > 1 && current_slot->ring_weights) {
+		double factor = uwsgi.subscription_ring_load > 100 ? uwsgi.subscription_ring_load : 100;
+		load = ((factor / 100) * (double) (current_slot->in_flight + 1)) / (double) current_slot->ring_weights;
+	}
+
+	struct uwsgi_subscribe_node *first_node = NULL, *choosen_node = NULL;
+	uint64_t i;
+	for(i=0;i<n;i++) {
+		struct uwsgi_subscribe_node *node = current_slot->ring[(lo + i) % n].node;
+		if (node->death_mark)
+			continue;
+		if (!first_node)
+			first_node = node;
+		if (load <= 0 || (double) node->reference < ceil(load * (double) node->weight)) {
+			choosen_node = node;
 			break;
+		}
 	}
 
-	return NULL;
+	if (!choosen_node) {
+		choosen_node = first_node;
+	}
+	else if (choosen_node != first_node) {
+		current_slot->ring_spills++;
+	}
+
+	if (choosen_node) {
+		uwsgi_subscribe_node_ref(choosen_node);
+	}
+	return choosen_node;
+}
+
+static void uwsgi_subscribe_slot_index_add(struct uwsgi_subscribe_slot *current_slot, struct uwsgi_subscribe_node *node) {
+	if (current_slot->nodes_cnt >= current_slot->nodes_size) {
+		current_slot->nodes_size = current_slot->nodes_size ? current_slot->nodes_size * 2 : 4;
+		current_slot->nodes_array = realloc(current_slot->nodes_array, sizeof(struct uwsgi_subscribe_node *) * current_slot->nodes_size);
+		if (!current_slot->nodes_array) {
+			uwsgi_error("uwsgi_subscribe_slot_index_add()/realloc()");
+			exit(1);
+		}
+	}
+	current_slot->nodes_array[current_slot->nodes_cnt++] = node;
+	if (uwsgi.subscription_ring)
+		uwsgi_subscribe_ring_add(current_slot, node);
+}
+
+static void uwsgi_subscribe_slot_index_del(struct uwsgi_subscribe_slot *current_slot, struct uwsgi_subscribe_node *node) {
+	uint64_t i;
+	if (uwsgi.subscription_ring)
+		uwsgi_subscribe_ring_del(current_slot, node);
+	for(i=0;i<current_slot->nodes_cnt;i++) {
+		if (current_slot->nodes_array[i] == node) {
+			current_slot->nodes_array[i] = current_slot->nodes_array[--current_slot->nodes_cnt];
+			return;
+		}
+	}
+}
+
+// remove death mark and update cores and load
+static void uwsgi_subscribe_node_refresh(struct uwsgi_subscribe_slot *current_slot, struct uwsgi_subscribe_node *node, struct uwsgi_subscribe_req *usr) {
+	node->death_mark = 0;
+	node->last_check = uwsgi_now();
+	node->cores = usr->cores;
+	node->load = usr->load;
+	node->weight = usr->weight;
+	if (!node->weight)
+		node->weight = 1;
+	node->last_requests = 0;
+	if (uwsgi.subscription_ring && node->ring_weight != node->weight) {
+		uwsgi_subscribe_ring_del(current_slot, node);
+		uwsgi_subscribe_ring_add(current_slot, node);
+	}
+}
+
+// marks (and removes when unused) nodes not announced for more than subscription_tolerance seconds
+// returns 1 if the node has been removed, 2 if the whole slot has been removed
+static int uwsgi_subscribe_node_check(struct uwsgi_subscribe_table *slot, struct uwsgi_subscribe_node *node, time_t now, char *key, uint16_t keylen) {
+	// is the node alive ?
+	if (now - node->last_check > uwsgi.subscription_tolerance) {
+		if (node->death_mark == 0)
+			uwsgi_log("[uwsgi-subscription for pid %d] %.*s => marking %.*s as failed (no announce received in %d seconds)\n", (int) uwsgi.mypid, (int) keylen, key, (int) node->len, node->name, uwsgi.subscription_tolerance);
+		node->failcnt++;
+		node->death_mark = 1;
+	}
+	// do i need to remove the node ?
+	if (node->death_mark && node->reference == 0) {
+		if (uwsgi_remove_subscribe_node(slot, node) == 1) {
+			return 2;
+		}
+		return 1;
+	}
+	return 0;
 }
 
 // least reference count
@@ -144,7 +458,7 @@ static struct uwsgi_subscribe_node *uwsgi_subscription_algo_lrc(struct uwsgi_sub
 	}
 
 	if (choosen_node) {
-		choosen_node->reference++;
+		uwsgi_subscribe_node_ref(choosen_node);
 	}
 
 	return choosen_node;
@@ -178,7 +492,7 @@ static struct uwsgi_subscribe_node *uwsgi_subscription_algo_wlrc(struct uwsgi_su
 	}
 
 	if (choosen_node) {
-		choosen_node->reference++;
+		uwsgi_subscribe_node_ref(choosen_node);
 	}
 
 	return choosen_node;
@@ -190,7 +504,7 @@ static struct uwsgi_subscribe_node *uwsgi_subscription_algo_wrr(struct uwsgi_sub
 	if (node) {
 		if (node->death_mark == 0 && node->wrr > 0) {
 			node->wrr--;
-			node->reference++;
+			uwsgi_subscribe_node_ref(node);
 			return node;
 		}
 		return NULL;
@@ -219,13 +533,131 @@ static struct uwsgi_subscribe_node *uwsgi_subscription_algo_wrr(struct uwsgi_sub
 	}
 	if (choosen_node) {
 		choosen_node->wrr--;
-		choosen_node->reference++;
+		uwsgi_subscribe_node_ref(choosen_node);
+	}
+	return choosen_node;
+}
+
+/*
+	power of two choices: two random nodes are compared and the less loaded one wins.
+	It is O(1) per request, and avoids the herd effect of always choosing the least loaded node.
+*/
+
+static uint64_t uwsgi_subscription_random() {
+	// xorshift64*, quality is more than enough for picking nodes
+	static uint64_t state = 0;
+	if (!state) {
+		state = uwsgi_micros() ^ ((uint64_t) uwsgi.mypid << 32) ^ 0x9e3779b97f4a7c15ULL;
+	}
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545f4914f6cdd1dULL;
+}
+
+static struct uwsgi_subscribe_node *uwsgi_subscription_p2c(struct uwsgi_subscribe_slot *current_slot, double (*cost)(struct uwsgi_subscribe_node *, uint64_t)) {
+	uint64_t n = current_slot->nodes_cnt;
+	if (n == 0)
+		return NULL;
+
+	struct uwsgi_subscribe_node *a = NULL, *b = NULL;
+	uint64_t r = uwsgi_subscription_random();
+	uint64_t i = r % n;
+	a = current_slot->nodes_array[i];
+	if (n > 1) {
+		uint64_t j = (r >> 32) % (n - 1);
+		if (j >= i) j++;
+		b = current_slot->nodes_array[j];
+	}
+
+	if (a && a->death_mark) a = NULL;
+	if (b && b->death_mark) b = NULL;
+
+	struct uwsgi_subscribe_node *choosen_node = NULL;
+	if (a && b) {
+		uint64_t now = uwsgi_micros();
+		choosen_node = cost(b, now) < cost(a, now) ? b : a;
+	}
+	else if (a || b) {
+		choosen_node = a ? a : b;
+	}
+	else {
+		// both dead, fallback to the first alive node
+		for(i=0;i<n;i++) {
+			if (!current_slot->nodes_array[i]->death_mark) {
+				choosen_node = current_slot->nodes_array[i];
+				break;
+			}
+		}
+	}
+
+	if (choosen_node) {
+		uwsgi_subscribe_node_ref(choosen_node);
 	}
 	return choosen_node;
 }
 
+static double uwsgi_subscription_cost_p2c(struct uwsgi_subscribe_node *node, uint64_t now) {
+	// node->weight is always >= 1
+	return (double) (node->reference + 1) / (double) node->weight;
+}
+
+/*
+	peak EWMA: the average is moved immediately to a slower response time, while faster ones are
+	averaged in with a time based decay (subscription_ewma_decay msecs). Reading it applies the decay too,
+	so a slow node that stopped receiving requests is retried after a while.
+	The cost is the average multiplied by the requests in flight.
+*/
+static double uwsgi_subscription_ewma_decayed(struct uwsgi_subscribe_node *node, uint64_t now) {
+	if (now <= node->ewma_ts)
+		return (double) node->ewma;
+	double tau = (double) uwsgi.subscription_ewma_decay * 1000;
+	if (tau <= 0)
+		return (double) node->ewma;
+	return (double) node->ewma * exp(-((double) (now - node->ewma_ts)) / tau);
+}
+
+static double uwsgi_subscription_cost_ewma(struct uwsgi_subscribe_node *node, uint64_t now) {
+	// never measured, send it a request at a time until a response time is available
+	if (!node->ewma_ts) {
+		return node->reference ? (double) UINT32_MAX : 0;
+	}
+	return (uwsgi_subscription_ewma_decayed(node, now) * (double) (node->reference + 1)) / (double) node->weight;
+}
+
+void uwsgi_subscribe_node_latency(struct uwsgi_subscribe_node *node, uint64_t rt) {
+	uint64_t now = uwsgi_micros();
+	double ewma = uwsgi_subscription_ewma_decayed(node, now);
+	if (!node->ewma_ts || (double) rt > ewma) {
+		node->ewma = rt;
+	}
+	else {
+		double tau = (double) uwsgi.subscription_ewma_decay * 1000;
+		double w = tau > 0 ? exp(-((double) (now - node->ewma_ts)) / tau) : 0;
+		node->ewma = (uint64_t) (((double) node->ewma * w) + ((double) rt * (1 - w)));
+	}
+	node->ewma_ts = now;
+}
+
+static struct uwsgi_subscribe_node *uwsgi_subscription_algo_p2c(struct uwsgi_subscribe_slot *current_slot, struct uwsgi_subscribe_node *node) {
+	return uwsgi_subscription_p2c(current_slot, uwsgi_subscription_cost_p2c);
+}
+
+static struct uwsgi_subscribe_node *uwsgi_subscription_algo_ewma(struct uwsgi_subscribe_slot *current_slot, struct uwsgi_subscribe_node *node) {
+	return uwsgi_subscription_p2c(current_slot, uwsgi_subscription_cost_ewma);
+}
+
+// without an affinity key the ring algos behave like p2c
+static struct uwsgi_subscribe_node *uwsgi_subscription_algo_ketama(struct uwsgi_subscribe_slot *current_slot, struct uwsgi_subscribe_node *node) {
+	return uwsgi_subscription_p2c(current_slot, uwsgi_subscription_cost_p2c);
+}
+
 void uwsgi_subscription_set_algo(char *algo) {
 
+	uwsgi.subscription_algo_direct = 0;
+	uwsgi.subscription_ring = 0;
+
+
 	if (!algo)
 		goto wrr;
 
@@ -244,11 +676,41 @@ void uwsgi_subscription_set_algo(char *algo) {
 		return;
 	}
 
+	if (!strcmp(algo, "p2c")) {
+		uwsgi.subscription_algo = uwsgi_subscription_algo_p2c;
+		uwsgi.subscription_algo_direct = 1;
+		return;
+	}
+
+	if (!strcmp(algo, "ewma")) {
+		uwsgi.subscription_algo = uwsgi_subscription_algo_ewma;
+		uwsgi.subscription_algo_direct = 1;
+		return;
+	}
+
+	if (!strcmp(algo, "ketama")) {
+		uwsgi.subscription_algo = uwsgi_subscription_algo_ketama;
+		uwsgi.subscription_algo_direct = 1;
+		uwsgi.subscription_ring = 1;
+		return;
+	}
+
+	if (!strcmp(algo, "ketama-bounded")) {
+		uwsgi.subscription_algo = uwsgi_subscription_algo_ketama;
+		uwsgi.subscription_algo_direct = 1;
+		uwsgi.subscription_ring = 2;
+		return;
+	}
+
 wrr:
 	uwsgi.subscription_algo = uwsgi_subscription_algo_wrr;
 }
 
-struct uwsgi_subscribe_node *uwsgi_get_subscribe_node(struct uwsgi_subscribe_slot **slot, char *key, uint16_t keylen) {
+uint32_t uwsgi_subscription_key_hash(char *key, uint16_t keylen) {
+	return uwsgi_subscription_hash_algo()->func(key, keylen);
+}
+
+static struct uwsgi_subscribe_node *uwsgi_get_subscribe_node_do(struct uwsgi_subscribe_table *slot, char *key, uint16_t keylen, uint32_t affinity, int has_affinity) {
 
 	if (keylen > 0xff)
 		return NULL;
@@ -257,27 +719,38 @@ struct uwsgi_subscribe_node *uwsgi_get_subscribe_node(struct uwsgi_subscribe_slo
 	if (!current_slot)
 		return NULL;
 
-	// slot found, move up in the list increasing hits
 	current_slot->hits++;
 	time_t now = uwsgi_now();
 	struct uwsgi_subscribe_node *node = current_slot->nodes;
+
+	if (uwsgi.subscription_algo_direct) {
+		if (current_slot->last_sweep != now) {
+			current_slot->last_sweep = now;
+			while (node) {
+				struct uwsgi_subscribe_node *next_node = node->next;
+				// if the slot has been removed, return NULL;
+				if (uwsgi_subscribe_node_check(slot, node, now, key, keylen) == 2) {
+					return NULL;
+				}
+				node = next_node;
+			}
+		}
+		if (has_affinity && uwsgi.subscription_ring) {
+			return uwsgi_subscription_ring_get(current_slot, affinity);
+		}
+		return uwsgi.subscription_algo(current_slot, NULL);
+	}
+
 	while (node) {
-		// is the node alive ?
-		if (now - node->last_check > uwsgi.subscription_tolerance) {
-			if (node->death_mark == 0)
-				uwsgi_log("[uwsgi-subscription for pid %d] %.*s => marking %.*s as failed (no announce received in %d seconds)\n", (int) uwsgi.mypid, (int) keylen, key, (int) node->len, node->name, uwsgi.subscription_tolerance);
-			node->failcnt++;
-			node->death_mark = 1;
+		struct uwsgi_subscribe_node *next_node = node->next;
+		int ret = uwsgi_subscribe_node_check(slot, node, now, key, keylen);
+		// if the slot has been removed, return NULL;
+		if (ret == 2) {
+			return NULL;
 		}
-		// do i need to remove the node ?
-		if (node->death_mark && node->reference == 0) {
-			// remove the node and move to next
-			struct uwsgi_subscribe_node *dead_node = node;
-			node = node->next;
-			// if the slot has been removed, return NULL;
-			if (uwsgi_remove_subscribe_node(slot, dead_node) == 1) {
-				return NULL;
-			}
+		// the node has been removed, move to next
+		if (ret == 1) {
+			node = next_node;
 			continue;
 		}
 
@@ -291,7 +764,16 @@ struct uwsgi_subscribe_node *uwsgi_get_subscribe_node(struct uwsgi_subscribe_slo
 	return uwsgi.subscription_algo(current_slot, node);
 }
 
-struct uwsgi_subscribe_node *uwsgi_get_subscribe_node_by_name(struct uwsgi_subscribe_slot **slot, char *key, uint16_t keylen, char *val, uint16_t vallen) {
+struct uwsgi_subscribe_node *uwsgi_get_subscribe_node(struct uwsgi_subscribe_table *slot, char *key, uint16_t keylen) {
+	return uwsgi_get_subscribe_node_do(slot, key, keylen, 0, 0);
+}
+
+// the affinity is the hash (uwsgi_subscription_key_hash()) of the request key, used by the consistent hash algos
+struct uwsgi_subscribe_node *uwsgi_get_subscribe_node_affinity(struct uwsgi_subscribe_table *slot, char *key, uint16_t keylen, uint32_t affinity) {
+	return uwsgi_get_subscribe_node_do(slot, key, keylen, affinity, 1);
+}
+
+struct uwsgi_subscribe_node *uwsgi_get_subscribe_node_by_name(struct uwsgi_subscribe_table *slot, char *key, uint16_t keylen, char *val, uint16_t vallen) {
 
 	if (keylen > 0xff)
 		return NULL;
@@ -309,16 +791,38 @@ struct uwsgi_subscribe_node *uwsgi_get_subscribe_node_by_name(struct uwsgi_subsc
 	return NULL;
 }
 
-int uwsgi_remove_subscribe_node(struct uwsgi_subscribe_slot **slot, struct uwsgi_subscribe_node *node) {
+// a heartbeat only carries the hash of the key: refresh the node with the announced address in every slot with that hash
+struct uwsgi_subscribe_node *uwsgi_subscribe_node_heartbeat(struct uwsgi_subscribe_table *ust, uint32_t hash, struct uwsgi_subscribe_req *usr) {
+	struct uwsgi_subscribe_node *found = NULL;
+	uint64_t mask = ust->size - 1;
+	uint64_t pos = hash & mask;
+	while (ust->buckets[pos].slot) {
+		struct uwsgi_subscribe_bucket *usb = &ust->buckets[pos];
+		if (usb->hash == hash) {
+			struct uwsgi_subscribe_node *node = usb->slot->nodes;
+			while (node) {
+				if (!uwsgi_strncmp(node->name, node->len, usr->address, usr->address_len)) {
+					uwsgi_subscribe_node_refresh(usb->slot, node, usr);
+					found = node;
+					break;
+				}
+				node = node->next;
+			}
+		}
+		pos = (pos + 1) & mask;
+	}
+	ust->heartbeats++;
+	if (!found)
+		ust->heartbeat_misses++;
+	return found;
+}
+
+int uwsgi_remove_subscribe_node(struct uwsgi_subscribe_table *slot, struct uwsgi_subscribe_node *node) {
 
 	int ret = 0;
 
 	struct uwsgi_subscribe_node *a_node;
 	struct uwsgi_subscribe_slot *node_slot = node->slot;
-	struct uwsgi_subscribe_slot *prev_slot = node_slot->prev;
-	struct uwsgi_subscribe_slot *next_slot = node_slot->next;
-
-	int hash_key = node_slot->hash;
 
 	// over-engineering to avoid race conditions
 	node->len = 0;
@@ -337,60 +841,39 @@ int uwsgi_remove_subscribe_node(struct uwsgi_subscribe_slot **slot, struct uwsgi
 		}
 	}
 
+	uwsgi_subscribe_slot_index_del(node_slot, node);
+
 	free(node);
 	// no more nodes, remove the slot too
 	if (node_slot->nodes == NULL) {
 
 		ret = 1;
 
-		// first check if i am the only node
-		if ((!prev_slot && !next_slot) || next_slot == node_slot) {
-#ifdef UWSGI_SSL
-			if (uwsgi.subscriptions_sign_check_dir) {
-				EVP_PKEY_free(node_slot->sign_public_key);
-				EVP_MD_CTX_destroy(node_slot->sign_ctx);
-			}
-#ifdef SSL_CTRL_SET_TLSEXT_HOSTNAME
-			// if there is a SNI context active, destroy it
-			if (node_slot->sni_enabled) {
-				uwsgi_ssl_del_sni_item(node_slot->key, node_slot->keylen);
-			}
-#endif
-#endif
-			free(node_slot);
-			slot[hash_key] = NULL;
-			goto end;
-		}
-
-		// if i am the main entry point, set the next value
-		if (node_slot == slot[hash_key]) {
-			slot[hash_key] = next_slot;
-		}
-
-		if (prev_slot) {
-			prev_slot->next = next_slot;
-		}
-		if (next_slot) {
-			next_slot->prev = prev_slot;
-		}
+		uwsgi_subscribe_table_remove(slot, node_slot);
 
 #ifdef UWSGI_SSL
 		if (uwsgi.subscriptions_sign_check_dir) {
 			EVP_PKEY_free(node_slot->sign_public_key);
 			EVP_MD_CTX_destroy(node_slot->sign_ctx);
 		}
+#ifdef SSL_CTRL_SET_TLSEXT_HOSTNAME
+		// if there is a SNI context active, destroy it
+		if (node_slot->sni_enabled) {
+			uwsgi_ssl_del_sni_item(node_slot->key, node_slot->keylen);
+		}
 #endif
+#endif
+		free(node_slot->nodes_array);
+		free(node_slot->ring);
 		free(node_slot);
 	}
 
-end:
-
 	return ret;
 }
 
-struct uwsgi_subscribe_node *uwsgi_add_subscribe_node(struct uwsgi_subscribe_slot **slot, struct uwsgi_subscribe_req *usr) {
+struct uwsgi_subscribe_node *uwsgi_add_subscribe_node(struct uwsgi_subscribe_table *slot, struct uwsgi_subscribe_req *usr) {
 
-	struct uwsgi_subscribe_slot *current_slot = uwsgi_get_subscribe_slot(slot, usr->key, usr->keylen), *old_slot = NULL, *a_slot;
+	struct uwsgi_subscribe_slot *current_slot = uwsgi_get_subscribe_slot(slot, usr->key, usr->keylen);
 	struct uwsgi_subscribe_node *node, *old_node = NULL;
 
 	if (usr->address_len > 0xff || usr->address_len == 0)
@@ -424,15 +907,7 @@ struct uwsgi_subscribe_node *uwsgi_add_subscribe_node(struct uwsgi_subscribe_slo
 					return NULL;
 				}
 #endif
-				// remove death mark and update cores and load
-				node->death_mark = 0;
-				node->last_check = uwsgi_now();
-				node->cores = usr->cores;
-				node->load = usr->load;
-				node->weight = usr->weight;
-				if (!node->weight)
-					node->weight = 1;
-				node->last_requests = 0;
+				uwsgi_subscribe_node_refresh(current_slot, node, usr);
 				return node;
 			}
 			old_node = node;
@@ -448,7 +923,7 @@ struct uwsgi_subscribe_node *uwsgi_add_subscribe_node(struct uwsgi_subscribe_slo
                 uwsgi_subscription_sni_check(current_slot, usr);
 #endif
 
-		node = uwsgi_malloc(sizeof(struct uwsgi_subscribe_node));
+		node = uwsgi_calloc(sizeof(struct uwsgi_subscribe_node));
 		node->len = usr->address_len;
 		node->modifier1 = usr->modifier1;
 		node->modifier2 = usr->modifier2;
@@ -480,6 +955,7 @@ struct uwsgi_subscribe_node *uwsgi_add_subscribe_node(struct uwsgi_subscribe_slo
 			old_node->next = node;
 		}
 		node->next = NULL;
+		uwsgi_subscribe_slot_index_add(current_slot, node);
 
 		uwsgi_log("[uwsgi-subscription for pid %d] %.*s => new node: %.*s\n", (int) uwsgi.mypid, usr->keylen, usr->key, usr->address_len, usr->address);
 		if (node->notify[0]) {
@@ -505,10 +981,8 @@ struct uwsgi_subscribe_node *uwsgi_add_subscribe_node(struct uwsgi_subscribe_slo
 
 		}
 #endif
-		current_slot = uwsgi_malloc(sizeof(struct uwsgi_subscribe_slot));
-		uint32_t hash = djb33x_hash(usr->key, usr->keylen);
-		int hash_key = hash % 0xffff;
-		current_slot->hash = hash_key;
+		current_slot = uwsgi_calloc(sizeof(struct uwsgi_subscribe_slot));
+		current_slot->hash = uwsgi_subscribe_table_hash(slot, usr->key, usr->keylen);
 #ifdef UWSGI_SSL
 		if (uwsgi.subscriptions_sign_check_dir) {
 			current_slot->sign_public_key = PEM_read_PUBKEY(kf, NULL, NULL, NULL);
@@ -549,7 +1023,7 @@ struct uwsgi_subscribe_node *uwsgi_add_subscribe_node(struct uwsgi_subscribe_slo
 		current_slot->sni_enabled = 0;
 		uwsgi_subscription_sni_check(current_slot, usr);
 #endif
-		current_slot->nodes = uwsgi_malloc(sizeof(struct uwsgi_subscribe_node));
+		current_slot->nodes = uwsgi_calloc(sizeof(struct uwsgi_subscribe_node));
 		current_slot->nodes->slot = current_slot;
 		current_slot->nodes->len = usr->address_len;
 		current_slot->nodes->reference = 0;
@@ -579,27 +1053,11 @@ struct uwsgi_subscribe_node *uwsgi_add_subscribe_node(struct uwsgi_subscribe_slo
 		current_slot->nodes->last_check = uwsgi_now();
 
 		current_slot->nodes->next = NULL;
+		uwsgi_subscribe_slot_index_add(current_slot, current_slot->nodes);
 
-		a_slot = slot[hash_key];
-		while (a_slot) {
-			old_slot = a_slot;
-			a_slot = a_slot->next;
-		}
-
+		uwsgi_subscribe_table_insert(slot, current_slot);
 
-		if (old_slot) {
-			old_slot->next = current_slot;
-		}
-
-		current_slot->prev = old_slot;
-		current_slot->next = NULL;
-
-
-		if (!slot[hash_key] || current_slot->prev == NULL) {
-			slot[hash_key] = current_slot;
-		}
-
-		uwsgi_log("[uwsgi-subscription for pid %d] new pool: %.*s (hash key: %d)\n", (int) uwsgi.mypid, usr->keylen, usr->key, current_slot->hash);
+		uwsgi_log("[uwsgi-subscription for pid %d] new pool: %.*s (hash key: %u)\n", (int) uwsgi.mypid, usr->keylen, usr->key, current_slot->hash);
 		uwsgi_log("[uwsgi-subscription for pid %d] %.*s => new node: %.*s\n", (int) uwsgi.mypid, usr->keylen, usr->key, usr->address_len, usr->address);
 
 		if (current_slot->nodes->notify[0]) {
@@ -692,6 +1150,19 @@ static void send_subscription(int sfd, char *host, char *message, uint16_t messa
         	close(fd);
 }
 
+// the vars describing the node (shared by single and batched subscriptions)
+static int uwsgi_subscription_ub_node(struct uwsgi_buffer *ub) {
+        if (uwsgi_buffer_append_keynum(ub, "cores", 5, uwsgi.numproc * uwsgi.cores)) return -1;
+        if (uwsgi_buffer_append_keynum(ub, "load", 4, uwsgi.shared->load)) return -1;
+        if (uwsgi.auto_weight) {
+                if (uwsgi_buffer_append_keynum(ub, "weight", 6, uwsgi.numproc * uwsgi.cores )) return -1;
+        }
+        else {
+                if (uwsgi_buffer_append_keynum(ub, "weight", 6, uwsgi.weight )) return -1;
+        }
+        return 0;
+}
+
 static struct uwsgi_buffer *uwsgi_subscription_ub(char *key, size_t keysize, uint8_t modifier1, uint8_t modifier2, uint8_t cmd, char *socket_name, char *sign, char *sni_key, char *sni_crt, char *sni_ca) {
 	struct uwsgi_buffer *ub =  uwsgi_buffer_new(4096);
 
@@ -702,14 +1173,7 @@ static struct uwsgi_buffer *uwsgi_subscription_ub(char *key, size_t keysize, uin
         if (uwsgi_buffer_append_keyval(ub, "address", 7, socket_name, strlen(socket_name))) goto end;
         if (uwsgi_buffer_append_keynum(ub, "modifier1", 9, modifier1)) goto end;
         if (uwsgi_buffer_append_keynum(ub, "modifier2", 9, modifier2)) goto end;
-        if (uwsgi_buffer_append_keynum(ub, "cores", 5, uwsgi.numproc * uwsgi.cores)) goto end;
-        if (uwsgi_buffer_append_keynum(ub, "load", 4, uwsgi.shared->load)) goto end;
-        if (uwsgi.auto_weight) {
-                if (uwsgi_buffer_append_keynum(ub, "weight", 6, uwsgi.numproc * uwsgi.cores )) goto end;
-        }
-        else {
-                if (uwsgi_buffer_append_keynum(ub, "weight", 6, uwsgi.weight )) goto end;
-        }
+        if (uwsgi_subscription_ub_node(ub)) goto end;
 
         if (sni_key) {
                 if (uwsgi_buffer_append_keyval(ub, "sni_key", 7, sni_key, strlen(sni_key))) goto end;
@@ -774,7 +1238,295 @@ void uwsgi_send_subscription_from_fd(int fd, char *udp_address, char *key, size_
 }
 
 
+/*
+
+	how batched subscriptions work:
+
+	with --subscribe-batch the keys announced by uwsgi_subscribe_all() are not sent one per packet: they are
+	collected by (server, address) and sent as UWSGI_SUBSCRIBE_BATCH packets (modifier2 2) made of the node vars
+	(address, cores, load, weight, notify), an "add" var for every announced key and a "del" var for every key
+	no more announced since the previous round. modifier1 and modifier2 vars apply to all of the following keys.
+	Packets are never bigger than UWSGI_SUBSCRIBE_BATCH_SIZE, bigger batches are split.
+
+	with --subscribe-delta keys are sent only when they change and every subscribe-delta-refresh rounds.
+	In the other rounds a UWSGI_SUBSCRIBE_HEARTBEAT packet (modifier2 3) is sent: the node vars, the name of
+	the subscription hash algo and a "digest" var with the 32bit (little endian) hashes of all of the keys.
+	The router refreshes the node with the same address in the slots with those hashes, so only 4 bytes
+	per key are sent and no key is compared. A router that missed a key (e.g. it has been restarted)
+	will get it with the next full refresh.
+
+	Signed and SNI-enabled subscriptions are always sent one per packet.
+
+	Routers older than this format treat every packet with modifier2 != 0 as an unsubscription of its "key" var
+	(and read only 4k): batches and heartbeats never carry a "key" var, so for them they are no-ops.
+	As they would never get the keys, --subscribe-batch/--subscribe-delta must be enabled only after
+	all of the routers have been upgraded.
+
+*/
+
+struct uwsgi_subscription_batch_key {
+	uint32_t hash;
+	char *key;
+	uint16_t keylen;
+	uint8_t modifier1;
+	uint8_t modifier2;
+};
+
+struct uwsgi_subscription_batch {
+	char *server;
+	char *address;
+	// keys announced in the current round
+	struct uwsgi_subscription_batch_key *keys;
+	uint64_t keys_cnt;
+	uint64_t keys_size;
+	// keys announced in the previous one
+	struct uwsgi_subscription_batch_key *sent;
+	uint64_t sent_cnt;
+	uint64_t rounds;
+	struct uwsgi_subscription_batch *next;
+};
+
+static struct uwsgi_subscription_batch *uwsgi_subscription_batches = NULL;
+static int uwsgi_subscription_batching = 0;
+
+static int uwsgi_subscription_batch_cmp(const void *a, const void *b) {
+	const struct uwsgi_subscription_batch_key *k1 = (const struct uwsgi_subscription_batch_key *) a;
+	const struct uwsgi_subscription_batch_key *k2 = (const struct uwsgi_subscription_batch_key *) b;
+	if (k1->hash != k2->hash)
+		return k1->hash < k2->hash ? -1 : 1;
+	uint16_t len = k1->keylen < k2->keylen ? k1->keylen : k2->keylen;
+	int ret = memcmp(k1->key, k2->key, len);
+	if (ret)
+		return ret;
+	return (int) k1->keylen - (int) k2->keylen;
+}
+
+static void uwsgi_subscription_batch_free_keys(struct uwsgi_subscription_batch_key *keys, uint64_t n) {
+	uint64_t i;
+	for(i=0;i<n;i++) {
+		free(keys[i].key);
+	}
+	free(keys);
+}
+
+// returns 0 if the key has been queued
+static int uwsgi_subscription_batch_add(char *server, char *address, char *key, size_t keysize, uint8_t modifier1, uint8_t modifier2) {
+	if (keysize == 0 || keysize > 0xff)
+		return -1;
+
+	if (!address) {
+		if (!uwsgi.sockets)
+			return 0;
+		address = uwsgi.sockets->name;
+	}
+
+	struct uwsgi_subscription_batch *usb = uwsgi_subscription_batches, *last = NULL;
+	while (usb) {
+		if (!strcmp(usb->server, server) && !strcmp(usb->address, address))
+			break;
+		last = usb;
+		usb = usb->next;
+	}
+
+	if (!usb) {
+		usb = uwsgi_calloc(sizeof(struct uwsgi_subscription_batch));
+		usb->server = uwsgi_str(server);
+		usb->address = uwsgi_str(address);
+		if (last) {
+			last->next = usb;
+		}
+		else {
+			uwsgi_subscription_batches = usb;
+		}
+	}
+
+	if (usb->keys_cnt >= usb->keys_size) {
+		usb->keys_size = usb->keys_size ? usb->keys_size * 2 : 16;
+		usb->keys = realloc(usb->keys, sizeof(struct uwsgi_subscription_batch_key) * usb->keys_size);
+		if (!usb->keys) {
+			uwsgi_error("uwsgi_subscription_batch_add()/realloc()");
+			exit(1);
+		}
+	}
+
+	struct uwsgi_subscription_batch_key *usbk = &usb->keys[usb->keys_cnt++];
+	usbk->key = uwsgi_concat2n(key, keysize, "", 0);
+	usbk->keylen = keysize;
+	usbk->hash = uwsgi_subscription_key_hash(usbk->key, usbk->keylen);
+	usbk->modifier1 = modifier1;
+	usbk->modifier2 = modifier2;
+	return 0;
+}
+
+static struct uwsgi_buffer *uwsgi_subscription_batch_ub(struct uwsgi_subscription_batch *usb, uint8_t cmd) {
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(UWSGI_SUBSCRIBE_BATCH_SIZE);
+	// make space for uwsgi header
+	ub->pos = 4;
+	if (uwsgi_buffer_append_keyval(ub, "address", 7, usb->address, strlen(usb->address))) goto end;
+	if (uwsgi_subscription_ub_node(ub)) goto end;
+	if (cmd == UWSGI_SUBSCRIBE_HEARTBEAT) {
+		struct uwsgi_hash_algo *uha = uwsgi_subscription_hash_algo();
+		if (uwsgi_buffer_append_keyval(ub, "hash", 4, uha->name, strlen(uha->name))) goto end;
+	}
+	else if (uwsgi.subscription_notify_socket) {
+		if (uwsgi_buffer_append_keyval(ub, "notify", 6, uwsgi.subscription_notify_socket, strlen(uwsgi.subscription_notify_socket))) goto end;
+	}
+	else if (uwsgi.notify_socket_fd > -1 && uwsgi.notify_socket) {
+		if (uwsgi_buffer_append_keyval(ub, "notify", 6, uwsgi.notify_socket, strlen(uwsgi.notify_socket))) goto end;
+	}
+	return ub;
+end:
+	uwsgi_buffer_destroy(ub);
+	return NULL;
+}
+
+static void uwsgi_subscription_batch_send(struct uwsgi_subscription_batch *usb, struct uwsgi_buffer *ub, uint8_t cmd) {
+	if (!uwsgi_buffer_set_uh(ub, 224, cmd)) {
+		send_subscription(-2, usb->server, ub->buf, ub->pos);
+	}
+	uwsgi_buffer_destroy(ub);
+}
+
+// append a key to add (or to delete) to the current packet, sending it when full
+static void uwsgi_subscription_batch_append(struct uwsgi_subscription_batch *usb, struct uwsgi_buffer **ub, int *modifiers, struct uwsgi_subscription_batch_key *usbk, int unkey) {
+	// the key and (at worst) both of the modifiers vars
+	size_t need = 2 + 3 + 2 + usbk->keylen + ((2 + 9 + 2 + 3) * 2);
+	if (*ub && (*ub)->pos + need > UWSGI_SUBSCRIBE_BATCH_SIZE) {
+		uwsgi_subscription_batch_send(usb, *ub, UWSGI_SUBSCRIBE_BATCH);
+		*ub = NULL;
+	}
+	if (!*ub) {
+		*ub = uwsgi_subscription_batch_ub(usb, UWSGI_SUBSCRIBE_BATCH);
+		if (!*ub) return;
+		modifiers[0] = -1;
+		modifiers[1] = -1;
+	}
+	if (modifiers[0] != usbk->modifier1) {
+		if (uwsgi_buffer_append_keynum(*ub, "modifier1", 9, usbk->modifier1)) return;
+		modifiers[0] = usbk->modifier1;
+	}
+	if (modifiers[1] != usbk->modifier2) {
+		if (uwsgi_buffer_append_keynum(*ub, "modifier2", 9, usbk->modifier2)) return;
+		modifiers[1] = usbk->modifier2;
+	}
+	if (unkey) {
+		uwsgi_buffer_append_keyval(*ub, "del", 3, usbk->key, usbk->keylen);
+	}
+	else {
+		uwsgi_buffer_append_keyval(*ub, "add", 3, usbk->key, usbk->keylen);
+	}
+}
+
+static void uwsgi_subscription_batch_heartbeat(struct uwsgi_subscription_batch *usb) {
+	uint64_t i = 0;
+	while (i < usb->keys_cnt) {
+		struct uwsgi_buffer *ub = uwsgi_subscription_batch_ub(usb, UWSGI_SUBSCRIBE_HEARTBEAT);
+		if (!ub) return;
+		uint64_t n = (UWSGI_SUBSCRIBE_BATCH_SIZE - ub->pos - (2 + 6 + 2)) / 4;
+		if (n > usb->keys_cnt - i)
+			n = usb->keys_cnt - i;
+		char *digest = uwsgi_malloc(n * 4);
+		uint64_t j;
+		for(j=0;j<n;j++) {
+			uint32_t hash = usb->keys[i + j].hash;
+			digest[j * 4] = (uint8_t) (hash & 0xff);
+			digest[(j * 4) + 1] = (uint8_t) ((hash >> 8) & 0xff);
+			digest[(j * 4) + 2] = (uint8_t) ((hash >> 16) & 0xff);
+			digest[(j * 4) + 3] = (uint8_t) ((hash >> 24) & 0xff);
+		}
+		if (uwsgi_buffer_append_keyval(ub, "digest", 6, digest, n * 4)) {
+			free(digest);
+			uwsgi_buffer_destroy(ub);
+			return;
+		}
+		free(digest);
+		uwsgi_subscription_batch_send(usb, ub, UWSGI_SUBSCRIBE_HEARTBEAT);
+		i += n;
+	}
+}
+
+static void uwsgi_subscription_batch_flush(uint8_t cmd) {
+	struct uwsgi_subscription_batch *usb;
+	uwsgi_foreach(usb, uwsgi_subscription_batches) {
+		uint64_t i, j;
+		if (usb->keys_cnt > 1) {
+			qsort(usb->keys, usb->keys_cnt, sizeof(struct uwsgi_subscription_batch_key), uwsgi_subscription_batch_cmp);
+			// remove duplicates
+			for(i=1,j=0;i<usb->keys_cnt;i++) {
+				if (!uwsgi_subscription_batch_cmp(&usb->keys[j], &usb->keys[i])) {
+					free(usb->keys[i].key);
+					continue;
+				}
+				usb->keys[++j] = usb->keys[i];
+			}
+			usb->keys_cnt = j + 1;
+		}
+
+		int refresh = uwsgi.subscribe_delta_refresh > 0 ? uwsgi.subscribe_delta_refresh : 1;
+		int full = cmd || !uwsgi.subscribe_delta || (usb->rounds % refresh) == 0;
+
+		struct uwsgi_buffer *ub = NULL;
+		int modifiers[2];
+		// both of the lists are sorted, walk them together to find new and removed keys
+		i = 0; j = 0;
+		while (i < usb->keys_cnt || j < usb->sent_cnt) {
+			int ret;
+			if (i >= usb->keys_cnt) {
+				ret = 1;
+			}
+			else if (j >= usb->sent_cnt) {
+				ret = -1;
+			}
+			else {
+				ret = uwsgi_subscription_batch_cmp(&usb->keys[i], &usb->sent[j]);
+			}
+			// removed key
+			if (ret > 0) {
+				uwsgi_subscription_batch_append(usb, &ub, modifiers, &usb->sent[j], 1);
+				j++;
+				continue;
+			}
+			int is_new = ret < 0 || usb->keys[i].modifier1 != usb->sent[j].modifier1 || usb->keys[i].modifier2 != usb->sent[j].modifier2;
+			if (cmd || full || is_new) {
+				uwsgi_subscription_batch_append(usb, &ub, modifiers, &usb->keys[i], cmd);
+			}
+			i++;
+			if (ret == 0)
+				j++;
+		}
+		if (ub) {
+			uwsgi_subscription_batch_send(usb, ub, UWSGI_SUBSCRIBE_BATCH);
+		}
+
+		// keys not sent in this round are kept alive by the heartbeat
+		if (!full && usb->keys_cnt > 0) {
+			uwsgi_subscription_batch_heartbeat(usb);
+		}
+
+		uwsgi_subscription_batch_free_keys(usb->sent, usb->sent_cnt);
+		if (cmd) {
+			// after an unsubscription start again with a full round
+			uwsgi_subscription_batch_free_keys(usb->keys, usb->keys_cnt);
+			usb->sent = NULL;
+			usb->sent_cnt = 0;
+			usb->rounds = 0;
+		}
+		else {
+			usb->sent = usb->keys;
+			usb->sent_cnt = usb->keys_cnt;
+			usb->rounds++;
+		}
+		usb->keys = NULL;
+		usb->keys_cnt = 0;
+		usb->keys_size = 0;
+	}
+}
+
 void uwsgi_send_subscription(char *udp_address, char *key, size_t keysize, uint8_t modifier1, uint8_t modifier2, uint8_t cmd, char *socket_name, char *sign, char *sni_key, char *sni_crt, char *sni_ca) {
+	if (uwsgi_subscription_batching && !sign && !sni_key && !sni_crt && !sni_ca) {
+		if (!uwsgi_subscription_batch_add(udp_address, socket_name, key, keysize, modifier1, modifier2))
+			return;
+	}
 	uwsgi_send_subscription_from_fd(-1, udp_address, key, keysize, modifier1, modifier2, cmd, socket_name, sign, sni_key, sni_crt, sni_ca);
 }
 
@@ -803,20 +1555,19 @@ int uwsgi_subscription_sign_check(struct uwsgi_subscribe_slot *slot, struct uwsg
 }
 #endif
 
-int uwsgi_no_subscriptions(struct uwsgi_subscribe_slot **slot) {
-	int i;
-	for (i = 0; i < UMAX16; i++) {
-		if (slot[i])
-			return 0;
-	}
-	return 1;
+int uwsgi_no_subscriptions(struct uwsgi_subscribe_table *slot) {
+	return slot->items == 0;
 }
 
-struct uwsgi_subscribe_slot **uwsgi_subscription_init_ht() {
+struct uwsgi_subscribe_table *uwsgi_subscription_init_ht() {
 	if (!uwsgi.subscription_algo) {
 		uwsgi_subscription_set_algo(NULL);
 	}
-	return uwsgi_calloc(sizeof(struct uwsgi_subscription_slot *) * UMAX16);
+	// the hash algo is resolved on first usage, as hash algos are registered after options parsing
+	struct uwsgi_subscribe_table *ust = uwsgi_calloc(sizeof(struct uwsgi_subscribe_table));
+	ust->size = UWSGI_SUBSCRIBE_TABLE_MIN;
+	ust->buckets = uwsgi_calloc(sizeof(struct uwsgi_subscribe_bucket) * ust->size);
+	return ust;
 }
 
 void uwsgi_subscribe(char *subscription, uint8_t cmd) {
@@ -1030,6 +1781,7 @@ end:
 void uwsgi_subscribe_all(uint8_t cmd, int verbose) {
 
 	if (uwsgi.subscriptions_blocked) return;
+	uwsgi_subscription_batching = uwsgi.subscribe_batch || uwsgi.subscribe_delta;
 	// -- subscribe
 	struct uwsgi_string_list *subscriptions = uwsgi.subscriptions;
         while (subscriptions) {
@@ -1050,5 +1802,10 @@ void uwsgi_subscribe_all(uint8_t cmd, int verbose) {
                 subscriptions = subscriptions->next;
         }
 
+	if (uwsgi_subscription_batching) {
+		uwsgi_subscription_batching = 0;
+		uwsgi_subscription_batch_flush(cmd);
+	}
+
 }
 
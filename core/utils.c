@@ -3137,6 +3137,10 @@ void escape_json(char *src, size_t len, char *dst) {
 			*ptr++ = '\\';
 			*ptr++ = '"';
 		}
+		else if (src[i] == '\\') {
+			*ptr++ = '\\';
+			*ptr++ = '\\';
+		}
 		else {
 			*ptr++ = src[i];
 		}
@@ -3856,6 +3860,11 @@ int uwsgi_kvlist_parse(char *src, size_t len, char list_separator, char kv_separ
 }
 
 int uwsgi_send_http_stats(int fd) {
+	return uwsgi_send_http_stats_query(fd, NULL, 0);
+}
+
+// like uwsgi_send_http_stats() but stores the query string of the request in 'query'
+int uwsgi_send_http_stats_query(int fd, char *query, size_t query_size) {
 
 	char buf[4096];
 
@@ -3863,9 +3872,25 @@ int uwsgi_send_http_stats(int fd) {
 	if (ret <= 0)
 		return -1;
 
-	if (read(fd, buf, 4096) <= 0)
+	ssize_t rlen = read(fd, buf, 4096);
+	if (rlen <= 0)
 		return -1;
 
+	if (query && query_size > 0) {
+		query[0] = 0;
+		// GET /?query HTTP/1.x
+		char *qs = memchr(buf, '?', rlen);
+		char *eol = memchr(buf, '\n', rlen);
+		if (qs && (!eol || qs < eol)) {
+			qs++;
+			size_t qs_len = 0;
+			while (qs + qs_len < buf + rlen && qs[qs_len] != ' ' && qs[qs_len] != '\r' && qs[qs_len] != '\n') qs_len++;
+			if (qs_len >= query_size) qs_len = query_size - 1;
+			memcpy(query, qs, qs_len);
+			query[qs_len] = 0;
+		}
+	}
+
 	struct uwsgi_buffer *ub = uwsgi_buffer_new(uwsgi.page_size);
 	if (!ub)
 		return -1;
@@ -4131,6 +4156,21 @@ uint64_t uwsgi_be64(char *buf) {
 	return ret;
 }
 
+uint16_t uwsgi_le16(char *buf) {
+	uint8_t *src = (uint8_t *) buf;
+	return (uint16_t) (src[0] | (src[1] << 8));
+}
+
+uint64_t uwsgi_le64(char *buf) {
+	uint8_t *src = (uint8_t *) buf;
+	uint64_t ret = 0;
+	int i;
+	for (i = 7; i >= 0; i--) {
+		ret = (ret << 8) | src[i];
+	}
+	return ret;
+}
+
 char *uwsgi_get_header(struct wsgi_request *wsgi_req, char *hh, uint16_t len, uint16_t * rlen) {
 	char *key = uwsgi_malloc(len + 6);
 	uint16_t key_len = len;
@@ -562,9 +562,10 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"udp", required_argument, 0, "run the udp server on the specified address", uwsgi_opt_set_str, &uwsgi.udp_socket, UWSGI_OPT_MASTER},
 	{"stats", required_argument, 0, "enable the stats server on the specified address", uwsgi_opt_set_str, &uwsgi.stats, UWSGI_OPT_MASTER},
 	{"stats-server", required_argument, 0, "enable the stats server on the specified address", uwsgi_opt_set_str, &uwsgi.stats, UWSGI_OPT_MASTER},
-	{"stats-http", no_argument, 0, "prefix stats server json output with http headers", uwsgi_opt_true, &uwsgi.stats_http, UWSGI_OPT_MASTER},
+	{"stats-http", no_argument, 0, "prefix stats server json output with http headers (the query string of the request filters the output)", uwsgi_opt_true, &uwsgi.stats_http, UWSGI_OPT_MASTER},
 	{"stats-minified", no_argument, 0, "minify statistics json output", uwsgi_opt_true, &uwsgi.stats_minified, UWSGI_OPT_MASTER},
 	{"stats-min", no_argument, 0, "minify statistics json output", uwsgi_opt_true, &uwsgi.stats_minified, UWSGI_OPT_MASTER},
+	{"stats-stream", no_argument, 0, "stream the stats server json output while it is generated", uwsgi_opt_true, &uwsgi.stats_stream, UWSGI_OPT_MASTER},
 	{"stats-push", required_argument, 0, "push the stats json to the specified destination", uwsgi_opt_add_string_list, &uwsgi.requested_stats_pushers, UWSGI_OPT_MASTER|UWSGI_OPT_METRICS},
 	{"stats-pusher-default-freq", required_argument, 0, "set the default frequency of stats pushers", uwsgi_opt_set_int, &uwsgi.stats_pusher_default_freq, UWSGI_OPT_MASTER},
 	{"stats-pushers-default-freq", required_argument, 0, "set the default frequency of stats pushers", uwsgi_opt_set_int, &uwsgi.stats_pusher_default_freq, UWSGI_OPT_MASTER},
@@ -602,12 +603,19 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"subscriptions-credentials-check", required_argument, 0, "add a directory to search for subscriptions key credentials", uwsgi_opt_add_string_list, &uwsgi.subscriptions_credentials_check_dir, UWSGI_OPT_MASTER},
 	{"subscriptions-use-credentials", no_argument, 0, "enable management of SCM_CREDENTIALS in subscriptions UNIX sockets", uwsgi_opt_true, &uwsgi.subscriptions_use_credentials, 0},
 	{"subscription-algo", required_argument, 0, "set load balancing algorithm for the subscription system", uwsgi_opt_ssa, NULL, 0},
+	{"subscription-ewma-decay", required_argument, 0, "set the decay time (in milliseconds) of the response times average used by the ewma subscription algorithm (default 10000)", uwsgi_opt_set_int, &uwsgi.subscription_ewma_decay, 0},
+	{"subscription-ring-vnodes", required_argument, 0, "set the number of points (multiplied by the weight) each node gets in the ketama subscription ring (default 160)", uwsgi_opt_set_int, &uwsgi.subscription_ring_vnodes, 0},
+	{"subscription-ring-load", required_argument, 0, "set the maximum load (percentage of the average) of a node before the ketama-bounded subscription algorithm spills to the next one (default 125)", uwsgi_opt_set_int, &uwsgi.subscription_ring_load, 0},
 	{"subscription-dotsplit", no_argument, 0, "try to fallback to the next part (dot based) in subscription key", uwsgi_opt_true, &uwsgi.subscription_dotsplit, 0},
+	{"subscription-hash", required_argument, 0, "set the hash algorithm used for indexing subscription keys (default: xxh3)", uwsgi_opt_set_str, &uwsgi.subscription_hash, 0},
 	{"subscribe-to", required_argument, 0, "subscribe to the specified subscription server", uwsgi_opt_add_string_list, &uwsgi.subscriptions, UWSGI_OPT_MASTER},
 	{"st", required_argument, 0, "subscribe to the specified subscription server", uwsgi_opt_add_string_list, &uwsgi.subscriptions, UWSGI_OPT_MASTER},
 	{"subscribe", required_argument, 0, "subscribe to the specified subscription server", uwsgi_opt_add_string_list, &uwsgi.subscriptions, UWSGI_OPT_MASTER},
 	{"subscribe2", required_argument, 0, "subscribe to the specified subscription server using advanced keyval syntax", uwsgi_opt_add_string_list, &uwsgi.subscriptions2, UWSGI_OPT_MASTER},
 	{"subscribe-freq", required_argument, 0, "send subscription announce at the specified interval", uwsgi_opt_set_int, &uwsgi.subscribe_freq, 0},
+	{"subscribe-batch", no_argument, 0, "send subscription announces batched (multiple keys per packet, routers without batches support ignore them: upgrade the routers first)", uwsgi_opt_true, &uwsgi.subscribe_batch, UWSGI_OPT_MASTER},
+	{"subscribe-delta", no_argument, 0, "send batched subscription announces only on changes (and every subscribe-delta-refresh announces), heartbeats otherwise (implies subscribe-batch, upgrade the routers first)", uwsgi_opt_true, &uwsgi.subscribe_delta, UWSGI_OPT_MASTER},
+	{"subscribe-delta-refresh", required_argument, 0, "send a full subscription announce every the specified number of announces in delta mode (default 6)", uwsgi_opt_set_int, &uwsgi.subscribe_delta_refresh, 0},
 	{"subscription-tolerance", required_argument, 0, "set tolerance for subscription servers", uwsgi_opt_set_int, &uwsgi.subscription_tolerance, 0},
 	{"unsubscribe-on-graceful-reload", no_argument, 0, "force unsubscribe request even during graceful reload", uwsgi_opt_true, &uwsgi.unsubscribe_on_graceful_reload, 0},
 	{"snmp", optional_argument, 0, "enable the embedded snmp server", uwsgi_opt_snmp, NULL, 0},
@@ -634,6 +642,7 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"privileged-binary-patch-arg", required_argument, 0, "patch the uwsgi binary with a new command and arguments (before privileges drop)", uwsgi_opt_set_str, &uwsgi.privileged_binary_patch_arg, 0},
 	{"unprivileged-binary-patch-arg", required_argument, 0, "patch the uwsgi binary with a new command and arguments (after privileges drop)", uwsgi_opt_set_str, &uwsgi.unprivileged_binary_patch_arg, 0},
 	{"async", required_argument, 0, "enable async mode with specified cores", uwsgi_opt_set_int, &uwsgi.async, 0},
+	{"event-batch", required_argument, 0, "set the max number of events the master and the async loops manage for each wakeup (default 64)", uwsgi_opt_set_int, &uwsgi.event_batch, 0},
 	{"max-fd", required_argument, 0, "set maximum number of file descriptors (requires root privileges)", uwsgi_opt_set_int, &uwsgi.requested_max_fd, 0},
 	{"logto", required_argument, 0, "set logfile/udp address", uwsgi_opt_set_str, &uwsgi.logfile, 0},
 	{"logto2", required_argument, 0, "log to specified file or udp address after privileges drop", uwsgi_opt_set_str, &uwsgi.logto2, 0},
@@ -689,6 +698,8 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"log-master", no_argument, 0, "delegate logging to master process", uwsgi_opt_true, &uwsgi.log_master, UWSGI_OPT_MASTER},
 	{"log-master-bufsize", required_argument, 0, "set the buffer size for the master logger. bigger log messages will be truncated", uwsgi_opt_set_64bit, &uwsgi.log_master_bufsize, 0},
 	{"log-master-stream", no_argument, 0, "create the master logpipe as SOCK_STREAM", uwsgi_opt_true, &uwsgi.log_master_stream, 0},
+	{"req-log-ring", required_argument, 0, "log requests via per-core shared memory rings of the specified size (drained by the master or the threaded logger)", uwsgi_opt_set_64bit, &uwsgi.req_log_ring, UWSGI_OPT_REQ_LOG_MASTER},
+	{"req-log-ring-freq", required_argument, 0, "set the request log rings drain frequency (in milliseconds) of the master or the threaded logger (default 10)", uwsgi_opt_set_int, &uwsgi.req_log_ring_freq, 0},
 	{"log-master-req-stream", no_argument, 0, "create the master requests logpipe as SOCK_STREAM", uwsgi_opt_true, &uwsgi.log_master_req_stream, 0},
 	{"log-reopen", no_argument, 0, "reopen log after reload", uwsgi_opt_true, &uwsgi.log_reopen, 0},
 	{"log-truncate", no_argument, 0, "truncate log on startup", uwsgi_opt_true, &uwsgi.log_truncate, 0},
@@ -803,6 +814,7 @@ static struct uwsgi_option uwsgi_base_options[] = {
 
 	{"router-list", no_argument, 0, "list enabled routers", uwsgi_opt_true, &uwsgi.router_list, 0},
 	{"routers-list", no_argument, 0, "list enabled routers", uwsgi_opt_true, &uwsgi.router_list, 0},
+	{"routing-stats", no_argument, 0, "collect per-route evaluations, matches and time spent (exported by the stats server)", uwsgi_opt_true, &uwsgi.routing_stats, 0},
 #endif
 
 
@@ -843,6 +855,12 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"static-safe", required_argument, 0, "skip security checks if the file is under the specified path", uwsgi_opt_add_string_list, &uwsgi.static_safe, UWSGI_OPT_MIME},
 	{"static-cache-paths", required_argument, 0, "put resolved paths in the uWSGI cache for the specified amount of seconds", uwsgi_opt_set_int, &uwsgi.use_static_cache_paths, UWSGI_OPT_MIME|UWSGI_OPT_MASTER},
 	{"static-cache-paths-name", required_argument, 0, "use the specified cache for static paths", uwsgi_opt_set_str, &uwsgi.static_cache_paths_name, UWSGI_OPT_MIME|UWSGI_OPT_MASTER},
+	{"static-etag", no_argument, 0, "add a strong ETag (mtime, size and inode) to static files and honour If-None-Match", uwsgi_opt_true, &uwsgi.static_etag, UWSGI_OPT_MIME},
+	{"static-open-cache", required_argument, 0, "keep up to the specified number of static files (with their stat, gzip variant and mime type) open in each worker", uwsgi_opt_set_64bit, &uwsgi.static_open_cache, UWSGI_OPT_MIME},
+	{"static-open-cache-ttl", required_argument, 0, "set the validity (in seconds) of the static open file cache items (default 10)", uwsgi_opt_set_int, &uwsgi.static_open_cache_ttl, UWSGI_OPT_MIME},
+	{"static-open-cache-monitor", required_argument, 0, "invalidate the static open file cache when the specified filesystem object is modified", uwsgi_opt_add_string_list, &uwsgi.static_open_cache_monitor, UWSGI_OPT_MIME|UWSGI_OPT_MASTER},
+	{"static-store", required_argument, 0, "load the files of the specified directory (and their compressed variants) in shared memory and serve them from there", uwsgi_opt_add_string_list, &uwsgi.static_store, UWSGI_OPT_MIME},
+	{"static-store-max-file", required_argument, 0, "set the maximum size of the files loaded by --static-store in bytes (default 1048576)", uwsgi_opt_set_64bit, &uwsgi.static_store_max_file, UWSGI_OPT_MIME},
 #ifdef __APPLE__
 	{"mimefile", required_argument, 0, "set mime types file path (default /etc/apache2/mime.types)", uwsgi_opt_add_string_list, &uwsgi.mime_file, UWSGI_OPT_MIME},
 	{"mime-file", required_argument, 0, "set mime types file path (default /etc/apache2/mime.types)", uwsgi_opt_add_string_list, &uwsgi.mime_file, UWSGI_OPT_MIME},
@@ -874,6 +892,7 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"honour-range", no_argument, 0, "enable support for the HTTP Range header", uwsgi_opt_true, &uwsgi.honour_range, 0},
 
 	{"offload-threads", required_argument, 0, "set the number of offload threads to spawn (per-worker, default 0)", uwsgi_opt_set_int, &uwsgi.offload_threads, 0},
+	{"offload-threads-events", required_argument, 0, "set the max number of events an offload thread manages for each wakeup (default 64)", uwsgi_opt_set_int, &uwsgi.offload_threads_events, 0},
 	{"offload-thread", required_argument, 0, "set the number of offload threads to spawn (per-worker, default 0)", uwsgi_opt_set_int, &uwsgi.offload_threads, 0},
 
 	{"file-serve-mode", required_argument, 0, "set static file serving mode", uwsgi_opt_fileserve_mode, NULL, UWSGI_OPT_MIME},
@@ -2402,7 +2421,7 @@ void uwsgi_setup(int argc, char *argv[], char *envp[]) {
 
 int uwsgi_start(void *v_argv) {
 
-	int i, j;
+	int i;
 
 #ifdef __linux__
 	uwsgi_set_cgroup();
@@ -2647,6 +2666,14 @@ int uwsgi_start(void *v_argv) {
 		}
         }
 
+	if (uwsgi.static_open_cache) {
+		uwsgi_static_open_cache_init();
+	}
+
+	if (uwsgi.static_store) {
+		uwsgi_static_store_init();
+	}
+
         // initialize the alarm subsystem
         uwsgi_alarms_init();
 
@@ -2906,12 +2933,10 @@ unsafe:
 		//if (uwsgi.logformat_strftime) {
 			//uwsgi.logit = uwsgi_logit_lf_strftime;
 		//}
-		uwsgi.logvectors = uwsgi_malloc(sizeof(struct iovec *) * uwsgi.cores);
-		for (j = 0; j < uwsgi.cores; j++) {
-			uwsgi.logvectors[j] = uwsgi_malloc(sizeof(struct iovec) * uwsgi.logformat_vectors);
-			uwsgi.logvectors[j][uwsgi.logformat_vectors - 1].iov_base = "\n";
-			uwsgi.logvectors[j][uwsgi.logformat_vectors - 1].iov_len = 1;
-		}
+	}
+
+	if (uwsgi.req_log_ring) {
+		uwsgi_req_log_rings_init();
 	}
 
 	// initialize locks and socket as soon as possible, as the master could enqueue tasks
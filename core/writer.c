@@ -594,7 +594,7 @@ sendfile:
 		len = st.st_size;
 	}
 
-	if (wsgi_req->socket->can_offload) {
+	if (wsgi_req->socket->can_offload && !wsgi_req->no_offload) {
 		// of we cannot close the socket (before the app will close it later)
 		// let's dup it
 		if (!can_close) {
@@ -607,7 +607,7 @@ sendfile:
 			fd = tmp_fd;
 			can_close = 1;
 		}
-       		if (!uwsgi_offload_request_sendfile_do(wsgi_req, fd, len)) {
+       		if (!uwsgi_offload_request_sendfile_pos_do(wsgi_req, fd, pos, len)) {
                 	wsgi_req->via = UWSGI_VIA_OFFLOAD;
 			wsgi_req->response_size += len;
                         return 0;
@@ -26,6 +26,8 @@
 
 		6 -> dump the whole cache
 
+		8 -> multi get, 9 -> multi set (see "batched operations" in core/cache.c)
+
 		17 -> magic interface for plugins remote access { "cmd": "get|set|update|del|exists", "key": "cache key", "expires": "seconds", "cache": "the cache name"}
 			returns: {"status":"ok|notfound|error", "size": "size of the following body, if present"} + stream
 
@@ -78,6 +80,7 @@ static void manage_magic_context(struct wsgi_request *wsgi_req, struct uwsgi_cac
 	if (!uwsgi_strncmp(ucmc->cmd, ucmc->cmd_len, "get", 3)) {
 		uint64_t vallen = 0;
 		uint64_t expires = 0;
+		uc = uwsgi_cache_shard(uc, ucmc->key, ucmc->key_len);
 		uwsgi_rlock(uc->lock);
 		char *value = uwsgi_cache_get3(uc, ucmc->key, ucmc->key_len, &vallen, &expires);
 		if (!value) {
@@ -103,6 +106,7 @@ static void manage_magic_context(struct wsgi_request *wsgi_req, struct uwsgi_cac
 
 	// cache exists
 	if (!uwsgi_strncmp(ucmc->cmd, ucmc->cmd_len, "exists", 6)) {
+                uc = uwsgi_cache_shard(uc, ucmc->key, ucmc->key_len);
                 uwsgi_rlock(uc->lock);
                 if (!uwsgi_cache_exists2(uc, ucmc->key, ucmc->key_len)) {
                         uwsgi_rwunlock(uc->lock);
@@ -122,6 +126,7 @@ static void manage_magic_context(struct wsgi_request *wsgi_req, struct uwsgi_cac
 
 	// cache del
         if (!uwsgi_strncmp(ucmc->cmd, ucmc->cmd_len, "del", 3)) {
+                uc = uwsgi_cache_shard(uc, ucmc->key, ucmc->key_len);
                 uwsgi_wlock(uc->lock);
                 if (uwsgi_cache_del2(uc, ucmc->key, ucmc->key_len, 0, 0)) {
                         uwsgi_rwunlock(uc->lock);
@@ -141,21 +146,14 @@ static void manage_magic_context(struct wsgi_request *wsgi_req, struct uwsgi_cac
 
 	// cache clear
         if (!uwsgi_strncmp(ucmc->cmd, ucmc->cmd_len, "clear", 5)) {
-		uint64_t i;
-		uwsgi_wlock(uc->lock);
-		for (i = 1; i < uwsgi.caches->max_items; i++) {
-			if (uwsgi_cache_del2(uc, NULL, 0, i, 0)) {
-                                uwsgi_rwunlock(uc->lock);
-                                return;
-                        }	
-		}
-                // we are still locked !!!
+		// locking is managed by uwsgi_cache_clear()
+		if (uwsgi_cache_clear(uc)) return;
                 ub = uwsgi_buffer_new(uwsgi.page_size);
                 ub->pos = 4;
-                if (uwsgi_buffer_append_keyval(ub, "status", 6, "ok", 2)) goto error;
-                if (uwsgi_buffer_set_uh(ub, 111, 17)) goto error;
-                // unlock !!!
-                uwsgi_rwunlock(uc->lock);
+                if (uwsgi_buffer_append_keyval(ub, "status", 6, "ok", 2) || uwsgi_buffer_set_uh(ub, 111, 17)) {
+			uwsgi_buffer_destroy(ub);
+			return;
+		}
                 uwsgi_response_write_body_do(wsgi_req, ub->buf, ub->pos);
                 uwsgi_buffer_destroy(ub);
                 return;
@@ -170,6 +168,7 @@ static void manage_magic_context(struct wsgi_request *wsgi_req, struct uwsgi_cac
 		char *value = uwsgi_request_body_read(wsgi_req, ucmc->size, &rlen);
 		if (rlen != (ssize_t) ucmc->size) return;
 		// ok let's lock
+		uc = uwsgi_cache_shard(uc, ucmc->key, ucmc->key_len);
 		uwsgi_wlock(uc->lock);
 		if (uwsgi_cache_set2(uc, ucmc->key, ucmc->key_len, value, ucmc->size, ucmc->expires, ucmc->cmd_len > 3 ? UWSGI_CACHE_FLAG_UPDATE : 0)) {
 			uwsgi_rwunlock(uc->lock);
@@ -193,6 +192,144 @@ error:
 	uwsgi_buffer_destroy(ub);
 }
 
+// parse the cache name of a batch packet (an empty name is the default cache)
+static struct uwsgi_cache *cache_batch_cache(char **ptr, char *end) {
+	if (*ptr + 2 > end) return NULL;
+	uint16_t len = uwsgi_le16(*ptr);
+	*ptr += 2;
+	if (*ptr + len > end) return NULL;
+	char *name = *ptr;
+	*ptr += len;
+	if (!len) return uwsgi.caches;
+	return uwsgi_cache_by_namelen(name, len);
+}
+
+static void cache_mget(struct wsgi_request *wsgi_req) {
+	char *ptr = wsgi_req->buffer;
+	char *end = ptr + wsgi_req->uh->pktsize;
+	struct uwsgi_cache *uc = cache_batch_cache(&ptr, end);
+	if (!uc) return;
+
+	// every key takes at least 3 bytes
+	uint64_t max = (end - ptr) / 3;
+	if (!max) return;
+	char **keys = uwsgi_malloc(sizeof(char *) * max);
+	uint16_t *keylens = uwsgi_malloc(sizeof(uint16_t) * max);
+	char **values = uwsgi_malloc(sizeof(char *) * max);
+	uint64_t *vallens = uwsgi_malloc(sizeof(uint64_t) * max);
+	struct uwsgi_buffer *ub = NULL;
+	uint64_t i, n = 0;
+
+	while(ptr < end) {
+		if (ptr + 2 > end) goto end;
+		keylens[n] = uwsgi_le16(ptr);
+		ptr += 2;
+		if (!keylens[n] || ptr + keylens[n] > end) goto end;
+		keys[n] = ptr;
+		ptr += keylens[n];
+		n++;
+	}
+
+	uint64_t found = uwsgi_cache_mget(uc, n, keys, keylens, values, vallens);
+
+	ub = uwsgi_buffer_new(uwsgi.page_size);
+	// header + size of the items (set at the end)
+	ub->pos = 12;
+	for (i = 0; i < n; i++) {
+		if (!values[i]) {
+			if (uwsgi_buffer_u64le(ub, 0xffffffffffffffffLLU)) goto end2;
+			continue;
+		}
+		if (uwsgi_buffer_u64le(ub, vallens[i])) goto end2;
+		if (uwsgi_buffer_append(ub, values[i], vallens[i])) goto end2;
+	}
+	// the packet size is the number of found items
+	ub->buf[0] = 111;
+	ub->buf[1] = (uint8_t) (found & 0xff);
+	ub->buf[2] = (uint8_t) ((found >> 8) & 0xff);
+	ub->buf[3] = 8;
+	uint64_t items_size = ub->pos - 12;
+	for (i = 0; i < 8; i++) {
+		ub->buf[4 + i] = (uint8_t) ((items_size >> (i * 8)) & 0xff);
+	}
+	uwsgi_response_write_body_do(wsgi_req, ub->buf, ub->pos);
+end2:
+	for (i = 0; i < n; i++) {
+		if (values[i]) free(values[i]);
+	}
+	uwsgi_buffer_destroy(ub);
+end:
+	free(keys);
+	free(keylens);
+	free(values);
+	free(vallens);
+}
+
+static void cache_mset(struct wsgi_request *wsgi_req) {
+	char *ptr = wsgi_req->buffer;
+	char *end = ptr + wsgi_req->uh->pktsize;
+	struct uwsgi_cache *uc = cache_batch_cache(&ptr, end);
+	if (!uc) return;
+
+	if (ptr + 9 > end) return;
+	uint64_t expires = uwsgi_le64(ptr);
+	uint64_t flags = ptr[8] ? UWSGI_CACHE_FLAG_UPDATE : 0;
+	ptr += 9;
+
+	// every item takes at least 11 bytes
+	uint64_t max = (end - ptr) / 11;
+	if (!max) return;
+	char **keys = uwsgi_malloc(sizeof(char *) * max);
+	uint16_t *keylens = uwsgi_malloc(sizeof(uint16_t) * max);
+	char **values = uwsgi_malloc(sizeof(char *) * max);
+	uint64_t *vallens = uwsgi_malloc(sizeof(uint64_t) * max);
+	uint64_t i, n = 0;
+	size_t total = 0;
+
+	while(ptr < end) {
+		if (ptr + 2 > end) goto end;
+		keylens[n] = uwsgi_le16(ptr);
+		ptr += 2;
+		if (!keylens[n] || ptr + keylens[n] + 8 > end) goto end;
+		keys[n] = ptr;
+		ptr += keylens[n];
+		vallens[n] = uwsgi_le64(ptr);
+		ptr += 8;
+		if (vallens[n] > uc->max_item_size) goto end;
+		total += vallens[n];
+		n++;
+	}
+
+	// read the values
+	char *body = NULL;
+	if (total > 0) {
+		wsgi_req->post_cl = total;
+		ssize_t rlen = 0;
+		body = uwsgi_request_body_read(wsgi_req, total, &rlen);
+		if (rlen != (ssize_t) total) goto end;
+	}
+	for (i = 0; i < n; i++) {
+		values[i] = body;
+		body += vallens[i];
+	}
+
+	uint64_t stored = uwsgi_cache_mset(uc, n, keys, keylens, values, vallens, expires, flags);
+
+	struct uwsgi_header uh;
+	uh.modifier1 = 111;
+	uh.modifier2 = 9;
+	// the packet size is the number of stored items
+	char *pktsize = (char *) &uh.pktsize;
+	pktsize[0] = (uint8_t) (stored & 0xff);
+	pktsize[1] = (uint8_t) ((stored >> 8) & 0xff);
+	uwsgi_response_write_body_do(wsgi_req, (char *) &uh, 4);
+end:
+	free(keys);
+	free(keylens);
+	free(values);
+	free(vallens);
+}
+
 static int uwsgi_cache_request(struct wsgi_request *wsgi_req) {
 
         uint64_t vallen = 0;
@@ -269,7 +406,8 @@ static int uwsgi_cache_request(struct wsgi_request *wsgi_req) {
 				uc = uwsgi_cache_by_namelen(wsgi_req->buffer, wsgi_req->uh->pktsize);
 			}
 
-			if (!uc) break;
+			// sharded caches cannot be dumped as a single memory area
+			if (!uc || uc->shards_n) break;
 
 			uwsgi_wlock(uc->lock);
 			struct uwsgi_buffer *cache_dump = uwsgi_buffer_new(uwsgi.page_size + uc->filesize);
@@ -298,6 +436,18 @@ static int uwsgi_cache_request(struct wsgi_request *wsgi_req) {
 			uwsgi_response_write_body_do(wsgi_req, cache_dump->buf, cache_dump->pos);
 			uwsgi_buffer_destroy(cache_dump);
 			break;
+		case 8:
+			// multi get
+			if (wsgi_req->uh->pktsize > 0) {
+				cache_mget(wsgi_req);
+			}
+			break;
+		case 9:
+			// multi set
+			if (wsgi_req->uh->pktsize > 0) {
+				cache_mset(wsgi_req);
+			}
+			break;
 		case 17:
 			if (wsgi_req->uh->pktsize == 0) break;
 			memset(&ucmc, 0, sizeof(struct uwsgi_cache_magic_context));
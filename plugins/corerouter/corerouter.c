@@ -67,6 +67,7 @@ void uwsgi_cr_peer_reset(struct corerouter_peer *peer) {
 	cr_del_timeout(peer->session->corerouter, peer);
 	
 	if (peer->fd != -1) {
+		event_queue_fd_forget(peer->session->corerouter->queue, peer->fd);
 		close(peer->fd);
 		peer->session->corerouter->cr_table[peer->fd] = NULL;
 		peer->fd = -1;
@@ -79,9 +80,29 @@ void uwsgi_cr_peer_reset(struct corerouter_peer *peer) {
 	peer->timed_out = 0;
 
 	peer->un = NULL;
+	peer->un_start = 0;
 	peer->static_node = NULL;
 }
 
+// account data read from a subscription node (and its response time on the first chunk)
+void uwsgi_cr_peer_node_read(struct corerouter_peer *peer, ssize_t len) {
+	peer->un->tx += len;
+	if (peer->un_start && len > 0) {
+		uwsgi_subscribe_node_latency(peer->un, uwsgi_micros() - peer->un_start);
+		peer->un_start = 0;
+	}
+}
+
+// uwsgi_hooked_parse() hook, store the hash of the affinity var of a request
+void uwsgi_cr_affinity_hook(char *key, uint16_t keylen, char *val, uint16_t vallen, void *data) {
+	struct corerouter_peer *peer = (struct corerouter_peer *) data;
+	struct uwsgi_corerouter *ucr = peer->session->corerouter;
+	if (!uwsgi_strncmp(ucr->affinity_var, ucr->affinity_var_len, key, keylen)) {
+		peer->affinity = uwsgi_subscription_key_hash(val, vallen);
+		peer->has_affinity = 1;
+	}
+}
+
 // destroy a peer
 void uwsgi_cr_peer_del(struct corerouter_peer *peer) {
 	struct corerouter_peer *prev = peer->prev;
@@ -142,6 +163,12 @@ void uwsgi_opt_corerouter_use_base(char *opt, char *value, void *cr) {
 	ucr->has_backends++;
 }
 
+void uwsgi_opt_corerouter_affinity_var(char *opt, char *value, void *cr) {
+	struct uwsgi_corerouter *ucr = (struct uwsgi_corerouter *) cr;
+        ucr->affinity_var = value;
+        ucr->affinity_var_len = strlen(ucr->affinity_var);
+}
+
 void uwsgi_opt_corerouter_use_pattern(char *opt, char *value, void *cr) {
 	struct uwsgi_corerouter *ucr = (struct uwsgi_corerouter *) cr;
         ucr->pattern = value;
@@ -302,7 +329,7 @@ void corerouter_close_peer(struct uwsgi_corerouter *ucr, struct corerouter_peer
 #ifdef UWSGI_DEBUG
                uwsgi_log("[1] node %.*s refcnt: %llu\n", peer->un->len, peer->un->name, peer->un->reference);
 #endif
-               peer->un->reference--;
+               uwsgi_subscribe_node_unref(peer->un);
 #ifdef UWSGI_DEBUG
                uwsgi_log("[2] node %.*s refcnt: %llu\n", peer->un->len, peer->un->name, peer->un->reference);
 #endif
@@ -411,7 +438,7 @@ void corerouter_close_session(struct uwsgi_corerouter *ucr, struct corerouter_se
 		peers = peers->next;
 		// special case here for subscription system
 		if (ucr->subscriptions && tmp_peer->un && tmp_peer->un->len) {
-			tmp_peer->un->reference--;
+			uwsgi_subscribe_node_unref(tmp_peer->un);
 		}
 		uwsgi_cr_peer_del(tmp_peer);
 	}
@@ -793,6 +820,17 @@ void uwsgi_corerouter_loop(int id, void *data) {
 			while (ugs) {
 				if (ugs->gateway == &ushared->gateways[id] && ucr->interesting_fd == ugs->fd) {
 					if (!ugs->subscription) {
+						// connections already accepted by the event queue (io_uring multishot accept)
+						for (;;) {
+							cr_addr_len = sizeof(struct sockaddr_un);
+							new_connection = event_queue_accepted(ucr->queue, ucr->interesting_fd, (struct sockaddr *) &cr_addr, &cr_addr_len);
+							if (new_connection < 0) break;
+							if (!corerouter_alloc_session(ucr, ugs, new_connection, (struct sockaddr *) &cr_addr, cr_addr_len)) break;
+						}
+						if (new_connection != -1) {
+							taken = 1;
+							break;
+						}
 #if defined(__linux__) && defined(SOCK_NONBLOCK) && !defined(OBSOLETE_LINUX_KERNEL)
 						new_connection = accept4(ucr->interesting_fd, (struct sockaddr *) &cr_addr, &cr_addr_len, SOCK_NONBLOCK);
 						if (new_connection < 0) {
@@ -1028,22 +1066,42 @@ void corerouter_send_stats(struct uwsgi_corerouter *ucr) {
         }
 
 	if (ucr->has_subscription_sockets) {
+		struct uwsgi_subscribe_table *ust = ucr->subscriptions;
+		if (uwsgi_stats_key(us , "subscriptions_table")) goto end0;
+		if (uwsgi_stats_object_open(us)) goto end0;
+		if (uwsgi_stats_keyval_comma(us, "hash", ust->hash ? ust->hash->name : "")) goto end0;
+		if (uwsgi_stats_keylong_comma(us, "size", (unsigned long long) ust->size)) goto end0;
+		if (uwsgi_stats_keylong_comma(us, "items", (unsigned long long) ust->items)) goto end0;
+		if (uwsgi_stats_keylong_comma(us, "resizes", (unsigned long long) ust->resizes)) goto end0;
+		if (uwsgi_stats_keylong_comma(us, "lookups", (unsigned long long) ust->sampled_lookups * UWSGI_SUBSCRIBE_LOOKUP_SAMPLING)) goto end0;
+		if (uwsgi_stats_keylong_comma(us, "sampled_lookups", (unsigned long long) ust->sampled_lookups)) goto end0;
+		if (uwsgi_stats_keylong_comma(us, "probes", (unsigned long long) ust->probes)) goto end0;
+		if (uwsgi_stats_keylong_comma(us, "lookup_ns", (unsigned long long) ust->lookup_ns)) goto end0;
+		if (uwsgi_stats_keylong_comma(us, "batches", (unsigned long long) ust->batches)) goto end0;
+		if (uwsgi_stats_keylong_comma(us, "heartbeats", (unsigned long long) ust->heartbeats)) goto end0;
+		if (uwsgi_stats_keylong_comma(us, "heartbeat_misses", (unsigned long long) ust->heartbeat_misses)) goto end0;
+		if (uwsgi_stats_keylong(us, "avg_lookup_ns", (unsigned long long) (ust->sampled_lookups ? ust->lookup_ns / ust->sampled_lookups : 0))) goto end0;
+		if (uwsgi_stats_object_close(us)) goto end0;
+		if (uwsgi_stats_comma(us)) goto end0;
+
 		if (uwsgi_stats_key(us , "subscriptions")) goto end0;
 		if (uwsgi_stats_list_open(us)) goto end0;
 
-		int i;
+		uint64_t i;
 		int first_processed = 0;
-		for(i=0;i<UMAX16;i++) {
-			struct uwsgi_subscribe_slot *s_slot = ucr->subscriptions[i];
-			if (s_slot && first_processed) {
-				if (uwsgi_stats_comma(us)) goto end0;
-			}
-			while (s_slot) {
+		for(i=0;i<ust->size;i++) {
+			struct uwsgi_subscribe_slot *s_slot = ust->buckets[i].slot;
+			if (s_slot) {
+				if (first_processed) {
+					if (uwsgi_stats_comma(us)) goto end0;
+				}
 				first_processed = 1;
 				if (uwsgi_stats_object_open(us)) goto end0;
 				if (uwsgi_stats_keyvaln_comma(us, "key", s_slot->key, s_slot->keylen)) goto end0;
 				if (uwsgi_stats_keylong_comma(us, "hash", (unsigned long long) s_slot->hash)) goto end0;
 				if (uwsgi_stats_keylong_comma(us, "hits", (unsigned long long) s_slot->hits)) goto end0;
+				if (uwsgi_stats_keylong_comma(us, "ring", (unsigned long long) s_slot->ring_cnt)) goto end0;
+				if (uwsgi_stats_keylong_comma(us, "ring_spills", (unsigned long long) s_slot->ring_spills)) goto end0;
 #ifdef UWSGI_SSL
 				if (uwsgi_stats_keylong_comma(us, "sni_enabled", (unsigned long long) s_slot->sni_enabled)) goto end0;
 #endif
@@ -1072,6 +1130,7 @@ void corerouter_send_stats(struct uwsgi_corerouter *ucr) {
 					if (uwsgi_stats_keylong_comma(us, "weight", (unsigned long long) s_node->weight)) goto end0;
 					if (uwsgi_stats_keylong_comma(us, "wrr", (unsigned long long) s_node->wrr)) goto end0;
 					if (uwsgi_stats_keylong_comma(us, "ref", (unsigned long long) s_node->reference)) goto end0;
+					if (uwsgi_stats_keylong_comma(us, "ewma", (unsigned long long) s_node->ewma)) goto end0;
 					if (uwsgi_stats_keylong_comma(us, "failcnt", (unsigned long long) s_node->failcnt)) goto end0;
 					if (uwsgi_stats_keylong(us, "death_mark", (unsigned long long) s_node->death_mark)) goto end0;
 
@@ -1084,14 +1143,6 @@ void corerouter_send_stats(struct uwsgi_corerouter *ucr) {
 
 				if (uwsgi_stats_list_close(us)) goto end0;
 				if (uwsgi_stats_object_close(us)) goto end0;
-				if (s_slot->next) {
-					if (uwsgi_stats_comma(us)) goto end0;
-				}
-
-				s_slot = s_slot->next;
-				// check for loopy optimization
-				if (s_slot == ucr->subscriptions[i])
-					break;
 			}
 		}
 
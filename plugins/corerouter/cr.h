@@ -47,22 +47,22 @@
         peer->connecting = 1;\
 	cr_write_to_backend(peer, f);
 
-#define cr_read(peer, f) read(peer->fd, peer->in->buf + peer->in->pos, peer->in->len - peer->in->pos);\
+#define cr_read(peer, f) event_queue_fd_read(peer->session->corerouter->queue, peer->fd, peer->in->buf + peer->in->pos, peer->in->len - peer->in->pos);\
 	if (len < 0) {\
                 cr_try_again;\
                 uwsgi_cr_error(peer, f);\
                 return -1;\
         }\
-	if (peer != peer->session->main_peer && peer->un) peer->un->tx+=len;\
+	if (peer != peer->session->main_peer && peer->un) uwsgi_cr_peer_node_read(peer, len);\
         peer->in->pos += len;\
 
-#define cr_read_exact(peer, l, f) read(peer->fd, peer->in->buf + peer->in->pos, (l - peer->in->pos));\
+#define cr_read_exact(peer, l, f) event_queue_fd_read(peer->session->corerouter->queue, peer->fd, peer->in->buf + peer->in->pos, (l - peer->in->pos));\
         if (len < 0) {\
                 cr_try_again;\
                 uwsgi_cr_error(peer, f);\
                 return -1;\
         }\
-	if (peer != peer->session->main_peer && peer->un) peer->un->tx+=len;\
+	if (peer != peer->session->main_peer && peer->un) uwsgi_cr_peer_node_read(peer, len);\
         peer->in->pos += len;\
 
 #define cr_reset_hooks(peer) if(!peer->session->main_peer->disabled) {\
@@ -158,6 +158,11 @@ struct corerouter_peer {
 
 	// backend info
         struct uwsgi_subscribe_node *un;
+	// when the node has been chosen (zeroed on the first response byte)
+	uint64_t un_start;
+	// hash of the affinity var (for consistent hash subscription algos)
+	uint32_t affinity;
+	int has_affinity;
         struct uwsgi_string_list *static_node;
 
 	// incoming data 
@@ -224,6 +229,10 @@ struct uwsgi_corerouter {
         char *base;
         int base_len;
 
+	// request var used as key by the consistent hash subscription algos
+	char *affinity_var;
+	int affinity_var_len;
+
         size_t post_buffering;
         char *pb_base_dir;
 
@@ -238,7 +247,7 @@ struct uwsgi_corerouter {
         int socket_num;
         struct uwsgi_socket *to_socket;
 
-        struct uwsgi_subscribe_slot **subscriptions;
+        struct uwsgi_subscribe_table *subscriptions;
 
         struct uwsgi_string_list *fallback;
 
@@ -319,6 +328,7 @@ void uwsgi_opt_undeferred_corerouter(char *, char *, void *);
 void uwsgi_opt_corerouter_use_socket(char *, char *, void *);
 void uwsgi_opt_corerouter_use_base(char *, char *, void *);
 void uwsgi_opt_corerouter_use_pattern(char *, char *, void *);
+void uwsgi_opt_corerouter_affinity_var(char *, char *, void *);
 void uwsgi_opt_corerouter_zerg(char *, char *, void *);
 void uwsgi_opt_corerouter_cs(char *, char *, void *);
 void uwsgi_opt_corerouter_ss(char *, char *, void *);
@@ -352,4 +362,6 @@ int uwsgi_cr_set_hooks(struct corerouter_peer *, ssize_t (*)(struct corerouter_p
 struct corerouter_peer *uwsgi_cr_peer_add(struct corerouter_session *);
 struct corerouter_peer *uwsgi_cr_peer_find_by_sid(struct corerouter_session *, uint32_t);
 void corerouter_close_peer(struct uwsgi_corerouter *, struct corerouter_peer *);
+void uwsgi_cr_peer_node_read(struct corerouter_peer *, ssize_t);
+void uwsgi_cr_affinity_hook(char *, uint16_t, char *, uint16_t, void *);
 struct uwsgi_rb_timer *corerouter_reset_timeout(struct uwsgi_corerouter *, struct corerouter_peer *);
@@ -100,9 +100,12 @@ void *uwsgi_corerouter_setup_event_queue(struct uwsgi_corerouter *ucr, int id) {
 	struct uwsgi_gateway_socket *ugs = uwsgi.gateway_sockets;
 	while (ugs) {
 		if (!strcmp(ucr->name, ugs->owner)) {
-			if (!ucr->cheap || ugs->subscription) {
+			if (ugs->subscription) {
 				event_queue_add_fd_read(ucr->queue, ugs->fd);
 			}
+			else if (!ucr->cheap) {
+				event_queue_add_fd_accept(ucr->queue, ugs->fd);
+			}
 			ugs->gateway = &ushared->gateways[id];
 		}
 		ugs = ugs->next;
@@ -111,69 +114,217 @@ void *uwsgi_corerouter_setup_event_queue(struct uwsgi_corerouter *ucr, int id) {
 	return event_queue_alloc(ucr->nevents);
 }
 
+static void corerouter_subscribe(struct uwsgi_corerouter *ucr, struct uwsgi_subscribe_req *usr) {
+	if (uwsgi_add_subscribe_node(ucr->subscriptions, usr) && ucr->i_am_cheap) {
+		struct uwsgi_gateway_socket *ugs = uwsgi.gateway_sockets;
+		while (ugs) {
+			if (!strcmp(ugs->owner, ucr->name) && !ugs->subscription) {
+				event_queue_add_fd_accept(ucr->queue, ugs->fd);
+			}
+			ugs = ugs->next;
+		}
+		ucr->i_am_cheap = 0;
+		uwsgi_log("[%s pid %d] leaving cheap mode...\n", ucr->name, (int) uwsgi.mypid);
+	}
+}
+
+// returns -1 if the (signed) request is not valid
+static int corerouter_unsubscribe(struct uwsgi_corerouter *ucr, struct uwsgi_subscribe_req *usr, int check_sign) {
+	struct uwsgi_subscribe_node *node = uwsgi_get_subscribe_node_by_name(ucr->subscriptions, usr->key, usr->keylen, usr->address, usr->address_len);
+	if (node && node->len) {
+#ifdef UWSGI_SSL
+		if (check_sign && uwsgi.subscriptions_sign_check_dir) {
+			if (usr->sign_len == 0 || usr->base_len == 0)
+				return -1;
+			if (usr->unix_check <= node->unix_check)
+				return -1;
+			if (!uwsgi_subscription_sign_check(node->slot, usr)) {
+				return -1;
+			}
+		}
+#endif
+		if (node->death_mark == 0)
+			uwsgi_log("[%s pid %d] %.*s => marking %.*s as failed\n", ucr->name, (int) uwsgi.mypid, (int) usr->keylen, usr->key, (int) usr->address_len, usr->address);
+		node->failcnt++;
+		node->death_mark = 1;
+		// check if i can remove the node
+		if (node->reference == 0) {
+			uwsgi_remove_subscribe_node(ucr->subscriptions, node);
+		}
+		if (ucr->cheap && !ucr->i_am_cheap && uwsgi_no_subscriptions(ucr->subscriptions)) {
+			uwsgi_gateway_go_cheap(ucr->name, ucr->queue, &ucr->i_am_cheap);
+		}
+	}
+	return 0;
+}
+
+static void corerouter_resubscribe(struct uwsgi_corerouter *ucr, struct uwsgi_subscribe_req *usr, uint8_t cmd) {
+	static char *address = NULL;
+	if (!address) {
+		struct uwsgi_gateway_socket *augs = uwsgi.gateway_sockets;
+		while (augs) {
+			if (!strcmp(ucr->name, augs->owner)) {
+				if (!augs->subscription) {
+					address = augs->name;
+					break;
+				}
+			}
+			augs = augs->next;
+		}
+	}
+	struct uwsgi_string_list *usl = NULL;
+	char *sni_key = NULL;
+	char *sni_cert = NULL;
+	char *sni_ca = NULL;
+	if (usr->sni_key_len) {
+		sni_key = uwsgi_concat2n(usr->sni_key, usr->sni_key_len, "", 0);
+	}
+	if (usr->sni_crt_len) {
+		sni_cert = uwsgi_concat2n(usr->sni_crt, usr->sni_crt_len, "", 0);
+	}
+	if (usr->sni_ca_len) {
+		sni_ca = uwsgi_concat2n(usr->sni_ca, usr->sni_ca_len, "", 0);
+	}
+	uwsgi_foreach(usl, ucr->resubscribe) {
+		if (ucr->resubscribe_bind) {
+			static int rfd = -1;
+			if (rfd == -1) {
+				rfd = bind_to_udp(ucr->resubscribe_bind, 0, 0);
+			}
+			uwsgi_send_subscription_from_fd(rfd, usl->value, usr->key, usr->keylen, usr->modifier1, usr->modifier2, cmd, address, NULL, sni_key, sni_cert, sni_ca);
+		}
+		else {
+			uwsgi_send_subscription_from_fd(-2, usl->value, usr->key, usr->keylen, usr->modifier1, usr->modifier2, cmd, address, NULL, sni_key, sni_cert, sni_ca);
+		}
+	}
+	if (sni_key) free(sni_key);
+	if (sni_cert) free(sni_cert);
+	if (sni_ca) free(sni_ca);
+}
+
+/*
+	batched subscriptions (see core/subscription.c for the format) are processed in a single pass:
+	the table is grown once for all of the keys, then every var is applied in order (node vars update
+	the request, "add"/"del" subscribe/unsubscribe the current request, "digest" refreshes the nodes by hash)
+*/
+
+struct corerouter_subscription_batch {
+	struct uwsgi_corerouter *ucr;
+	struct uwsgi_subscribe_req *usr;
+	int resubscribe;
+	int bad_hash;
+};
+
+static void corerouter_count_subscription_batch(char *key, uint16_t keylen, char *val, uint16_t vallen, void *data) {
+	uint64_t *keys = (uint64_t *) data;
+	if (!uwsgi_strncmp("add", 3, key, keylen)) {
+		(*keys)++;
+	}
+}
+
+static void corerouter_manage_subscription_batch(char *key, uint16_t keylen, char *val, uint16_t vallen, void *data) {
+	struct corerouter_subscription_batch *crsb = (struct corerouter_subscription_batch *) data;
+	struct uwsgi_corerouter *ucr = crsb->ucr;
+	struct uwsgi_subscribe_req *usr = crsb->usr;
+
+	if (!uwsgi_strncmp("add", 3, key, keylen)) {
+		usr->key = val;
+		usr->keylen = vallen;
+		corerouter_subscribe(ucr, usr);
+		if (crsb->resubscribe) corerouter_resubscribe(ucr, usr, 0);
+	}
+	else if (!uwsgi_strncmp("del", 3, key, keylen)) {
+		usr->key = val;
+		usr->keylen = vallen;
+		corerouter_unsubscribe(ucr, usr, 0);
+		if (crsb->resubscribe) corerouter_resubscribe(ucr, usr, 1);
+	}
+	else if (!uwsgi_strncmp("hash", 4, key, keylen)) {
+		// digests are useless if the hash algos do not match
+		char *name = uwsgi.subscription_hash ? uwsgi.subscription_hash : "xxh3";
+		crsb->bad_hash = uwsgi_strncmp(name, strlen(name), val, vallen);
+	}
+	else if (!uwsgi_strncmp("digest", 6, key, keylen)) {
+		if (crsb->bad_hash) return;
+		uint16_t i;
+		for(i=0;i+4<=vallen;i+=4) {
+			uint8_t *ptr = (uint8_t *) val + i;
+			uint32_t hash = ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t) ptr[3] << 24);
+			struct uwsgi_subscribe_node *node = uwsgi_subscribe_node_heartbeat(ucr->subscriptions, hash, usr);
+			if (node && crsb->resubscribe) {
+				usr->key = node->slot->key;
+				usr->keylen = node->slot->keylen;
+				usr->modifier1 = node->modifier1;
+				usr->modifier2 = node->modifier2;
+				corerouter_resubscribe(ucr, usr, 0);
+			}
+		}
+	}
+	else {
+		corerouter_manage_subscription(key, keylen, val, vallen, usr);
+	}
+}
+
+// returns -1 if the batch cannot be managed (and must not be propagated)
+static int corerouter_manage_batch(struct uwsgi_corerouter *ucr, char *bbuf, ssize_t len, struct uwsgi_subscribe_req *usr, int resubscribe) {
+	if (bbuf[3] != UWSGI_SUBSCRIBE_BATCH && bbuf[3] != UWSGI_SUBSCRIBE_HEARTBEAT)
+		return -1;
+#ifdef UWSGI_SSL
+	// batches are not signed
+	if (uwsgi.subscriptions_sign_check_dir)
+		return -1;
+#endif
+
+	struct corerouter_subscription_batch crsb;
+	crsb.ucr = ucr;
+	crsb.usr = usr;
+	crsb.resubscribe = resubscribe && ucr->resubscribe;
+	crsb.bad_hash = 0;
+
+	if (bbuf[3] == UWSGI_SUBSCRIBE_BATCH) {
+		uint64_t keys = 0;
+		if (uwsgi_hooked_parse(bbuf + 4, len - 4, corerouter_count_subscription_batch, &keys)) return -1;
+		uwsgi_subscribe_table_reserve(ucr->subscriptions, keys);
+	}
+	ucr->subscriptions->batches++;
+	if (uwsgi_hooked_parse(bbuf + 4, len - 4, corerouter_manage_subscription_batch, &crsb)) return -1;
+	return 0;
+}
+
 void uwsgi_corerouter_manage_subscription(struct uwsgi_corerouter *ucr, int id, struct uwsgi_gateway_socket *ugs) {
 
 	int i;
 	struct uwsgi_subscribe_req usr;
-	char bbuf[4096];
+	char bbuf[UWSGI_SUBSCRIBE_BATCH_SIZE];
 	ssize_t len = -1;
 
 	memset(&usr, 0, sizeof(struct uwsgi_subscribe_req));
 
 	if (uwsgi.subscriptions_use_credentials) {
-		len = uwsgi_recv_cred2(ugs->fd, bbuf, 4096, &usr.pid, &usr.uid, &usr.gid);
+		len = uwsgi_recv_cred2(ugs->fd, bbuf, UWSGI_SUBSCRIBE_BATCH_SIZE, &usr.pid, &usr.uid, &usr.gid);
 	}
 	else {
-		len = recv(ugs->fd, bbuf, 4096, 0);
+		len = recv(ugs->fd, bbuf, UWSGI_SUBSCRIBE_BATCH_SIZE, 0);
 	}
-	if (len > 0) {
-		uwsgi_hooked_parse(bbuf + 4, len - 4, corerouter_manage_subscription, &usr);
-		if (usr.sign_len > 0) {
-			// calc the base size
-			usr.base = bbuf + 4;
-			usr.base_len = len - 4 - (2 + 4 + 2 + usr.sign_len);
+	if (len > 4) {
+		if (bbuf[3] > 1) {
+			if (corerouter_manage_batch(ucr, bbuf, len, &usr, 1)) return;
 		}
+		else {
+			uwsgi_hooked_parse(bbuf + 4, len - 4, corerouter_manage_subscription, &usr);
+			if (usr.sign_len > 0) {
+				// calc the base size
+				usr.base = bbuf + 4;
+				usr.base_len = len - 4 - (2 + 4 + 2 + usr.sign_len);
+			}
 
-		// subscribe request ?
-		if (bbuf[3] == 0) {
-			if (uwsgi_add_subscribe_node(ucr->subscriptions, &usr) && ucr->i_am_cheap) {
-				struct uwsgi_gateway_socket *ugs = uwsgi.gateway_sockets;
-				while (ugs) {
-					if (!strcmp(ugs->owner, ucr->name) && !ugs->subscription) {
-						event_queue_add_fd_read(ucr->queue, ugs->fd);
-					}
-					ugs = ugs->next;
-				}
-				ucr->i_am_cheap = 0;
-				uwsgi_log("[%s pid %d] leaving cheap mode...\n", ucr->name, (int) uwsgi.mypid);
+			// subscribe request ?
+			if (bbuf[3] == 0) {
+				corerouter_subscribe(ucr, &usr);
 			}
-		}
-		//unsubscribe 
-		else {
-			struct uwsgi_subscribe_node *node = uwsgi_get_subscribe_node_by_name(ucr->subscriptions, usr.key, usr.keylen, usr.address, usr.address_len);
-			if (node && node->len) {
-#ifdef UWSGI_SSL
-				if (uwsgi.subscriptions_sign_check_dir) {
-					if (usr.sign_len == 0 || usr.base_len == 0)
-						return;
-					if (usr.unix_check <= node->unix_check)
-						return;
-					if (!uwsgi_subscription_sign_check(node->slot, &usr)) {
-						return;
-					}
-				}
-#endif
-				if (node->death_mark == 0)
-					uwsgi_log("[%s pid %d] %.*s => marking %.*s as failed\n", ucr->name, (int) uwsgi.mypid, (int) usr.keylen, usr.key, (int) usr.address_len, usr.address);
-				node->failcnt++;
-				node->death_mark = 1;
-				// check if i can remove the node
-				if (node->reference == 0) {
-					uwsgi_remove_subscribe_node(ucr->subscriptions, node);
-				}
-				if (ucr->cheap && !ucr->i_am_cheap && uwsgi_no_subscriptions(ucr->subscriptions)) {
-					uwsgi_gateway_go_cheap(ucr->name, ucr->queue, &ucr->i_am_cheap);
-				}
+			//unsubscribe 
+			else {
+				if (corerouter_unsubscribe(ucr, &usr, 1)) return;
 			}
 		}
 
@@ -188,49 +339,9 @@ void uwsgi_corerouter_manage_subscription(struct uwsgi_corerouter *ucr, int id,
 			}
 		}
 
-		// resubscribe if needed ?
-		if (ucr->resubscribe) {
-			static char *address = NULL;
-			if (!address) {
-				struct uwsgi_gateway_socket *augs = uwsgi.gateway_sockets;
-        			while (augs) {
-                			if (!strcmp(ucr->name, augs->owner)) {
-                        			if (!augs->subscription) {
-							address = augs->name;
-							break;
-						}
-					}
-					augs = augs->next;
-				}
-			}
-			struct uwsgi_string_list *usl = NULL;
-			char *sni_key = NULL;
-			char *sni_cert = NULL;
-			char *sni_ca = NULL;
-			if (usr.sni_key_len) {
-				sni_key = uwsgi_concat2n(usr.sni_key, usr.sni_key_len, "", 0);
-			}
-			if (usr.sni_crt_len) {
-				sni_cert = uwsgi_concat2n(usr.sni_crt, usr.sni_crt_len, "", 0);
-			}
-			if (usr.sni_ca_len) {
-				sni_ca = uwsgi_concat2n(usr.sni_ca, usr.sni_ca_len, "", 0);
-			}
-			uwsgi_foreach(usl, ucr->resubscribe) {	
-				if (ucr->resubscribe_bind) {
-					static int rfd = -1;
-					if (rfd == -1) {
-						rfd = bind_to_udp(ucr->resubscribe_bind, 0, 0);
-					}
-					uwsgi_send_subscription_from_fd(rfd, usl->value, usr.key, usr.keylen, usr.modifier1, usr.modifier2, bbuf[3], address, NULL, sni_key, sni_cert, sni_ca);
-				}
-				else {
-					uwsgi_send_subscription_from_fd(-2, usl->value, usr.key, usr.keylen, usr.modifier1, usr.modifier2, bbuf[3], address, NULL, sni_key, sni_cert, sni_ca);
-				}
-			}
-			if (sni_key) free(sni_key);
-			if (sni_cert) free(sni_cert);
-			if (sni_ca) free(sni_ca);
+		// resubscribe if needed ? (batches resubscribe their keys while being parsed)
+		if (ucr->resubscribe && bbuf[3] <= 1) {
+			corerouter_resubscribe(ucr, &usr, bbuf[3]);
 		}
 	}
 
@@ -240,43 +351,24 @@ void uwsgi_corerouter_manage_internal_subscription(struct uwsgi_corerouter *ucr,
 
 
 	struct uwsgi_subscribe_req usr;
-	char bbuf[4096];
+	char bbuf[UWSGI_SUBSCRIBE_BATCH_SIZE];
 
-	ssize_t len = recv(fd, bbuf, 4096, 0);
-	if (len > 0) {
+	ssize_t len = recv(fd, bbuf, UWSGI_SUBSCRIBE_BATCH_SIZE, 0);
+	if (len > 4) {
 		memset(&usr, 0, sizeof(struct uwsgi_subscribe_req));
+		if (bbuf[3] > 1) {
+			corerouter_manage_batch(ucr, bbuf, len, &usr, 0);
+			return;
+		}
 		uwsgi_hooked_parse(bbuf + 4, len - 4, corerouter_manage_subscription, &usr);
 
 		// subscribe request ?
 		if (bbuf[3] == 0) {
-			if (uwsgi_add_subscribe_node(ucr->subscriptions, &usr) && ucr->i_am_cheap) {
-				struct uwsgi_gateway_socket *ugs = uwsgi.gateway_sockets;
-				while (ugs) {
-					if (!strcmp(ugs->owner, ucr->name) && !ugs->subscription) {
-						event_queue_add_fd_read(ucr->queue, ugs->fd);
-					}
-					ugs = ugs->next;
-				}
-				ucr->i_am_cheap = 0;
-				uwsgi_log("[%s pid %d] leaving cheap mode...\n", ucr->name, (int) uwsgi.mypid);
-			}
+			corerouter_subscribe(ucr, &usr);
 		}
 		//unsubscribe 
 		else {
-			struct uwsgi_subscribe_node *node = uwsgi_get_subscribe_node_by_name(ucr->subscriptions, usr.key, usr.keylen, usr.address, usr.address_len);
-			if (node && node->len) {
-				if (node->death_mark == 0)
-					uwsgi_log("[%s pid %d] %.*s => marking %.*s as failed\n", ucr->name, (int) uwsgi.mypid, (int) usr.keylen, usr.key, (int) usr.address_len, usr.address);
-				node->failcnt++;
-				node->death_mark = 1;
-				// check if i can remove the node
-				if (node->reference == 0) {
-					uwsgi_remove_subscribe_node(ucr->subscriptions, node);
-				}
-				if (ucr->cheap && !ucr->i_am_cheap && uwsgi_no_subscriptions(ucr->subscriptions)) {
-					uwsgi_gateway_go_cheap(ucr->name, ucr->queue, &ucr->i_am_cheap);
-				}
-			}
+			corerouter_unsubscribe(ucr, &usr, 0);
 		}
 	}
 
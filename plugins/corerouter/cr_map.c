@@ -10,8 +10,9 @@ int uwsgi_cr_map_use_void(struct uwsgi_corerouter *ucr, struct corerouter_peer *
 
 int uwsgi_cr_map_use_cache(struct uwsgi_corerouter *ucr, struct corerouter_peer *peer) {
 	uint64_t hits = 0;
-	uwsgi_rlock(ucr->cache->lock);
-	char *value = uwsgi_cache_get4(ucr->cache, peer->key, peer->key_len, &peer->instance_address_len, &hits);
+	struct uwsgi_cache *ucs = uwsgi_cache_shard(ucr->cache, peer->key, peer->key_len);
+	uwsgi_rlock(ucs->lock);
+	char *value = uwsgi_cache_get4(ucs, peer->key, peer->key_len, &peer->instance_address_len, &hits);
 	if (!value) goto end;
 	peer->tmp_socket_name = uwsgi_concat2n(value, peer->instance_address_len, "", 0);
 	size_t nodes = uwsgi_str_occurence(peer->tmp_socket_name, peer->instance_address_len, '|');
@@ -31,7 +32,7 @@ int uwsgi_cr_map_use_cache(struct uwsgi_corerouter *ucr, struct corerouter_peer
 		peer->instance_address_len = (cs_mod - peer->instance_address);
 	}
 end:
-	uwsgi_rwunlock(ucr->cache->lock);
+	uwsgi_rwunlock(ucs->lock);
 	return 0;
 }
 
@@ -48,11 +49,17 @@ int uwsgi_cr_map_use_pattern(struct uwsgi_corerouter *ucr, struct corerouter_pee
 
 int uwsgi_cr_map_use_subscription(struct uwsgi_corerouter *ucr, struct corerouter_peer *peer) {
 
-	peer->un = uwsgi_get_subscribe_node(ucr->subscriptions, peer->key, peer->key_len);
+	if (peer->has_affinity) {
+		peer->un = uwsgi_get_subscribe_node_affinity(ucr->subscriptions, peer->key, peer->key_len, peer->affinity);
+	}
+	else {
+		peer->un = uwsgi_get_subscribe_node(ucr->subscriptions, peer->key, peer->key_len);
+	}
 	if (peer->un && peer->un->len) {
 		peer->instance_address = peer->un->name;
 		peer->instance_address_len = peer->un->len;
 		peer->modifier1 = peer->un->modifier1;
+		peer->un_start = uwsgi_micros();
 	}
 	else if (ucr->cheap && !ucr->i_am_cheap && uwsgi_no_subscriptions(ucr->subscriptions)) {
 		uwsgi_gateway_go_cheap(ucr->name, ucr->queue, &ucr->i_am_cheap);
@@ -70,7 +77,12 @@ split:
 #ifdef UWSGI_DEBUG
 	uwsgi_log("trying with %.*s\n", name_len, name);
 #endif
-        peer->un = uwsgi_get_subscribe_node(ucr->subscriptions, name, name_len);
+	if (peer->has_affinity) {
+		peer->un = uwsgi_get_subscribe_node_affinity(ucr->subscriptions, name, name_len, peer->affinity);
+	}
+	else {
+        	peer->un = uwsgi_get_subscribe_node(ucr->subscriptions, name, name_len);
+	}
 	if (!peer->un) {
 		char *next = memchr(name+1, '.', name_len-1);
 		if (next) {
@@ -84,6 +96,7 @@ split:
                 peer->instance_address = peer->un->name;
                 peer->instance_address_len = peer->un->len;
                 peer->modifier1 = peer->un->modifier1;
+                peer->un_start = uwsgi_micros();
         }
         else if (ucr->cheap && !ucr->i_am_cheap && uwsgi_no_subscriptions(ucr->subscriptions)) {
                 uwsgi_gateway_go_cheap(ucr->name, ucr->queue, &ucr->i_am_cheap);
@@ -25,6 +25,7 @@ static struct uwsgi_option fastrouter_options[] = {
 	{"fastrouter-zerg", required_argument, 0, "attach the fastrouter to a zerg server", uwsgi_opt_corerouter_zerg, &ufr, 0},
 	{"fastrouter-use-cache", optional_argument, 0, "use uWSGI cache as hostname->server mapper for the fastrouter", uwsgi_opt_set_str, &ufr.cr.use_cache, 0},
 
+	{"fastrouter-affinity-var", required_argument, 0, "use the specified request var (like REQUEST_URI or HTTP_X_USER_ID) as key for the consistent hash subscription algos", uwsgi_opt_corerouter_affinity_var, &ufr, 0},
 	{"fastrouter-use-pattern", required_argument, 0, "use a pattern for fastrouter hostname->server mapping", uwsgi_opt_corerouter_use_pattern, &ufr, 0},
 	{"fastrouter-use-base", required_argument, 0, "use a base dir for fastrouter hostname->server mapping", uwsgi_opt_corerouter_use_base, &ufr, 0},
 
@@ -64,6 +65,10 @@ static void fr_get_hostname(char *key, uint16_t keylen, char *val, uint16_t vall
 	struct fastrouter_session *fr = (struct fastrouter_session *) peer->session;
 
 	//uwsgi_log("%.*s = %.*s\n", keylen, key, vallen, val);
+	if (peer->session->corerouter->affinity_var) {
+		uwsgi_cr_affinity_hook(key, keylen, val, vallen, data);
+	}
+
 	if (!uwsgi_strncmp("SERVER_NAME", 11, key, keylen) && !peer->key_len) {
 		peer->key = val;
 		peer->key_len = vallen;
@@ -27,6 +27,7 @@ struct uwsgi_option http_options[] = {
 	{"http-modifier1", required_argument, 0, "set uwsgi protocol modifier1", uwsgi_opt_set_int, &uhttp.modifier1, 0},
 	{"http-modifier2", required_argument, 0, "set uwsgi protocol modifier2", uwsgi_opt_set_int, &uhttp.modifier2, 0},
 	{"http-use-cache", optional_argument, 0, "use uWSGI cache as key->value virtualhost mapper", uwsgi_opt_set_str, &uhttp.cr.use_cache, 0},
+	{"http-affinity-var", required_argument, 0, "use the specified request var (like REQUEST_URI or HTTP_X_USER_ID) as key for the consistent hash subscription algos", uwsgi_opt_corerouter_affinity_var, &uhttp, 0},
 	{"http-use-pattern", required_argument, 0, "use the specified pattern for mapping requests to unix sockets", uwsgi_opt_corerouter_use_pattern, &uhttp, 0},
 	{"http-use-base", required_argument, 0, "use the specified base for mapping requests to unix sockets", uwsgi_opt_corerouter_use_base, &uhttp, 0},
 	{"http-events", required_argument, 0, "set the number of concurrent http async events", uwsgi_opt_set_int, &uhttp.cr.nevents, 0},
@@ -61,39 +62,14 @@ struct uwsgi_option http_options[] = {
 	{0, 0, 0, 0, 0, 0, 0},
 };
 
-int http_add_uwsgi_header(struct corerouter_peer *peer, char *hh, uint16_t hhlen) {
+int http_add_uwsgi_header(struct corerouter_peer *peer, struct uwsgi_http_header *uhh) {
 
 	struct uwsgi_buffer *out = peer->out;
 	struct http_session *hr = (struct http_session *) peer->session;
 
-	int i;
-	int status = 0;
-	char *val = hh;
-	uint16_t keylen = 0, vallen = 0;
-	int prefix = 0;
-
-	for (i = 0; i < hhlen; i++) {
-		if (!status) {
-			hh[i] = toupper((int) hh[i]);
-			if (hh[i] == '-')
-				hh[i] = '_';
-			if (hh[i] == ':') {
-				status = 1;
-				keylen = i;
-			}
-		}
-		else if (status == 1 && hh[i] != ' ') {
-			status = 2;
-			val += i;
-			vallen++;
-		}
-		else if (status == 2) {
-			vallen++;
-		}
-	}
-
-	if (!keylen)
-		return -1;
+	char *hh = uhh->key;
+	char *val = uhh->val;
+	uint16_t keylen = uhh->keylen, vallen = uhh->vallen;
 
 	if (hr->websockets) {
 		if (!uwsgi_strncmp("UPGRADE", 7, hh, keylen)) {
@@ -149,18 +125,13 @@ int http_add_uwsgi_header(struct corerouter_peer *peer, char *hh, uint16_t hhlen
 
 done:
 
-	if (uwsgi_strncmp("CONTENT_TYPE", 12, hh, keylen) && uwsgi_strncmp("CONTENT_LENGTH", 14, hh, keylen)) {
-		keylen += 5;
-		prefix = 1;
-	}
+	if (uwsgi_buffer_u16le(out, uhh->prefix ? keylen + 5 : keylen)) return -1;
 
-	if (uwsgi_buffer_u16le(out, keylen)) return -1;
-
-	if (prefix) {
+	if (uhh->prefix) {
 		if (uwsgi_buffer_append(out, "HTTP_", 5)) return -1;
 	}
 
-	if (uwsgi_buffer_append(out, hh, keylen - (prefix * 5))) return -1;
+	if (uwsgi_buffer_append(out, hh, keylen)) return -1;
 
 	if (uwsgi_buffer_u16le(out, vallen)) return -1;
 	if (uwsgi_buffer_append(out, val, vallen)) return -1;
@@ -174,9 +145,10 @@ int http_headers_parse(struct corerouter_peer *peer) {
 	struct http_session *hr = (struct http_session *) peer->session;
 
 	char *ptr = peer->session->main_peer->in->buf;
-	char *watermark = ptr + hr->headers_size;
-	char *base = ptr;
-	char *query_string = NULL;
+	// headers_size is the position of the last \n
+	char *watermark = ptr + hr->headers_size + 1;
+	struct uwsgi_http_request_line uhrl;
+	struct uwsgi_http_header uhh;
 
 	peer->out = uwsgi_buffer_new(uwsgi.page_size);
 	// force this buffer to be destroyed as soon as possibile
@@ -187,111 +159,45 @@ int http_headers_parse(struct corerouter_peer *peer) {
 	peer->out_pos = 0;
 
 	struct uwsgi_buffer *out = peer->out;
-	int found = 0;
 
-	// REQUEST_METHOD 
-	while (ptr < watermark) {
-		if (*ptr == ' ') {
-			if (uwsgi_buffer_append_keyval(out, "REQUEST_METHOD", 14, base, ptr - base)) return -1;
-			ptr++;
-			found = 1;
-			break;
-		}
-		else if (*ptr == '\r' || *ptr == '\n') break;
-		ptr++;
-	}
+	ptr = uwsgi_http_parse_request_line(ptr, watermark, &uhrl);
+	if (!ptr) return -1;
 
-        // ensure we have a method
-        if (!found) {
-          return -1;
-        }
+	// REQUEST_METHOD 
+	if (uwsgi_buffer_append_keyval(out, "REQUEST_METHOD", 14, uhrl.method, uhrl.method_len)) return -1;
 
 	// REQUEST_URI / PATH_INFO / QUERY_STRING
-	base = ptr;
-	found = 0;
-	while (ptr < watermark) {
-		if (*ptr == '?' && !query_string) {
-			// PATH_INFO must be url-decoded !!!
-			if (!hr->path_info) {
-				hr->path_info_len = ptr - base;
-				hr->path_info = uwsgi_malloc(hr->path_info_len);
-			}
-			else {
-				size_t new_path_info = ptr - base;
-				if (new_path_info > hr->path_info_len) {
-					char *tmp_buf = realloc(hr->path_info, new_path_info);
-					if (!tmp_buf) return -1;
-					hr->path_info = tmp_buf;
-				}
-				hr->path_info_len = new_path_info;
-			}
-			http_url_decode(base, &hr->path_info_len, hr->path_info);
-			if (uwsgi_buffer_append_keyval(out, "PATH_INFO", 9, hr->path_info, hr->path_info_len)) return -1;
-			query_string = ptr + 1;
-		}
-		else if (*ptr == ' ') {
-			hr->request_uri = base;
-			hr->request_uri_len = ptr - base;
-			if (uwsgi_buffer_append_keyval(out, "REQUEST_URI", 11, base, ptr - base)) return -1;
-			if (!query_string) {
-				// PATH_INFO must be url-decoded !!!
-				if (!hr->path_info) {
-                                	hr->path_info_len = ptr - base;
-                                	hr->path_info = uwsgi_malloc(hr->path_info_len);
-                        	}
-                        	else {
-                                	size_t new_path_info = ptr - base;
-                                	if (new_path_info > hr->path_info_len) {
-                                        	char *tmp_buf = realloc(hr->path_info, new_path_info);
-                                        	if (!tmp_buf) return -1;
-                                        	hr->path_info = tmp_buf;
-                                	}
-                                	hr->path_info_len = new_path_info;
-                        	}
-				http_url_decode(base, &hr->path_info_len, hr->path_info);
-				if (uwsgi_buffer_append_keyval(out, "PATH_INFO", 9, hr->path_info, hr->path_info_len)) return -1;
-				if (uwsgi_buffer_append_keyval(out, "QUERY_STRING", 12, "", 0)) return -1;
-			}
-			else {
-				if (uwsgi_buffer_append_keyval(out, "QUERY_STRING", 12, query_string, ptr - query_string)) return -1;
-			}
-			ptr++;
-			found = 1;
-			break;
+	hr->request_uri = uhrl.uri;
+	hr->request_uri_len = uhrl.uri_len;
+	if (uwsgi_buffer_append_keyval(out, "REQUEST_URI", 11, uhrl.uri, uhrl.uri_len)) return -1;
+	// PATH_INFO must be url-decoded !!!
+	if (!hr->path_info) {
+		hr->path_info_len = uhrl.path_len;
+		hr->path_info = uwsgi_malloc(hr->path_info_len);
+	}
+	else {
+		if (uhrl.path_len > hr->path_info_len) {
+			char *tmp_buf = realloc(hr->path_info, uhrl.path_len);
+			if (!tmp_buf) return -1;
+			hr->path_info = tmp_buf;
 		}
-		ptr++;
+		hr->path_info_len = uhrl.path_len;
+	}
+	http_url_decode(uhrl.path, &hr->path_info_len, hr->path_info);
+	if (uwsgi_buffer_append_keyval(out, "PATH_INFO", 9, hr->path_info, hr->path_info_len)) return -1;
+	if (uhrl.query_string) {
+		if (uwsgi_buffer_append_keyval(out, "QUERY_STRING", 12, uhrl.query_string, uhrl.query_string_len)) return -1;
+	}
+	else {
+		if (uwsgi_buffer_append_keyval(out, "QUERY_STRING", 12, "", 0)) return -1;
 	}
-
-        // ensure we have a URI
-        if (!found) {
-          return -1;
-        }
 
 	// SERVER_PROTOCOL
-	base = ptr;
-	found = 0;
-	while (ptr < watermark) {
-		if (*ptr == '\r') {
-			if (ptr + 1 >= watermark)
-				return 0;
-			if (*(ptr + 1) != '\n')
-				return 0;
-			if (uwsgi_buffer_append_keyval(out, "SERVER_PROTOCOL", 15, base, ptr - base)) return -1;
-			if (uhttp.keepalive && !uwsgi_strncmp("HTTP/1.1", 8, base, ptr-base)) {
-				hr->session.can_keepalive = 1;
-			}
-			ptr += 2;
-			found = 1;
-			break;
-		}
-		ptr++;
+	if (uwsgi_buffer_append_keyval(out, "SERVER_PROTOCOL", 15, uhrl.protocol, uhrl.protocol_len)) return -1;
+	if (uhttp.keepalive && !uwsgi_strncmp("HTTP/1.1", 8, uhrl.protocol, uhrl.protocol_len)) {
+		hr->session.can_keepalive = 1;
 	}
 
-        // ensure we have a protocol
-        if (!found) {
-          return -1;
-        }
-
 	// SCRIPT_NAME
 	if (uwsgi_buffer_append_keyval(out, "SCRIPT_NAME", 11, "", 0)) return -1;
 
@@ -320,34 +226,17 @@ int http_headers_parse(struct corerouter_peer *peer) {
 	if (uwsgi_buffer_append_keyval(out, "REMOTE_PORT", 11, peer->session->client_port, strlen(peer->session->client_port))) return -1;
 
 	//HEADERS
-	base = ptr;
-
-	while (ptr < watermark) {
-		if (*ptr == '\r') {
-			if (ptr + 1 >= watermark)
-				break;
-			if (*(ptr + 1) != '\n')
-				break;
-			// multiline header ?
-			if (ptr + 2 < watermark) {
-				if (*(ptr + 2) == ' ' || *(ptr + 2) == '\t') {
-					ptr += 2;
-					continue;
-				}
+	int ret;
+	while ((ret = uwsgi_http_parse_header(&ptr, watermark, &uhh)) > 0) {
+		// Expect: 100-continue
+		if (uhttp.manage_expect) {
+			if (!uwsgi_strncmp("EXPECT", 6, uhh.key, uhh.keylen) && !uwsgi_strnicmp(uhh.val, uhh.vallen, "100-continue", 12)) {
+				hr->send_expect_100 = 1;
 			}
-
-			// this is an hack with dumb/wrong/useless error checking
-			if (uhttp.manage_expect) {
-				if (!uwsgi_strncmp("Expect: 100-continue", 20, base, ptr - base)) {
-					hr->send_expect_100 = 1;
-				}
-			}
-			if (http_add_uwsgi_header(peer, base, ptr - base)) return -1;
-			ptr++;
-			base = ptr + 1;
 		}
-		ptr++;
+		if (http_add_uwsgi_header(peer, &uhh)) return -1;
 	}
+	if (ret < 0) return -1;
 
 	struct uwsgi_string_list *hv = uhttp.http_vars;
 	while (hv) {
@@ -653,103 +542,81 @@ ssize_t http_parse(struct corerouter_peer *main_peer) {
 	}
 
 	// read until \r\n\r\n is found
-	size_t j;
-	size_t len = main_peer->in->pos;
-	char *ptr = main_peer->in->buf;
-
-	hr->rnrn = 0;
-	
-	for (j = 0; j < len; j++) {
-		if (*ptr == '\r' && (hr->rnrn == 0 || hr->rnrn == 2)) {
-			hr->rnrn++;
-		}
-		else if (*ptr == '\r') {
-			hr->rnrn = 1;
-		}
-		else if (*ptr == '\n' && hr->rnrn == 1) {
-			hr->rnrn = 2;
-		}
-		else if (*ptr == '\n' && hr->rnrn == 3) {
-			hr->rnrn = 4;
-			hr->headers_size = j;
+	ssize_t end = uwsgi_http_headers_end(main_peer->in->buf, main_peer->in->pos, 0);
+	if (end < 0) return 1;
 
-			// for security
-			if ((j+1) <= len) {
-				hr->remains = len - (j+1);
-			}
+	hr->rnrn = 4;
+	hr->headers_size = end - 1;
+	hr->remains = main_peer->in->pos - end;
 
-			struct uwsgi_corerouter *ucr = main_peer->session->corerouter;
+	struct uwsgi_corerouter *ucr = main_peer->session->corerouter;
 
-			// create a new peer
-                	struct corerouter_peer *new_peer = uwsgi_cr_peer_add(main_peer->session);
-			// default hook
-			new_peer->last_hook_read = hr_instance_read;
-		
-			// parse HTTP request
-			if (http_headers_parse(new_peer)) return -1;
+	// create a new peer
+	struct corerouter_peer *new_peer = uwsgi_cr_peer_add(main_peer->session);
+	// default hook
+	new_peer->last_hook_read = hr_instance_read;
+
+	// parse HTTP request
+	if (http_headers_parse(new_peer)) return -1;
+
+	if (ucr->affinity_var) {
+		if (uwsgi_hooked_parse(new_peer->out->buf+4, new_peer->out->pos-4, uwsgi_cr_affinity_hook, (void *) new_peer)) return -1;
+	}
 
-			// check for a valid hostname
-			if (new_peer->key_len == 0) return -1;
+	// check for a valid hostname
+	if (new_peer->key_len == 0) return -1;
 
 #ifdef UWSGI_SSL
-			if (hr->force_https) {
-				if (hr_force_https(new_peer)) return -1;
-				break;
-			}
+	if (hr->force_https) {
+		if (hr_force_https(new_peer)) return -1;
+		return 1;
+	}
 #endif
-			// find an instance using the key
-                	if (ucr->mapper(ucr, new_peer))
-                        	return -1;
-
-                	// check instance
-                	if (new_peer->instance_address_len == 0)
-                        	return -1;
-
-			uint16_t pktsize = new_peer->out->pos-4;
-        		// fix modifiers
-        		new_peer->out->buf[0] = new_peer->session->main_peer->modifier1;
-        		new_peer->out->buf[3] = new_peer->session->main_peer->modifier2;
-        		// fix pktsize
-        		new_peer->out->buf[1] = (uint8_t) (pktsize & 0xff);
-        		new_peer->out->buf[2] = (uint8_t) ((pktsize >> 8) & 0xff);
-
-			if (hr->remains > 0) {
-				if (hr->content_length < hr->remains) { 
-					hr->remains = hr->content_length;
-					hr->content_length = 0;
-					// we need to avoid problems with pipelined requests
-					hr->session.can_keepalive = 0;
-				}
-				else {
-					hr->content_length -= hr->remains;
-				}
-				if (uwsgi_buffer_append(new_peer->out, main_peer->in->buf + hr->headers_size + 1, hr->remains)) return -1;
-			}
-
-			if (hr->session.can_keepalive && hr->content_length == 0) {
-				main_peer->disabled = 1;
-				// stop reading from the client
-				if (uwsgi_cr_set_hooks(main_peer, NULL, NULL)) return -1;
-			}
+	// find an instance using the key
+	if (ucr->mapper(ucr, new_peer))
+		return -1;
 
-			if (hr->send_expect_100) {
-				if (hr_manage_expect_continue(new_peer)) return -1;	
-				break;
-        		}
+	// check instance
+	if (new_peer->instance_address_len == 0)
+		return -1;
 
-			if (hr->websockets > 2 && hr->websocket_key_len > 0) {
-				hr->raw_body = 1;
-			}
-			new_peer->can_retry = 1;
-                	cr_connect(new_peer, hr_instance_connected);
-			break;
+	uint16_t pktsize = new_peer->out->pos-4;
+	// fix modifiers
+	new_peer->out->buf[0] = new_peer->session->main_peer->modifier1;
+	new_peer->out->buf[3] = new_peer->session->main_peer->modifier2;
+	// fix pktsize
+	new_peer->out->buf[1] = (uint8_t) (pktsize & 0xff);
+	new_peer->out->buf[2] = (uint8_t) ((pktsize >> 8) & 0xff);
+
+	if (hr->remains > 0) {
+		if (hr->content_length < hr->remains) { 
+			hr->remains = hr->content_length;
+			hr->content_length = 0;
+			// we need to avoid problems with pipelined requests
+			hr->session.can_keepalive = 0;
 		}
 		else {
-			hr->rnrn = 0;
+			hr->content_length -= hr->remains;
 		}
-		ptr++;
+		if (uwsgi_buffer_append(new_peer->out, main_peer->in->buf + hr->headers_size + 1, hr->remains)) return -1;
+	}
+
+	if (hr->session.can_keepalive && hr->content_length == 0) {
+		main_peer->disabled = 1;
+		// stop reading from the client
+		if (uwsgi_cr_set_hooks(main_peer, NULL, NULL)) return -1;
+	}
+
+	if (hr->send_expect_100) {
+		if (hr_manage_expect_continue(new_peer)) return -1;	
+		return 1;
+	}
+
+	if (hr->websockets > 2 && hr->websocket_key_len > 0) {
+		hr->raw_body = 1;
 	}
-	
+	new_peer->can_retry = 1;
+	cr_connect(new_peer, hr_instance_connected);
 	return 1;
 }
 
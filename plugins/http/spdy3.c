@@ -553,6 +553,10 @@ static ssize_t spdy_inflate_http_headers(struct http_session *hr) {
 
         struct uwsgi_corerouter *ucr = hr->session.corerouter;
 
+	if (ucr->affinity_var) {
+		if (uwsgi_hooked_parse(new_peer->out->buf+4, new_peer->out->pos-4, uwsgi_cr_affinity_hook, (void *) new_peer)) return -1;
+	}
+
         // get instance name
 	if (ucr->mapper(ucr, new_peer )) return -1;
 
@@ -13,6 +13,11 @@ static int legion_action_cache_fetch_from_legion(struct uwsgi_legion *ul, char *
 		return 1;
 	}
 
+	if (uc->shards_n) {
+		uwsgi_log("[legion-cache-fetch] cannot sync, cache '%s' is sharded\n", arg);
+		return 1;
+	}
+
 	struct uwsgi_string_list *dump_from_nodes = NULL;
 
 	uwsgi_rlock(ul->lock);
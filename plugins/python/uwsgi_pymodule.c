@@ -3028,7 +3028,7 @@ PyObject *py_uwsgi_cache_keys(PyObject * self, PyObject * args) {
 
 	PyObject *l = PyList_New(0);
 
-	uwsgi_rlock(uc->lock);
+	uwsgi_cache_rlock(uc);
         for(;;) {
                 uci = uwsgi_cache_keys(uc, &pos, &uci);
                 if (!uci) break;
@@ -3036,10 +3036,124 @@ PyObject *py_uwsgi_cache_keys(PyObject * self, PyObject * args) {
 		PyList_Append(l, ci);
 		Py_DECREF(ci);
         }
-	uwsgi_rwunlock(uc->lock);
+	uwsgi_cache_rwunlock(uc);
 	return l;
 }
 
+PyObject *py_uwsgi_cache_mget(PyObject * self, PyObject * args) {
+
+	PyObject *pykeys;
+	char *cache = NULL;
+
+	if (!PyArg_ParseTuple(args, "O|s:cache_mget", &pykeys, &cache)) {
+		return NULL;
+	}
+
+	PyObject *fast = PySequence_Fast(pykeys, "cache_mget() requires a sequence of keys");
+	if (!fast) return NULL;
+
+	Py_ssize_t i, n = PySequence_Fast_GET_SIZE(fast);
+	char **keys = uwsgi_calloc(sizeof(char *) * (n + 1));
+	uint16_t *keylens = uwsgi_calloc(sizeof(uint16_t) * (n + 1));
+	char **values = uwsgi_calloc(sizeof(char *) * (n + 1));
+	uint64_t *vallens = uwsgi_calloc(sizeof(uint64_t) * (n + 1));
+	PyObject *ret = NULL;
+
+	for (i = 0; i < n; i++) {
+		Py_ssize_t keylen = 0;
+		if (!PyArg_Parse(PySequence_Fast_GET_ITEM(fast, i), "s#", &keys[i], &keylen)) goto end;
+		if (keylen > 0xffff) {
+			PyErr_Format(PyExc_ValueError, "cache key too long");
+			goto end;
+		}
+		keylens[i] = keylen;
+	}
+
+	UWSGI_RELEASE_GIL
+	int64_t found = uwsgi_cache_magic_mget(n, keys, keylens, values, vallens, cache);
+	UWSGI_GET_GIL
+
+	if (found < 0) {
+		Py_INCREF(Py_None);
+		ret = Py_None;
+		goto end;
+	}
+
+	// a list of values (None for missing keys)
+	ret = PyList_New(n);
+	for (i = 0; i < n; i++) {
+		if (values[i]) {
+			PyList_SET_ITEM(ret, i, PyString_FromStringAndSize(values[i], vallens[i]));
+			free(values[i]);
+		}
+		else {
+			Py_INCREF(Py_None);
+			PyList_SET_ITEM(ret, i, Py_None);
+		}
+	}
+
+end:
+	free(keys);
+	free(keylens);
+	free(values);
+	free(vallens);
+	Py_DECREF(fast);
+	return ret;
+}
+
+PyObject *py_uwsgi_cache_mset(PyObject * self, PyObject * args) {
+
+	PyObject *items;
+	uint64_t expires = 0;
+	char *cache = NULL;
+
+	if (!PyArg_ParseTuple(args, "O!|ls:cache_mset", &PyDict_Type, &items, &expires, &cache)) {
+		return NULL;
+	}
+
+	Py_ssize_t n = PyDict_Size(items);
+	char **keys = uwsgi_calloc(sizeof(char *) * (n + 1));
+	uint16_t *keylens = uwsgi_calloc(sizeof(uint16_t) * (n + 1));
+	char **values = uwsgi_calloc(sizeof(char *) * (n + 1));
+	uint64_t *vallens = uwsgi_calloc(sizeof(uint64_t) * (n + 1));
+	PyObject *ret = NULL;
+
+	PyObject *key, *value;
+	Py_ssize_t pos = 0, i = 0;
+	while (PyDict_Next(items, &pos, &key, &value)) {
+		Py_ssize_t keylen = 0, vallen = 0;
+		if (!PyArg_Parse(key, "s#", &keys[i], &keylen)) goto end;
+		if (!PyArg_Parse(value, "s#", &values[i], &vallen)) goto end;
+		if (keylen > 0xffff) {
+			PyErr_Format(PyExc_ValueError, "cache key too long");
+			goto end;
+		}
+		keylens[i] = keylen;
+		vallens[i] = vallen;
+		i++;
+	}
+
+	UWSGI_RELEASE_GIL
+	int64_t stored = uwsgi_cache_magic_mset(n, keys, keylens, values, vallens, expires, 0, cache);
+	UWSGI_GET_GIL
+
+	if (stored < 0) {
+		Py_INCREF(Py_None);
+		ret = Py_None;
+		goto end;
+	}
+
+	// the number of stored items
+	ret = PyInt_FromLong(stored);
+
+end:
+	free(keys);
+	free(keylens);
+	free(values);
+	free(vallens);
+	return ret;
+}
+
 
 static PyMethodDef uwsgi_cache_methods[] = {
 	{"cache_get", py_uwsgi_cache_get, METH_VARARGS, ""},
@@ -3054,6 +3168,8 @@ static PyMethodDef uwsgi_cache_methods[] = {
 	{"cache_div", py_uwsgi_cache_div, METH_VARARGS, ""},
 	{"cache_num", py_uwsgi_cache_num, METH_VARARGS, ""},
 	{"cache_keys", py_uwsgi_cache_keys, METH_VARARGS, ""},
+	{"cache_mget", py_uwsgi_cache_mget, METH_VARARGS, ""},
+	{"cache_mset", py_uwsgi_cache_mset, METH_VARARGS, ""},
 	{NULL, NULL},
 };
 
@@ -315,12 +315,17 @@ int uwsgi_proto_base_sendfile(struct wsgi_request * wsgi_req, int fd, size_t pos
 int uwsgi_proto_ssl_sendfile(struct wsgi_request *wsgi_req, int fd, size_t pos, size_t len) {
 	char buf[32768];
 
-	ssize_t rlen = read(fd, buf, UMIN(len, 32768));
+	// pread() does not move the file offset (fd could be shared by the static file cache)
+	size_t written = wsgi_req->write_pos;
+	ssize_t rlen = pread(fd, buf, UMIN(len - written, 32768), pos + written);
 	if (rlen <= 0) return -1;
 
+	// uwsgi_proto_ssl_write() accounts a single buffer, write_pos is restored after it
+	wsgi_req->write_pos = 0;
 	for(;;) {
 		int ret = uwsgi_proto_ssl_write(wsgi_req, buf, rlen);
 		if (ret == UWSGI_OK) {
+			wsgi_req->write_pos = written + rlen;
 			if (wsgi_req->write_pos >= len) {
 				return UWSGI_OK;
 			}
@@ -328,12 +333,13 @@ int uwsgi_proto_ssl_sendfile(struct wsgi_request *wsgi_req, int fd, size_t pos,
                 }
 		if (ret == UWSGI_AGAIN) {
 			ret = uwsgi_wait_write_req(wsgi_req);
-			if (ret <= 0 ) return -1;
+			if (ret <= 0 ) break;
 			continue;
 		}
-		return -1;
+		break;
 	}
 
+	wsgi_req->write_pos = written;
 	return -1;
 }
 
@@ -4,53 +4,20 @@
 
 extern struct uwsgi_server uwsgi;
 
-static uint16_t http_add_uwsgi_header(struct wsgi_request *wsgi_req, char *hh, int hhlen) {
+static uint16_t http_add_uwsgi_header(struct wsgi_request *wsgi_req, struct uwsgi_http_header *uhh) {
 
 	char *buffer = wsgi_req->buffer + wsgi_req->uh->pktsize;
 	char *watermark = wsgi_req->buffer + uwsgi.buffer_size;
 
-	int i;
-	int status = 0;
-	char *val = hh;
-	uint16_t keylen = 0, vallen = 0;
-	int prefix = 0;
+	uint16_t keylen = uhh->keylen;
 	char *ptr = buffer;
 
-	for (i = 0; i < hhlen; i++) {
-		if (!status) {
-			hh[i] = toupper((int) hh[i]);
-			if (hh[i] == '-')
-				hh[i] = '_';
-			if (hh[i] == ':') {
-				status = 1;
-				keylen = i;
-			}
-		}
-		else if (status == 1 && hh[i] != ' ') {
-			status = 2;
-			val += i;
-			vallen++;
-		}
-		else if (status == 2) {
-			vallen++;
-		}
-	}
-
-	if (!keylen)
-		return 0;
-
-	if (uwsgi_strncmp("CONTENT_LENGTH", 14, hh, keylen) && uwsgi_strncmp("CONTENT_TYPE", 12, hh, keylen)) {
+	if (uhh->prefix) {
 		keylen += 5;
-		prefix = 1;
 	}
 
-	if (buffer + keylen + vallen + 2 + 2 >= watermark) {
-		if (prefix) {
-			uwsgi_log("[WARNING] unable to add HTTP_%.*s=%.*s to uwsgi packet, consider increasing buffer size\n", keylen, hh, vallen, val);
-		}
-		else {
-			uwsgi_log("[WARNING] unable to add %.*s=%.*s to uwsgi packet, consider increasing buffer size\n", keylen, hh, vallen, val);
-		}
+	if (buffer + keylen + uhh->vallen + 2 + 2 >= watermark) {
+		uwsgi_log("[WARNING] unable to add %s%.*s=%.*s to uwsgi packet, consider increasing buffer size\n", uhh->prefix ? "HTTP_" : "", uhh->keylen, uhh->key, uhh->vallen, uhh->val);
 		return 0;
 	}
 
@@ -58,22 +25,18 @@ static uint16_t http_add_uwsgi_header(struct wsgi_request *wsgi_req, char *hh, i
 	*ptr++ = (uint8_t) (keylen & 0xff);
 	*ptr++ = (uint8_t) ((keylen >> 8) & 0xff);
 
-	if (prefix) {
+	if (uhh->prefix) {
 		memcpy(ptr, "HTTP_", 5);
 		ptr += 5;
-		memcpy(ptr, hh, keylen - 5);
-		ptr += (keylen - 5);
-	}
-	else {
-		memcpy(ptr, hh, keylen);
-		ptr += keylen;
 	}
+	memcpy(ptr, uhh->key, uhh->keylen);
+	ptr += uhh->keylen;
 
-	*ptr++ = (uint8_t) (vallen & 0xff);
-	*ptr++ = (uint8_t) ((vallen >> 8) & 0xff);
-	memcpy(ptr, val, vallen);
+	*ptr++ = (uint8_t) (uhh->vallen & 0xff);
+	*ptr++ = (uint8_t) ((uhh->vallen >> 8) & 0xff);
+	memcpy(ptr, uhh->val, uhh->vallen);
 
-	return 2 + keylen + 2 + vallen;
+	return 2 + keylen + 2 + uhh->vallen;
 }
 
 static char *proxy1_parse(char *ptr, char *watermark, char **src, uint16_t *src_len, char **dst, uint16_t *dst_len,  char **src_port, uint16_t *src_port_len, char **dst_port, uint16_t *dst_port_len) {
@@ -170,8 +133,8 @@ static char *proxy1_parse(char *ptr, char *watermark, char **src, uint16_t *src_
 static int http_parse(struct wsgi_request *wsgi_req, char *watermark) {
 
 	char *ptr = wsgi_req->proto_parser_buf;
-	char *base = ptr;
-	char *query_string = NULL;
+	struct uwsgi_http_request_line uhrl;
+	struct uwsgi_http_header uhh;
 	char ip[INET_ADDRSTRLEN+1];
 	struct sockaddr_in *http_sin = (struct sockaddr_in *) &wsgi_req->c_addr;
 	char *proxy_src = NULL;
@@ -185,76 +148,36 @@ static int http_parse(struct wsgi_request *wsgi_req, char *watermark) {
 
 	if (uwsgi.enable_proxy_protocol) {
 		ptr = proxy1_parse(ptr, watermark, &proxy_src, &proxy_src_len, &proxy_dst, &proxy_dst_len, &proxy_src_port, &proxy_src_port_len, &proxy_dst_port, &proxy_dst_port_len);
-		base = ptr;
 	}
 
+	ptr = uwsgi_http_parse_request_line(ptr, watermark, &uhrl);
+	if (!ptr) return -1;
+
 	// REQUEST_METHOD 
-	while (ptr < watermark) {
-		if (*ptr == ' ') {
-			wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "REQUEST_METHOD", 14, base, ptr - base);
-			ptr++;
-			break;
-		}
-		ptr++;
-	}
+	wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "REQUEST_METHOD", 14, uhrl.method, uhrl.method_len);
 
 	// REQUEST_URI / PATH_INFO / QUERY_STRING
-	base = ptr;
-	while (ptr < watermark) {
-		if (*ptr == '?' && !query_string) {
-			if (watermark + (ptr - base) < (char *)(wsgi_req->proto_parser_buf + uwsgi.buffer_size)) {
-				uint16_t path_info_len = ptr - base;
-				char *path_info = uwsgi_malloc(path_info_len);
-				http_url_decode(base, &path_info_len, path_info);
-				wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "PATH_INFO", 9, path_info, path_info_len);
-				free(path_info);
-			}
-			else {
-				uwsgi_log("not enough space in wsgi_req http proto_parser_buf to decode PATH_INFO, consider tuning it with --buffer-size\n");
-				return -1;
-			}
-			query_string = ptr + 1;
-		}
-		else if (*ptr == ' ') {
-			wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "REQUEST_URI", 11, base, ptr - base);
-			
-			if (!query_string) {
-				if (watermark + (ptr - base) < (char *)(wsgi_req->proto_parser_buf + uwsgi.buffer_size)) {
-                                	uint16_t path_info_len = ptr - base;
-					char *path_info = uwsgi_malloc(path_info_len);
-                                	http_url_decode(base, &path_info_len, path_info);
-                                	wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "PATH_INFO", 9, path_info, path_info_len);
-					free(path_info);
-                        	}
-				else {
-					uwsgi_log("not enough space in wsgi_req http proto_parser_buf to decode PATH_INFO, consider tuning it with --buffer-size\n");
-					return -1;
-				}
-				wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "QUERY_STRING", 12, "", 0);
-			}
-			else {
-				wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "QUERY_STRING", 12, query_string, ptr - query_string);
-			}
-			ptr++;
-			break;
-		}
-		ptr++;
+	wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "REQUEST_URI", 11, uhrl.uri, uhrl.uri_len);
+	if (watermark + uhrl.path_len < (char *)(wsgi_req->proto_parser_buf + uwsgi.buffer_size)) {
+		uint16_t path_info_len = uhrl.path_len;
+		char *path_info = uwsgi_malloc(path_info_len);
+		http_url_decode(uhrl.path, &path_info_len, path_info);
+		wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "PATH_INFO", 9, path_info, path_info_len);
+		free(path_info);
+	}
+	else {
+		uwsgi_log("not enough space in wsgi_req http proto_parser_buf to decode PATH_INFO, consider tuning it with --buffer-size\n");
+		return -1;
+	}
+	if (uhrl.query_string) {
+		wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "QUERY_STRING", 12, uhrl.query_string, uhrl.query_string_len);
+	}
+	else {
+		wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "QUERY_STRING", 12, "", 0);
 	}
 
 	// SERVER_PROTOCOL
-	base = ptr;
-	while (ptr < watermark) {
-		if (*ptr == '\r') {
-			if (ptr + 1 >= watermark)
-				return -1 ;
-			if (*(ptr + 1) != '\n')
-				return -1;
-			wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "SERVER_PROTOCOL", 15, base, ptr - base);
-			ptr += 2;
-			break;
-		}
-		ptr++;
-	}
+	wsgi_req->uh->pktsize += proto_base_add_uwsgi_var(wsgi_req, "SERVER_PROTOCOL", 15, uhrl.protocol, uhrl.protocol_len);
 
 	// SCRIPT_NAME
 	if (!uwsgi.manage_script_name) {
@@ -302,29 +225,12 @@ static int http_parse(struct wsgi_request *wsgi_req, char *watermark) {
 	}
 
 	//HEADERS
-	base = ptr;
-
-	while (ptr < watermark) {
-		if (*ptr == '\r') {
-			if (ptr + 1 >= watermark)
-				return -1;
-			if (*(ptr + 1) != '\n')
-				return -1;
-			// multiline header ?
-			if (ptr + 2 < watermark) {
-				if (*(ptr + 2) == ' ' || *(ptr + 2) == '\t') {
-					ptr += 2;
-					continue;
-				}
-			}
-			wsgi_req->uh->pktsize += http_add_uwsgi_header(wsgi_req, base, ptr - base);
-			ptr++;
-			base = ptr + 1;
-		}
-		ptr++;
+	int ret;
+	while ((ret = uwsgi_http_parse_header(&ptr, watermark, &uhh)) > 0) {
+		wsgi_req->uh->pktsize += http_add_uwsgi_header(wsgi_req, &uhh);
 	}
 
-	return 0;
+	return ret;
 
 }
 
@@ -332,8 +238,8 @@ static int http_parse(struct wsgi_request *wsgi_req, char *watermark) {
 
 static int uwsgi_proto_http_parser(struct wsgi_request *wsgi_req) {
 
-	ssize_t j;
-	char *ptr;
+	size_t from;
+	ssize_t end;
 
 	// first round ? (wsgi_req->proto_parser_buf is freed at the end of the request)
 	if (!wsgi_req->proto_parser_buf) {
@@ -363,37 +269,21 @@ static int uwsgi_proto_http_parser(struct wsgi_request *wsgi_req) {
 	return -1;
 
 parse:
-	ptr = wsgi_req->proto_parser_buf + wsgi_req->proto_parser_pos;
+	// the \r\n\r\n could start in the previous read
+	from = wsgi_req->proto_parser_pos > 3 ? wsgi_req->proto_parser_pos - 3 : 0;
 	wsgi_req->proto_parser_pos += len;
 
-	for (j = 0; j < len; j++) {
-		if (*ptr == '\r' && (wsgi_req->proto_parser_status == 0 || wsgi_req->proto_parser_status == 2)) {
-			wsgi_req->proto_parser_status++;
-		}
-		else if (*ptr == '\r') {
-			wsgi_req->proto_parser_status = 1;
-		}
-		else if (*ptr == '\n' && wsgi_req->proto_parser_status == 1) {
-			wsgi_req->proto_parser_status = 2;
-		}
-		else if (*ptr == '\n' && wsgi_req->proto_parser_status == 3) {
-			ptr++;
-			wsgi_req->proto_parser_remains = len - (j + 1);
-			if (wsgi_req->proto_parser_remains > 0) {
-				wsgi_req->proto_parser_remains_buf = (wsgi_req->proto_parser_buf + wsgi_req->proto_parser_pos) - wsgi_req->proto_parser_remains;
-			}
-			if (http_parse(wsgi_req, ptr)) return -1;
-			wsgi_req->uh->modifier1 = uwsgi.http_modifier1;
-			wsgi_req->uh->modifier2 = uwsgi.http_modifier2;
-			return UWSGI_OK;
-		}
-		else {
-			wsgi_req->proto_parser_status = 0;
-		}
-		ptr++;
-	}
+	end = uwsgi_http_headers_end(wsgi_req->proto_parser_buf, wsgi_req->proto_parser_pos, from);
+	if (end < 0) return UWSGI_AGAIN;
 
-	return UWSGI_AGAIN;
+	wsgi_req->proto_parser_remains = wsgi_req->proto_parser_pos - end;
+	if (wsgi_req->proto_parser_remains > 0) {
+		wsgi_req->proto_parser_remains_buf = wsgi_req->proto_parser_buf + end;
+	}
+	if (http_parse(wsgi_req, wsgi_req->proto_parser_buf + end)) return -1;
+	wsgi_req->uh->modifier1 = uwsgi.http_modifier1;
+	wsgi_req->uh->modifier2 = uwsgi.http_modifier2;
+	return UWSGI_OK;
 }
 
 static void uwsgi_httpize_var(char *buf, size_t len) {
@@ -577,8 +467,8 @@ void uwsgi_proto_http_setup(struct uwsgi_socket *uwsgi_sock) {
 #ifdef UWSGI_SSL
 static int uwsgi_proto_https_parser(struct wsgi_request *wsgi_req) {
 
-        ssize_t j;
-        char *ptr;
+	size_t from;
+	ssize_t end;
 	int len = -1;
 
         // first round ? (wsgi_req->proto_parser_buf is freed at the end of the request)
@@ -622,39 +512,23 @@ empty:
         return -1;
 
 parse:
-        ptr = wsgi_req->proto_parser_buf + wsgi_req->proto_parser_pos;
-        wsgi_req->proto_parser_pos += len;
+	// the \r\n\r\n could start in the previous read
+	from = wsgi_req->proto_parser_pos > 3 ? wsgi_req->proto_parser_pos - 3 : 0;
+	wsgi_req->proto_parser_pos += len;
 
-        for (j = 0; j < len; j++) {
-                if (*ptr == '\r' && (wsgi_req->proto_parser_status == 0 || wsgi_req->proto_parser_status == 2)) {
-                        wsgi_req->proto_parser_status++;
-                }
-                else if (*ptr == '\r') {
-                        wsgi_req->proto_parser_status = 1;
-                }
-                else if (*ptr == '\n' && wsgi_req->proto_parser_status == 1) {
-                        wsgi_req->proto_parser_status = 2;
-                }
-                else if (*ptr == '\n' && wsgi_req->proto_parser_status == 3) {
-                        ptr++;
-                        wsgi_req->proto_parser_remains = len - (j + 1);
-                        if (wsgi_req->proto_parser_remains > 0) {
-                                wsgi_req->proto_parser_remains_buf = (wsgi_req->proto_parser_buf + wsgi_req->proto_parser_pos) - wsgi_req->proto_parser_remains;
-                        }
-			wsgi_req->https = "on";
-			wsgi_req->https_len = 2;
-                        if (http_parse(wsgi_req, ptr)) return -1;
-                        wsgi_req->uh->modifier1 = uwsgi.https_modifier1;
-                        wsgi_req->uh->modifier2 = uwsgi.https_modifier2;
-                        return UWSGI_OK;
-                }
-                else {
-                        wsgi_req->proto_parser_status = 0;
-                }
-                ptr++;
-        }
+	end = uwsgi_http_headers_end(wsgi_req->proto_parser_buf, wsgi_req->proto_parser_pos, from);
+	if (end < 0) return UWSGI_AGAIN;
 
-        return UWSGI_AGAIN;
+	wsgi_req->proto_parser_remains = wsgi_req->proto_parser_pos - end;
+	if (wsgi_req->proto_parser_remains > 0) {
+		wsgi_req->proto_parser_remains_buf = wsgi_req->proto_parser_buf + end;
+	}
+	wsgi_req->https = "on";
+	wsgi_req->https_len = 2;
+	if (http_parse(wsgi_req, wsgi_req->proto_parser_buf + end)) return -1;
+	wsgi_req->uh->modifier1 = uwsgi.https_modifier1;
+	wsgi_req->uh->modifier2 = uwsgi.https_modifier2;
+	return UWSGI_OK;
 }
 
 void uwsgi_proto_https_setup(struct uwsgi_socket *uwsgi_sock) {
@@ -0,0 +1,45 @@
+import uwsgi
+
+import time
+
+# compare the chained and the open addressing cache indexes
+#
+# uwsgi --plugin python --cache2 name=chain,items=200000,blocksize=64 --cache2 name=open,items=200000,blocksize=64,index=open --pyrun t/cachebench.py
+
+ITEMS = 100000
+ROUNDS = 5
+
+keys = ['key%d' % i for i in range(0, ITEMS)]
+missing = ['nokey%d' % i for i in range(0, ITEMS)]
+
+def bench(cache):
+    for key in keys:
+        if not uwsgi.cache_set(key, key, 0, cache):
+            raise Exception('unable to store %s in cache %s' % (key, cache))
+
+    t0 = time.time()
+    for i in range(0, ROUNDS):
+        for key in keys:
+            if uwsgi.cache_get(key, cache) != key:
+                raise Exception('CACHE BENCH FAILED: invalid value for %s in cache %s' % (key, cache))
+    hit = time.time() - t0
+
+    t0 = time.time()
+    for i in range(0, ROUNDS):
+        for key in missing:
+            if uwsgi.cache_exists(key, cache):
+                raise Exception('CACHE BENCH FAILED: unexpected key %s in cache %s' % (key, cache))
+    miss = time.time() - t0
+
+    t0 = time.time()
+    for key in keys:
+        uwsgi.cache_del(key, cache)
+    delete = time.time() - t0
+
+    ops = ITEMS * ROUNDS
+    print "%s: get %d ops/s, miss %d ops/s, del %d ops/s" % (cache, ops / hit, ops / miss, ITEMS / delete)
+
+for cache in ('chain', 'open'):
+    bench(cache)
+
+print "TEST PASSED"
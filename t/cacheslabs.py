@@ -0,0 +1,41 @@
+import uwsgi
+
+import time
+import random
+
+# compare the bitmap and the slab allocators with mixed size values (100 bytes - 64k)
+#
+# uwsgi --plugin python --cache2 name=bitmap,items=20000,blocksize=64,blocks=1600000,bitmap=1 --cache2 name=slabs,items=20000,blocksize=64,blocks=1600000,slabs=1 --pyrun t/cacheslabs.py
+
+ITEMS = 4000
+ROUNDS = 10
+
+random.seed(17)
+sizes = [random.randint(100, 64 * 1024) for i in range(0, ITEMS)]
+keys = ['key%d' % i for i in range(0, ITEMS)]
+values = ['x' * size for size in sizes]
+
+def bench(cache):
+    # fill the cache with 1/3 of the items
+    for i in range(0, ITEMS / 3):
+        uwsgi.cache_set(keys[i], values[i], 0, cache)
+
+    full = 0
+    t0 = time.time()
+    for r in range(0, ROUNDS):
+        for i in range(0, ITEMS):
+            key = keys[(i * 7 + r) % ITEMS]
+            if not uwsgi.cache_update(key, values[(i + r) % ITEMS], 0, cache):
+                full += 1
+            # churn
+            if i % 2:
+                uwsgi.cache_del(keys[(i * 13 + r) % ITEMS], cache)
+    elapsed = time.time() - t0
+
+    ops = ITEMS * ROUNDS
+    print "%s: set %d ops/s (%d failed)" % (cache, ops / elapsed, full)
+
+for cache in ('bitmap', 'slabs'):
+    bench(cache)
+
+print "TEST PASSED"
@@ -0,0 +1,105 @@
+/*
+
+	hash algorithms benchmark: throughput (GB/s) and distribution quality
+	(chi-square over 65536 buckets, like the cache hashtable) for various key lengths
+
+	make hashbench && ./hashbench [algo]
+
+*/
+
+#include "../../core/hash.c"
+
+struct uwsgi_server uwsgi;
+
+// stubs for the few core functions used by core/hash.c
+size_t uwsgi_str_num(char *str, int len) {
+	return 0;
+}
+
+void uwsgi_exit(int status) {
+	_exit(status);
+}
+
+void *uwsgi_calloc(size_t size) {
+	void *ptr = calloc(1, size);
+	if (!ptr) {
+		perror("calloc()");
+		exit(1);
+	}
+	return ptr;
+}
+
+#define BUCKETS 65536
+#define KEYS (BUCKETS * 16)
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void bench(struct uwsgi_hash_algo *uha, uint64_t len) {
+	char *buf = uwsgi_calloc(len + 32);
+	uint64_t i;
+	for (i = 0; i < len + 32; i++) buf[i] = 'a' + (i % 26);
+
+	// throughput
+	uint64_t total = 0;
+	volatile uint32_t sink = 0;
+	double t0 = now();
+	double elapsed = 0;
+	while (elapsed < 0.2) {
+		for (i = 0; i < 1024; i++) {
+			sink += uha->func(buf + (i % 32), len);
+		}
+		total += len * 1024;
+		elapsed = now() - t0;
+	}
+
+	// distribution of sequential keys (the worst case for weak hashes)
+	uint32_t *buckets = uwsgi_calloc(sizeof(uint32_t) * BUCKETS);
+	uint64_t keys = KEYS;
+	// short keys cannot be all different
+	if (len < 7) {
+		keys = 1;
+		for (i = 0; i < len; i++) keys *= 10;
+	}
+	for (i = 0; i < keys; i++) {
+		int klen = snprintf(buf, len + 1, "%0*llu", (int) len, (unsigned long long) i);
+		if (klen > (int) len) klen = len;
+		buckets[uha->func(buf, klen) % BUCKETS]++;
+	}
+	double expected = (double) keys / BUCKETS;
+	double chi2 = 0;
+	uint32_t max = 0;
+	for (i = 0; i < BUCKETS; i++) {
+		double diff = buckets[i] - expected;
+		chi2 += (diff * diff) / expected;
+		if (buckets[i] > max) max = buckets[i];
+	}
+
+	// chi2/buckets is ~1.0 for an uniform distribution
+	printf("%-8s %6llu bytes: %8.3f GB/s  chi2/n %8.3f  max bucket %5u (expected %.1f)\n", uha->name, (unsigned long long) len,
+		(total / elapsed) / (1024 * 1024 * 1024), chi2 / BUCKETS, max, expected);
+
+	free(buckets);
+	free(buf);
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t lens[] = { 4, 8, 16, 32, 64, 128, 256, 1024, 4096, 0 };
+	uwsgi_hash_algo_register_all();
+	struct uwsgi_hash_algo *uha = uwsgi.hash_algos;
+	while (uha) {
+		// skip the non-hashing algos
+		if (!strcmp(uha->name, "random") || !strcmp(uha->name, "rand") || !strcmp(uha->name, "rr")) goto next;
+		if (argc > 1 && strcmp(argv[1], uha->name)) goto next;
+		int i;
+		for (i = 0; lens[i]; i++) {
+			bench(uha, lens[i]);
+		}
+next:
+		uha = uha->next;
+	}
+	return 0;
+}
@@ -0,0 +1,447 @@
+/*
+
+	http request parser fuzzer: generates random (valid and mangled) requests and checks
+	core/http.c against a byte-at-a-time reference implementation of the same rules.
+	Valid requests are checked against the header translation of the old parsers too.
+
+	make httpfuzz && ./httpfuzz [-n requests] [-s seed]
+
+	every request is placed at the end of a page followed by an unmapped one,
+	so reading a single byte after the data crashes the fuzzer.
+	Rebuild with CC="cc -mavx2" and CC="cc -U__SSE2__" to check the other code paths.
+
+*/
+
+#include "../../uwsgi.h"
+
+// stubs for the core functions used by core/http.c
+void uwsgi_exit(int status) {
+	_exit(status);
+}
+
+int uwsgi_strncmp(char *src, int slen, char *dst, int dlen) {
+	if (slen != dlen)
+		return 1;
+	return memcmp(src, dst, dlen);
+}
+
+#define HTTPFUZZ_MAX 8192
+
+static uint64_t httpfuzz_state;
+
+static uint32_t httpfuzz_rand(uint32_t n) {
+	// xorshift64*
+	httpfuzz_state ^= httpfuzz_state >> 12;
+	httpfuzz_state ^= httpfuzz_state << 25;
+	httpfuzz_state ^= httpfuzz_state >> 27;
+	return (uint32_t) ((httpfuzz_state * 0x2545F4914F6CDD1DULL) >> 32) % n;
+}
+
+// the parsers output (a log of what they found)
+struct httpfuzz_out {
+	char buf[HTTPFUZZ_MAX * 4];
+	size_t pos;
+};
+
+static void httpfuzz_log(struct httpfuzz_out *out, char type, char *data, size_t len) {
+	out->buf[out->pos++] = type;
+	memcpy(out->buf + out->pos, &len, sizeof(size_t));
+	out->pos += sizeof(size_t);
+	memcpy(out->buf + out->pos, data, len);
+	out->pos += len;
+}
+
+static void httpfuzz_log_num(struct httpfuzz_out *out, char type, ssize_t n) {
+	httpfuzz_log(out, type, (char *) &n, sizeof(ssize_t));
+}
+
+// core/http.c
+static void httpfuzz_parse(char *buf, size_t len, size_t pos, struct httpfuzz_out *out) {
+	struct uwsgi_http_request_line uhrl;
+	struct uwsgi_http_header uhh;
+
+	ssize_t end = uwsgi_http_headers_end(buf, len, pos);
+	httpfuzz_log_num(out, 'E', end);
+	if (end < 0) return;
+	char *watermark = buf + end;
+
+	char *ptr = uwsgi_http_parse_request_line(buf, watermark, &uhrl);
+	if (!ptr) {
+		httpfuzz_log_num(out, 'R', -1);
+		return;
+	}
+	httpfuzz_log(out, 'M', uhrl.method, uhrl.method_len);
+	httpfuzz_log(out, 'U', uhrl.uri, uhrl.uri_len);
+	httpfuzz_log(out, 'P', uhrl.path, uhrl.path_len);
+	if (uhrl.query_string) {
+		httpfuzz_log(out, 'Q', uhrl.query_string, uhrl.query_string_len);
+	}
+	httpfuzz_log(out, 'V', uhrl.protocol, uhrl.protocol_len);
+	httpfuzz_log_num(out, 'H', ptr - buf);
+
+	int ret;
+	while ((ret = uwsgi_http_parse_header(&ptr, watermark, &uhh)) > 0) {
+		httpfuzz_log(out, uhh.prefix ? 'K' : 'k', uhh.key, uhh.keylen);
+		httpfuzz_log(out, 'v', uhh.val, uhh.vallen);
+	}
+	httpfuzz_log_num(out, 'X', ret);
+	if (ret == 0) httpfuzz_log_num(out, 'H', ptr - buf);
+}
+
+// the reference implementation
+static char *ref_find(char *ptr, char *end, char *chars) {
+	while (ptr < end) {
+		if (strchr(chars, *ptr)) return ptr;
+		ptr++;
+	}
+	return NULL;
+}
+
+// returns 0 for valid requests, -1 for invalid ones and -2 if the end of the headers is missing
+static int ref_parse(char *buf, size_t len, size_t pos, struct httpfuzz_out *out) {
+	ssize_t end = -1;
+	size_t i;
+	for (i = pos; i + 4 <= len; i++) {
+		if (!memcmp(buf + i, "\r\n\r\n", 4)) {
+			end = i + 4;
+			break;
+		}
+	}
+	httpfuzz_log_num(out, 'E', end);
+	if (end < 0) return -2;
+	char *watermark = buf + end;
+
+	char *method = buf;
+	char *ptr = ref_find(buf, watermark, " \r\n");
+	if (!ptr || *ptr != ' ') goto invalid;
+	size_t method_len = ptr - method;
+
+	char *uri = ++ptr;
+	char *query_string = NULL;
+	size_t query_string_len = 0;
+	ptr = ref_find(ptr, watermark, " ?\r\n");
+	if (!ptr) goto invalid;
+	size_t path_len = ptr - uri;
+	if (*ptr == '?') {
+		query_string = ptr + 1;
+		ptr = ref_find(query_string, watermark, " \r\n");
+		if (!ptr) goto invalid;
+		query_string_len = ptr - query_string;
+	}
+	if (*ptr != ' ') goto invalid;
+	size_t uri_len = ptr - uri;
+
+	char *protocol = ++ptr;
+	ptr = ref_find(ptr, watermark, "\r\n");
+	if (!ptr || *ptr != '\r' || ptr + 1 >= watermark || ptr[1] != '\n') goto invalid;
+
+	httpfuzz_log(out, 'M', method, method_len);
+	httpfuzz_log(out, 'U', uri, uri_len);
+	httpfuzz_log(out, 'P', uri, path_len);
+	if (query_string) {
+		httpfuzz_log(out, 'Q', query_string, query_string_len);
+	}
+	httpfuzz_log(out, 'V', protocol, ptr - protocol);
+	ptr += 2;
+	httpfuzz_log_num(out, 'H', ptr - buf);
+
+	for (;;) {
+		if (watermark - ptr < 2) goto error;
+		if (ptr[0] == '\r' && ptr[1] == '\n') {
+			httpfuzz_log_num(out, 'X', 0);
+			httpfuzz_log_num(out, 'H', ptr + 2 - buf);
+			return 0;
+		}
+		char *line = ptr;
+		for (;;) {
+			if (ptr >= watermark) goto error;
+			if (*ptr == '\r') {
+				if (ptr + 1 >= watermark || ptr[1] != '\n') goto error;
+				if (ptr + 2 < watermark && (ptr[2] == ' ' || ptr[2] == '\t')) {
+					ptr += 2;
+					continue;
+				}
+				break;
+			}
+			ptr++;
+		}
+		if (ptr - line > UMAX16) goto error;
+		char *colon = NULL;
+		char *k;
+		for (k = line; k < ptr; k++) {
+			if (*k == ':') {
+				colon = k;
+				break;
+			}
+			if (*k >= 'a' && *k <= 'z') *k -= 0x20;
+			else if (*k == '-') *k = '_';
+		}
+		if (!colon || colon == line) goto error;
+		char *val = colon + 1;
+		while (val < ptr && *val == ' ') val++;
+		int prefix = uwsgi_strncmp("CONTENT_LENGTH", 14, line, colon - line) && uwsgi_strncmp("CONTENT_TYPE", 12, line, colon - line);
+		httpfuzz_log(out, prefix ? 'K' : 'k', line, colon - line);
+		httpfuzz_log(out, 'v', val, ptr - val);
+		ptr += 2;
+	}
+
+invalid:
+	httpfuzz_log_num(out, 'R', -1);
+	return -1;
+error:
+	httpfuzz_log_num(out, 'X', -1);
+	return -1;
+}
+
+// the header translation of the old byte-at-a-time parsers
+static void old_header(char *hh, int hhlen, struct httpfuzz_out *out) {
+	int i;
+	int status = 0;
+	char *val = hh;
+	uint16_t keylen = 0, vallen = 0;
+
+	for (i = 0; i < hhlen; i++) {
+		if (!status) {
+			hh[i] = toupper((int) hh[i]);
+			if (hh[i] == '-')
+				hh[i] = '_';
+			if (hh[i] == ':') {
+				status = 1;
+				keylen = i;
+			}
+		}
+		else if (status == 1 && hh[i] != ' ') {
+			status = 2;
+			val += i;
+			vallen++;
+		}
+		else if (status == 2) {
+			vallen++;
+		}
+	}
+
+	int prefix = uwsgi_strncmp("CONTENT_LENGTH", 14, hh, keylen) && uwsgi_strncmp("CONTENT_TYPE", 12, hh, keylen);
+	httpfuzz_log(out, prefix ? 'K' : 'k', hh, keylen);
+	httpfuzz_log(out, 'v', val, vallen);
+}
+
+static void old_headers(char *ptr, char *watermark, struct httpfuzz_out *out) {
+	char *base = ptr;
+	while (ptr < watermark) {
+		if (*ptr == '\r') {
+			if (ptr + 1 >= watermark)
+				break;
+			if (*(ptr + 1) != '\n')
+				break;
+			// multiline header ?
+			if (ptr + 2 < watermark) {
+				if (*(ptr + 2) == ' ' || *(ptr + 2) == '\t') {
+					ptr += 2;
+					continue;
+				}
+			}
+			// the empty line
+			if (ptr == base) break;
+			old_header(base, ptr - base, out);
+			ptr++;
+			base = ptr + 1;
+		}
+		ptr++;
+	}
+}
+
+static void new_headers(char *ptr, char *watermark, struct httpfuzz_out *out) {
+	struct uwsgi_http_header uhh;
+	while (uwsgi_http_parse_header(&ptr, watermark, &uhh) > 0) {
+		httpfuzz_log(out, uhh.prefix ? 'K' : 'k', uhh.key, uhh.keylen);
+		httpfuzz_log(out, 'v', uhh.val, uhh.vallen);
+	}
+}
+
+static void httpfuzz_append(char *buf, size_t *len, char *data, size_t data_len) {
+	if (*len + data_len > HTTPFUZZ_MAX) return;
+	memcpy(buf + *len, data, data_len);
+	*len += data_len;
+}
+
+static void httpfuzz_random_string(char *buf, size_t *len, char *alphabet, size_t max) {
+	size_t n = httpfuzz_rand(max + 1);
+	size_t alphabet_len = strlen(alphabet);
+	while (n--) {
+		char c = alphabet[httpfuzz_rand(alphabet_len)];
+		httpfuzz_append(buf, len, &c, 1);
+	}
+}
+
+static char *httpfuzz_methods[] = {"GET", "POST", "HEAD", "PUT", "DELETE", "OPTIONS", "PROPFIND", NULL};
+static char *httpfuzz_keys[] = {"Host", "User-Agent", "Accept", "Content-Length", "content-type", "CONTENT-TYPE", "Content-Typex", "Cookie", "X-Forwarded-For", "Sec-WebSocket-Key", "x", NULL};
+
+#define HTTPFUZZ_URI "abcdefghijklmnopqrstuvwxyz0123456789/.%-_=&?"
+#define HTTPFUZZ_KEY "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_.{}[]\x7f\x80\xe0\xff"
+#define HTTPFUZZ_VAL "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789 ;,:=\"/\t-\x80\xff"
+
+// a valid request (with long tokens from time to time, to cross the vectors boundaries)
+static size_t httpfuzz_request(char *buf) {
+	size_t len = 0;
+	int i;
+	char *method = httpfuzz_methods[httpfuzz_rand(7)];
+	httpfuzz_append(buf, &len, method, strlen(method));
+	httpfuzz_append(buf, &len, " /", 2);
+	httpfuzz_random_string(buf, &len, HTTPFUZZ_URI, httpfuzz_rand(4) ? 20 : 200);
+	httpfuzz_append(buf, &len, " HTTP/1.", 8);
+	httpfuzz_random_string(buf, &len, "01", 1);
+	httpfuzz_append(buf, &len, "\r\n", 2);
+	int headers = httpfuzz_rand(20);
+	for (i = 0; i < headers; i++) {
+		if (httpfuzz_rand(2)) {
+			char *key = httpfuzz_keys[httpfuzz_rand(11)];
+			httpfuzz_append(buf, &len, key, strlen(key));
+		}
+		else {
+			httpfuzz_append(buf, &len, "k", 1);
+			httpfuzz_random_string(buf, &len, HTTPFUZZ_KEY, httpfuzz_rand(4) ? 16 : 64);
+		}
+		httpfuzz_append(buf, &len, ":", 1);
+		httpfuzz_random_string(buf, &len, " ", 3);
+		httpfuzz_random_string(buf, &len, HTTPFUZZ_VAL, httpfuzz_rand(4) ? 40 : 400);
+		// continuation line
+		if (!httpfuzz_rand(10)) {
+			httpfuzz_append(buf, &len, httpfuzz_rand(2) ? "\r\n " : "\r\n\t", 3);
+			httpfuzz_random_string(buf, &len, HTTPFUZZ_VAL, 40);
+		}
+		httpfuzz_append(buf, &len, "\r\n", 2);
+	}
+	httpfuzz_append(buf, &len, "\r\n", 2);
+	return len;
+}
+
+// replaces, inserts or removes some byte (mostly with the ones the parser looks for)
+static size_t httpfuzz_mangle(char *buf, size_t len) {
+	static char specials[] = "\r\n :?\t-aZ\x80";
+	int n = 1 + httpfuzz_rand(4);
+	while (n-- && len > 0) {
+		size_t pos = httpfuzz_rand(len);
+		char c = specials[httpfuzz_rand(sizeof(specials) - 1)];
+		switch (httpfuzz_rand(3)) {
+		case 0:
+			buf[pos] = c;
+			break;
+		case 1:
+			if (len < HTTPFUZZ_MAX) {
+				memmove(buf + pos + 1, buf + pos, len - pos);
+				buf[pos] = c;
+				len++;
+			}
+			break;
+		default:
+			memmove(buf + pos, buf + pos + 1, len - pos - 1);
+			len--;
+			break;
+		}
+	}
+	// truncate
+	if (!httpfuzz_rand(8)) len = httpfuzz_rand(len + 1);
+	return len;
+}
+
+static void httpfuzz_fail(char *what, char *request, size_t len, size_t pos) {
+	fprintf(stderr, "%s mismatch (pos %llu) for request:\n", what, (unsigned long long) pos);
+	fwrite(request, len, 1, stderr);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t n = 1000000;
+	uint64_t seed = time(NULL);
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n':
+			n = strtoull(optarg, NULL, 10);
+			break;
+		case 's':
+			seed = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n requests] [-s seed]\n", argv[0]);
+			return 1;
+		}
+	}
+	httpfuzz_state = seed ? seed : 1;
+
+	// the data always ends at the guard page
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t area_size = ((HTTPFUZZ_MAX / page_size) + 1) * page_size;
+	char *area = mmap(NULL, area_size + page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (area == MAP_FAILED) {
+		perror("mmap()");
+		return 1;
+	}
+	if (mprotect(area + area_size, page_size, PROT_NONE)) {
+		perror("mprotect()");
+		return 1;
+	}
+
+	char *request = malloc(HTTPFUZZ_MAX);
+	struct httpfuzz_out *out = malloc(sizeof(struct httpfuzz_out));
+	struct httpfuzz_out *ref = malloc(sizeof(struct httpfuzz_out));
+	uint64_t i, valid = 0, invalid = 0, incomplete = 0;
+
+	for (i = 0; i < n; i++) {
+		size_t len = httpfuzz_request(request);
+		int mangled = httpfuzz_rand(2);
+		if (mangled) len = httpfuzz_mangle(request, len);
+		// the search for the end of the headers could start after the first byte (like after a partial read)
+		size_t pos = httpfuzz_rand(4) ? 0 : httpfuzz_rand(len + 1);
+
+		char *buf = area + area_size - len;
+		memcpy(buf, request, len);
+		out->pos = 0;
+		httpfuzz_parse(buf, len, pos, out);
+		char *new_buf = malloc(len + 1);
+		memcpy(new_buf, buf, len);
+
+		memcpy(buf, request, len);
+		ref->pos = 0;
+		int ret = ref_parse(buf, len, pos, ref);
+
+		if (out->pos != ref->pos || memcmp(out->buf, ref->buf, out->pos)) httpfuzz_fail("parser", request, len, pos);
+		// the in-place translation must not touch the values
+		if (memcmp(new_buf, buf, len)) httpfuzz_fail("translation", request, len, pos);
+		free(new_buf);
+
+		if (ret == -2) {
+			incomplete++;
+			continue;
+		}
+		if (ret == -1) {
+			invalid++;
+			continue;
+		}
+		valid++;
+
+		// valid requests must get the same vars of the old parsers
+		if (!mangled) {
+			ssize_t end = uwsgi_http_headers_end(request, len, 0);
+			char *headers = uwsgi_http_parse_request_line(request, request + end, &(struct uwsgi_http_request_line) {0});
+			memcpy(buf, request, len);
+			out->pos = 0;
+			new_headers(buf + (headers - request), buf + end, out);
+			memcpy(buf, request, len);
+			ref->pos = 0;
+			old_headers(buf + (headers - request), buf + end, ref);
+			if (out->pos != ref->pos || memcmp(out->buf, ref->buf, out->pos)) httpfuzz_fail("old translation", request, len, 0);
+		}
+	}
+
+	free(request);
+	free(out);
+	free(ref);
+	munmap(area, area_size + page_size);
+
+	printf("%llu requests (seed %llu): %llu valid, %llu invalid, %llu incomplete, all the results match\n",
+		(unsigned long long) n, (unsigned long long) seed, (unsigned long long) valid, (unsigned long long) invalid, (unsigned long long) incomplete);
+	return 0;
+}
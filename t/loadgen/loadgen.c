@@ -0,0 +1,273 @@
+/*
+
+	a minimal HTTP load generator, useful for comparing event engines
+	(and more generally the request path) on the same box
+
+	build with "make loadgen"
+
+	./loadgen [-c connections] [-d seconds] [-k] host:port [path]
+
+	every connection sends a request, waits for the whole response
+	and starts again (on the same socket with -k, on a new one otherwise).
+	At the end requests/sec and latency percentiles are reported.
+
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+struct conn {
+	int fd;
+	size_t sent;
+	size_t received;
+	ssize_t content_length;
+	size_t header_len;
+	uint64_t started;
+	char buf[8192];
+};
+
+static struct sockaddr_in addr;
+static char request[4096];
+static size_t request_len;
+static int keepalive;
+
+static uint64_t *latencies;
+static size_t latencies_n;
+static size_t latencies_max;
+static uint64_t errors;
+
+static uint64_t now_usec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void add_latency(uint64_t usec) {
+	if (latencies_n >= latencies_max) {
+		latencies_max = latencies_max ? latencies_max * 2 : 65536;
+		latencies = realloc(latencies, sizeof(uint64_t) * latencies_max);
+		if (!latencies) {
+			perror("realloc()");
+			exit(1);
+		}
+	}
+	latencies[latencies_n++] = usec;
+}
+
+static int conn_open(int efd, struct conn *c) {
+	c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (c->fd < 0) {
+		perror("socket()");
+		exit(1);
+	}
+	int one = 1;
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(int));
+	if (connect(c->fd, (struct sockaddr *) &addr, sizeof(addr)) && errno != EINPROGRESS) {
+		close(c->fd);
+		c->fd = -1;
+		return -1;
+	}
+	struct epoll_event ee;
+	memset(&ee, 0, sizeof(struct epoll_event));
+	ee.events = EPOLLOUT;
+	ee.data.ptr = c;
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, c->fd, &ee)) {
+		perror("epoll_ctl()");
+		exit(1);
+	}
+	return 0;
+}
+
+static void conn_start(int efd, struct conn *c) {
+	c->sent = 0;
+	c->received = 0;
+	c->content_length = -1;
+	c->header_len = 0;
+	c->started = now_usec();
+	if (c->fd < 0) {
+		while (conn_open(efd, c)) {
+			errors++;
+		}
+		return;
+	}
+	struct epoll_event ee;
+	memset(&ee, 0, sizeof(struct epoll_event));
+	ee.events = EPOLLOUT;
+	ee.data.ptr = c;
+	epoll_ctl(efd, EPOLL_CTL_MOD, c->fd, &ee);
+}
+
+static void conn_close(struct conn *c) {
+	if (c->fd >= 0) {
+		close(c->fd);
+		c->fd = -1;
+	}
+}
+
+// returns 1 when the response is complete
+static int response_done(struct conn *c) {
+	if (!c->header_len) {
+		char *end = memmem(c->buf, c->received, "\r\n\r\n", 4);
+		if (!end) return 0;
+		c->header_len = (end - c->buf) + 4;
+		char *cl = memmem(c->buf, c->header_len, "Content-Length:", 15);
+		if (!cl) cl = memmem(c->buf, c->header_len, "content-length:", 15);
+		if (cl) c->content_length = strtol(cl + 15, NULL, 10);
+	}
+	if (c->content_length >= 0) {
+		return c->received >= c->header_len + (size_t) c->content_length;
+	}
+	return 0;
+}
+
+static void conn_event(int efd, struct conn *c, uint32_t events) {
+	if (c->sent < request_len) {
+		ssize_t rlen = write(c->fd, request + c->sent, request_len - c->sent);
+		if (rlen <= 0) {
+			if (rlen < 0 && errno == EAGAIN) return;
+			goto error;
+		}
+		c->sent += rlen;
+		if (c->sent == request_len) {
+			struct epoll_event ee;
+			memset(&ee, 0, sizeof(struct epoll_event));
+			ee.events = EPOLLIN;
+			ee.data.ptr = c;
+			epoll_ctl(efd, EPOLL_CTL_MOD, c->fd, &ee);
+		}
+		return;
+	}
+
+	for (;;) {
+		// the body is not stored, only headers are needed
+		size_t off = c->received < sizeof(c->buf) ? c->received : 0;
+		ssize_t rlen = read(c->fd, c->buf + off, sizeof(c->buf) - off);
+		if (rlen < 0) {
+			if (errno == EAGAIN) return;
+			goto error;
+		}
+		if (rlen == 0) {
+			// connection closed by the server, without a content length that is the end of the response
+			if (c->header_len && c->content_length < 0) break;
+			goto error;
+		}
+		c->received += rlen;
+		if (response_done(c)) break;
+	}
+
+	add_latency(now_usec() - c->started);
+	if (!keepalive) conn_close(c);
+	conn_start(efd, c);
+	return;
+
+error:
+	errors++;
+	conn_close(c);
+	conn_start(efd, c);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[]) {
+	int concurrency = 16;
+	int duration = 5;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:d:k")) != -1) {
+		switch (opt) {
+		case 'c':
+			concurrency = atoi(optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'k':
+			keepalive = 1;
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (optind >= argc || concurrency < 1 || duration < 1) goto usage;
+
+	char *host = strdup(argv[optind]);
+	char *colon = strrchr(host, ':');
+	if (!colon) goto usage;
+	*colon = 0;
+	const char *path = optind + 1 < argc ? argv[optind + 1] : "/";
+
+	struct hostent *he = gethostbyname(host);
+	if (!he) {
+		fprintf(stderr, "unable to resolve %s\n", host);
+		exit(1);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(atoi(colon + 1));
+	memcpy(&addr.sin_addr, he->h_addr_list[0], sizeof(addr.sin_addr));
+
+	request_len = snprintf(request, sizeof(request), "GET %s HTTP/1.%d\r\nHost: %s\r\n%s\r\n", path, keepalive, host, keepalive ? "Connection: Keep-Alive\r\n" : "");
+
+	int efd = epoll_create(concurrency + 1);
+	if (efd < 0) {
+		perror("epoll_create()");
+		exit(1);
+	}
+
+	struct conn *conns = calloc(concurrency, sizeof(struct conn));
+	struct epoll_event *events = calloc(concurrency, sizeof(struct epoll_event));
+	int i;
+	for (i = 0; i < concurrency; i++) {
+		conns[i].fd = -1;
+		conn_start(efd, &conns[i]);
+	}
+
+	uint64_t start = now_usec();
+	uint64_t deadline = start + (uint64_t) duration * 1000000;
+	for (;;) {
+		uint64_t now = now_usec();
+		if (now >= deadline) break;
+		int ret = epoll_wait(efd, events, concurrency, (deadline - now) / 1000 + 1);
+		if (ret < 0) {
+			if (errno == EINTR) continue;
+			perror("epoll_wait()");
+			exit(1);
+		}
+		for (i = 0; i < ret; i++) {
+			conn_event(efd, events[i].data.ptr, events[i].events);
+		}
+	}
+	double elapsed = (now_usec() - start) / 1000000.0;
+
+	printf("%zu requests in %.2fs, %.0f req/s, %llu errors, %d connections%s\n", latencies_n, elapsed, latencies_n / elapsed, (unsigned long long) errors, concurrency, keepalive ? " (keepalive)" : "");
+	if (latencies_n) {
+		qsort(latencies, latencies_n, sizeof(uint64_t), cmp_u64);
+		printf("latency usec: p50 %llu p90 %llu p99 %llu max %llu\n",
+			(unsigned long long) latencies[latencies_n / 2],
+			(unsigned long long) latencies[(latencies_n * 90) / 100],
+			(unsigned long long) latencies[(latencies_n * 99) / 100],
+			(unsigned long long) latencies[latencies_n - 1]);
+	}
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-c connections] [-d seconds] [-k] host:port [path]\n", argv[0]);
+	return 1;
+}
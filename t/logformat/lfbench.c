@@ -0,0 +1,219 @@
+/*
+
+	logformat benchmark: runs uwsgi_logit_lf() against a synthetic request
+	(the output goes to /dev/null) and reports ns/line.
+
+	make lfbench && ./lfbench [-m] [-n lines] [format]
+
+	-m re-registers the built-in chunks as allocating functions (the pre-compiled
+	logformat behaviour) for comparison
+
+*/
+
+#include "../../uwsgi.h"
+#include <fcntl.h>
+
+struct uwsgi_server uwsgi;
+
+// stubs for the core functions used by core/logging.c and core/buffer.c
+void uwsgi_exit(int status) {
+	_exit(status);
+}
+
+void *uwsgi_malloc(size_t size) {
+	void *ptr = malloc(size);
+	if (!ptr) {
+		perror("malloc()");
+		exit(1);
+	}
+	return ptr;
+}
+
+void *uwsgi_calloc(size_t size) {
+	void *ptr = calloc(1, size);
+	if (!ptr) {
+		perror("calloc()");
+		exit(1);
+	}
+	return ptr;
+}
+
+void *uwsgi_calloc_shared(size_t size) {
+	return uwsgi_calloc(size);
+}
+
+char *uwsgi_concat2n(char *one, int s1, char *two, int s2) {
+	char *buf = uwsgi_malloc(s1 + s2 + 1);
+	memcpy(buf, one, s1);
+	memcpy(buf + s1, two, s2);
+	buf[s1 + s2] = 0;
+	return buf;
+}
+
+char *uwsgi_concat2(char *one, char *two) {
+	return uwsgi_concat2n(one, strlen(one), two, strlen(two));
+}
+
+char *uwsgi_concat3(char *one, char *two, char *three) {
+	char *tmp = uwsgi_concat2(one, two);
+	char *buf = uwsgi_concat2(tmp, three);
+	free(tmp);
+	return buf;
+}
+
+int uwsgi_strncmp(char *src, int slen, char *dst, int dlen) {
+	if (slen != dlen)
+		return 1;
+	return memcmp(src, dst, dlen);
+}
+
+int uwsgi_starts_with(char *src, int slen, char *dst, int dlen) {
+	if (slen < dlen)
+		return -1;
+	return memcmp(src, dst, dlen);
+}
+
+char *uwsgi_num2str(int num) {
+	char *buf = uwsgi_malloc(11);
+	snprintf(buf, 11, "%d", num);
+	return buf;
+}
+
+uint64_t uwsgi_micros() {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+time_t uwsgi_now() {
+	return time(NULL);
+}
+
+char *uwsgi_get_var(struct wsgi_request *wsgi_req, char *key, uint16_t keylen, uint16_t *len) {
+	return NULL;
+}
+
+int64_t uwsgi_metric_get(char *name, char *oid) {
+	return 0;
+}
+
+// never called by the logformat code
+static void lfbench_unused(const char *name) {
+	fprintf(stderr, "%s() should not be called\n", name);
+	exit(1);
+}
+
+void daemonize(char *logfile) { lfbench_unused("daemonize"); }
+void escape_json(char *src, size_t len, char *dst) { lfbench_unused("escape_json"); }
+int event_queue_add_fd_read(int eq, int fd) { lfbench_unused("event_queue_add_fd_read"); return -1; }
+void grace_them_all(int signum) { lfbench_unused("grace_them_all"); }
+char *uwsgi_base64_encode(char *buf, size_t len, size_t *rlen) { lfbench_unused("uwsgi_base64_encode"); return NULL; }
+char *uwsgi_check_touches(struct uwsgi_string_list *usl) { lfbench_unused("uwsgi_check_touches"); return NULL; }
+int uwsgi_kvlist_parse(char *src, size_t len, char list_separator, char kv_separator, ...) { lfbench_unused("uwsgi_kvlist_parse"); return -1; }
+char *uwsgi_resolve_ip(char *domain) { lfbench_unused("uwsgi_resolve_ip"); return NULL; }
+void uwsgi_socket_nb(int fd) { lfbench_unused("uwsgi_socket_nb"); }
+struct uwsgi_string_list *uwsgi_string_new_list(struct uwsgi_string_list **list, char *value) { lfbench_unused("uwsgi_string_new_list"); return NULL; }
+int uwsgi_waitfd_event(int fd, int timeout, int event) { lfbench_unused("uwsgi_waitfd_event"); return -1; }
+
+// the allocating chunks (as they were before the logformat was compiled)
+static ssize_t old_lf_status(struct wsgi_request *wsgi_req, char **buf) {
+	*buf = uwsgi_num2str(wsgi_req->status);
+	return strlen(*buf);
+}
+
+static ssize_t old_lf_size(struct wsgi_request *wsgi_req, char **buf) {
+	*buf = uwsgi_num2str(wsgi_req->headers_size + wsgi_req->response_size);
+	return strlen(*buf);
+}
+
+static ssize_t old_lf_msecs(struct wsgi_request *wsgi_req, char **buf) {
+	*buf = uwsgi_num2str((wsgi_req->end_of_request - wsgi_req->start_of_request) / 1000);
+	return strlen(*buf);
+}
+
+static ssize_t old_lf_ltime(struct wsgi_request *wsgi_req, char **buf) {
+	*buf = uwsgi_malloc(64);
+	time_t now = wsgi_req->start_of_request / 1000000;
+	size_t ret = strftime(*buf, 64, "%d/%b/%Y:%H:%M:%S %z", localtime(&now));
+	if (ret == 0) {
+		*buf[0] = 0;
+		return 0;
+	}
+	return ret;
+}
+
+#define lfbench_set(x, y) wsgi_req->x = y; wsgi_req->x ## _len = strlen(y);
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+int main(int argc, char *argv[]) {
+	char *format = "%(addr) - %(user) [%(ltime)] \"%(method) %(uri) %(proto)\" %(status) %(size) \"%(referer)\" \"%(uagent)\" %(msecs)ms";
+	uint64_t n = 1000000;
+	int old = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "mn:")) != -1) {
+		switch (opt) {
+		case 'm':
+			old = 1;
+			break;
+		case 'n':
+			n = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-m] [-n lines] [format]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc) format = argv[optind];
+
+	uwsgi.cores = 1;
+	uwsgi.page_size = 4096;
+	uwsgi.req_log_fd = open("/dev/null", O_WRONLY);
+
+	uwsgi_register_logchunks();
+	if (old) {
+		uwsgi_register_logchunk("status", old_lf_status, 1);
+		uwsgi_register_logchunk("size", old_lf_size, 1);
+		uwsgi_register_logchunk("msecs", old_lf_msecs, 1);
+		uwsgi_register_logchunk("ltime", old_lf_ltime, 1);
+	}
+	uwsgi_build_log_format(format);
+
+	struct uwsgi_header uh;
+	memset(&uh, 0, sizeof(struct uwsgi_header));
+	struct wsgi_request *wsgi_req = uwsgi_calloc(sizeof(struct wsgi_request));
+	wsgi_req->uh = &uh;
+	lfbench_set(remote_addr, "192.168.173.17");
+	lfbench_set(method, "GET");
+	lfbench_set(uri, "/static/js/app.min.js?v=1234567");
+	lfbench_set(protocol, "HTTP/1.1");
+	lfbench_set(referer, "https://www.example.com/index.html");
+	lfbench_set(user_agent, "Mozilla/5.0 (X11; Linux x86_64; rv:31.0) Gecko/20100101 Firefox/31.0");
+	wsgi_req->status = 200;
+	wsgi_req->headers_size = 231;
+	wsgi_req->response_size = 48213;
+	wsgi_req->start_of_request = uwsgi_micros();
+	wsgi_req->start_of_request_in_sec = wsgi_req->start_of_request / 1000000;
+	wsgi_req->end_of_request = wsgi_req->start_of_request + 1717;
+
+	uint64_t i;
+	double t0 = now();
+	for (i = 0; i < n; i++) {
+		// a new second every 1000 lines
+		if (i % 1000 == 0) {
+			wsgi_req->start_of_request += 1000000;
+			wsgi_req->start_of_request_in_sec++;
+			wsgi_req->end_of_request += 1000000;
+		}
+		uwsgi_logit_lf(wsgi_req);
+	}
+	double elapsed = now() - t0;
+
+	printf("%s: %llu lines in %.3fs, %.1f ns/line (%.0f lines/s)\n", old ? "allocating chunks" : "compiled logformat", (unsigned long long) n, elapsed, (elapsed * 1e9) / n, n / elapsed);
+	return 0;
+}
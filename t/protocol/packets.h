@@ -0,0 +1,178 @@
+/*
+	uwsgi packets captured behind the http router (--http-to), used by parsebench
+	when no packet file is specified
+*/
+
+// a browser asking for a static file (with conditional headers)
+static uint8_t parsebench_browser[] = {
+	0x00, 0x34, 0x03, 0x00, 0x0e, 0x00, 0x52, 0x45, 0x51, 0x55, 0x45, 0x53, 0x54, 0x5f, 0x4d, 0x45,
+	0x54, 0x48, 0x4f, 0x44, 0x03, 0x00, 0x47, 0x45, 0x54, 0x09, 0x00, 0x50, 0x41, 0x54, 0x48, 0x5f,
+	0x49, 0x4e, 0x46, 0x4f, 0x15, 0x00, 0x2f, 0x73, 0x74, 0x61, 0x74, 0x69, 0x63, 0x2f, 0x6a, 0x73,
+	0x2f, 0x61, 0x70, 0x70, 0x2e, 0x6d, 0x69, 0x6e, 0x2e, 0x6a, 0x73, 0x0b, 0x00, 0x52, 0x45, 0x51,
+	0x55, 0x45, 0x53, 0x54, 0x5f, 0x55, 0x52, 0x49, 0x1f, 0x00, 0x2f, 0x73, 0x74, 0x61, 0x74, 0x69,
+	0x63, 0x2f, 0x6a, 0x73, 0x2f, 0x61, 0x70, 0x70, 0x2e, 0x6d, 0x69, 0x6e, 0x2e, 0x6a, 0x73, 0x3f,
+	0x76, 0x3d, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x0c, 0x00, 0x51, 0x55, 0x45, 0x52, 0x59,
+	0x5f, 0x53, 0x54, 0x52, 0x49, 0x4e, 0x47, 0x09, 0x00, 0x76, 0x3d, 0x31, 0x32, 0x33, 0x34, 0x35,
+	0x36, 0x37, 0x0f, 0x00, 0x53, 0x45, 0x52, 0x56, 0x45, 0x52, 0x5f, 0x50, 0x52, 0x4f, 0x54, 0x4f,
+	0x43, 0x4f, 0x4c, 0x08, 0x00, 0x48, 0x54, 0x54, 0x50, 0x2f, 0x31, 0x2e, 0x31, 0x0b, 0x00, 0x53,
+	0x43, 0x52, 0x49, 0x50, 0x54, 0x5f, 0x4e, 0x41, 0x4d, 0x45, 0x00, 0x00, 0x0b, 0x00, 0x53, 0x45,
+	0x52, 0x56, 0x45, 0x52, 0x5f, 0x4e, 0x41, 0x4d, 0x45, 0x02, 0x00, 0x76, 0x6d, 0x0b, 0x00, 0x53,
+	0x45, 0x52, 0x56, 0x45, 0x52, 0x5f, 0x50, 0x4f, 0x52, 0x54, 0x04, 0x00, 0x39, 0x33, 0x33, 0x30,
+	0x0c, 0x00, 0x55, 0x57, 0x53, 0x47, 0x49, 0x5f, 0x52, 0x4f, 0x55, 0x54, 0x45, 0x52, 0x04, 0x00,
+	0x68, 0x74, 0x74, 0x70, 0x0b, 0x00, 0x52, 0x45, 0x4d, 0x4f, 0x54, 0x45, 0x5f, 0x41, 0x44, 0x44,
+	0x52, 0x09, 0x00, 0x31, 0x32, 0x37, 0x2e, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x0b, 0x00, 0x52, 0x45,
+	0x4d, 0x4f, 0x54, 0x45, 0x5f, 0x50, 0x4f, 0x52, 0x54, 0x05, 0x00, 0x33, 0x36, 0x30, 0x36, 0x31,
+	0x09, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x48, 0x4f, 0x53, 0x54, 0x0e, 0x00, 0x31, 0x32, 0x37,
+	0x2e, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x3a, 0x39, 0x33, 0x33, 0x30, 0x0f, 0x00, 0x48, 0x54, 0x54,
+	0x50, 0x5f, 0x55, 0x53, 0x45, 0x52, 0x5f, 0x41, 0x47, 0x45, 0x4e, 0x54, 0x44, 0x00, 0x4d, 0x6f,
+	0x7a, 0x69, 0x6c, 0x6c, 0x61, 0x2f, 0x35, 0x2e, 0x30, 0x20, 0x28, 0x58, 0x31, 0x31, 0x3b, 0x20,
+	0x4c, 0x69, 0x6e, 0x75, 0x78, 0x20, 0x78, 0x38, 0x36, 0x5f, 0x36, 0x34, 0x3b, 0x20, 0x72, 0x76,
+	0x3a, 0x33, 0x31, 0x2e, 0x30, 0x29, 0x20, 0x47, 0x65, 0x63, 0x6b, 0x6f, 0x2f, 0x32, 0x30, 0x31,
+	0x30, 0x30, 0x31, 0x30, 0x31, 0x20, 0x46, 0x69, 0x72, 0x65, 0x66, 0x6f, 0x78, 0x2f, 0x33, 0x31,
+	0x2e, 0x30, 0x0b, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x41, 0x43, 0x43, 0x45, 0x50, 0x54, 0x3f,
+	0x00, 0x74, 0x65, 0x78, 0x74, 0x2f, 0x68, 0x74, 0x6d, 0x6c, 0x2c, 0x61, 0x70, 0x70, 0x6c, 0x69,
+	0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x2f, 0x78, 0x68, 0x74, 0x6d, 0x6c, 0x2b, 0x78, 0x6d, 0x6c,
+	0x2c, 0x61, 0x70, 0x70, 0x6c, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x2f, 0x78, 0x6d, 0x6c,
+	0x3b, 0x71, 0x3d, 0x30, 0x2e, 0x39, 0x2c, 0x2a, 0x2f, 0x2a, 0x3b, 0x71, 0x3d, 0x30, 0x2e, 0x38,
+	0x14, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x41, 0x43, 0x43, 0x45, 0x50, 0x54, 0x5f, 0x4c, 0x41,
+	0x4e, 0x47, 0x55, 0x41, 0x47, 0x45, 0x0e, 0x00, 0x65, 0x6e, 0x2d, 0x55, 0x53, 0x2c, 0x65, 0x6e,
+	0x3b, 0x71, 0x3d, 0x30, 0x2e, 0x35, 0x14, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x41, 0x43, 0x43,
+	0x45, 0x50, 0x54, 0x5f, 0x45, 0x4e, 0x43, 0x4f, 0x44, 0x49, 0x4e, 0x47, 0x0d, 0x00, 0x67, 0x7a,
+	0x69, 0x70, 0x2c, 0x20, 0x64, 0x65, 0x66, 0x6c, 0x61, 0x74, 0x65, 0x0c, 0x00, 0x48, 0x54, 0x54,
+	0x50, 0x5f, 0x52, 0x45, 0x46, 0x45, 0x52, 0x45, 0x52, 0x22, 0x00, 0x68, 0x74, 0x74, 0x70, 0x73,
+	0x3a, 0x2f, 0x2f, 0x77, 0x77, 0x77, 0x2e, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x63,
+	0x6f, 0x6d, 0x2f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x0b, 0x00, 0x48,
+	0x54, 0x54, 0x50, 0x5f, 0x43, 0x4f, 0x4f, 0x4b, 0x49, 0x45, 0x45, 0x00, 0x73, 0x65, 0x73, 0x73,
+	0x69, 0x6f, 0x6e, 0x69, 0x64, 0x3d, 0x33, 0x66, 0x32, 0x61, 0x39, 0x63, 0x30, 0x65, 0x35, 0x62,
+	0x37, 0x64, 0x34, 0x65, 0x31, 0x66, 0x38, 0x61, 0x36, 0x62, 0x32, 0x63, 0x39, 0x64, 0x30, 0x65,
+	0x37, 0x66, 0x31, 0x61, 0x33, 0x62, 0x3b, 0x20, 0x63, 0x73, 0x72, 0x66, 0x74, 0x6f, 0x6b, 0x65,
+	0x6e, 0x3d, 0x5a, 0x78, 0x38, 0x31, 0x6b, 0x51, 0x70, 0x4c, 0x6d, 0x33, 0x4e, 0x77, 0x37, 0x52,
+	0x74, 0x0f, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x43, 0x4f, 0x4e, 0x4e, 0x45, 0x43, 0x54, 0x49,
+	0x4f, 0x4e, 0x0a, 0x00, 0x6b, 0x65, 0x65, 0x70, 0x2d, 0x61, 0x6c, 0x69, 0x76, 0x65, 0x12, 0x00,
+	0x48, 0x54, 0x54, 0x50, 0x5f, 0x43, 0x41, 0x43, 0x48, 0x45, 0x5f, 0x43, 0x4f, 0x4e, 0x54, 0x52,
+	0x4f, 0x4c, 0x09, 0x00, 0x6d, 0x61, 0x78, 0x2d, 0x61, 0x67, 0x65, 0x3d, 0x30, 0x16, 0x00, 0x48,
+	0x54, 0x54, 0x50, 0x5f, 0x49, 0x46, 0x5f, 0x4d, 0x4f, 0x44, 0x49, 0x46, 0x49, 0x45, 0x44, 0x5f,
+	0x53, 0x49, 0x4e, 0x43, 0x45, 0x1d, 0x00, 0x53, 0x61, 0x74, 0x2c, 0x20, 0x31, 0x37, 0x20, 0x4f,
+	0x63, 0x74, 0x20, 0x32, 0x30, 0x32, 0x36, 0x20, 0x31, 0x30, 0x3a, 0x30, 0x30, 0x3a, 0x30, 0x30,
+	0x20, 0x47, 0x4d, 0x54, 0x12, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x49, 0x46, 0x5f, 0x4e, 0x4f,
+	0x4e, 0x45, 0x5f, 0x4d, 0x41, 0x54, 0x43, 0x48, 0x0e, 0x00, 0x22, 0x35, 0x61, 0x31, 0x66, 0x2d,
+	0x33, 0x63, 0x32, 0x2d, 0x31, 0x62, 0x37, 0x22,
+};
+
+// a plain curl request
+static uint8_t parsebench_curl[] = {
+	0x00, 0x1c, 0x01, 0x00, 0x0e, 0x00, 0x52, 0x45, 0x51, 0x55, 0x45, 0x53, 0x54, 0x5f, 0x4d, 0x45,
+	0x54, 0x48, 0x4f, 0x44, 0x03, 0x00, 0x47, 0x45, 0x54, 0x0b, 0x00, 0x52, 0x45, 0x51, 0x55, 0x45,
+	0x53, 0x54, 0x5f, 0x55, 0x52, 0x49, 0x01, 0x00, 0x2f, 0x09, 0x00, 0x50, 0x41, 0x54, 0x48, 0x5f,
+	0x49, 0x4e, 0x46, 0x4f, 0x01, 0x00, 0x2f, 0x0c, 0x00, 0x51, 0x55, 0x45, 0x52, 0x59, 0x5f, 0x53,
+	0x54, 0x52, 0x49, 0x4e, 0x47, 0x00, 0x00, 0x0f, 0x00, 0x53, 0x45, 0x52, 0x56, 0x45, 0x52, 0x5f,
+	0x50, 0x52, 0x4f, 0x54, 0x4f, 0x43, 0x4f, 0x4c, 0x08, 0x00, 0x48, 0x54, 0x54, 0x50, 0x2f, 0x31,
+	0x2e, 0x31, 0x0b, 0x00, 0x53, 0x43, 0x52, 0x49, 0x50, 0x54, 0x5f, 0x4e, 0x41, 0x4d, 0x45, 0x00,
+	0x00, 0x0b, 0x00, 0x53, 0x45, 0x52, 0x56, 0x45, 0x52, 0x5f, 0x4e, 0x41, 0x4d, 0x45, 0x02, 0x00,
+	0x76, 0x6d, 0x0b, 0x00, 0x53, 0x45, 0x52, 0x56, 0x45, 0x52, 0x5f, 0x50, 0x4f, 0x52, 0x54, 0x04,
+	0x00, 0x39, 0x33, 0x33, 0x30, 0x0c, 0x00, 0x55, 0x57, 0x53, 0x47, 0x49, 0x5f, 0x52, 0x4f, 0x55,
+	0x54, 0x45, 0x52, 0x04, 0x00, 0x68, 0x74, 0x74, 0x70, 0x0b, 0x00, 0x52, 0x45, 0x4d, 0x4f, 0x54,
+	0x45, 0x5f, 0x41, 0x44, 0x44, 0x52, 0x09, 0x00, 0x31, 0x32, 0x37, 0x2e, 0x30, 0x2e, 0x30, 0x2e,
+	0x31, 0x0b, 0x00, 0x52, 0x45, 0x4d, 0x4f, 0x54, 0x45, 0x5f, 0x50, 0x4f, 0x52, 0x54, 0x05, 0x00,
+	0x35, 0x38, 0x35, 0x35, 0x38, 0x09, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x48, 0x4f, 0x53, 0x54,
+	0x0e, 0x00, 0x31, 0x32, 0x37, 0x2e, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x3a, 0x39, 0x33, 0x33, 0x30,
+	0x0f, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x55, 0x53, 0x45, 0x52, 0x5f, 0x41, 0x47, 0x45, 0x4e,
+	0x54, 0x0b, 0x00, 0x63, 0x75, 0x72, 0x6c, 0x2f, 0x37, 0x2e, 0x38, 0x38, 0x2e, 0x31, 0x0b, 0x00,
+	0x48, 0x54, 0x54, 0x50, 0x5f, 0x41, 0x43, 0x43, 0x45, 0x50, 0x54, 0x03, 0x00, 0x2a, 0x2f, 0x2a,
+};
+
+// a json POST to an api behind a proxy
+static uint8_t parsebench_api[] = {
+	0x00, 0x80, 0x02, 0x00, 0x0e, 0x00, 0x52, 0x45, 0x51, 0x55, 0x45, 0x53, 0x54, 0x5f, 0x4d, 0x45,
+	0x54, 0x48, 0x4f, 0x44, 0x04, 0x00, 0x50, 0x4f, 0x53, 0x54, 0x09, 0x00, 0x50, 0x41, 0x54, 0x48,
+	0x5f, 0x49, 0x4e, 0x46, 0x4f, 0x0d, 0x00, 0x2f, 0x61, 0x70, 0x69, 0x2f, 0x76, 0x31, 0x2f, 0x69,
+	0x74, 0x65, 0x6d, 0x73, 0x0b, 0x00, 0x52, 0x45, 0x51, 0x55, 0x45, 0x53, 0x54, 0x5f, 0x55, 0x52,
+	0x49, 0x20, 0x00, 0x2f, 0x61, 0x70, 0x69, 0x2f, 0x76, 0x31, 0x2f, 0x69, 0x74, 0x65, 0x6d, 0x73,
+	0x3f, 0x6c, 0x69, 0x6d, 0x69, 0x74, 0x3d, 0x32, 0x30, 0x26, 0x6f, 0x66, 0x66, 0x73, 0x65, 0x74,
+	0x3d, 0x34, 0x30, 0x0c, 0x00, 0x51, 0x55, 0x45, 0x52, 0x59, 0x5f, 0x53, 0x54, 0x52, 0x49, 0x4e,
+	0x47, 0x12, 0x00, 0x6c, 0x69, 0x6d, 0x69, 0x74, 0x3d, 0x32, 0x30, 0x26, 0x6f, 0x66, 0x66, 0x73,
+	0x65, 0x74, 0x3d, 0x34, 0x30, 0x0f, 0x00, 0x53, 0x45, 0x52, 0x56, 0x45, 0x52, 0x5f, 0x50, 0x52,
+	0x4f, 0x54, 0x4f, 0x43, 0x4f, 0x4c, 0x08, 0x00, 0x48, 0x54, 0x54, 0x50, 0x2f, 0x31, 0x2e, 0x31,
+	0x0b, 0x00, 0x53, 0x43, 0x52, 0x49, 0x50, 0x54, 0x5f, 0x4e, 0x41, 0x4d, 0x45, 0x00, 0x00, 0x0b,
+	0x00, 0x53, 0x45, 0x52, 0x56, 0x45, 0x52, 0x5f, 0x4e, 0x41, 0x4d, 0x45, 0x02, 0x00, 0x76, 0x6d,
+	0x0b, 0x00, 0x53, 0x45, 0x52, 0x56, 0x45, 0x52, 0x5f, 0x50, 0x4f, 0x52, 0x54, 0x04, 0x00, 0x39,
+	0x33, 0x33, 0x30, 0x0c, 0x00, 0x55, 0x57, 0x53, 0x47, 0x49, 0x5f, 0x52, 0x4f, 0x55, 0x54, 0x45,
+	0x52, 0x04, 0x00, 0x68, 0x74, 0x74, 0x70, 0x0b, 0x00, 0x52, 0x45, 0x4d, 0x4f, 0x54, 0x45, 0x5f,
+	0x41, 0x44, 0x44, 0x52, 0x09, 0x00, 0x31, 0x32, 0x37, 0x2e, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x0b,
+	0x00, 0x52, 0x45, 0x4d, 0x4f, 0x54, 0x45, 0x5f, 0x50, 0x4f, 0x52, 0x54, 0x05, 0x00, 0x36, 0x30,
+	0x36, 0x30, 0x36, 0x09, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x48, 0x4f, 0x53, 0x54, 0x0e, 0x00,
+	0x31, 0x32, 0x37, 0x2e, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x3a, 0x39, 0x33, 0x33, 0x30, 0x0f, 0x00,
+	0x48, 0x54, 0x54, 0x50, 0x5f, 0x55, 0x53, 0x45, 0x52, 0x5f, 0x41, 0x47, 0x45, 0x4e, 0x54, 0x0b,
+	0x00, 0x63, 0x75, 0x72, 0x6c, 0x2f, 0x37, 0x2e, 0x38, 0x38, 0x2e, 0x31, 0x0b, 0x00, 0x48, 0x54,
+	0x54, 0x50, 0x5f, 0x41, 0x43, 0x43, 0x45, 0x50, 0x54, 0x03, 0x00, 0x2a, 0x2f, 0x2a, 0x0c, 0x00,
+	0x43, 0x4f, 0x4e, 0x54, 0x45, 0x4e, 0x54, 0x5f, 0x54, 0x59, 0x50, 0x45, 0x10, 0x00, 0x61, 0x70,
+	0x70, 0x6c, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x2f, 0x6a, 0x73, 0x6f, 0x6e, 0x12, 0x00,
+	0x48, 0x54, 0x54, 0x50, 0x5f, 0x41, 0x55, 0x54, 0x48, 0x4f, 0x52, 0x49, 0x5a, 0x41, 0x54, 0x49,
+	0x4f, 0x4e, 0x63, 0x00, 0x42, 0x65, 0x61, 0x72, 0x65, 0x72, 0x20, 0x65, 0x79, 0x4a, 0x68, 0x62,
+	0x47, 0x63, 0x69, 0x4f, 0x69, 0x4a, 0x49, 0x55, 0x7a, 0x49, 0x31, 0x4e, 0x69, 0x4a, 0x39, 0x2e,
+	0x65, 0x79, 0x4a, 0x7a, 0x64, 0x57, 0x49, 0x69, 0x4f, 0x69, 0x49, 0x78, 0x4d, 0x6a, 0x4d, 0x30,
+	0x4e, 0x54, 0x59, 0x33, 0x4f, 0x44, 0x6b, 0x77, 0x49, 0x6e, 0x30, 0x2e, 0x64, 0x6f, 0x7a, 0x6a,
+	0x67, 0x4e, 0x72, 0x79, 0x50, 0x34, 0x4a, 0x33, 0x6a, 0x56, 0x6d, 0x4e, 0x48, 0x6c, 0x30, 0x77,
+	0x35, 0x4e, 0x5f, 0x58, 0x67, 0x4c, 0x30, 0x6e, 0x33, 0x49, 0x39, 0x50, 0x6c, 0x46, 0x55, 0x50,
+	0x30, 0x54, 0x48, 0x73, 0x52, 0x38, 0x55, 0x11, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x58, 0x5f,
+	0x52, 0x45, 0x51, 0x55, 0x45, 0x53, 0x54, 0x5f, 0x49, 0x44, 0x24, 0x00, 0x39, 0x66, 0x31, 0x63,
+	0x32, 0x61, 0x37, 0x65, 0x2d, 0x33, 0x33, 0x62, 0x31, 0x2d, 0x34, 0x63, 0x32, 0x65, 0x2d, 0x38,
+	0x64, 0x30, 0x62, 0x2d, 0x36, 0x66, 0x32, 0x63, 0x31, 0x65, 0x34, 0x61, 0x39, 0x62, 0x37, 0x37,
+	0x14, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x58, 0x5f, 0x46, 0x4f, 0x52, 0x57, 0x41, 0x52, 0x44,
+	0x45, 0x44, 0x5f, 0x46, 0x4f, 0x52, 0x09, 0x00, 0x31, 0x30, 0x2e, 0x30, 0x2e, 0x33, 0x2e, 0x31,
+	0x37, 0x16, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x58, 0x5f, 0x46, 0x4f, 0x52, 0x57, 0x41, 0x52,
+	0x44, 0x45, 0x44, 0x5f, 0x50, 0x52, 0x4f, 0x54, 0x4f, 0x05, 0x00, 0x68, 0x74, 0x74, 0x70, 0x73,
+	0x0e, 0x00, 0x43, 0x4f, 0x4e, 0x54, 0x45, 0x4e, 0x54, 0x5f, 0x4c, 0x45, 0x4e, 0x47, 0x54, 0x48,
+	0x02, 0x00, 0x32, 0x31,
+};
+
+// a websocket handshake
+static uint8_t parsebench_websocket[] = {
+	0x00, 0x4e, 0x02, 0x00, 0x0e, 0x00, 0x52, 0x45, 0x51, 0x55, 0x45, 0x53, 0x54, 0x5f, 0x4d, 0x45,
+	0x54, 0x48, 0x4f, 0x44, 0x03, 0x00, 0x47, 0x45, 0x54, 0x0b, 0x00, 0x52, 0x45, 0x51, 0x55, 0x45,
+	0x53, 0x54, 0x5f, 0x55, 0x52, 0x49, 0x08, 0x00, 0x2f, 0x77, 0x73, 0x2f, 0x63, 0x68, 0x61, 0x74,
+	0x09, 0x00, 0x50, 0x41, 0x54, 0x48, 0x5f, 0x49, 0x4e, 0x46, 0x4f, 0x08, 0x00, 0x2f, 0x77, 0x73,
+	0x2f, 0x63, 0x68, 0x61, 0x74, 0x0c, 0x00, 0x51, 0x55, 0x45, 0x52, 0x59, 0x5f, 0x53, 0x54, 0x52,
+	0x49, 0x4e, 0x47, 0x00, 0x00, 0x0f, 0x00, 0x53, 0x45, 0x52, 0x56, 0x45, 0x52, 0x5f, 0x50, 0x52,
+	0x4f, 0x54, 0x4f, 0x43, 0x4f, 0x4c, 0x08, 0x00, 0x48, 0x54, 0x54, 0x50, 0x2f, 0x31, 0x2e, 0x31,
+	0x0b, 0x00, 0x53, 0x43, 0x52, 0x49, 0x50, 0x54, 0x5f, 0x4e, 0x41, 0x4d, 0x45, 0x00, 0x00, 0x0b,
+	0x00, 0x53, 0x45, 0x52, 0x56, 0x45, 0x52, 0x5f, 0x4e, 0x41, 0x4d, 0x45, 0x02, 0x00, 0x76, 0x6d,
+	0x0b, 0x00, 0x53, 0x45, 0x52, 0x56, 0x45, 0x52, 0x5f, 0x50, 0x4f, 0x52, 0x54, 0x04, 0x00, 0x39,
+	0x33, 0x33, 0x30, 0x0c, 0x00, 0x55, 0x57, 0x53, 0x47, 0x49, 0x5f, 0x52, 0x4f, 0x55, 0x54, 0x45,
+	0x52, 0x04, 0x00, 0x68, 0x74, 0x74, 0x70, 0x0b, 0x00, 0x52, 0x45, 0x4d, 0x4f, 0x54, 0x45, 0x5f,
+	0x41, 0x44, 0x44, 0x52, 0x09, 0x00, 0x31, 0x32, 0x37, 0x2e, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x0b,
+	0x00, 0x52, 0x45, 0x4d, 0x4f, 0x54, 0x45, 0x5f, 0x50, 0x4f, 0x52, 0x54, 0x05, 0x00, 0x36, 0x33,
+	0x36, 0x37, 0x38, 0x09, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x48, 0x4f, 0x53, 0x54, 0x0e, 0x00,
+	0x31, 0x32, 0x37, 0x2e, 0x30, 0x2e, 0x30, 0x2e, 0x31, 0x3a, 0x39, 0x33, 0x33, 0x30, 0x0f, 0x00,
+	0x48, 0x54, 0x54, 0x50, 0x5f, 0x55, 0x53, 0x45, 0x52, 0x5f, 0x41, 0x47, 0x45, 0x4e, 0x54, 0x0b,
+	0x00, 0x63, 0x75, 0x72, 0x6c, 0x2f, 0x37, 0x2e, 0x38, 0x38, 0x2e, 0x31, 0x0b, 0x00, 0x48, 0x54,
+	0x54, 0x50, 0x5f, 0x41, 0x43, 0x43, 0x45, 0x50, 0x54, 0x03, 0x00, 0x2a, 0x2f, 0x2a, 0x0f, 0x00,
+	0x48, 0x54, 0x54, 0x50, 0x5f, 0x43, 0x4f, 0x4e, 0x4e, 0x45, 0x43, 0x54, 0x49, 0x4f, 0x4e, 0x07,
+	0x00, 0x55, 0x70, 0x67, 0x72, 0x61, 0x64, 0x65, 0x0c, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x55,
+	0x50, 0x47, 0x52, 0x41, 0x44, 0x45, 0x09, 0x00, 0x77, 0x65, 0x62, 0x73, 0x6f, 0x63, 0x6b, 0x65,
+	0x74, 0x0b, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x4f, 0x52, 0x49, 0x47, 0x49, 0x4e, 0x17, 0x00,
+	0x68, 0x74, 0x74, 0x70, 0x73, 0x3a, 0x2f, 0x2f, 0x77, 0x77, 0x77, 0x2e, 0x65, 0x78, 0x61, 0x6d,
+	0x70, 0x6c, 0x65, 0x2e, 0x63, 0x6f, 0x6d, 0x1a, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x53, 0x45,
+	0x43, 0x5f, 0x57, 0x45, 0x42, 0x53, 0x4f, 0x43, 0x4b, 0x45, 0x54, 0x5f, 0x56, 0x45, 0x52, 0x53,
+	0x49, 0x4f, 0x4e, 0x02, 0x00, 0x31, 0x33, 0x16, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x53, 0x45,
+	0x43, 0x5f, 0x57, 0x45, 0x42, 0x53, 0x4f, 0x43, 0x4b, 0x45, 0x54, 0x5f, 0x4b, 0x45, 0x59, 0x18,
+	0x00, 0x64, 0x47, 0x68, 0x6c, 0x49, 0x48, 0x4e, 0x68, 0x62, 0x58, 0x42, 0x73, 0x5a, 0x53, 0x42,
+	0x75, 0x62, 0x32, 0x35, 0x6a, 0x5a, 0x51, 0x3d, 0x3d, 0x1b, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f,
+	0x53, 0x45, 0x43, 0x5f, 0x57, 0x45, 0x42, 0x53, 0x4f, 0x43, 0x4b, 0x45, 0x54, 0x5f, 0x50, 0x52,
+	0x4f, 0x54, 0x4f, 0x43, 0x4f, 0x4c, 0x0f, 0x00, 0x63, 0x68, 0x61, 0x74, 0x2c, 0x20, 0x73, 0x75,
+	0x70, 0x65, 0x72, 0x63, 0x68, 0x61, 0x74, 0x1d, 0x00, 0x48, 0x54, 0x54, 0x50, 0x5f, 0x53, 0x45,
+	0x43, 0x5f, 0x57, 0x45, 0x42, 0x53, 0x4f, 0x43, 0x4b, 0x45, 0x54, 0x5f, 0x45, 0x58, 0x54, 0x45,
+	0x4e, 0x53, 0x49, 0x4f, 0x4e, 0x53, 0x2a, 0x00, 0x70, 0x65, 0x72, 0x6d, 0x65, 0x73, 0x73, 0x61,
+	0x67, 0x65, 0x2d, 0x64, 0x65, 0x66, 0x6c, 0x61, 0x74, 0x65, 0x3b, 0x20, 0x63, 0x6c, 0x69, 0x65,
+	0x6e, 0x74, 0x5f, 0x6d, 0x61, 0x78, 0x5f, 0x77, 0x69, 0x6e, 0x64, 0x6f, 0x77, 0x5f, 0x62, 0x69,
+	0x74, 0x73,
+};
+
+#define parsebench_packet(x) { (char *) x + 4, sizeof(x) - 4 }
+
+static struct parsebench_packet parsebench_default_packets[] = {
+	parsebench_packet(parsebench_browser),
+	parsebench_packet(parsebench_curl),
+	parsebench_packet(parsebench_api),
+	parsebench_packet(parsebench_websocket),
+};
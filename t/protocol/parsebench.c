@@ -0,0 +1,208 @@
+/*
+
+	uwsgi packets parser benchmark: runs uwsgi_parse_vars() against real packets
+	and reports ns/packet (the average and the best of the rounds of 100k packets,
+	the latter is more stable on noisy machines).
+
+	make parsebench && ./parsebench [-n packets] [packet files...]
+
+	without arguments the packets in packets.h (generated by the http router for a browser,
+	a curl, an api and a websocket request) are used in turn. Other packets can be captured
+	with something like:
+
+	nc -l 127.0.0.1 3031 > request.pkt
+	./uwsgi --http :8080 --http-to 127.0.0.1:3031
+
+	every file must contain a whole uwsgi packet (the 4 bytes header followed by the vars)
+
+*/
+
+#include "../../uwsgi.h"
+
+struct uwsgi_server uwsgi;
+
+// stubs for the core functions used by core/protocol.c
+void uwsgi_exit(int status) {
+	_exit(status);
+}
+
+void uwsgi_log(const char *fmt, ...) {
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
+
+void *uwsgi_malloc(size_t size) {
+	void *ptr = malloc(size);
+	if (!ptr) {
+		perror("malloc()");
+		exit(1);
+	}
+	return ptr;
+}
+
+char *uwsgi_concat2n(char *one, int s1, char *two, int s2) {
+	char *buf = uwsgi_malloc(s1 + s2 + 1);
+	memcpy(buf, one, s1);
+	memcpy(buf + s1, two, s2);
+	buf[s1 + s2] = 0;
+	return buf;
+}
+
+int uwsgi_strncmp(char *src, int slen, char *dst, int dlen) {
+	if (slen != dlen)
+		return 1;
+	return memcmp(src, dst, dlen);
+}
+
+int uwsgi_starts_with(char *src, int slen, char *dst, int dlen) {
+	if (slen < dlen)
+		return -1;
+	return memcmp(src, dst, dlen);
+}
+
+int uwsgi_startswith(char *src, char *what, int wlen) {
+	return memcmp(what, src, wlen);
+}
+
+size_t uwsgi_str_num(char *str, int len) {
+	size_t num = 0;
+	int i;
+	for (i = 0; i < len; i++) {
+		if (str[i] < '0' || str[i] > '9')
+			break;
+		num = (num * 10) + (str[i] - '0');
+	}
+	return num;
+}
+
+// never called with the benchmark configuration
+static void parsebench_unused(const char *name) {
+	fprintf(stderr, "%s() should not be called\n", name);
+	exit(1);
+}
+
+char *uwsgi_cache_magic_get(char *key, uint16_t keylen, uint64_t *vallen, uint64_t *expires, char *cache) { parsebench_unused("uwsgi_cache_magic_get"); return NULL; }
+char *uwsgi_cheap_string(char *buf, int len) { parsebench_unused("uwsgi_cheap_string"); return NULL; }
+char *uwsgi_expand_path(char *dir, int dir_len, char *ptr) { parsebench_unused("uwsgi_expand_path"); return NULL; }
+int uwsgi_file_serve(struct wsgi_request *wsgi_req, char *document_root, uint16_t document_root_len, char *path_info, uint16_t path_info_len, int is_a_file) { parsebench_unused("uwsgi_file_serve"); return -1; }
+int uwsgi_is_file(char *filename) { parsebench_unused("uwsgi_is_file"); return 0; }
+int uwsgi_postbuffer_do_in_disk(struct wsgi_request *wsgi_req) { parsebench_unused("uwsgi_postbuffer_do_in_disk"); return -1; }
+int uwsgi_postbuffer_do_in_mem(struct wsgi_request *wsgi_req) { parsebench_unused("uwsgi_postbuffer_do_in_mem"); return -1; }
+int uwsgi_response_add_header(struct wsgi_request *wsgi_req, char *key, uint16_t key_len, char *value, uint16_t value_len) { parsebench_unused("uwsgi_response_add_header"); return -1; }
+int uwsgi_response_prepare_headers(struct wsgi_request *wsgi_req, char *status, uint16_t status_len) { parsebench_unused("uwsgi_response_prepare_headers"); return -1; }
+int uwsgi_response_write_body_do(struct wsgi_request *wsgi_req, char *buf, size_t len) { parsebench_unused("uwsgi_response_write_body_do"); return -1; }
+int uwsgi_waitfd_event(int fd, int timeout, int event) { parsebench_unused("uwsgi_waitfd_event"); return -1; }
+
+struct parsebench_packet {
+	char *buf;
+	uint16_t len;
+};
+
+#include "packets.h"
+
+static struct parsebench_packet *parsebench_load(char *filename) {
+	FILE *f = fopen(filename, "r");
+	if (!f) {
+		perror(filename);
+		exit(1);
+	}
+	char *buf = uwsgi_malloc(4 + 65536);
+	size_t len = fread(buf, 1, 4 + 65536, f);
+	fclose(f);
+	struct uwsgi_header *uh = (struct uwsgi_header *) buf;
+	uint16_t pktsize = uh->pktsize;
+#ifdef __BIG_ENDIAN__
+	pktsize = uwsgi_swap16(pktsize);
+#endif
+	if (len < 4 || uh->modifier1 != 0 || len != (size_t) (4 + pktsize)) {
+		fprintf(stderr, "%s is not a valid uwsgi packet\n", filename);
+		exit(1);
+	}
+	struct parsebench_packet *pp = uwsgi_malloc(sizeof(struct parsebench_packet));
+	pp->buf = buf + 4;
+	pp->len = pktsize;
+	return pp;
+}
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t n = 10000000;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			n = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n packets] [packet files...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int packets_cnt = argc - optind;
+	struct parsebench_packet **packets;
+	int i;
+	if (packets_cnt > 0) {
+		packets = uwsgi_malloc(sizeof(struct parsebench_packet *) * packets_cnt);
+		for (i = 0; i < packets_cnt; i++) {
+			packets[i] = parsebench_load(argv[optind + i]);
+		}
+	}
+	else {
+		packets_cnt = sizeof(parsebench_default_packets) / sizeof(struct parsebench_packet);
+		packets = uwsgi_malloc(sizeof(struct parsebench_packet *) * packets_cnt);
+		for (i = 0; i < packets_cnt; i++) {
+			packets[i] = &parsebench_default_packets[i];
+		}
+	}
+
+	uwsgi.max_vars = MAX_VARS;
+	uwsgi.vec_size = 4 + 1 + (4 * uwsgi.max_vars);
+	uwsgi_proto_hooks_setup();
+
+	struct uwsgi_header uh;
+	memset(&uh, 0, sizeof(struct uwsgi_header));
+	struct wsgi_request *wsgi_req = calloc(1, sizeof(struct wsgi_request));
+	wsgi_req->uh = &uh;
+	wsgi_req->hvec = calloc(uwsgi.vec_size, sizeof(struct iovec));
+
+	uint64_t j;
+	uint64_t vars = 0;
+	uint64_t round = 100000;
+	double best = 0;
+	double t0 = now();
+	double rt = t0;
+	for (j = 0; j < n; j++) {
+		struct parsebench_packet *pp = packets[j % packets_cnt];
+		// reset the fields checked by the parser
+		wsgi_req->parsed = 0;
+		wsgi_req->var_cnt = 0;
+		wsgi_req->uri_len = 0;
+		wsgi_req->host_len = 0;
+		wsgi_req->remote_addr_len = 0;
+		wsgi_req->buffer = pp->buf;
+		uh.pktsize = pp->len;
+		if (uwsgi_parse_vars(wsgi_req)) {
+			fprintf(stderr, "unable to parse packet %d\n", (int) (j % packets_cnt));
+			return 1;
+		}
+		vars += wsgi_req->var_cnt / 2;
+		if ((j + 1) % round == 0) {
+			double t1 = now();
+			if (best == 0 || t1 - rt < best) best = t1 - rt;
+			rt = t1;
+		}
+	}
+	double elapsed = now() - t0;
+
+	printf("%llu packets (%.1f vars each) in %.3fs, %.1f ns/packet (%.0f packets/s), best round %.1f ns/packet\n", (unsigned long long) n, (double) vars / n, elapsed, (elapsed * 1e9) / n, n / elapsed, (best * 1e9) / round);
+	return 0;
+}
@@ -769,6 +769,39 @@ struct uwsgi_cache_item {
 	char key[];
 } __attribute__ ((__packed__));
 
+// an open addressing index bucket (8 hash tags + 8 item slots, exactly one cache line)
+struct uwsgi_cache_bucket {
+	uint32_t tags[8];
+	uint32_t slots[8];
+};
+
+// a slab class (chunks of the same size, see core/cache.c)
+struct uwsgi_cache_slab_class {
+	uint64_t chunk_blocks;
+	uint64_t free_list;
+	uint64_t carve;
+	uint64_t carve_end;
+	uint64_t pages;
+	uint64_t used;
+	uint64_t free;
+	uint64_t requested;
+};
+
+struct uwsgi_cache;
+
+// eviction policies (see core/cache.c)
+struct uwsgi_cache_policy {
+	char *name;
+	// allocate (or reset) the shared state of the policy
+	void (*init)(struct uwsgi_cache *);
+	void (*insert)(struct uwsgi_cache *, uint64_t);
+	void (*hit)(struct uwsgi_cache *, uint64_t);
+	void (*remove)(struct uwsgi_cache *, uint64_t);
+	// returns the item to evict to make room for a value of the given size (0 if none)
+	uint64_t (*victim)(struct uwsgi_cache *, uint64_t);
+	struct uwsgi_cache_policy *next;
+};
+
 struct uwsgi_cache {
 	char *name;
 	uint16_t name_len;
@@ -781,6 +814,11 @@ struct uwsgi_cache {
 	uint64_t *hashtable;
 	uint32_t hashsize;
 
+	uint8_t use_open_index;
+	struct uwsgi_cache_bucket *buckets;
+	uint64_t buckets_n;
+	uint64_t buckets_tombstones;
+
 	uint64_t first_available_block;
 	uint64_t *unused_blocks_stack;
 	uint64_t unused_blocks_stack_ptr;
@@ -790,6 +828,17 @@ struct uwsgi_cache {
 	uint64_t blocks_bitmap_pos;
 	uint64_t blocks_bitmap_size;
 
+	uint8_t use_slabs;
+	double slab_factor;
+	uint64_t slab_page_size;
+	uint64_t slab_page_blocks;
+	uint64_t slab_pages;
+	uint64_t slab_pages_used;
+	uint64_t slab_next_page;
+	uint8_t *slab_page_class;
+	struct uwsgi_cache_slab_class *slabs;
+	uint64_t slabs_n;
+
 	uint64_t max_items;
 	uint64_t max_item_size;
 	uint64_t n_items;
@@ -818,6 +867,29 @@ struct uwsgi_cache {
 
 	struct uwsgi_lock_item *lock;
 
+	// seqlock style reads (see core/cache.c)
+	uint8_t lockless;
+	volatile uint64_t lockless_seq;
+	volatile uint64_t *lockless_versions;
+	uint64_t lockless_fallbacks;
+
+	struct uwsgi_cache_policy *policy;
+	void *policy_data;
+	uint64_t evictions;
+	// counters halvings (lfu and tinylfu)
+	uint64_t policy_agings;
+
+	// tinylfu admission (count-min sketch)
+	uint8_t use_tinylfu;
+	uint8_t *sketch;
+	uint64_t sketch_width;
+	uint64_t sketch_additions;
+	uint64_t rejected;
+
+	// a sharded cache only holds the configuration, items live in the shards
+	uint64_t shards_n;
+	struct uwsgi_cache *shards;
+
 	struct uwsgi_cache *next;
 };
 
@@ -1049,6 +1121,7 @@ int uwsgi_regexp_build(char *, pcre **, pcre_extra **);
 int uwsgi_regexp_match(pcre *, pcre_extra *, char *, int);
 int uwsgi_regexp_match_ovec(pcre *, pcre_extra *, char *, int, int *, int);
 int uwsgi_regexp_ovector(pcre *, pcre_extra *);
+int uwsgi_regexp_jitted(pcre *, pcre_extra *);
 char *uwsgi_regexp_apply_ovec(char *, int, char *, int, int *, int);
 #endif
 
@@ -1130,6 +1203,15 @@ struct uwsgi_spooler {
 // close the request
 #define UWSGI_ROUTE_BREAK 2
 
+struct uwsgi_route_matcher;
+
+// --routing-stats counters, one for each worker
+struct uwsgi_route_stats {
+	uint64_t evaluations;
+	uint64_t matches;
+	uint64_t ns;
+};
+
 struct uwsgi_route {
 
 	pcre *pattern;
@@ -1178,6 +1260,12 @@ struct uwsgi_route {
 	// this is used by virtual route to free resources
 	void (*free)(struct uwsgi_route *);
 
+	// literal-anchors index of the route subject (see uwsgi_fixup_routes())
+	struct uwsgi_route_matcher *matcher;
+	uint32_t matcher_id;
+
+	struct uwsgi_route_stats *stats;
+
 	struct uwsgi_route *next;
 
 };
@@ -1288,6 +1376,21 @@ struct uwsgi_log_encoder {
 	struct uwsgi_log_encoder *next;
 };
 
+// single producer (a worker core) single consumer (the master or the threaded logger) request log ring
+struct uwsgi_req_log_ring {
+	// written only by the core
+	volatile uint64_t head;
+	uint64_t records;
+	uint64_t drops;
+	uint64_t high_water;
+	char pad[32];
+	// written only by the consumer
+	volatile uint64_t tail;
+	char pad2[56];
+	uint64_t size;
+	char buf[];
+};
+
 struct uwsgi_transformation {
 	int (*func)(struct wsgi_request *, struct uwsgi_transformation *);
 	struct uwsgi_buffer *chunk;
@@ -1402,6 +1505,9 @@ struct wsgi_request {
 	char *if_modified_since;
 	uint16_t if_modified_since_len;
 
+	char *if_none_match;
+	uint16_t if_none_match_len;
+
 	int fd_closed;
 
 	int sendfile_fd;
@@ -1470,6 +1576,12 @@ struct wsgi_request {
 
 	size_t range_from;
 	size_t range_to;
+	// the raw Range header (for multiple ranges)
+	char *range;
+	uint16_t range_len;
+
+	// never offload the transfers of this request
+	int no_offload;
 
 	// current socket mapped to request
 	struct uwsgi_socket *socket;
@@ -1661,6 +1773,73 @@ struct uwsgi_harakiri_options {
 	int mules;
 };
 
+// a file (or its gzip variant) kept open by the static open file cache
+struct uwsgi_static_file_variant {
+	int fd;
+	struct stat st;
+	// 30+1
+	char last_modified[31];
+	int last_modified_len;
+	char etag[64];
+	int etag_len;
+};
+
+struct uwsgi_static_file {
+	// docroot + PATH_INFO (before path resolution)
+	char *key;
+	size_t key_len;
+	uint32_t hash;
+	// resolved path (key and resolved path share the same memory area)
+	char *real_filename;
+	size_t real_filename_len;
+	size_t buf_size;
+	struct uwsgi_string_list *index;
+	char *mime_type;
+	size_t mime_type_len;
+	struct uwsgi_static_file_variant plain;
+	int has_gzip;
+	struct uwsgi_static_file_variant gzip;
+	time_t expires;
+	uint64_t generation;
+	int refs;
+	int stale;
+};
+
+#define UWSGI_STATIC_STORE_IDENTITY 0
+#define UWSGI_STATIC_STORE_GZIP 1
+#define UWSGI_STATIC_STORE_BR 2
+
+// the body of a stored file (and the preformatted response headers for it)
+struct uwsgi_static_store_variant {
+	char *headers;
+	size_t headers_len;
+	int headers_cnt;
+	char *etag;
+	size_t etag_len;
+	char *body;
+	size_t len;
+};
+
+struct uwsgi_static_store_item {
+	struct uwsgi_static_store_item *next;
+	uint32_t hash;
+	char *path;
+	size_t path_len;
+	time_t mtime;
+	char *mime_type;
+	size_t mime_type_len;
+	struct uwsgi_static_store_variant variants[3];
+};
+
+// the shared memory area holding the stored files
+struct uwsgi_static_store {
+	size_t size;
+	uint64_t items;
+	uint64_t bytes;
+	uint64_t buckets;
+	struct uwsgi_static_store_item **table;
+};
+
 struct uwsgi_fsmon {
 	char *path;
 	int fd;
@@ -1728,11 +1907,12 @@ struct uwsgi_server {
 	char *logto2;
 	char *logformat;
 	int logformat_strftime;
-	int logformat_vectors;
 	struct uwsgi_logchunk *logchunks;
 	struct uwsgi_logchunk *registered_logchunks;
 	void (*logit) (struct wsgi_request *);
-	struct iovec **logvectors;
+	struct uwsgi_logop *logops;
+	int logops_cnt;
+	struct uwsgi_buffer **logbuffers;
 
 	// autoload plugins
 	int autoload;
@@ -1907,6 +2087,7 @@ struct uwsgi_server {
 	int cheaper_algo_list;
 #ifdef UWSGI_ROUTING
 	int router_list;
+	int routing_stats;
 #endif
 	int imperial_monitor_list;
 	int plugins_list;
@@ -2034,6 +2215,8 @@ struct uwsgi_server {
 	size_t log_master_bufsize;
 	int log_master_stream;
 	int log_master_req_stream;
+	uint64_t req_log_ring;
+	int req_log_ring_freq;
 
 	int log_reopen;
 	int log_truncate;
@@ -2200,6 +2383,7 @@ struct uwsgi_server {
 	struct uwsgi_string_list *static_safe;
 
 	struct uwsgi_hash_algo *hash_algos;
+	struct uwsgi_cache_policy *cache_policies;
 	int use_static_cache_paths;
 	char *static_cache_paths_name;
 	struct uwsgi_cache *static_cache_paths;
@@ -2234,6 +2418,19 @@ struct uwsgi_server {
 	struct uwsgi_regexp_list *static_gzip;
 #endif
 
+	int static_etag;
+
+	uint64_t static_open_cache;
+	int static_open_cache_ttl;
+	struct uwsgi_string_list *static_open_cache_monitor;
+	struct uwsgi_static_file *static_open_cache_table;
+
+	struct uwsgi_string_list *static_store;
+	uint64_t static_store_max_file;
+	struct uwsgi_static_store *static_store_arena;
+	struct uwsgi_string_list *static_store_monitored;
+	uint64_t static_store_reload_at;
+
 	struct uwsgi_offload_engine *offload_engines;
 	struct uwsgi_offload_engine *offload_engine_sendfile;
 	struct uwsgi_offload_engine *offload_engine_transfer;
@@ -2241,6 +2438,11 @@ struct uwsgi_server {
 	struct uwsgi_offload_engine *offload_engine_pipe;
 	int offload_threads;
 	int offload_threads_events;
+	int event_batch;
+	// fds closed by the master while managing the current batch of events
+	int *master_batch_closed;
+	int master_batch_closed_cnt;
+	int master_batch_closed_size;
 	struct uwsgi_thread **offload_thread;
 
 	int check_static_docroot;
@@ -2577,6 +2779,8 @@ struct uwsgi_server {
 	int stats_fd;
 	int stats_http;
 	int stats_minified;
+	int stats_stream;
+	struct uwsgi_stats_client *stats_clients;
 	struct uwsgi_string_list *requested_stats_pushers;
 	struct uwsgi_stats_pusher *stats_pushers;
 	struct uwsgi_stats_pusher_instance *stats_pusher_instances;
@@ -2612,13 +2816,23 @@ struct uwsgi_server {
 	// subscription client
 	int subscriptions_blocked;
 	int subscribe_freq;
+	int subscribe_batch;
+	int subscribe_delta;
+	int subscribe_delta_refresh;
 	int subscription_tolerance;
 	int unsubscribe_on_graceful_reload;
 	struct uwsgi_string_list *subscriptions;
 	struct uwsgi_string_list *subscriptions2;
 
 	struct uwsgi_subscribe_node *(*subscription_algo) (struct uwsgi_subscribe_slot *, struct uwsgi_subscribe_node *);
+	// the algorithm picks from the nodes array, dead nodes are swept once per second
+	int subscription_algo_direct;
+	int subscription_ewma_decay;
+	int subscription_ring;
+	int subscription_ring_vnodes;
+	int subscription_ring_load;
 	int subscription_dotsplit;
+	char *subscription_hash;
 
 	int never_swap;
 
@@ -2759,6 +2973,15 @@ struct uwsgi_cron {
 #endif
 };
 
+#define UWSGI_EVENTS_HISTOGRAM_BUCKETS 8
+
+// bucket 0 counts the wakeups without events (timeouts), bucket n (n > 0) the ones with 2^(n-1) to 2^n - 1 events
+struct uwsgi_events_histogram {
+	uint64_t wakeups;
+	uint64_t events;
+	uint64_t buckets[UWSGI_EVENTS_HISTOGRAM_BUCKETS];
+};
+
 struct uwsgi_shared {
 
 	//vga 80 x25 specific !
@@ -2815,6 +3038,12 @@ struct uwsgi_shared {
 	uint64_t overloaded;
 
 	int ready;
+
+	// events returned by each wakeup of the master loop
+	struct uwsgi_events_histogram master_events;
+
+	// bumped by the master to invalidate the static open file caches of the workers
+	uint64_t static_open_cache_generation;
 };
 
 struct uwsgi_core {
@@ -2824,6 +3053,8 @@ struct uwsgi_core {
 	uint64_t requests;
 	uint64_t failed_requests;
 	uint64_t static_requests;
+	uint64_t static_open_cache_hits;
+	uint64_t static_open_cache_misses;
 	uint64_t routed_requests;
 	uint64_t offloaded_requests;
 
@@ -2844,6 +3075,8 @@ struct uwsgi_core {
 	struct iovec *hvec;
 	char *post_buf;
 
+	struct uwsgi_req_log_ring *log_ring;
+
 	struct wsgi_request req;
 };
 
@@ -2901,6 +3134,10 @@ struct uwsgi_worker {
 	int accepting;
 
 	char name[0xff];
+
+	// events returned by each wakeup of the async loop and of the offload threads
+	struct uwsgi_events_histogram async_events;
+	struct uwsgi_events_histogram offload_events;
 };
 
 
@@ -3136,6 +3373,7 @@ ssize_t uwsgi_send_message(int, uint8_t, uint8_t, char *, uint16_t, int, ssize_t
 
 int uwsgi_cache_set2(struct uwsgi_cache *, char *, uint16_t, char *, uint64_t, uint64_t, uint64_t);
 int uwsgi_cache_del2(struct uwsgi_cache *, char *, uint16_t, uint64_t, uint16_t);
+int uwsgi_cache_victim_fits(struct uwsgi_cache *, uint64_t, uint64_t);
 char *uwsgi_cache_get2(struct uwsgi_cache *, char *, uint16_t, uint64_t *);
 char *uwsgi_cache_get3(struct uwsgi_cache *, char *, uint16_t, uint64_t *, uint64_t *);
 char *uwsgi_cache_get4(struct uwsgi_cache *, char *, uint16_t, uint64_t *, uint64_t *);
@@ -3159,11 +3397,17 @@ void *uwsgi_calloc(size_t);
 
 int event_queue_init(void);
 void *event_queue_alloc(int);
+void uwsgi_events_histogram_add(struct uwsgi_events_histogram *, int);
 int event_queue_add_fd_read(int, int);
 int event_queue_add_fd_write(int, int);
+int event_queue_add_fd_accept(int, int);
+int event_queue_accepted(int, int, struct sockaddr *, socklen_t *);
+ssize_t event_queue_fd_read(int, int, char *, size_t);
+void event_queue_fd_forget(int, int);
 int event_queue_del_fd(int, int, int);
 int event_queue_wait(int, int, int *);
 int event_queue_wait_multi(int, int, void *, int);
+int event_queue_wait_multi_ms(int, int, void *, int);
 int event_queue_interesting_fd(void *, int);
 int event_queue_interesting_fd_has_error(void *, int);
 int event_queue_fd_write_to_read(int, int);
@@ -3236,6 +3480,12 @@ char *uwsgi_queue_pop(uint64_t *);
 int uwsgi_queue_set(uint64_t, char *, uint64_t);
 
 
+// modifier2 of subscription packets (0 and 1 are subscribe and unsubscribe)
+#define UWSGI_SUBSCRIBE_BATCH 2
+#define UWSGI_SUBSCRIBE_HEARTBEAT 3
+// max size of a batched subscription packet
+#define UWSGI_SUBSCRIBE_BATCH_SIZE 8192
+
 struct uwsgi_subscribe_req {
 	char *key;
 	uint16_t keylen;
@@ -3329,6 +3579,12 @@ char *uwsgi_amqp_consume(int, uint64_t *, char **);
 int uwsgi_file_serve(struct wsgi_request *, char *, uint16_t, char *, uint16_t, int);
 int uwsgi_starts_with(char *, int, char *, int);
 int uwsgi_static_want_gzip(struct wsgi_request *, char *, size_t *, struct stat *);
+void uwsgi_static_open_cache_init(void);
+void uwsgi_static_open_cache_invalidate(void);
+void uwsgi_static_store_init(void);
+void uwsgi_static_store_reload(void);
+void uwsgi_static_store_schedule_reload(void);
+int uwsgi_static_store_reload_due(void);
 
 #ifdef __sun__
 time_t timegm(struct tm *);
@@ -3496,6 +3752,34 @@ void uwsgi_set_processname(char *);
 void http_url_decode(char *, uint16_t *, char *);
 void http_url_encode(char *, uint16_t *, char *);
 
+struct uwsgi_http_request_line {
+	char *method;
+	size_t method_len;
+	char *uri;
+	size_t uri_len;
+	// the uri up to the '?'
+	char *path;
+	size_t path_len;
+	// NULL if the uri has no '?'
+	char *query_string;
+	size_t query_string_len;
+	char *protocol;
+	size_t protocol_len;
+};
+
+struct uwsgi_http_header {
+	char *key;
+	uint16_t keylen;
+	char *val;
+	uint16_t vallen;
+	// needs the HTTP_ prefix (all but CONTENT_LENGTH and CONTENT_TYPE)
+	int prefix;
+};
+
+ssize_t uwsgi_http_headers_end(char *, size_t, size_t);
+char *uwsgi_http_parse_request_line(char *, char *, struct uwsgi_http_request_line *);
+int uwsgi_http_parse_header(char **, char *, struct uwsgi_http_header *);
+
 pid_t uwsgi_fork(char *);
 
 struct uwsgi_mule *get_mule_by_id(int);
@@ -3540,6 +3824,13 @@ struct uwsgi_subscribe_node {
 
 	char notify[102];
 
+	// peak EWMA of the response time (usec), fed by the corerouters
+	uint64_t ewma;
+	uint64_t ewma_ts;
+
+	// weight used for generating the consistent hash ring points
+	uint64_t ring_weight;
+
 	struct uwsgi_subscribe_slot *slot;
 
 	struct uwsgi_subscribe_node *next;
@@ -3556,8 +3847,20 @@ struct uwsgi_subscribe_slot {
 
 	struct uwsgi_subscribe_node *nodes;
 
-	struct uwsgi_subscribe_slot *prev;
-	struct uwsgi_subscribe_slot *next;
+	// array of the nodes, for algorithms picking them in O(1)
+	struct uwsgi_subscribe_node **nodes_array;
+	uint64_t nodes_cnt;
+	uint64_t nodes_size;
+	time_t last_sweep;
+
+	// consistent hash ring (sorted points), see core/subscription.c
+	struct uwsgi_subscribe_ring_point *ring;
+	uint64_t ring_cnt;
+	uint64_t ring_size;
+	uint64_t ring_spills;
+	// running totals for the bounded ring
+	uint64_t ring_weights;
+	uint64_t in_flight;
 
 #ifdef UWSGI_SSL
 	EVP_PKEY *sign_public_key;
@@ -3567,16 +3870,52 @@ struct uwsgi_subscribe_slot {
 
 };
 
+struct uwsgi_subscribe_ring_point {
+	uint32_t hash;
+	struct uwsgi_subscribe_node *node;
+};
+
+struct uwsgi_subscribe_bucket {
+	uint32_t hash;
+	struct uwsgi_subscribe_slot *slot;
+};
+
+// the slots index (open addressing, see core/subscription.c)
+#define UWSGI_SUBSCRIBE_LOOKUP_SAMPLING 64
+
+struct uwsgi_subscribe_table {
+	struct uwsgi_hash_algo *hash;
+	struct uwsgi_subscribe_bucket *buckets;
+	uint64_t size;
+	uint64_t items;
+	uint64_t resizes;
+
+	// only updated by the sampled lookups (see core/subscription.c)
+	uint64_t sampled_lookups;
+	uint64_t lookup_ns;
+	uint64_t probes;
+
+	uint64_t batches;
+	uint64_t heartbeats;
+	uint64_t heartbeat_misses;
+};
+
 void mule_send_msg(int, char *, size_t);
 
 uint32_t djb33x_hash(char *, uint64_t);
 void create_signal_pipe(int *);
 void create_msg_pipe(int *, int);
-struct uwsgi_subscribe_slot *uwsgi_get_subscribe_slot(struct uwsgi_subscribe_slot **, char *, uint16_t);
-struct uwsgi_subscribe_node *uwsgi_get_subscribe_node_by_name(struct uwsgi_subscribe_slot **, char *, uint16_t, char *, uint16_t);
-struct uwsgi_subscribe_node *uwsgi_get_subscribe_node(struct uwsgi_subscribe_slot **, char *, uint16_t);
-int uwsgi_remove_subscribe_node(struct uwsgi_subscribe_slot **, struct uwsgi_subscribe_node *);
-struct uwsgi_subscribe_node *uwsgi_add_subscribe_node(struct uwsgi_subscribe_slot **, struct uwsgi_subscribe_req *);
+struct uwsgi_subscribe_slot *uwsgi_get_subscribe_slot(struct uwsgi_subscribe_table *, char *, uint16_t);
+struct uwsgi_subscribe_node *uwsgi_get_subscribe_node_by_name(struct uwsgi_subscribe_table *, char *, uint16_t, char *, uint16_t);
+struct uwsgi_subscribe_node *uwsgi_get_subscribe_node(struct uwsgi_subscribe_table *, char *, uint16_t);
+struct uwsgi_subscribe_node *uwsgi_subscribe_node_heartbeat(struct uwsgi_subscribe_table *, uint32_t, struct uwsgi_subscribe_req *);
+void uwsgi_subscribe_table_reserve(struct uwsgi_subscribe_table *, uint64_t);
+struct uwsgi_subscribe_node *uwsgi_get_subscribe_node_affinity(struct uwsgi_subscribe_table *, char *, uint16_t, uint32_t);
+uint32_t uwsgi_subscription_key_hash(char *, uint16_t);
+int uwsgi_remove_subscribe_node(struct uwsgi_subscribe_table *, struct uwsgi_subscribe_node *);
+void uwsgi_subscribe_node_unref(struct uwsgi_subscribe_node *);
+void uwsgi_subscribe_node_latency(struct uwsgi_subscribe_node *, uint64_t);
+struct uwsgi_subscribe_node *uwsgi_add_subscribe_node(struct uwsgi_subscribe_table *, struct uwsgi_subscribe_req *);
 
 ssize_t uwsgi_mule_get_msg(int, int, char *, size_t, int);
 
@@ -3804,6 +4143,9 @@ int uwsgi_cheaper_algo_manual(int);
 
 int uwsgi_master_log(void);
 int uwsgi_master_req_log(void);
+void uwsgi_req_log_rings_init(void);
+int uwsgi_req_log_ring_push(struct wsgi_request *, struct iovec *, int);
+void uwsgi_req_log_rings_drain(void);
 void uwsgi_flush_logs(void);
 
 void uwsgi_register_cheaper_algo(char *, int (*)(int));
@@ -3832,6 +4174,7 @@ char *uwsgi_expand_path(char *, int, char *);
 int uwsgi_try_autoload(char *);
 
 uint64_t uwsgi_micros(void);
+uint64_t uwsgi_nanos(void);
 int uwsgi_is_file(char *);
 int uwsgi_is_file2(char *, struct stat *);
 int uwsgi_is_dir(char *);
@@ -3848,6 +4191,22 @@ struct uwsgi_stats {
 	size_t size;
 	int minified;
 	int dirty;
+	// streaming fd (-1 if the whole document is built in memory)
+	int fd;
+	// filters (see uwsgi_stats_want())
+	char *query;
+};
+
+// a client of the master stats server (see uwsgi_send_stats())
+struct uwsgi_stats_client {
+	int fd;
+	// waiting for the http request
+	int reading;
+	struct uwsgi_stats *(*func) (void);
+	// the json not sent yet
+	struct uwsgi_stats *us;
+	time_t last_activity;
+	struct uwsgi_stats_client *next;
 };
 
 struct uwsgi_stats_pusher_instance;
@@ -3882,7 +4241,15 @@ void uwsgi_stats_pusher_loop(struct uwsgi_thread *);
 
 void uwsgi_stats_pusher_setup(void);
 void uwsgi_send_stats(int, struct uwsgi_stats *(*func) (void));
+int uwsgi_stats_client_event(int);
+void uwsgi_stats_clients_check_deadline(void);
 struct uwsgi_stats *uwsgi_master_generate_stats(void);
+struct uwsgi_stats *uwsgi_master_generate_stats_query(char *, int);
+int uwsgi_stats_flush(struct uwsgi_stats *);
+int uwsgi_stats_stream(struct uwsgi_stats *);
+void uwsgi_stats_uncomma(struct uwsgi_stats *);
+int uwsgi_stats_want(struct uwsgi_stats *, char *, char *);
+int uwsgi_stats_want_item(struct uwsgi_stats *, char *, char *, char *, size_t);
 struct uwsgi_stats_pusher * uwsgi_register_stats_pusher(char *, void (*)(struct uwsgi_stats_pusher_instance *, time_t, char *, size_t));
 
 struct uwsgi_stats *uwsgi_stats_new(size_t);
@@ -3944,7 +4311,7 @@ char *uwsgi_md5(char *, size_t, char *);
 
 void uwsgi_opt_ssa(char *, char *, void *);
 
-int uwsgi_no_subscriptions(struct uwsgi_subscribe_slot **);
+int uwsgi_no_subscriptions(struct uwsgi_subscribe_table *);
 void uwsgi_deadlock_check(pid_t);
 
 
@@ -3952,19 +4319,32 @@ struct uwsgi_logchunk {
 	char *name;
 	char *ptr;
 	size_t len;
-	int vec;
 	long pos;
 	long pos_len;
 	int type;
 	int free;
 	ssize_t(*func) (struct wsgi_request *, char **);
+	ssize_t(*bfunc) (struct wsgi_request *, struct uwsgi_buffer *);
 	struct uwsgi_logchunk *next;
 };
 
+// a compiled logchunk
+struct uwsgi_logop {
+	int type;
+	int free;
+	char *ptr;
+	size_t len;
+	long pos;
+	long pos_len;
+	ssize_t(*func) (struct wsgi_request *, char **);
+	ssize_t(*bfunc) (struct wsgi_request *, struct uwsgi_buffer *);
+};
+
 void uwsgi_build_log_format(char *);
 
-void uwsgi_add_logchunk(int, int, char *, size_t);
+void uwsgi_add_logchunk(int, char *, size_t);
 struct uwsgi_logchunk *uwsgi_register_logchunk(char *, ssize_t (*)(struct wsgi_request *, char **), int);
+struct uwsgi_logchunk *uwsgi_register_logchunk_buffer(char *, ssize_t (*)(struct wsgi_request *, struct uwsgi_buffer *));
 
 void uwsgi_logit_simple(struct wsgi_request *);
 void uwsgi_logit_lf(struct wsgi_request *);
@@ -4147,9 +4527,10 @@ struct uwsgi_thread {
 	uint64_t custom1;
 	uint64_t custom2;
 	uint64_t custom3;
-	// linked list for offloaded requests
-	struct uwsgi_offload_request *offload_requests_head;
-	struct uwsgi_offload_request *offload_requests_tail;
+	// offloaded requests indexed by each of their file descriptors
+	struct uwsgi_offload_request **offload_table;
+	// requests assigned to the thread (updated atomically, read by the dispatchers)
+	int offload_active;
 	void (*func) (struct uwsgi_thread *);
 };
 struct uwsgi_thread *uwsgi_thread_new(void (*)(struct uwsgi_thread *));
@@ -4187,17 +4568,29 @@ struct uwsgi_offload_request {
 	// this pipe is used for notifications
 	int pipe[2];
 
-	struct uwsgi_offload_request *prev;
-	struct uwsgi_offload_request *next;
+	// kernel side buffer for splice() based engines
+	int splice_pipe[2];
+};
+
+// shared by all of the workers, updated atomically
+struct uwsgi_offload_engine_counters {
+	uint64_t requests;
+	uint64_t active;
+	uint64_t bytes;
+	uint64_t errors;
 };
 
 struct uwsgi_offload_engine {
 	char *name;
 	int (*prepare_func)(struct wsgi_request *, struct uwsgi_offload_request *);
 	int (*event_func) (struct uwsgi_thread *, struct uwsgi_offload_request *, int);
+	struct uwsgi_offload_engine_counters *counters;
 	struct uwsgi_offload_engine *next;	
 };
 
+void uwsgi_offload_account(struct uwsgi_offload_request *, ssize_t);
+void uwsgi_offload_error(struct uwsgi_offload_request *, char *);
+
 struct uwsgi_offload_engine *uwsgi_offload_engine_by_name(char *);
 struct uwsgi_offload_engine *uwsgi_offload_register_engine(char *, int (*)(struct wsgi_request *, struct uwsgi_offload_request *), int (*) (struct uwsgi_thread *, struct uwsgi_offload_request *, int));
 
@@ -4207,6 +4600,7 @@ void uwsgi_offload_engines_register_all(void);
 
 struct uwsgi_thread *uwsgi_offload_thread_start(void);
 int uwsgi_offload_request_sendfile_do(struct wsgi_request *, int, size_t);
+int uwsgi_offload_request_sendfile_pos_do(struct wsgi_request *, int, size_t, size_t);
 int uwsgi_offload_request_net_do(struct wsgi_request *, char *, struct uwsgi_buffer *);
 int uwsgi_offload_request_memory_do(struct wsgi_request *, char *, size_t);
 int uwsgi_offload_request_pipe_do(struct wsgi_request *, int, size_t);
@@ -4216,7 +4610,7 @@ int uwsgi_simple_write(struct wsgi_request *, char *, size_t);
 
 
 void uwsgi_subscription_set_algo(char *);
-struct uwsgi_subscribe_slot **uwsgi_subscription_init_ht(void);
+struct uwsgi_subscribe_table *uwsgi_subscription_init_ht(void);
 
 int uwsgi_check_pidfile(char *);
 void uwsgi_daemons_spawn_all();
@@ -4230,6 +4624,7 @@ void uwsgi_loop_cores_run(void *(*)(void *));
 
 int uwsgi_kvlist_parse(char *, size_t, char, char, ...);
 int uwsgi_send_http_stats(int);
+int uwsgi_send_http_stats_query(int, char *, size_t);
 
 ssize_t uwsgi_simple_request_read(struct wsgi_request *, char *, size_t);
 int uwsgi_plugin_modifier1(char *);
@@ -4298,6 +4693,8 @@ char *uwsgi_chunked_read(struct wsgi_request *, size_t *, int, int);
 uint16_t uwsgi_be16(char *);
 uint32_t uwsgi_be32(char *);
 uint64_t uwsgi_be64(char *);
+uint16_t uwsgi_le16(char *);
+uint64_t uwsgi_le64(char *);
 
 int uwsgi_websocket_handshake(struct wsgi_request *, char *, uint16_t, char *, uint16_t, char *, uint16_t);
 
@@ -4372,6 +4769,8 @@ void uwsgi_master_check_chain(void);
 
 void uwsgi_master_fix_request_counters(void);
 int uwsgi_master_manage_events(int);
+void uwsgi_master_fd_closed(int);
+int uwsgi_master_fd_is_stale(int);
 
 void uwsgi_block_signal(int);
 void uwsgi_unblock_signal(int);
@@ -4437,6 +4836,10 @@ int uwsgi_cache_magic_set(char *, uint16_t, char *, uint64_t, uint64_t, uint64_t
 int uwsgi_cache_magic_del(char *, uint16_t, char *);
 int uwsgi_cache_magic_exists(char *, uint16_t, char *);
 int uwsgi_cache_magic_clear(char *);
+int64_t uwsgi_cache_magic_mget(uint64_t, char **, uint16_t *, char **, uint64_t *, char *);
+int64_t uwsgi_cache_magic_mset(uint64_t, char **, uint16_t *, char **, uint64_t *, uint64_t, uint64_t, char *);
+uint64_t uwsgi_cache_mget(struct uwsgi_cache *, uint64_t, char **, uint16_t *, char **, uint64_t *);
+uint64_t uwsgi_cache_mset(struct uwsgi_cache *, uint64_t, char **, uint16_t *, char **, uint64_t *, uint64_t, uint64_t);
 void uwsgi_cache_magic_context_hook(char *, uint16_t, char *, uint16_t, void *);
 
 char *uwsgi_legion_scrolls(char *, uint64_t *);
@@ -4519,6 +4922,11 @@ struct uwsgi_cache_item *uwsgi_cache_keys(struct uwsgi_cache *, uint64_t *, stru
 void uwsgi_cache_rlock(struct uwsgi_cache *);
 void uwsgi_cache_rwunlock(struct uwsgi_cache *);
 char *uwsgi_cache_item_key(struct uwsgi_cache_item *);
+struct uwsgi_cache *uwsgi_cache_shard(struct uwsgi_cache *, char *, uint16_t);
+int uwsgi_cache_clear(struct uwsgi_cache *);
+void uwsgi_cache_policy_register(struct uwsgi_cache_policy *);
+struct uwsgi_cache_policy *uwsgi_cache_policy_get(char *);
+char *uwsgi_cache_get_lockless(struct uwsgi_cache *, char *, uint16_t, uint64_t *, uint64_t *, int *);
 
 char *uwsgi_binsh(void);
 int uwsgi_file_executable(char *);
@@ -4534,6 +4942,8 @@ struct uwsgi_hook *uwsgi_hook_by_name(char *);
 void uwsgi_register_base_hooks(void);
 
 void uwsgi_setup_log_encoders(void);
+int uwsgi_log_encoders_flush_freq(void);
+void uwsgi_log_encoders_flush(int);
 void uwsgi_log_encoders_register_embedded(void);
 
 void uwsgi_register_log_encoder(char *, char *(*)(struct uwsgi_log_encoder *, char *, size_t, size_t *));
@@ -594,7 +594,7 @@ class uConf(object):
             'core/plugins', 'core/lock', 'core/cache', 'core/daemons', 'core/errors', 'core/hash', 'core/master_events', 'core/chunked',
             'core/queue', 'core/event', 'core/signal', 'core/strings', 'core/progress', 'core/timebomb', 'core/ini', 'core/fsmon', 'core/mount',
             'core/metrics', 'core/plugins_builder', 'core/sharedarea',
-            'core/rpc', 'core/gateway', 'core/loop', 'core/cookie', 'core/querystring', 'core/rb_timers', 'core/transformations', 'core/uwsgi']
+            'core/rpc', 'core/gateway', 'core/loop', 'core/cookie', 'core/querystring', 'core/http', 'core/rb_timers', 'core/transformations', 'core/uwsgi']
         # add protocols
         self.gcc_list.append('proto/base')
         self.gcc_list.append('proto/uwsgi')
@@ -889,6 +889,11 @@ class uConf(object):
             self.cflags.append('-DUWSGI_EVENT_USE_PORT')
         elif event_mode == 'poll':
             self.cflags.append('-DUWSGI_EVENT_USE_POLL')
+        elif event_mode == 'io_uring':
+            if not self.has_include('linux/io_uring.h'):
+                print("*** linux/io_uring.h not found, io_uring event engine not available ***")
+                sys.exit(1)
+            self.cflags.append('-DUWSGI_EVENT_USE_IO_URING')
 
         report['event'] = event_mode
 